@@ -0,0 +1,121 @@
+#include <string>
+#include <vector>
+#include <ctime>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/format.hpp>
+#include "collector/catalog.hpp"
+
+/**
+ * Function for converting date "YYYY-MM-DD" or "YYYY-MM-DD HH:MM:SS" (UTC)
+ * into seconds since epoch.
+ */
+static
+double ParseDate(const std::string &text) {
+  std::tm tm = {};
+  const char *end = ::strptime(text.c_str(), "%Y-%m-%d %H:%M:%S", &tm);
+  if (end == 0) {
+    tm  = std::tm();
+    end = ::strptime(text.c_str(), "%Y-%m-%d", &tm);
+  }
+  if (end == 0 || *end != 0) {
+    throw std::invalid_argument("Invalid date: " + text);
+  }
+  return ::timegm(&tm);
+}
+
+static
+void PrintEntries(const CaptureCatalog::Entries &entries) {
+  for (const auto &ent : entries) {
+    std::cout << ent.path << "\n\t" << ent.header.type_of_measurement
+              << " | " << ent.header.time_of_start
+              << " | Ref.osc: " << ent.header.ref_osc
+              << " | " << boost::format("%.2f s") % ent.GetDuration()
+              << " | " << (ent.size >> 10) << " KB" << std::endl;
+  }
+  std::cout << "Found captures: " << entries.size() << std::endl;
+}
+
+int main(int arg_amount, char **arg_values) {
+  namespace po = boost::program_options;
+  po::options_description desc("Catalog of captures for OROLIA demo");
+  desc.add_options()
+    ("help", "this description")
+    ("index", po::value<std::string>()->default_value("captures.idx"),
+              "path to index file, it is updated after scanning")
+    ("scan", po::value<std::vector<std::string>>(),
+              "directory for scanning (with subdirectories), can be repeated")
+    ("ext", po::value<std::string>()->default_value(".txt"),
+              "extension of capture files, empty - all files")
+    ("threads", po::value<unsigned>()->default_value(8),
+              "amount of threads, which read files")
+    ("type", po::value<std::string>()->default_value(""),
+              "type of measurement, for example \"FREQUENCY A\"")
+    ("ref-osc", po::value<std::string>()->default_value(""),
+              "reference oscillator, for example \"External\"")
+    ("input", po::value<std::string>()->default_value(""),
+              "settings of input A or B")
+    ("path", po::value<std::string>()->default_value(""),
+              "part of path")
+    ("from", po::value<std::string>(),
+              "the earliest start of capture: YYYY-MM-DD[ HH:MM:SS]")
+    ("to", po::value<std::string>(),
+              "the latest start of capture: YYYY-MM-DD[ HH:MM:SS]")
+    ("min-duration", po::value<double>(),
+              "the lowest duration of capture (s)");
+  try {
+    po::variables_map vm;
+    po::store(po::parse_command_line(arg_amount, arg_values, desc), vm);
+    po::notify(vm);
+    if (vm.count("help")) {
+      std::cout << desc << std::endl;
+      return 0;
+    }
+    CaptureCatalog catalog;
+    const auto kIndex = vm["index"].as<std::string>();
+    if (boost::filesystem::exists(kIndex) && not catalog.Load(kIndex)) {
+      std::cout << catalog.GetMessage() << std::endl;
+      return 1;
+    }
+    if (vm.count("scan")) {
+      for (const auto &dir : vm["scan"].as<std::vector<std::string>>()) {
+        if (not catalog.Scan(dir, vm["ext"].as<std::string>(),
+                             vm["threads"].as<unsigned>())) {
+          std::cout << catalog.GetMessage() << std::endl;
+          return 1;
+        }
+        const auto &stat = catalog.GetScanStatistics();
+        std::cout << "Scanned " << dir << ": " << stat.files << " files, "
+                  << stat.read << " read, " << stat.unchanged
+                  << " unchanged, " << stat.removed << " removed, "
+                  << stat.invalid << " without header" << std::endl;
+      }
+      if (not catalog.Save(kIndex)) {
+        std::cout << catalog.GetMessage() << std::endl;
+        return 1;
+      }
+    }
+    CaptureCatalog::Query query;
+    query.type    = vm["type"].as<std::string>();
+    query.ref_osc = vm["ref-osc"].as<std::string>();
+    query.input   = vm["input"].as<std::string>();
+    query.path    = vm["path"].as<std::string>();
+    if (vm.count("from")) {
+      query.start_from = ParseDate(vm["from"].as<std::string>());
+    }
+    if (vm.count("to")) {
+      query.start_to = ParseDate(vm["to"].as<std::string>());
+    }
+    if (vm.count("min-duration")) {
+      query.min_duration = vm["min-duration"].as<double>();
+    }
+    PrintEntries(catalog.Find(query));
+  } catch (const std::exception &e) {
+    std::cout << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,290 @@
+#include "async_data_source.hpp"
+#include <cerrno>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// class AsyncFileDataSource::Settings
+AsyncFileDataSource::Settings::Settings()
+    : block_size(1 << 20),
+      queue_depth(4),
+      direct(false),
+      backend(kAutoBackend) {
+}
+// class AsyncFileDataSource::Block
+AsyncFileDataSource::Block::Block()
+    : data(0),
+      offset(0),
+      size(0),
+      expected(0),
+      pending(false) {
+}
+// class AsyncFileDataSource
+AsyncFileDataSource::AsyncFileDataSource(const std::string &path,
+                                         const Settings &settings)
+    : VoidDataSource(),
+      _file(path),
+      _settings(settings),
+      _fd(-1),
+      _file_size(0),
+      _read_offset(0),
+      _current(0),
+      _pos(0),
+      _carry_len(0),
+      _direct(false) {
+  // direct reading requires aligned offsets and sizes
+  const uint32_t kBlocks = (_settings.block_size + kAlignment - 1)
+                         / kAlignment;
+  _settings.block_size  = (kBlocks > 0 ? kBlocks : 1) * kAlignment;
+  _settings.queue_depth = std::max<uint32_t>(_settings.queue_depth, 1);
+}
+
+AsyncFileDataSource::~AsyncFileDataSource() {
+  FreeBlocks();
+}
+
+std::string AsyncFileDataSource::GetBackendName() const {
+  if (not _reader) {
+    return "";
+  }
+  return std::string(_reader->GetName()) + (_direct ? ", direct" : "");
+}
+
+bool AsyncFileDataSource::CreateReader() {
+  const auto kBackend = _settings.backend;
+  if (kBackend == kAutoBackend || kBackend == kUringBackend) {
+    _reader.reset(new UringBlockReader());
+    if (_reader->Open(_fd, _settings.queue_depth)) {
+      return true;
+    }
+    if (kBackend == kUringBackend) {
+      SetMessage(_reader->GetMessage());
+      _reader.reset();
+      return false;
+    }
+  }
+  _reader.reset(new PreadBlockReader());
+  if (not _reader->Open(_fd, _settings.queue_depth)) {
+    SetMessage(_reader->GetMessage());
+    _reader.reset();
+    return false;
+  }
+  return true;
+}
+
+void AsyncFileDataSource::FreeBlocks() {
+  // reader waits for reads in flight, so buffers are freed after it
+  _reader.reset();
+  for (auto &block : _blocks) {
+    std::free(block.data);
+  }
+  _blocks.clear();
+  if (_fd >= 0) {
+    ::close(_fd);
+    _fd = -1;
+  }
+}
+
+bool AsyncFileDataSource::OccupySource() {
+  FreeBlocks();
+  _direct = _settings.direct;
+  _fd = ::open(_file.c_str(), O_RDONLY | (_direct ? O_DIRECT : 0));
+  if (_fd < 0 && _direct && errno == EINVAL) {
+    // file system does not support direct reading
+    _direct = false;
+    _fd     = ::open(_file.c_str(), O_RDONLY);
+  }
+  struct stat st;
+  if (_fd < 0 || ::fstat(_fd, &st) != 0) {
+    SetMessage("Failed to open file: " + _file);
+    FreeBlocks();
+    return false;
+  }
+  _file_size   = st.st_size;
+  _read_offset = 0;
+  _current     = 0;
+  _pos         = 0;
+  _carry_len   = 0;
+  _blocks.resize(_settings.queue_depth);
+  for (auto &block : _blocks) {
+    // additional byte is used for terminating of the last line
+    if (::posix_memalign((void**)&block.data, kAlignment,
+                         _settings.block_size + kAlignment) != 0) {
+      block.data = 0;
+      SetMessage("Failed to allocate buffers for reading");
+      FreeBlocks();
+      return false;
+    }
+  }
+  if (not CreateReader()) {
+    FreeBlocks();
+    return false;
+  }
+  for (uint32_t slot = 0; slot < _blocks.size(); ++slot) {
+    if (not SubmitBlock(slot)) {
+      SetMessage(_reader->GetMessage());
+      FreeBlocks();
+      return false;
+    }
+  }
+  return VoidDataSource::OccupySource();
+}
+
+void AsyncFileDataSource::ReleaseSource() {
+  FreeBlocks();
+  VoidDataSource::ReleaseSource();
+}
+
+bool AsyncFileDataSource::SubmitBlock(uint32_t slot) {
+  Block &block = _blocks[slot];
+  block.offset   = _read_offset;
+  block.size     = 0;
+  block.expected = 0;
+  block.pending  = false;
+  if (_read_offset >= _file_size) {
+    return true;
+  }
+  block.expected = std::min<uint64_t>(_settings.block_size,
+                                      _file_size - _read_offset);
+  if (not SubmitRest(slot)) {
+    return false;
+  }
+  _read_offset += _settings.block_size;
+  return true;
+}
+
+bool AsyncFileDataSource::SubmitRest(uint32_t slot) {
+  Block &block = _blocks[slot];
+  if (_direct) {
+    // direct reading requires aligned offsets and sizes, so the partially
+    // read sector is read again
+    block.size -= block.size % kAlignment;
+  }
+  if (not _reader->Submit(slot, block.data + block.size,
+                          _settings.block_size - block.size,
+                          block.offset + block.size)) {
+    SetReadFailure(_reader->GetMessage());
+    return false;
+  }
+  block.pending = true;
+  return true;
+}
+
+bool AsyncFileDataSource::WaitBlock(uint32_t slot) {
+  while (_blocks[slot].pending) {
+    uint32_t done   = 0;
+    int64_t  result = 0;
+    if (not _reader->Wait(&done, &result)) {
+      SetReadFailure(_reader->GetMessage());
+      return false;
+    }
+    Block &block = _blocks[done];
+    block.pending = false;
+    if (result < 0) {
+      block.size = result;
+      continue;
+    }
+    block.size += result;
+    // reading may complete partially before the end of file, the rest of
+    // the block is read again (reading of nothing means the end of file)
+    if (result > 0 && block.size < block.expected &&
+        not SubmitRest(done)) {
+      return false;
+    }
+  }
+  const Block &block = _blocks[slot];
+  if (block.size < 0) {
+    SetReadFailure("Failed to read file: " + _file + " ("
+               + std::strerror(-block.size) + ")");
+    return false;
+  }
+  if (block.size < block.expected) {
+    SetReadFailure("Unexpected end of file: " + _file);
+    return false;
+  }
+  return true;
+}
+
+int16_t AsyncFileDataSource::NextLine(const char **line) {
+  while (not IsReadFailed()) {
+    if (not WaitBlock(_current)) {
+      break;
+    }
+    Block &block = _blocks[_current];
+    if (block.size == 0) {
+      // end of file, the last line may have no line feed
+      if (_carry_len == 0) {
+        return -1;
+      }
+      const int16_t kLen = _carry_len;
+      _carry[_carry_len] = 0;
+      _carry_len = 0;
+      *line = _carry;
+      return kLen;
+    }
+    char  *begin = block.data + _pos;
+    char  *end   = block.data + block.size;
+    char  *feed  = (char*)std::memchr(begin, '\n', end - begin);
+    if (feed != 0) {
+      const size_t kLen = feed - begin + 1;
+      if (_carry_len + kLen > kLineSize) {
+        SetReadFailure("Too long line in file: " + _file);
+        break;
+      }
+      _pos += kLen;
+      if (_carry_len == 0) {
+        *feed = 0;
+        *line = begin;
+        return kLen;
+      }
+      // the line crosses the border of blocks
+      std::memcpy(_carry + _carry_len, begin, kLen - 1);
+      _carry[_carry_len + kLen - 1] = 0;
+      const int16_t kCarryLen = _carry_len + kLen;
+      _carry_len = 0;
+      *line = _carry;
+      return kCarryLen;
+    }
+    const size_t kTail = end - begin;
+    if (_carry_len + kTail > kLineSize) {
+      SetReadFailure("Too long line in file: " + _file);
+      break;
+    }
+    std::memcpy(_carry + _carry_len, begin, kTail);
+    _carry_len += kTail;
+    // the block is parsed, so the next block is read into it
+    if (not SubmitBlock(_current)) {
+      break;
+    }
+    _current = (_current + 1) % _blocks.size();
+    _pos     = 0;
+  }
+  return kFailedLine;
+}
+
+int16_t AsyncFileDataSource::GetLine(char *line, uint8_t max_len) {
+  const char *src  = 0;
+  const auto  kLen = NextLine(&src);
+  if (kLen < 0) {
+    return kLen;
+  }
+  const size_t kCopy = std::min<size_t>(kLen, max_len - 1);
+  std::memcpy(line, src, kCopy);
+  line[kCopy] = 0;
+  return kLen;
+}
+
+bool AsyncFileDataSource::GetRecord(Record *out) {
+  const char *line = 0;
+  const auto  kLen = NextLine(&line);
+  return ParseLine(line, kLen, out);
+}
+
+bool AsyncFileDataSource::GetRow(Row *out) {
+  const char *line = 0;
+  const auto  kLen = NextLine(&line);
+  return ParseRow(line, kLen, out);
+}
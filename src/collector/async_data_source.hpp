@@ -0,0 +1,89 @@
+#ifndef ASYNC_DATA_SOURCE_HPP
+#define ASYNC_DATA_SOURCE_HPP
+
+#include "data_source.hpp"
+#include "block_reader.hpp"
+
+/**
+ * Data source for reading records from text file by big blocks, several
+ * blocks are read asynchronously while previous blocks are parsed. Lines
+ * are parsed right inside of read blocks, only lines, which cross the
+ * border of blocks, are copied. Reading is done by io_uring, if it is
+ * available, otherwise by the pool of threads with "pread".
+ * Direct reading (O_DIRECT) bypasses the page cache, so loading of big
+ * captures does not evict cached data of other programs.
+ */
+class AsyncFileDataSource : public VoidDataSource {
+  public:
+    enum Backend {
+      kAutoBackend,
+      kUringBackend,
+      kPreadBackend
+    };
+    struct Settings {
+      Settings();
+
+      uint32_t block_size;  // bytes, it is rounded up to kAlignment
+      uint32_t queue_depth; // amount of blocks in flight
+      bool     direct;
+      Backend  backend;
+    };
+
+    AsyncFileDataSource(const std::string &path,
+                        const Settings &settings = Settings());
+    virtual ~AsyncFileDataSource();
+    virtual bool GetRecord(Record *out);
+    virtual bool GetRow(Row *out);
+    /**
+     * @return name of used reader or empty string if source is not
+     *         occupied.
+     */
+    std::string GetBackendName() const;
+  protected:
+    virtual bool OccupySource();
+    virtual int16_t GetLine(char *line, uint8_t max_len);
+    virtual void ReleaseSource();
+  private:
+    static const size_t kAlignment = 4096;
+
+    struct Block {
+      Block();
+
+      char    *data;
+      uint64_t offset;   // offset of the block in file
+      int64_t  size;     // amount of read bytes or -errno
+      int64_t  expected; // amount of bytes before the end of file
+      bool     pending;  // reading is in flight
+    };
+
+    bool CreateReader();
+    bool SubmitBlock(uint32_t slot);
+    /**
+     * Method for reading the rest of the block after its read bytes, in
+     * the direct mode from the beginning of the partially read sector.
+     */
+    bool SubmitRest(uint32_t slot);
+    bool WaitBlock(uint32_t slot);
+    /**
+     * Method for getting the next line without copying. The line is
+     * terminated by zero, the pointer is valid until the next call.
+     * @return length of the line including line feed, -1 at the end or
+     *         "kFailedLine" if reading has failed.
+     */
+    int16_t NextLine(const char **line);
+    void FreeBlocks();
+
+    const std::string   _file;
+    Settings            _settings;
+    int                 _fd;
+    uint64_t            _file_size;
+    uint64_t            _read_offset;
+    BlockReader::UnqPtr _reader;
+    std::vector<Block>  _blocks;
+    uint32_t            _current;
+    size_t              _pos;
+    char                _carry[kLineSize + 1];
+    size_t              _carry_len;
+    bool                _direct;
+};
+#endif
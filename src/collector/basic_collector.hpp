@@ -0,0 +1,591 @@
+#ifndef BASIC_COLLECTOR_HPP
+#define BASIC_COLLECTOR_HPP
+
+#include <list>
+#include "compressor.hpp"
+#include "detector.hpp"
+#include "exporter.hpp"
+#include "sample_store.hpp"
+#include "transform.hpp"
+#include "pipeline.hpp"
+#include "shared_view.hpp"
+#include "checkpoint.hpp"
+#include "drift.hpp"
+
+/**
+ * Policies of calling methods of the loading loop ("GetRecord" of data
+ * source and "PushRecord" of compressor):
+ * - StaticDispatch : methods are called by qualified names, so they are
+ *                    resolved at compile time and can be inlined. Objects
+ *                    must have exactly the types of template parameters;
+ * - VirtualDispatch: methods are called through virtual table, so objects
+ *                    can have any derived type.
+ */
+struct StaticDispatch {
+  template <class Source>
+  static bool GetRecord(Source *src, VoidDataSource::Record *out) {
+    return src->Source::GetRecord(out);
+  }
+  template <class Source>
+  static bool GetRow(Source *src, VoidDataSource::Row *out) {
+    return src->Source::GetRow(out);
+  }
+  template <class Comp>
+  static bool PushRecord(Comp *comp, const VoidDataSource::Record &rec) {
+    return comp->Comp::PushRecord(rec);
+  }
+};
+
+struct VirtualDispatch {
+  template <class Source>
+  static bool GetRecord(Source *src, VoidDataSource::Record *out) {
+    return src->GetRecord(out);
+  }
+  template <class Source>
+  static bool GetRow(Source *src, VoidDataSource::Row *out) {
+    return src->GetRow(out);
+  }
+  template <class Comp>
+  static bool PushRecord(Comp *comp, const VoidDataSource::Record &rec) {
+    return comp->PushRecord(rec);
+  }
+};
+
+/**
+ * Class for loading records from data source into compressor and other
+ * consumers (detector, exporter, storage of raw records).
+ * @param Source   type of data source, derived from "VoidDataSource";
+ * @param Comp     type of compressor, derived from "Compressor";
+ * @param Dispatch policy of calling methods of the loading loop.
+ */
+template <class Source, class Comp, class Dispatch = StaticDispatch>
+class BasicCollector {
+  public:
+    typedef std::list<std::string>  Messages;
+    typedef std::shared_ptr<Source> SourcePtr;
+    typedef std::shared_ptr<Comp>   CompPtr;
+    typedef std::vector<CompPtr>    CompPtrs;
+
+    BasicCollector() {}
+
+    void UseCompressor(Comp *ptr) {
+      _comp.reset(ptr);
+    }
+    void UseDataSource(Source *ptr) {
+      _source.reset(ptr);
+    }
+    void UseDetector(Detector *ptr) {
+      _detector.reset(ptr);
+    }
+    /**
+     * Method for setting exporter of loaded records. Records are written
+     * during loading, before compression.
+     */
+    void UseExporter(Exporter *ptr) {
+      _exporter.reset(ptr);
+    }
+    /**
+     * Method for setting storage of raw records. Records are stored during
+     * loading, so they can be used for zooming and analysis.
+     */
+    void UseSampleStore(SampleStore *ptr) {
+      _store.reset(ptr);
+    }
+    /**
+     * Method for setting runtime configured transformation of records,
+     * it is applied by "FetchAllRecords()" before all consumers. It can not
+     * be used with several channels.
+     */
+    void UseTransform(TransformChain *ptr) {
+      _transform.reset(ptr);
+    }
+    /**
+     * Method for enabling pipelined loading: reading, parsing and
+     * consuming of records are done by different threads. Null pointer
+     * disables it.
+     */
+    void UsePipeline(LoadingPipeline *ptr) {
+      _pipeline.reset(ptr);
+    }
+    /**
+     * Method for loading several columns of values (channels) of the data
+     * source. Every channel gets its own compressor with the same size,
+     * all of them receive the same time labels, so their buckets are
+     * aligned. The first channel is the main one: it is passed through
+     * transformation stages and to all other consumers, other channels
+     * are only compressed (for records passed by the stages).
+     * Pipelined loading does not support several channels.
+     * @param channels indexes of columns (please look at
+     *                 "VoidDataSource::SelectChannels").
+     */
+    void UseChannels(const VoidDataSource::Channels &channels) {
+      _channels = channels;
+    }
+    /**
+     * Method for publishing state of the main compressor into shared
+     * memory during loading, so other processes can show it. The segment
+     * is created by "Begin()", the final state is published by "End()".
+     */
+    void UsePublisher(SharedViewWriter *ptr) {
+      _publisher.reset(ptr);
+    }
+    /**
+     * Method for saving checkpoints of loading (states of compressors and
+     * estimator of drift, position of data source and messages)
+     * periodically during
+     * "FetchAllRecords()" and after its end, so loading can be continued
+     * by "Resume()" after restart of the process. Data source must
+     * support positions ("FileDataSource"), pipelined loading is not
+     * supported.
+     */
+    void UseCheckpoints(CheckpointWriter *ptr) {
+      _checkpoints.reset(ptr);
+    }
+    /**
+     * Method for estimating drift of values of the main channel during
+     * loading. The fit is calculated after the end of records, in the
+     * subtract mode the drift is subtracted from buckets of the main
+     * compressor, so its scale of values is not dominated by the ramp.
+     */
+    void UseDriftEstimator(DriftEstimator *ptr) {
+      _drift.reset(ptr);
+    }
+    /**
+     * Method for continuing loading from the checkpoint, it is called
+     * after "Begin()" with the same settings of compressors, channels and
+     * estimator of drift. States of other consumers (detector, exporter,
+     * storage, transformation) are not saved, so they would get only
+     * records after the checkpoint and the result would differ from the
+     * uninterrupted loading: loading with them is not continued (the
+     * exporter must not be used at all, "Begin()" truncates its file).
+     * @return false if checkpoint can not be read or it does not match
+     *         settings of loading or the file of data source.
+     */
+    bool Resume(const std::string &path);
+    /**
+     * Method for cancelling of loading by another thread (for example,
+     * loading is a task of the scheduler and GUI cancels it): the token is
+     * checked for every record, so "FetchAllRecords()" returns false soon
+     * after cancelling, "End()" releases data source as usually.
+     */
+    void UseCancelToken(CancelToken *ptr) {
+      _cancel.reset(ptr);
+    }
+    CompPtr GetCompressor() const {
+      return _comp;
+    }
+    /**
+     * @param channel index of channel in the selection;
+     * @return compressor of the channel or null pointer.
+     */
+    CompPtr GetCompressor(size_t channel) const {
+      if (channel == 0) {
+        return _comp;
+      }
+      return channel <= _channel_comps.size() ? _channel_comps[channel - 1]
+                                              : CompPtr();
+    }
+    size_t GetChannelsAmount() const {
+      return _channel_comps.size() + 1;
+    }
+    const VoidDataSource::Channels& GetChannels() const {
+      return _channels;
+    }
+    SourcePtr GetDataSource() const {
+      return _source;
+    }
+    Detector::ShrPtr GetDetector() const {
+      return _detector;
+    }
+    Exporter::ShrPtr GetExporter() const {
+      return _exporter;
+    }
+    SampleStore::ShrPtr GetSampleStore() const {
+      return _store;
+    }
+    TransformChain::ShrPtr GetTransform() const {
+      return _transform;
+    }
+    LoadingPipeline::ShrPtr GetPipeline() const {
+      return _pipeline;
+    }
+    SharedViewWriter::ShrPtr GetPublisher() const {
+      return _publisher;
+    }
+    CheckpointWriter::ShrPtr GetCheckpoints() const {
+      return _checkpoints;
+    }
+    CancelToken::ShrPtr GetCancelToken() const {
+      return _cancel;
+    }
+    DriftEstimator::ShrPtr GetDriftEstimator() const {
+      return _drift;
+    }
+    bool GetDataHeader(VoidDataSource::Header *out) const;
+    bool Begin();
+    bool FetchAllRecords();
+    /**
+     * Method for loading records through composed stages (please look at
+     * "transform.hpp"). Stages are inlined into the loading loop, records,
+     * which were dropped by stages, are not passed to consumers. Stages
+     * get only values of the first channel, values of other channels are
+     * not changed, they are dropped together with the row.
+     * @param pipe functor: bool (VoidDataSource::Record &rec);
+     * @return false if one of consumers or reading of the source has
+     *         failed.
+     */
+    template <class Pipe>
+    bool FetchAllRecords(Pipe &pipe);
+    void End();
+    const Messages& GetMessages() const {
+      return _messages;
+    }
+  private:
+    /**
+     * Data source is occupied and released through the base class, because
+     * derived classes hide these methods.
+     */
+    VoidDataSource* GetBaseSource() const {
+      return _source.get();
+    }
+    void RegisterMessage(const std::string &msg) {
+      if (not msg.empty()) {
+        _messages.emplace_back(msg);
+      }
+    }
+    /**
+     * Method for passing loaded record to all consumers.
+     * @return false if one of consumers has failed, its message is
+     *         registered.
+     */
+    bool ConsumeRecord(const VoidDataSource::Record &rec, uint32_t line);
+    /**
+     * Method for passing copy of the loading state to the writer of
+     * checkpoints, it is called between records.
+     */
+    void SaveCheckpoint();
+    /**
+     * @return true if loading is cancelled, the message is registered.
+     */
+    bool IsCancelled() {
+      if (_cancel && _cancel->IsCancelled()) {
+        RegisterMessage("Loading is cancelled");
+        return true;
+      }
+      return false;
+    }
+    /**
+     * Method for fitting the drift after the end of records and
+     * subtracting it in the subtract mode.
+     */
+    void FinishDrift() {
+      if (not _drift) {
+        return;
+      }
+      if (not _drift->Fit()) {
+        RegisterMessage(_drift->GetMessage());
+      } else if (_drift->GetSettings().mode == DriftEstimator::kSubtract) {
+        _drift->SubtractDrift(_comp.get());
+      }
+    }
+    /**
+     * Method for loading rows of several channels.
+     */
+    template <class Pipe>
+    bool FetchAllRows(Pipe &pipe);
+
+    CompPtr                  _comp;
+    SourcePtr                _source;
+    Detector::ShrPtr         _detector;
+    Exporter::ShrPtr         _exporter;
+    SampleStore::ShrPtr      _store;
+    TransformChain::ShrPtr   _transform;
+    LoadingPipeline::ShrPtr  _pipeline;
+    SharedViewWriter::ShrPtr _publisher;
+    CheckpointWriter::ShrPtr _checkpoints;
+    CancelToken::ShrPtr      _cancel;
+    DriftEstimator::ShrPtr   _drift;
+    VoidDataSource::Channels _channels;
+    CompPtrs                 _channel_comps;
+    Messages                 _messages;
+};
+
+template <class Source, class Comp, class Dispatch>
+bool BasicCollector<Source, Comp, Dispatch>::GetDataHeader(
+    VoidDataSource::Header *out) const {
+  if (not _source || out == 0) {
+    return false;
+  }
+  *out = GetBaseSource()->GetHeader();
+  return true;
+}
+
+template <class Source, class Comp, class Dispatch>
+bool BasicCollector<Source, Comp, Dispatch>::Begin() {
+  _channel_comps.clear();
+  if (not _channels.empty()) {
+    if (_pipeline && _channels.size() > 1) {
+      RegisterMessage("Pipelined loading does not support several channels");
+      return false;
+    }
+    // stages keep state of one series and may drop records, so other
+    // columns of rows would be left untransformed
+    if (_transform && _channels.size() > 1) {
+      RegisterMessage("Transform of records does not support several "
+                      "channels");
+      return false;
+    }
+    if (not GetBaseSource()->SelectChannels(_channels)) {
+      RegisterMessage(_source->GetMessage());
+      return false;
+    }
+    for (size_t i = 1; i < _channels.size(); ++i) {
+      _channel_comps.emplace_back(new Comp(_comp->GetMaxSize()));
+      _channel_comps.back()->UseQuantiles(_comp->IsQuantilesUsed());
+    }
+  }
+  if (_checkpoints && _pipeline) {
+    RegisterMessage("Pipelined loading does not support checkpoints");
+    return false;
+  }
+  if (not GetBaseSource()->OccupySource()) {
+    RegisterMessage(_source->GetMessage());
+    return false;
+  }
+  VoidDataSource::Position pos;
+  if (_checkpoints && not GetBaseSource()->GetPosition(&pos)) {
+    RegisterMessage("Data source does not support checkpoints");
+    return false;
+  }
+  if (_detector) {
+    _detector->UseHeader(GetBaseSource()->GetHeader());
+  }
+  if (_exporter && not _exporter->Open(Exporter::GetRecordColumns())) {
+    RegisterMessage(_exporter->GetMessage());
+    return false;
+  }
+  if (_publisher && not _publisher->Open()) {
+    RegisterMessage(_publisher->GetMessage());
+    return false;
+  }
+  return true;
+}
+
+template <class Source, class Comp, class Dispatch>
+inline
+bool BasicCollector<Source, Comp, Dispatch>::ConsumeRecord(
+    const VoidDataSource::Record &rec, uint32_t line) {
+  if (_detector) {
+    _detector->PushRecord(rec, line);
+  }
+  if (_exporter && not _exporter->WriteRecord(rec)) {
+    RegisterMessage(_exporter->GetMessage());
+    return false;
+  }
+  if (_store && not _store->PushRecord(rec)) {
+    RegisterMessage(_store->GetMessage());
+    return false;
+  }
+  if (_drift) {
+    _drift->PushRecord(rec);
+  }
+  if (not Dispatch::PushRecord(_comp.get(), rec)) {
+    RegisterMessage(_comp->GetMessage());
+    return false;
+  }
+  if (_publisher) {
+    _publisher->Update(*_comp);
+  }
+  return true;
+}
+
+template <class Source, class Comp, class Dispatch>
+bool BasicCollector<Source, Comp, Dispatch>::Resume(const std::string &path) {
+  if (_detector || _exporter || _store || _transform) {
+    RegisterMessage("Loading with detector, exporter, storage or "
+                    "transformation is not continued from checkpoint");
+    return false;
+  }
+  Checkpoint state;
+  if (not state.Load(path)) {
+    RegisterMessage(state.GetMessage());
+    return false;
+  }
+  if (state.max_size != _comp->GetMaxSize() ||
+      state.quantiles != _comp->IsQuantilesUsed() ||
+      state.channels != _channels ||
+      state.comps.size() != GetChannelsAmount() ||
+      state.drift != bool(_drift)) {
+    RegisterMessage("Checkpoint does not match settings of loading: " + path);
+    return false;
+  }
+  if (not GetBaseSource()->SetPosition(state.source)) {
+    RegisterMessage(_source->GetMessage());
+    return false;
+  }
+  if (_drift && not _drift->SetState(state.drift_state)) {
+    RegisterMessage(_drift->GetMessage());
+    return false;
+  }
+  for (size_t ch = 0; ch < state.comps.size(); ++ch) {
+    if (not GetCompressor(ch)->SetState(std::move(state.comps[ch]))) {
+      RegisterMessage(GetCompressor(ch)->GetMessage());
+      return false;
+    }
+  }
+  // messages of the interrupted loading go first
+  _messages.splice(_messages.begin(), state.messages);
+  return true;
+}
+
+template <class Source, class Comp, class Dispatch>
+void BasicCollector<Source, Comp, Dispatch>::SaveCheckpoint() {
+  Checkpoint state;
+  state.max_size  = _comp->GetMaxSize();
+  state.quantiles = _comp->IsQuantilesUsed();
+  state.channels  = _channels;
+  state.comps.resize(GetChannelsAmount());
+  for (size_t ch = 0; ch < state.comps.size(); ++ch) {
+    GetCompressor(ch)->GetState(&state.comps[ch]);
+  }
+  state.drift = bool(_drift);
+  if (_drift) {
+    _drift->GetState(&state.drift_state);
+  }
+  GetBaseSource()->GetPosition(&state.source);
+  state.messages = _messages;
+  _checkpoints->Save(std::move(state));
+}
+
+template <class Source, class Comp, class Dispatch>
+bool BasicCollector<Source, Comp, Dispatch>::FetchAllRecords() {
+  if (_transform) {
+    return FetchAllRecords(*_transform);
+  }
+  transform::Identity pipe;
+  return FetchAllRecords(pipe);
+}
+
+template <class Source, class Comp, class Dispatch>
+template <class Pipe>
+bool BasicCollector<Source, Comp, Dispatch>::FetchAllRecords(Pipe &pipe) {
+  if (not _channel_comps.empty()) {
+    return FetchAllRows(pipe);
+  }
+  // raw pointers keep "shared_ptr" dereferencing out of the loop
+  Source *source = _source.get();
+  VoidDataSource::Record rec;
+  bool consume_ok = true;
+  if (_pipeline) {
+    consume_ok = _pipeline->Run(source,
+      [this, &pipe](const VoidDataSource::Record *recs, const uint32_t *lines,
+                    size_t amount) {
+        if (IsCancelled()) {
+          return false;
+        }
+        for (size_t i = 0; i < amount; ++i) {
+          VoidDataSource::Record t_rec(recs[i]);
+          if (pipe(t_rec) && not ConsumeRecord(t_rec, lines[i])) {
+            return false;
+          }
+        }
+        return true;
+      }
+    );
+  }
+  while (not source->IsAtTheEnd() && consume_ok) {
+    if (IsCancelled()) {
+      consume_ok = false;
+    } else if (Dispatch::GetRecord(source, &rec) && pipe(rec)) {
+      consume_ok = ConsumeRecord(rec, source->GetLineNumber());
+      if (_checkpoints && consume_ok && _checkpoints->IsTime()) {
+        SaveCheckpoint();
+      }
+    }
+  }
+  // the source keeps the last error of parsing, loading continues after
+  // it, but failed reading means lost records
+  RegisterMessage(GetBaseSource()->GetMessage());
+  if (GetBaseSource()->IsFailed()) {
+    consume_ok = false;
+  }
+  if (_detector) {
+    _detector->Finish();
+  }
+  if (_checkpoints && consume_ok) {
+    SaveCheckpoint();
+  }
+  // checkpoint keeps buckets without correction, loading can be continued
+  if (consume_ok) {
+    FinishDrift();
+  }
+  return consume_ok;
+}
+
+template <class Source, class Comp, class Dispatch>
+template <class Pipe>
+bool BasicCollector<Source, Comp, Dispatch>::FetchAllRows(Pipe &pipe) {
+  Source *source = _source.get();
+  VoidDataSource::Row row;
+  bool consume_ok = true;
+  while (not source->IsAtTheEnd() && consume_ok) {
+    if (IsCancelled()) {
+      consume_ok = false;
+      break;
+    }
+    if (not Dispatch::GetRow(source, &row)) {
+      continue;
+    }
+    VoidDataSource::Record rec(row.GetRecord(0));
+    if (not pipe(rec)) {
+      continue;
+    }
+    consume_ok = ConsumeRecord(rec, source->GetLineNumber());
+    // compressors of channels are independent, so every one of them
+    // walks its own column of the row
+    for (size_t i = 0; i < _channel_comps.size() && consume_ok; ++i) {
+      Comp *comp = _channel_comps[i].get();
+      if (not Dispatch::PushRecord(comp, VoidDataSource::Record(rec.time,
+                                                     row.values[i + 1]))) {
+        RegisterMessage(comp->GetMessage());
+        consume_ok = false;
+      }
+    }
+    if (_checkpoints && consume_ok && _checkpoints->IsTime()) {
+      SaveCheckpoint();
+    }
+  }
+  // the source keeps the last error of parsing, loading continues after
+  // it, but failed reading means lost records
+  RegisterMessage(GetBaseSource()->GetMessage());
+  if (GetBaseSource()->IsFailed()) {
+    consume_ok = false;
+  }
+  if (_detector) {
+    _detector->Finish();
+  }
+  if (_checkpoints && consume_ok) {
+    SaveCheckpoint();
+  }
+  // checkpoint keeps buckets without correction, loading can be continued
+  if (consume_ok) {
+    FinishDrift();
+  }
+  return consume_ok;
+}
+
+template <class Source, class Comp, class Dispatch>
+void BasicCollector<Source, Comp, Dispatch>::End() {
+  GetBaseSource()->ReleaseSource();
+  if (_exporter && _exporter->IsOpened() && not _exporter->Close()) {
+    RegisterMessage(_exporter->GetMessage());
+  }
+  if (_publisher && _publisher->IsOpened() &&
+      not _publisher->Publish(*_comp, true)) {
+    RegisterMessage(_publisher->GetMessage());
+  }
+  if (_checkpoints && not _checkpoints->Flush()) {
+    RegisterMessage(_checkpoints->GetMessage());
+  }
+}
+#endif
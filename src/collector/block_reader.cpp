@@ -0,0 +1,297 @@
+#include "block_reader.hpp"
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+// class BlockReader
+BlockReader::BlockReader() {
+}
+
+BlockReader::~BlockReader() {
+}
+
+const std::string& BlockReader::GetMessage() const {
+  return _message;
+}
+
+void BlockReader::SetMessage(const std::string &msg) {
+  _message = msg;
+}
+// class UringBlockReader::Ring
+UringBlockReader::Ring::Ring()
+    : ptr(MAP_FAILED),
+      size(0),
+      head(0),
+      tail(0),
+      mask(0) {
+}
+// class UringBlockReader
+UringBlockReader::UringBlockReader()
+    : BlockReader(),
+      _ring_fd(-1),
+      _fd(-1),
+      _sq_array(0),
+      _sqes(MAP_FAILED),
+      _sqes_size(0),
+      _cqes(0),
+      _in_flight(0),
+      _queued(0) {
+}
+
+UringBlockReader::~UringBlockReader() {
+  Close();
+}
+
+static
+void* MapRing(int ring_fd, size_t size, off_t offset) {
+  return ::mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                ring_fd, offset);
+}
+
+bool UringBlockReader::Open(int fd, uint32_t depth) {
+  Close();
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  _ring_fd = ::syscall(__NR_io_uring_setup, depth, &params);
+  if (_ring_fd < 0) {
+    SetMessage(std::string("io_uring is not available: ")
+               + std::strerror(errno));
+    return false;
+  }
+  _sq.size   = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  _cq.size   = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+  const bool kSingleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (kSingleMap) {
+    _sq.size = _cq.size = std::max(_sq.size, _cq.size);
+  }
+  _sq.ptr = MapRing(_ring_fd, _sq.size, IORING_OFF_SQ_RING);
+  _cq.ptr = kSingleMap ? _sq.ptr
+                       : MapRing(_ring_fd, _cq.size, IORING_OFF_CQ_RING);
+  _sqes   = MapRing(_ring_fd, _sqes_size, IORING_OFF_SQES);
+  if (_sq.ptr == MAP_FAILED || _cq.ptr == MAP_FAILED || _sqes == MAP_FAILED) {
+    SetMessage("Failed to map rings of io_uring");
+    Close();
+    return false;
+  }
+  char *sq = (char*)_sq.ptr;
+  char *cq = (char*)_cq.ptr;
+  _sq.head  = (unsigned*)(sq + params.sq_off.head);
+  _sq.tail  = (unsigned*)(sq + params.sq_off.tail);
+  _sq.mask  = (unsigned*)(sq + params.sq_off.ring_mask);
+  _sq_array = (unsigned*)(sq + params.sq_off.array);
+  _cq.head  = (unsigned*)(cq + params.cq_off.head);
+  _cq.tail  = (unsigned*)(cq + params.cq_off.tail);
+  _cq.mask  = (unsigned*)(cq + params.cq_off.ring_mask);
+  _cqes     = cq + params.cq_off.cqes;
+  _fd        = fd;
+  _in_flight = 0;
+  _queued    = 0;
+  _iovecs.assign(depth, iovec());
+  return true;
+}
+
+void UringBlockReader::Close() {
+  uint32_t slot   = 0;
+  int64_t  result = 0;
+  while (_in_flight > 0 && Wait(&slot, &result)) {
+  }
+  if (_sqes != MAP_FAILED) {
+    ::munmap(_sqes, _sqes_size);
+  }
+  if (_cq.ptr != MAP_FAILED && _cq.ptr != _sq.ptr) {
+    ::munmap(_cq.ptr, _cq.size);
+  }
+  if (_sq.ptr != MAP_FAILED) {
+    ::munmap(_sq.ptr, _sq.size);
+  }
+  if (_ring_fd >= 0) {
+    ::close(_ring_fd);
+  }
+  _sq        = Ring();
+  _cq        = Ring();
+  _sqes      = MAP_FAILED;
+  _ring_fd   = -1;
+  _in_flight = 0;
+  _queued    = 0;
+}
+
+bool UringBlockReader::Submit(uint32_t slot, void *buf, size_t size,
+                              uint64_t offset) {
+  if (_ring_fd < 0 || slot >= _iovecs.size()) {
+    SetMessage("Invalid slot of reading");
+    return false;
+  }
+  // only this thread changes the tail of submission queue
+  const unsigned kTail  = *_sq.tail;
+  const unsigned kIndex = kTail & *_sq.mask;
+  io_uring_sqe *sqe = (io_uring_sqe*)_sqes + kIndex;
+  std::memset(sqe, 0, sizeof(*sqe));
+  _iovecs[slot].iov_base = buf;
+  _iovecs[slot].iov_len  = size;
+  sqe->opcode    = IORING_OP_READV;
+  sqe->fd        = _fd;
+  sqe->addr      = (uint64_t)&_iovecs[slot];
+  sqe->len       = 1;
+  sqe->off       = offset;
+  sqe->user_data = slot;
+  _sq_array[kIndex] = kIndex;
+  __atomic_store_n(_sq.tail, kTail + 1, __ATOMIC_RELEASE);
+  // the kernel gets queued reads by the next "Wait"
+  ++_queued;
+  ++_in_flight;
+  return true;
+}
+
+bool UringBlockReader::Wait(uint32_t *slot, int64_t *result) {
+  if (_in_flight == 0) {
+    return false;
+  }
+  while (true) {
+    // only this thread changes the head of completion queue
+    const unsigned kHead  = *_cq.head;
+    const bool     kReady = kHead != __atomic_load_n(_cq.tail,
+                                                     __ATOMIC_ACQUIRE);
+    if (_queued > 0 || not kReady) {
+      // all queued reads are submitted by one system call, it also waits
+      // for completion if there is nothing to return
+      const long kSubmitted = ::syscall(__NR_io_uring_enter, _ring_fd,
+                                        _queued, kReady ? 0 : 1,
+                                        kReady ? 0 : IORING_ENTER_GETEVENTS,
+                                        0, 0);
+      if (kSubmitted < 0 && errno != EINTR) {
+        SetMessage(std::string(_queued > 0 ? "Failed to submit reading: "
+                                           : "Failed to wait reading: ")
+                   + std::strerror(errno));
+        return false;
+      }
+      if (kSubmitted > 0) {
+        _queued -= std::min<uint32_t>(kSubmitted, _queued);
+      }
+      continue;
+    }
+    const io_uring_cqe *cqe = (io_uring_cqe*)_cqes + (kHead & *_cq.mask);
+    *slot   = cqe->user_data;
+    *result = cqe->res;
+    __atomic_store_n(_cq.head, kHead + 1, __ATOMIC_RELEASE);
+    --_in_flight;
+    return true;
+  }
+}
+
+const char* UringBlockReader::GetName() const {
+  return "io_uring";
+}
+// class PreadBlockReader
+PreadBlockReader::PreadBlockReader()
+    : BlockReader(),
+      _fd(-1),
+      _in_flight(0),
+      _closing(false) {
+}
+
+PreadBlockReader::~PreadBlockReader() {
+  Close();
+}
+
+bool PreadBlockReader::Open(int fd, uint32_t depth) {
+  Close();
+  _fd        = fd;
+  _in_flight = 0;
+  _closing   = false;
+  for (uint32_t i = 0; i < std::max<uint32_t>(depth, 1); ++i) {
+    _threads.emplace_back(&PreadBlockReader::ReadRequests, this);
+  }
+  return true;
+}
+
+void PreadBlockReader::Close() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _closing = true;
+  }
+  _submitted_cond.notify_all();
+  for (auto &thread : _threads) {
+    thread.join();
+  }
+  _threads.clear();
+  _submitted.clear();
+  _completed.clear();
+  _in_flight = 0;
+}
+
+void PreadBlockReader::ReadRequests() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (true) {
+    _submitted_cond.wait(lock, [this]() {
+      return _closing || not _submitted.empty();
+    });
+    // submitted requests are finished before closing
+    if (_submitted.empty()) {
+      return;
+    }
+    Request req = _submitted.front();
+    _submitted.pop_front();
+    lock.unlock();
+    char  *buf  = (char*)req.buf;
+    size_t done = 0;
+    while (done < req.size) {
+      const auto kRead = ::pread(_fd, buf + done, req.size - done,
+                                 req.offset + done);
+      if (kRead < 0 && errno == EINTR) {
+        continue;
+      }
+      if (kRead < 0) {
+        req.result = -errno;
+        break;
+      }
+      if (kRead == 0) {
+        break;
+      }
+      done += kRead;
+      req.result = done;
+    }
+    lock.lock();
+    _completed.push_back(req);
+    _completed_cond.notify_one();
+  }
+}
+
+bool PreadBlockReader::Submit(uint32_t slot, void *buf, size_t size,
+                              uint64_t offset) {
+  if (_threads.empty()) {
+    SetMessage("Reader is not opened");
+    return false;
+  }
+  Request req = {slot, buf, size, offset, 0};
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _submitted.push_back(req);
+    ++_in_flight;
+  }
+  _submitted_cond.notify_one();
+  return true;
+}
+
+bool PreadBlockReader::Wait(uint32_t *slot, int64_t *result) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  if (_in_flight == 0) {
+    return false;
+  }
+  _completed_cond.wait(lock, [this]() {
+    return not _completed.empty();
+  });
+  *slot   = _completed.front().slot;
+  *result = _completed.front().result;
+  _completed.pop_front();
+  --_in_flight;
+  return true;
+}
+
+const char* PreadBlockReader::GetName() const {
+  return "pread";
+}
@@ -0,0 +1,128 @@
+#ifndef BLOCK_READER_HPP
+#define BLOCK_READER_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <sys/uio.h>
+
+/**
+ * Base class for asynchronous reading of file blocks. Reading is
+ * submitted for the "slot" (index of the buffer), completions are
+ * returned in any order.
+ */
+class BlockReader {
+  public:
+    typedef std::unique_ptr<BlockReader> UnqPtr;
+
+    BlockReader();
+    virtual ~BlockReader();
+    /**
+     * @param fd    descriptor of opened file;
+     * @param depth the greatest amount of reads in flight;
+     * @return false if reader can't work in this system.
+     */
+    virtual bool Open(int fd, uint32_t depth) = 0;
+    virtual void Close() = 0;
+    /**
+     * Method for starting of reading "size" bytes from "offset" into "buf".
+     * Reading may complete with less bytes than "size" before the end of
+     * file, the rest is submitted again by the caller.
+     * @return false if reading was not submitted.
+     */
+    virtual bool Submit(uint32_t slot, void *buf, size_t size,
+                        uint64_t offset) = 0;
+    /**
+     * Method for waiting the next completed reading.
+     * @param slot   slot of completed reading;
+     * @param result amount of read bytes or negative error code (-errno);
+     * @return false if there is nothing to wait.
+     */
+    virtual bool Wait(uint32_t *slot, int64_t *result) = 0;
+    virtual const char* GetName() const = 0;
+    const std::string& GetMessage() const;
+  protected:
+    void SetMessage(const std::string &msg);
+  private:
+    std::string _message;
+};
+
+/**
+ * Reader, which uses Linux io_uring interface directly (without liburing):
+ * reads are queued by "Submit" and all queued reads are passed to the
+ * kernel by one system call in "Wait", the kernel reads them in parallel.
+ */
+class UringBlockReader : public BlockReader {
+  public:
+    UringBlockReader();
+    virtual ~UringBlockReader();
+    virtual bool Open(int fd, uint32_t depth);
+    virtual void Close();
+    virtual bool Submit(uint32_t slot, void *buf, size_t size,
+                        uint64_t offset);
+    virtual bool Wait(uint32_t *slot, int64_t *result);
+    virtual const char* GetName() const;
+  private:
+    struct Ring {
+      Ring();
+
+      void     *ptr;
+      size_t    size;
+      unsigned *head;
+      unsigned *tail;
+      unsigned *mask;
+    };
+
+    int                   _ring_fd;
+    int                   _fd;
+    Ring                  _sq;
+    Ring                  _cq;
+    unsigned             *_sq_array;
+    void                 *_sqes;
+    size_t                _sqes_size;
+    void                 *_cqes;
+    uint32_t              _in_flight;
+    uint32_t              _queued; // reads, which are not passed to kernel
+    std::vector<iovec>    _iovecs;
+};
+
+/**
+ * Reader, which calls "pread" in the pool of threads. It is used when
+ * io_uring is not available.
+ */
+class PreadBlockReader : public BlockReader {
+  public:
+    PreadBlockReader();
+    virtual ~PreadBlockReader();
+    virtual bool Open(int fd, uint32_t depth);
+    virtual void Close();
+    virtual bool Submit(uint32_t slot, void *buf, size_t size,
+                        uint64_t offset);
+    virtual bool Wait(uint32_t *slot, int64_t *result);
+    virtual const char* GetName() const;
+  private:
+    struct Request {
+      uint32_t slot;
+      void    *buf;
+      size_t   size;
+      uint64_t offset;
+      int64_t  result;
+    };
+
+    void ReadRequests();
+
+    int                      _fd;
+    std::vector<std::thread> _threads;
+    std::mutex               _mutex;
+    std::condition_variable  _submitted_cond;
+    std::condition_variable  _completed_cond;
+    std::deque<Request>      _submitted;
+    std::deque<Request>      _completed;
+    uint32_t                 _in_flight;
+    bool                     _closing;
+};
+#endif
@@ -0,0 +1,351 @@
+#include "catalog.hpp"
+#include "parallel.hpp"
+#include <ctime>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <unordered_set>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+
+namespace fs = boost::filesystem;
+
+static const char kIndexMagic[] = "# orolia capture catalog v1";
+static const size_t kIndexFields = 21;
+// amount of lines after header, which are checked for the first record
+static const int kFirstRecordLines = 16;
+
+// class CaptureCatalog::Entry
+CaptureCatalog::Entry::Entry()
+    : size(0),
+      mtime(0),
+      valid(false),
+      start_time(std::nan("")),
+      first_time(std::nan("")),
+      last_time(std::nan("")) {
+}
+
+double CaptureCatalog::Entry::GetDuration() const {
+  return last_time - first_time;
+}
+// class CaptureCatalog::Query
+CaptureCatalog::Query::Query()
+    : start_from(std::nan("")),
+      start_to(std::nan("")),
+      min_duration(std::nan("")) {
+}
+// class CaptureCatalog::ScanStatistics
+CaptureCatalog::ScanStatistics::ScanStatistics()
+    : files(0),
+      read(0),
+      unchanged(0),
+      removed(0),
+      invalid(0) {
+}
+// class CaptureCatalog
+CaptureCatalog::CaptureCatalog() {
+}
+
+double CaptureCatalog::ParseStartTime(const std::string &text) {
+  std::tm tm = {};
+  const char *end = ::strptime(text.c_str(), "%a %b %d %H:%M:%S %Y", &tm);
+  if (end == 0) {
+    return std::nan("");
+  }
+  return ::timegm(&tm);
+}
+
+/**
+ * Function for reading the time label of the last line, only the tail of
+ * the file is read.
+ */
+static
+double ReadLastTime(const std::string &path, uint64_t size) {
+  const uint64_t kTail = std::min<uint64_t>(size,
+                                            2 * VoidDataSource::kLineSize);
+  std::ifstream file(path, std::ios_base::in | std::ios_base::binary);
+  std::string   tail(kTail, 0);
+  file.seekg(size - kTail);
+  if (kTail == 0 || not file.read(&tail[0], kTail)) {
+    return std::nan("");
+  }
+  const size_t kEnd = tail.find_last_not_of(" \t\r\n");
+  if (kEnd == std::string::npos) {
+    return std::nan("");
+  }
+  const size_t kFeed  = tail.rfind('\n', kEnd);
+  const size_t kBegin = kFeed == std::string::npos ? 0 : kFeed + 1;
+  if (tail[kBegin] == '#') {
+    return std::nan("");
+  }
+  const char *begin = tail.c_str() + kBegin;
+  char       *end   = 0;
+  const double kTime = std::strtod(begin, &end);
+  return end != begin ? kTime : std::nan("");
+}
+
+bool CaptureCatalog::ReadEntry(const std::string &path, Entry *out) {
+  // "path" may be a field of "out"
+  Entry entry;
+  entry.path = path;
+  boost::system::error_code err;
+  entry.size  = fs::file_size(path, err);
+  entry.mtime = fs::last_write_time(path, err);
+  if (err) {
+    *out = entry;
+    return false;
+  }
+  FileDataSource  src(path);
+  VoidDataSource *base = &src;
+  entry.valid = base->OccupySource();
+  if (entry.valid) {
+    entry.header     = base->GetHeader();
+    entry.start_time = ParseStartTime(entry.header.time_of_start);
+    VoidDataSource::Record rec;
+    for (int i = 0; i < kFirstRecordLines && not base->IsAtTheEnd(); ++i) {
+      if (base->GetRecord(&rec)) {
+        entry.first_time = rec.time;
+        break;
+      }
+    }
+  }
+  base->ReleaseSource();
+  if (entry.valid) {
+    entry.last_time = ReadLastTime(path, entry.size);
+  }
+  *out = entry;
+  return true;
+}
+
+bool CaptureCatalog::Scan(const std::string &dir, const std::string &extension,
+                          size_t threads) {
+  _statistics = ScanStatistics();
+  boost::system::error_code err;
+  const fs::path kRoot = fs::canonical(dir, err);
+  if (err) {
+    SetMessage("Failed to open directory: " + dir);
+    return false;
+  }
+  // listing of files is sequential, it reads only directories
+  Entries found;
+  fs::recursive_directory_iterator it(kRoot,
+    fs::directory_options::skip_permission_denied, err
+  );
+  for (; not err && it != fs::recursive_directory_iterator();
+       it.increment(err)) {
+    if (not fs::is_regular_file(it->status()) ||
+        (not extension.empty() && it->path().extension() != extension)) {
+      continue;
+    }
+    boost::system::error_code file_err;
+    Entry entry;
+    entry.path  = it->path().string();
+    entry.size  = fs::file_size(it->path(), file_err);
+    entry.mtime = fs::last_write_time(it->path(), file_err);
+    if (not file_err) {
+      found.push_back(entry);
+    }
+  }
+  if (err) {
+    SetMessage("Failed to read directory: " + dir + " (" + err.message() + ")");
+    return false;
+  }
+  std::vector<size_t>             changed;
+  std::unordered_set<std::string> found_paths;
+  for (size_t i = 0; i < found.size(); ++i) {
+    const auto kOld = _entries.find(found[i].path);
+    if (kOld == _entries.end() || kOld->second.size != found[i].size ||
+        kOld->second.mtime != found[i].mtime) {
+      changed.push_back(i);
+    }
+    found_paths.insert(found[i].path);
+  }
+  // reading of files is parallel, every task writes its own entry
+  ParallelFor(changed.size(), [&found, &changed](size_t index, size_t) {
+    Entry &entry = found[changed[index]];
+    ReadEntry(entry.path, &entry);
+  }, threads);
+  for (auto idx : changed) {
+    _entries[found[idx].path] = found[idx];
+  }
+  // entries of removed files are removed only inside of scanned directory
+  const std::string kPrefix = kRoot.string() + fs::path::preferred_separator;
+  for (auto ent = _entries.lower_bound(kPrefix); ent != _entries.end() &&
+       boost::algorithm::starts_with(ent->first, kPrefix);) {
+    if (found_paths.count(ent->first) == 0) {
+      ent = _entries.erase(ent);
+      ++_statistics.removed;
+    } else {
+      _statistics.invalid += ent->second.valid ? 0 : 1;
+      ++ent;
+    }
+  }
+  _statistics.files     = found.size();
+  _statistics.read      = changed.size();
+  _statistics.unchanged = found.size() - changed.size();
+  return true;
+}
+
+const CaptureCatalog::ScanStatistics&
+CaptureCatalog::GetScanStatistics() const {
+  return _statistics;
+}
+
+static
+bool ContainsText(const std::string &text, const std::string &part) {
+  return part.empty() || boost::algorithm::icontains(text, part);
+}
+
+CaptureCatalog::Entries CaptureCatalog::Find(const Query &query) const {
+  Entries result;
+  for (const auto &item : _entries) {
+    const Entry &ent = item.second;
+    // comparing with NaN is always false, so unset limits pass all
+    if (not ent.valid ||
+        not ContainsText(ent.header.type_of_measurement, query.type) ||
+        not ContainsText(ent.header.ref_osc, query.ref_osc) ||
+        not ContainsText(ent.path, query.path) ||
+        not (ContainsText(ent.header.input_a, query.input) ||
+             ContainsText(ent.header.input_b, query.input)) ||
+        ent.start_time < query.start_from || ent.start_time > query.start_to ||
+        ent.GetDuration() < query.min_duration) {
+      continue;
+    }
+    if ((not std::isnan(query.start_from) || not std::isnan(query.start_to)) &&
+        std::isnan(ent.start_time)) {
+      continue;
+    }
+    if (not std::isnan(query.min_duration) && std::isnan(ent.GetDuration())) {
+      continue;
+    }
+    result.push_back(ent);
+  }
+  return result;
+}
+
+size_t CaptureCatalog::GetSize() const {
+  return _entries.size();
+}
+
+static
+std::string CleanField(std::string text) {
+  for (auto &chr : text) {
+    if (chr == '\t' || chr == '\n' || chr == '\r') {
+      chr = ' ';
+    }
+  }
+  return text;
+}
+
+bool CaptureCatalog::Save(const std::string &path) {
+  // index is written into temporary file and renamed, so readers never
+  // see partially written index
+  const std::string kTmpPath = path + ".tmp";
+  std::ofstream file(kTmpPath, std::ios_base::out | std::ios_base::trunc);
+  if (not file.is_open()) {
+    SetMessage("Failed to create index: " + kTmpPath);
+    return false;
+  }
+  file << kIndexMagic << "\n";
+  for (const auto &item : _entries) {
+    const Entry &ent = item.second;
+    const auto  &hd  = ent.header;
+    file << CleanField(ent.path) << '\t' << ent.size << '\t' << ent.mtime
+         << '\t' << ent.valid << '\t'
+         << boost::lexical_cast<std::string>(ent.start_time) << '\t'
+         << boost::lexical_cast<std::string>(ent.first_time) << '\t'
+         << boost::lexical_cast<std::string>(ent.last_time) << '\t'
+         << CleanField(hd.created_by.name) << '\t'
+         << CleanField(hd.created_by.version) << '\t'
+         << CleanField(hd.type_of_measurement) << '\t'
+         << CleanField(hd.time_of_start) << '\t'
+         << CleanField(hd.measuring_time) << '\t'
+         << CleanField(hd.input_a) << '\t' << CleanField(hd.input_b) << '\t'
+         << hd.ext_arm << '\t' << hd.hold_off << '\t' << hd.single << '\t'
+         << hd.filter << '\t' << hd.common << '\t'
+         << CleanField(hd.ref_osc) << '\t' << hd.statistics << "\n";
+  }
+  file.close();
+  if (not file || std::rename(kTmpPath.c_str(), path.c_str()) != 0) {
+    SetMessage("Failed to write index: " + path);
+    std::remove(kTmpPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+static
+bool ParseEntry(const std::string &line, CaptureCatalog::Entry *out) {
+  std::vector<std::string> fields;
+  std::stringstream stream(line);
+  std::string       field;
+  while (std::getline(stream, field, '\t')) {
+    fields.push_back(field);
+  }
+  if (fields.size() != kIndexFields) {
+    return false;
+  }
+  try {
+    auto &hd = out->header;
+    size_t i = 0;
+    out->path       = fields[i++];
+    out->size       = boost::lexical_cast<uint64_t>(fields[i++]);
+    out->mtime      = boost::lexical_cast<int64_t>(fields[i++]);
+    out->valid      = boost::lexical_cast<bool>(fields[i++]);
+    out->start_time = boost::lexical_cast<double>(fields[i++]);
+    out->first_time = boost::lexical_cast<double>(fields[i++]);
+    out->last_time  = boost::lexical_cast<double>(fields[i++]);
+    hd.created_by.name     = fields[i++];
+    hd.created_by.version  = fields[i++];
+    hd.type_of_measurement = fields[i++];
+    hd.time_of_start       = fields[i++];
+    hd.measuring_time      = fields[i++];
+    hd.input_a             = fields[i++];
+    hd.input_b             = fields[i++];
+    hd.ext_arm    = boost::lexical_cast<bool>(fields[i++]);
+    hd.hold_off   = boost::lexical_cast<bool>(fields[i++]);
+    hd.single     = boost::lexical_cast<bool>(fields[i++]);
+    hd.filter     = boost::lexical_cast<bool>(fields[i++]);
+    hd.common     = boost::lexical_cast<bool>(fields[i++]);
+    hd.ref_osc    = fields[i++];
+    hd.statistics = boost::lexical_cast<bool>(fields[i++]);
+  } catch (const boost::bad_lexical_cast&) {
+    return false;
+  }
+  return true;
+}
+
+bool CaptureCatalog::Load(const std::string &path) {
+  std::ifstream file(path);
+  std::string   line;
+  if (not file.is_open() || not std::getline(file, line) ||
+      line != kIndexMagic) {
+    SetMessage("Invalid index: " + path);
+    return false;
+  }
+  EntriesMap entries;
+  uint32_t   line_num = 1;
+  while (std::getline(file, line)) {
+    ++line_num;
+    Entry entry;
+    if (not ParseEntry(line, &entry)) {
+      SetMessage("Invalid entry of index at line #"
+        + boost::lexical_cast<std::string>(line_num)
+      );
+      return false;
+    }
+    entries[entry.path] = entry;
+  }
+  _entries.swap(entries);
+  return true;
+}
+
+const std::string& CaptureCatalog::GetMessage() const {
+  return _message;
+}
+
+void CaptureCatalog::SetMessage(const std::string &msg) {
+  _message = msg;
+}
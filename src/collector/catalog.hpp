@@ -0,0 +1,103 @@
+#ifndef CATALOG_HPP
+#define CATALOG_HPP
+
+#include <map>
+#include <vector>
+#include "data_source.hpp"
+
+/**
+ * Catalog of capture files. Directories are scanned in parallel, only the
+ * header, the first record and the tail of every file are read. Entries
+ * are kept in memory, so queries do not touch files, and are persisted in
+ * the index file (tab separated text). Rescanning reads only new files
+ * and files with changed size or modification time.
+ */
+class CaptureCatalog {
+  public:
+    struct Entry {
+      Entry();
+      /**
+       * @return duration of capture in seconds (by time labels).
+       */
+      double GetDuration() const;
+
+      std::string            path;       // absolute path
+      uint64_t               size;       // bytes
+      int64_t                mtime;      // seconds since epoch
+      bool                   valid;      // file has valid header
+      VoidDataSource::Header header;
+      double                 start_time; // "time_of_start" in seconds since
+                                         // epoch (UTC) or NaN
+      double                 first_time; // the first time label or NaN
+      double                 last_time;  // the last time label or NaN
+    };
+    typedef std::vector<Entry> Entries;
+    /**
+     * Conditions of searching. Text conditions are matched as case
+     * insensitive substrings, empty text and NaN values are not checked.
+     */
+    struct Query {
+      Query();
+
+      std::string type;         // type of measurement
+      std::string ref_osc;      // reference oscillator
+      std::string input;        // settings of input A or B
+      std::string path;         // part of path
+      double      start_from;   // seconds since epoch
+      double      start_to;
+      double      min_duration; // seconds
+    };
+    struct ScanStatistics {
+      ScanStatistics();
+
+      size_t files;     // amount of found files
+      size_t read;      // new and changed files
+      size_t unchanged;
+      size_t removed;   // files, which are not found anymore
+      size_t invalid;   // files without valid header
+    };
+
+    CaptureCatalog();
+    /**
+     * Method for scanning directory with subdirectories. Files are read by
+     * several threads, unchanged files are not read.
+     * @param dir       path of directory;
+     * @param extension only files with this extension are read
+     *                  (for example ".txt"), empty - all files;
+     * @param threads   amount of threads, 0 - amount of hardware threads;
+     * @return false if directory can not be read.
+     */
+    bool Scan(const std::string &dir, const std::string &extension = "",
+              size_t threads = 0);
+    const ScanStatistics& GetScanStatistics() const;
+    Entries Find(const Query &query) const;
+    size_t GetSize() const;
+    /**
+     * Methods for saving and loading of the index file.
+     * @return false if file can not be written or read, or it is invalid.
+     */
+    bool Save(const std::string &path);
+    bool Load(const std::string &path);
+    const std::string& GetMessage() const;
+    /**
+     * Method for reading entry of one file. Files without valid header
+     * get entries with "valid" = false.
+     * @return false if file does not exist.
+     */
+    static bool ReadEntry(const std::string &path, Entry *out);
+    /**
+     * Method for converting "time_of_start" of header (for example
+     * "MON May 12 13:13:23 2003") into seconds since epoch.
+     * @return NaN if text is invalid.
+     */
+    static double ParseStartTime(const std::string &text);
+  private:
+    typedef std::map<std::string, Entry> EntriesMap;
+
+    void SetMessage(const std::string &msg);
+
+    EntriesMap     _entries;
+    ScanStatistics _statistics;
+    std::string    _message;
+};
+#endif
@@ -0,0 +1,342 @@
+#include "checkpoint.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <type_traits>
+#include <unistd.h>
+
+static_assert(std::is_trivially_copyable<QuantileSketch>::value,
+              "Sketches are written into checkpoint as bytes");
+
+static const uint64_t kFileMagic  = 0x54504b4344524f4fULL; // "OORDCKPT"
+static const uint32_t kFileLayout = 5;
+
+/**
+ * FNV-1a hash, it detects damaged files.
+ */
+static
+uint64_t GetChecksum(const std::string &data) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (unsigned char byte : data) {
+    hash ^= byte;
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+template <class T>
+static
+void Put(const T &value, std::string *out) {
+  out->append((const char*)&value, sizeof(value));
+}
+
+static
+void PutString(const std::string &str, std::string *out) {
+  Put<uint32_t>(str.size(), out);
+  out->append(str);
+}
+
+/**
+ * Reading of fields from the buffer, all reads after the end of buffer
+ * fail.
+ */
+class FieldReader {
+  public:
+    FieldReader(const std::string &data, size_t size)
+        : _data(data),
+          _size(size),
+          _pos(0) {
+    }
+    template <class T>
+    bool Get(T *out) {
+      if (_size - _pos < sizeof(T)) {
+        _pos = _size;
+        return false;
+      }
+      std::memcpy(static_cast<void*>(out), _data.data() + _pos, sizeof(T));
+      _pos += sizeof(T);
+      return true;
+    }
+    bool GetString(std::string *out) {
+      uint32_t size = 0;
+      if (not Get(&size) || _size - _pos < size) {
+        _pos = _size;
+        return false;
+      }
+      out->assign(_data, _pos, size);
+      _pos += size;
+      return true;
+    }
+    bool IsAtTheEnd() const {
+      return _pos == _size;
+    }
+  private:
+    const std::string &_data;
+    const size_t       _size;
+    size_t             _pos;
+};
+// class Checkpoint
+Checkpoint::Checkpoint()
+    : max_size(0),
+      quantiles(false),
+      drift(false) {
+}
+
+bool Checkpoint::Save(const std::string &path) {
+  std::string data;
+  Put(kFileMagic, &data);
+  Put(kFileLayout, &data);
+  Put(max_size, &data);
+  Put<uint8_t>(quantiles, &data);
+  Put<uint32_t>(channels.size(), &data);
+  for (uint8_t channel : channels) {
+    Put(channel, &data);
+  }
+  Put(source.offset, &data);
+  Put(source.line, &data);
+  Put(source.prev_time, &data);
+  Put(source.file_size, &data);
+  Put(source.file_time, &data);
+  Put<uint32_t>(messages.size(), &data);
+  for (const auto &msg : messages) {
+    PutString(msg, &data);
+  }
+  Put<uint8_t>(drift, &data);
+  if (drift) {
+    Put(drift_state.order, &data);
+    Put(drift_state.origin, &data);
+    Put(drift_state.shift, &data);
+    Put(drift_state.diagonal, &data);
+    Put(drift_state.factor, &data);
+    Put(drift_state.rhs, &data);
+    Put(drift_state.rss, &data);
+    Put(drift_state.amount, &data);
+    Put(drift_state.time_range, &data);
+  }
+  Put<uint32_t>(comps.size(), &data);
+  for (const auto &comp : comps) {
+    Put(comp.rec_capacity, &data);
+    Put(comp.merge_position, &data);
+    Put(comp.time_scale, &data);
+    Put(comp.value_scale, &data);
+    Put(comp.pushed, &data);
+    Put<uint32_t>(comp.records.size(), &data);
+    for (const auto &rec : comp.records) {
+      Put(rec.time, &data);
+      Put(rec.value, &data);
+      Put(rec.extreme_time, &data);
+      Put(rec.amount, &data);
+      if (quantiles) {
+        Put(rec.sketch ? *rec.sketch : QuantileSketch(), &data);
+      }
+    }
+  }
+  Put(GetChecksum(data), &data);
+  const std::string kTemp = path + ".tmp";
+  std::FILE *file = std::fopen(kTemp.c_str(), "wb");
+  if (file == 0) {
+    SetMessage("Failed to create file: " + kTemp);
+    return false;
+  }
+  // data must reach the disk before replacing of the old checkpoint
+  const bool kWritten = std::fwrite(data.data(), 1, data.size(), file)
+                        == data.size() &&
+                        std::fflush(file) == 0 &&
+                        ::fsync(::fileno(file)) == 0;
+  if (std::fclose(file) != 0 || not kWritten ||
+      std::rename(kTemp.c_str(), path.c_str()) != 0) {
+    SetMessage("Failed to write checkpoint: " + path);
+    std::remove(kTemp.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool Checkpoint::Load(const std::string &path) {
+  std::ifstream in(path, std::ios_base::binary);
+  if (not in.is_open()) {
+    SetMessage("Failed to open checkpoint: " + path);
+    return false;
+  }
+  const std::string kData((std::istreambuf_iterator<char>(in)),
+                          std::istreambuf_iterator<char>());
+  uint64_t checksum = 0;
+  if (kData.size() < sizeof(kFileMagic) + sizeof(checksum)) {
+    SetMessage("Damaged checkpoint: " + path);
+    return false;
+  }
+  const size_t kSize = kData.size() - sizeof(checksum);
+  std::memcpy(&checksum, kData.data() + kSize, sizeof(checksum));
+  if (checksum != GetChecksum(kData.substr(0, kSize))) {
+    SetMessage("Damaged checkpoint: " + path);
+    return false;
+  }
+  FieldReader reader(kData, kSize);
+  uint64_t magic  = 0;
+  uint32_t layout = 0;
+  if (not reader.Get(&magic) || magic != kFileMagic ||
+      not reader.Get(&layout) || layout != kFileLayout) {
+    SetMessage("Unknown format of checkpoint: " + path);
+    return false;
+  }
+  uint8_t  t_quantiles = 0;
+  uint32_t amount      = 0;
+  bool     ok          = reader.Get(&max_size) &&
+                         reader.Get(&t_quantiles) &&
+                         reader.Get(&amount);
+  channels.clear();
+  for (uint32_t i = 0; i < amount && ok; ++i) {
+    channels.emplace_back();
+    ok = reader.Get(&channels.back());
+  }
+  ok = ok &&
+       reader.Get(&source.offset) &&
+       reader.Get(&source.line) &&
+       reader.Get(&source.prev_time) &&
+       reader.Get(&source.file_size) &&
+       reader.Get(&source.file_time) &&
+       reader.Get(&amount);
+  quantiles = t_quantiles != 0;
+  messages.clear();
+  for (uint32_t i = 0; i < amount && ok; ++i) {
+    messages.emplace_back();
+    ok = reader.GetString(&messages.back());
+  }
+  uint8_t t_drift = 0;
+  ok    = ok && reader.Get(&t_drift);
+  drift = t_drift != 0;
+  if (drift) {
+    ok = ok &&
+         reader.Get(&drift_state.order) &&
+         reader.Get(&drift_state.origin) &&
+         reader.Get(&drift_state.shift) &&
+         reader.Get(&drift_state.diagonal) &&
+         reader.Get(&drift_state.factor) &&
+         reader.Get(&drift_state.rhs) &&
+         reader.Get(&drift_state.rss) &&
+         reader.Get(&drift_state.amount) &&
+         reader.Get(&drift_state.time_range);
+  }
+  ok = ok && reader.Get(&amount);
+  comps.clear();
+  for (uint32_t c = 0; c < amount && ok; ++c) {
+    comps.emplace_back();
+    Compressor::State &comp = comps.back();
+    uint32_t records = 0;
+    ok = reader.Get(&comp.rec_capacity) &&
+         reader.Get(&comp.merge_position) &&
+         reader.Get(&comp.time_scale) &&
+         reader.Get(&comp.value_scale) &&
+         reader.Get(&comp.pushed) &&
+         reader.Get(&records);
+    for (uint32_t i = 0; i < records && ok; ++i) {
+      Compressor::Record rec(std::nan(""), std::nan(""));
+      QuantileSketch     sketch;
+      ok = reader.Get(&rec.time) &&
+           reader.Get(&rec.value) &&
+           reader.Get(&rec.extreme_time) &&
+           reader.Get(&rec.amount) &&
+           (not quantiles || reader.Get(&sketch));
+      if (quantiles) {
+        rec.sketch.reset(new QuantileSketch(sketch));
+      }
+      comp.records.push_back(std::move(rec));
+    }
+  }
+  if (not ok || not reader.IsAtTheEnd()) {
+    SetMessage("Damaged checkpoint: " + path);
+    return false;
+  }
+  return true;
+}
+
+const std::string& Checkpoint::GetMessage() const {
+  return _message;
+}
+
+void Checkpoint::SetMessage(const std::string &msg) {
+  _message = msg;
+}
+// class CheckpointWriter
+CheckpointWriter::CheckpointWriter(const std::string &path, double period)
+    : _path(path),
+      _period(std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(period)
+      )),
+      _next_save(Clock::now() + _period),
+      _unchecked(0),
+      _queued(false),
+      _running(false),
+      _failed(false),
+      _written(0) {
+}
+
+CheckpointWriter::~CheckpointWriter() {
+  Flush();
+}
+
+void CheckpointWriter::Save(Checkpoint &&state) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _pending.reset(new Checkpoint(std::move(state)));
+  _next_save = Clock::now() + _period;
+  if (_running) {
+    // the writer takes the newest state after the current one
+    return;
+  }
+  if (not _queued) {
+    _queued = true;
+    TaskScheduler::GetShared().Run([this]() { WriteCheckpoints(true); },
+                                   TaskScheduler::kHighPriority, &_task);
+    return;
+  }
+  // the task has waited for the whole period, so workers are occupied
+  lock.unlock();
+  WriteCheckpoints(false);
+}
+
+void CheckpointWriter::WriteCheckpoints(bool task) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  if (task) {
+    _queued = false;
+  }
+  if (_running) {
+    return;
+  }
+  _running = true;
+  while (_pending) {
+    std::unique_ptr<Checkpoint> state(std::move(_pending));
+    lock.unlock();
+    const bool kOk = state->Save(_path);
+    lock.lock();
+    _failed = not kOk;
+    if (kOk) {
+      ++_written;
+    } else {
+      _message = state->GetMessage();
+    }
+  }
+  _running = false;
+}
+
+bool CheckpointWriter::Flush() {
+  // the task is waited by the loading thread, so it can execute the task
+  // itself, when all workers are busy
+  TaskScheduler::GetShared().Wait(&_task);
+  std::lock_guard<std::mutex> lock(_mutex);
+  return not _failed;
+}
+
+uint64_t CheckpointWriter::GetWritten() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _written;
+}
+
+const std::string& CheckpointWriter::GetPath() const {
+  return _path;
+}
+
+const std::string& CheckpointWriter::GetMessage() const {
+  return _message;
+}
@@ -0,0 +1,125 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <list>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <vector>
+#include "drift.hpp"
+#include "scheduler.hpp"
+
+/**
+ * State of loading, which is enough for continuing it by another process:
+ * states of compressors (the main one and compressors of channels),
+ * indexes of selected channels, accumulated data of the estimator of drift, position of data source
+ * (with identity of its file, so loading is not continued in another
+ * file) and registered messages.
+ * File has binary format with native byte order: header, fields, records
+ * of compressors and checksum of all previous bytes. It is written into
+ * the temporary file, which replaces the old one, so the file is always
+ * complete.
+ */
+class Checkpoint {
+  public:
+    typedef std::list<std::string> Messages;
+
+    Checkpoint();
+    bool Save(const std::string &path);
+    /**
+     * @return false if file can not be read, it is damaged or has another
+     *         version of format.
+     */
+    bool Load(const std::string &path);
+    const std::string& GetMessage() const;
+
+    uint32_t                       max_size;  // limit of buffers
+    bool                           quantiles; // records have sketches
+    VoidDataSource::Channels       channels;  // selection of the source
+    std::vector<Compressor::State> comps;
+    bool                           drift;     // estimator of drift is used
+    DriftEstimator::State          drift_state;
+    VoidDataSource::Position       source;
+    Messages                       messages;
+  private:
+    void SetMessage(const std::string &msg);
+
+    std::string _message;
+};
+
+/**
+ * Periodical saving of checkpoints without pausing of loading. The
+ * loading thread copies the state (buckets of compressors are small) and
+ * passes it to the task of writer (it is executed by the shared scheduler
+ * with the high priority, so it is not queued behind batch jobs), which
+ * serializes and writes it. If writing is slower than loading, only the
+ * newest state is written. If the task is not started until the next
+ * checkpoint (all workers are occupied by long tasks), the loading thread
+ * writes the checkpoint itself.
+ */
+class CheckpointWriter {
+  public:
+    typedef std::shared_ptr<CheckpointWriter> ShrPtr;
+
+    /**
+     * @param path   path to the file of checkpoint;
+     * @param period the lowest interval between checkpoints (seconds).
+     */
+    CheckpointWriter(const std::string &path, double period = 10);
+    /**
+     * Passed checkpoints are written before destroying.
+     */
+    ~CheckpointWriter();
+    /**
+     * Method for calling from the loading loop after every consumed
+     * record, time is checked only once per "kCheckRecords" calls.
+     * @return true if checkpoint must be saved.
+     */
+    bool IsTime() {
+      if (++_unchecked < kCheckRecords) {
+        return false;
+      }
+      _unchecked = 0;
+      return Clock::now() >= _next_save;
+    }
+    /**
+     * Method for passing checkpoint to the task of writer, checkpoint,
+     * which is not written yet, is replaced.
+     */
+    void Save(Checkpoint &&state);
+    /**
+     * Method for waiting, until passed checkpoints are written.
+     * @return false if writing of the last checkpoint has failed.
+     */
+    bool Flush();
+    /**
+     * @return amount of written checkpoints.
+     */
+    uint64_t GetWritten() const;
+    const std::string& GetPath() const;
+    const std::string& GetMessage() const;
+  private:
+    typedef std::chrono::steady_clock Clock;
+
+    static const uint32_t kCheckRecords = 16384;
+
+    /**
+     * Method for writing passed checkpoints, until there are no new ones.
+     * @param task true if it is called by the task of writer.
+     */
+    void WriteCheckpoints(bool task);
+
+    const std::string           _path;
+    const Clock::duration       _period;
+    Clock::time_point           _next_save;
+    uint32_t                    _unchecked;
+    mutable std::mutex          _mutex;
+    TaskScheduler::Group        _task;
+    std::unique_ptr<Checkpoint> _pending;
+    bool                        _queued;  // the task is not started
+    bool                        _running; // checkpoints are written
+    bool                        _failed;
+    uint64_t                    _written;
+    std::string                 _message;
+};
+#endif
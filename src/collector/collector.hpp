@@ -1,25 +1,20 @@
 #ifndef COLLECTOR_HPP
 #define COLLECTOR_HPP
 
-#include "compressor.hpp"
+#include "basic_collector.hpp"
+#include "async_data_source.hpp"
 
-class Collector {
+/**
+ * Collector for data sources and compressors of any derived types, methods
+ * of the loading loop are called through virtual table. For loading with
+ * known types please use "BasicCollector" with "StaticDispatch".
+ */
+class Collector : public BasicCollector<VoidDataSource, Compressor,
+                                        VirtualDispatch> {
   public:
-    typedef std::list<std::string> Messages;
     Collector();
-
-    void UseCompressor(Compressor *ptr);
-    void UseDataSource(VoidDataSource *ptr);
-    Compressor::ShrPtr GetCompressor() const;
-    bool GetDataHeader(VoidDataSource::Header *out) const;
-    bool Begin();
-    bool FetchAllRecords();
-    void End();
-    const Messages& GetMessages() const;
-  private:
-    void RegisterMessage(const std::string &msg);
-    Compressor::ShrPtr     _comp;
-    VoidDataSource::ShrPtr _source;
-    Messages               _messages;
 };
-#endif
\ No newline at end of file
+
+extern template class BasicCollector<VoidDataSource, Compressor,
+                                     VirtualDispatch>;
+#endif
@@ -0,0 +1,514 @@
+#include "compressed_store.hpp"
+#include "parallel.hpp"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+typedef VoidDataSource::Record Record;
+
+enum CodingMode {
+  kDecimalMode = 0, // integer decimal mantissas
+  kBitsMode,        // bits of double as integers
+  kXorMode          // XOR with the previous value (only values)
+};
+
+static const uint8_t kMaxScale = 18;
+static const double  kPowers[kMaxScale + 1] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,
+  1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18
+};
+// integers up to 2^53 are exact in double
+static const double kMaxMantissa = 9007199254740992.0;
+// reading of fewer blocks is not parallel
+static const size_t kParallelBlocks = 4;
+
+/**
+ * Class for writing bit fields into words, the lowest bits are the first.
+ */
+class BitWriter {
+  public:
+    explicit BitWriter(std::vector<uint64_t> *out)
+        : _out(out),
+          _used(64) {
+    }
+    /**
+     * Method for appending the lowest "amount" (0 - 64) bits of "bits",
+     * higher bits must be zero.
+     */
+    void Put(uint64_t bits, unsigned amount) {
+      if (amount == 0) {
+        return;
+      }
+      if (_used == 64) {
+        _out->push_back(0);
+        _used = 0;
+      }
+      const unsigned kFree = 64 - _used;
+      _out->back() |= bits << _used;
+      if (amount > kFree) {
+        _out->push_back(bits >> kFree);
+        _used = amount - kFree;
+      } else {
+        _used += amount;
+      }
+    }
+
+    uint64_t GetPosition() const {
+      return _out->size() * 64 - (64 - _used);
+    }
+  private:
+    std::vector<uint64_t> *_out;
+    unsigned               _used; // bits of the last word
+};
+
+class BitReader {
+  public:
+    BitReader(const uint64_t *data, uint64_t pos)
+        : _data(data),
+          _pos(pos) {
+    }
+
+    uint64_t Get(unsigned amount) {
+      if (amount == 0) {
+        return 0;
+      }
+      const uint64_t kWord  = _pos >> 6;
+      const unsigned kShift = _pos & 63;
+      uint64_t result = _data[kWord] >> kShift;
+      if (kShift + amount > 64) {
+        result |= _data[kWord + 1] << (64 - kShift);
+      }
+      _pos += amount;
+      return amount == 64 ? result : result & ((uint64_t(1) << amount) - 1);
+    }
+  private:
+    const uint64_t *_data;
+    uint64_t        _pos;
+};
+
+static inline
+unsigned GetBitWidth(uint64_t value) {
+  return value == 0 ? 0 : 64 - __builtin_clzll(value);
+}
+
+static inline
+uint64_t GetBits(double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static inline
+double FromBits(uint64_t bits) {
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+/**
+ * Function for searching the lowest amount of decimal digits after point,
+ * which represent all values exactly (bit by bit, so -0.0 and NaN fail).
+ * @return false if there is no such amount.
+ */
+static
+bool FindDecimalScale(const std::vector<double> &values, uint8_t *scale) {
+  for (uint8_t digits = 0; digits <= kMaxScale; ++digits) {
+    bool exact = true;
+    for (auto value : values) {
+      const double kMantissa = std::nearbyint(value * kPowers[digits]);
+      if (not (std::fabs(kMantissa) < kMaxMantissa) ||
+          GetBits((double)(int64_t)kMantissa / kPowers[digits]) !=
+          GetBits(value)) {
+        exact = false;
+        break;
+      }
+    }
+    if (exact) {
+      *scale = digits;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Function for coding integers as zigzag differences of order "order"
+ * (1 - differences, 2 - differences of differences) and packing them.
+ * Width is chosen by histogram of bit widths, it gives the lowest size.
+ */
+static
+void EncodeIntegers(std::vector<uint64_t> *data, unsigned order,
+                    uint8_t *width, bool *exceptions, BitWriter *out) {
+  for (unsigned o = 0; o < order; ++o) {
+    uint64_t prev = 0;
+    for (auto &x : *data) {
+      const uint64_t kCurrent = x;
+      x   -= prev;
+      prev = kCurrent;
+    }
+  }
+  uint64_t histogram[65] = {};
+  for (auto &x : *data) {
+    x = (x << 1) ^ (uint64_t)((int64_t)x >> 63);
+    ++histogram[GetBitWidth(x)];
+  }
+  const uint64_t kAmount = data->size();
+  uint64_t best_size   = kAmount * 64;
+  uint64_t not_greater = 0;
+  *width      = 64;
+  *exceptions = false;
+  for (unsigned w = 0; w <= 64; ++w) {
+    not_greater += histogram[w];
+    const uint64_t kGreater = kAmount - not_greater;
+    const uint64_t kSize    = kGreater == 0
+      ? kAmount * w
+      : kAmount + not_greater * w + kGreater * 64;
+    if (kSize < best_size) {
+      best_size   = kSize;
+      *width      = w;
+      *exceptions = kGreater > 0;
+    }
+  }
+  for (auto x : *data) {
+    if (not *exceptions) {
+      out->Put(x, *width);
+    } else if (GetBitWidth(x) <= *width) {
+      out->Put(x << 1, *width + 1);
+    } else {
+      out->Put(1, 1);
+      out->Put(x, 64);
+    }
+  }
+}
+
+static
+void EncodeXor(const std::vector<double> &values, BitWriter *out) {
+  uint64_t prev     = 0;
+  unsigned leading  = 65; // window of meaningful bits is not set
+  unsigned trailing = 0;
+  for (auto value : values) {
+    const uint64_t kBits = GetBits(value);
+    const uint64_t kXor  = kBits ^ prev;
+    prev = kBits;
+    if (kXor == 0) {
+      out->Put(0, 1);
+      continue;
+    }
+    const unsigned kLeading  = std::min(__builtin_clzll(kXor), 31);
+    const unsigned kTrailing = __builtin_ctzll(kXor);
+    if (leading <= 64 && kLeading >= leading && kTrailing >= trailing) {
+      // bits fit into the previous window
+      out->Put(1, 2);
+      out->Put(kXor >> trailing, 64 - leading - trailing);
+    } else {
+      const unsigned kLength = 64 - kLeading - kTrailing;
+      out->Put(3, 2);
+      out->Put(kLeading, 5);
+      out->Put(kLength - 1, 6);
+      out->Put(kXor >> kTrailing, kLength);
+      leading  = kLeading;
+      trailing = kTrailing;
+    }
+  }
+}
+
+template <unsigned kOrder, CodingMode kMode>
+static
+void DecodeIntegers(BitReader *in, uint8_t width, bool exceptions,
+                    double divisor, size_t skip, size_t amount, Record *out,
+                    double Record::*field) {
+  uint64_t x     = 0;
+  uint64_t delta = 0;
+  for (size_t i = 0; i < skip + amount; ++i) {
+    const uint64_t kZigzag = exceptions && in->Get(1) != 0 ? in->Get(64)
+                                                           : in->Get(width);
+    const uint64_t kDiff = (kZigzag >> 1) ^ (0 - (kZigzag & 1));
+    if (kOrder == 2) {
+      delta += kDiff;
+      x     += delta;
+    } else {
+      x += kDiff;
+    }
+    if (i >= skip) {
+      out[i - skip].*field = kMode == kDecimalMode
+        ? (double)(int64_t)x / divisor
+        : FromBits(x);
+    }
+  }
+}
+
+static
+void DecodeXor(BitReader *in, size_t skip, size_t amount, Record *out) {
+  uint64_t bits     = 0;
+  unsigned leading  = 0;
+  unsigned trailing = 0;
+  for (size_t i = 0; i < skip + amount; ++i) {
+    if (in->Get(1) != 0) {
+      if (in->Get(1) != 0) {
+        leading = in->Get(5);
+        trailing = 64 - leading - ((unsigned)in->Get(6) + 1);
+      }
+      bits ^= in->Get(64 - leading - trailing) << trailing;
+    }
+    if (i >= skip) {
+      out[i - skip].value = FromBits(bits);
+    }
+  }
+}
+// class CompressedSampleStore::Statistics
+CompressedSampleStore::Statistics::Statistics()
+    : records(0),
+      blocks(0),
+      decimal_blocks(0),
+      bytes(0) {
+}
+
+double CompressedSampleStore::Statistics::GetBytesPerRecord() const {
+  return records > 0 ? (double)bytes / records : 0;
+}
+// class CompressedSampleStore::Coding
+CompressedSampleStore::Coding::Coding()
+    : mode(kBitsMode),
+      scale(0),
+      width(64),
+      exceptions(false) {
+}
+// class CompressedSampleStore
+CompressedSampleStore::CompressedSampleStore(uint32_t block_records,
+                                             size_t threads)
+    : SampleStore(),
+      _block_records(block_records > 0 ? block_records : 1),
+      _threads(threads),
+      _decimal_blocks(0) {
+  _last.reserve(_block_records);
+}
+
+CompressedSampleStore::~CompressedSampleStore() {
+}
+
+void CompressedSampleStore::SealBlock() {
+  Block block;
+  std::vector<double> times(_last.size());
+  std::vector<double> values(_last.size());
+  block.min_time  = block.min_value = HUGE_VAL;
+  block.max_time  = block.max_value = -HUGE_VAL;
+  for (size_t i = 0; i < _last.size(); ++i) {
+    times[i]  = _last[i].time;
+    values[i] = _last[i].value;
+    // NaN never changes ranges
+    block.min_time  = std::min(block.min_time,  times[i]);
+    block.max_time  = std::max(block.max_time,  times[i]);
+    block.min_value = std::min(block.min_value, values[i]);
+    block.max_value = std::max(block.max_value, values[i]);
+  }
+  BitWriter out(&block.bits);
+  std::vector<uint64_t> integers(_last.size());
+  // time labels
+  if (FindDecimalScale(times, &block.time.scale)) {
+    block.time.mode = kDecimalMode;
+    for (size_t i = 0; i < times.size(); ++i) {
+      integers[i] = (uint64_t)(int64_t)std::nearbyint(
+        times[i] * kPowers[block.time.scale]
+      );
+    }
+  } else {
+    block.time.mode = kBitsMode;
+    std::transform(times.begin(), times.end(), integers.begin(), GetBits);
+  }
+  EncodeIntegers(&integers, 2, &block.time.width, &block.time.exceptions,
+                 &out);
+  // values
+  block.value_pos = out.GetPosition();
+  if (FindDecimalScale(values, &block.value.scale)) {
+    block.value.mode = kDecimalMode;
+    for (size_t i = 0; i < values.size(); ++i) {
+      integers[i] = (uint64_t)(int64_t)std::nearbyint(
+        values[i] * kPowers[block.value.scale]
+      );
+    }
+    EncodeIntegers(&integers, 1, &block.value.width, &block.value.exceptions,
+                   &out);
+    ++_decimal_blocks;
+  } else {
+    block.value.mode = kXorMode;
+    EncodeXor(values, &out);
+  }
+  block.bits.shrink_to_fit();
+  _blocks.push_back(std::move(block));
+  _last.clear();
+}
+
+void CompressedSampleStore::DecodeBlock(const Block &block, size_t skip,
+                                        size_t amount, Record *out) {
+  BitReader times(block.bits.data(), 0);
+  const Coding &kTime = block.time;
+  if (kTime.mode == kDecimalMode) {
+    DecodeIntegers<2, kDecimalMode>(&times, kTime.width, kTime.exceptions,
+                                    kPowers[kTime.scale], skip, amount, out,
+                                    &Record::time);
+  } else {
+    DecodeIntegers<2, kBitsMode>(&times, kTime.width, kTime.exceptions, 1,
+                                 skip, amount, out, &Record::time);
+  }
+  BitReader values(block.bits.data(), block.value_pos);
+  const Coding &kValue = block.value;
+  if (kValue.mode == kDecimalMode) {
+    DecodeIntegers<1, kDecimalMode>(&values, kValue.width, kValue.exceptions,
+                                    kPowers[kValue.scale], skip, amount, out,
+                                    &Record::value);
+  } else {
+    DecodeXor(&values, skip, amount, out);
+  }
+}
+
+bool CompressedSampleStore::PushRecord(const Record &rec) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _last.push_back(rec);
+  if (_last.size() == _block_records) {
+    SealBlock();
+  }
+  return true;
+}
+
+uint64_t CompressedSampleStore::GetSize() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return (uint64_t)_blocks.size() * _block_records + _last.size();
+}
+
+size_t CompressedSampleStore::ReadLocked(uint64_t first, Record *out,
+                                         size_t max_amount) const {
+  const uint64_t kSealed = (uint64_t)_blocks.size() * _block_records;
+  const uint64_t kSize   = kSealed + _last.size();
+  if (first >= kSize) {
+    return 0;
+  }
+  const size_t   kAmount = std::min<uint64_t>(max_amount, kSize - first);
+  const uint64_t kEnd    = first + kAmount;
+  if (first < kSealed) {
+    const size_t kFirstBlock = first / _block_records;
+    const size_t kBlocks     = (std::min(kEnd, kSealed) - 1) / _block_records
+                             - kFirstBlock + 1;
+    auto decode = [this, first, kEnd, kFirstBlock, out](size_t index,
+                                                         size_t) {
+      const uint64_t kBlockFirst = (kFirstBlock + index) * _block_records;
+      const uint64_t kFrom = std::max(first, kBlockFirst);
+      const uint64_t kTo   = std::min(kEnd, kBlockFirst + _block_records);
+      DecodeBlock(_blocks[kFirstBlock + index], kFrom - kBlockFirst,
+                  kTo - kFrom, out + (kFrom - first));
+    };
+    if (kBlocks >= kParallelBlocks) {
+      ParallelFor(kBlocks, decode, _threads);
+    } else {
+      for (size_t i = 0; i < kBlocks; ++i) {
+        decode(i, 0);
+      }
+    }
+  }
+  for (uint64_t pos = std::max(first, kSealed); pos < kEnd; ++pos) {
+    out[pos - first] = _last[pos - kSealed];
+  }
+  return kAmount;
+}
+
+size_t CompressedSampleStore::ReadRecords(uint64_t first, Record *out,
+                                          size_t max_amount) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return ReadLocked(first, out, max_amount);
+}
+
+uint64_t CompressedSampleStore::FindBound(double time, bool upper) const {
+  auto is_before = [time, upper](double label) {
+    return upper ? label <= time : label < time;
+  };
+  // records are sorted by time, so the block is found by its last label
+  const auto kBlock = std::partition_point(_blocks.begin(), _blocks.end(),
+    [&is_before](const Block &block) {
+      return is_before(block.max_time);
+    }
+  );
+  const uint64_t kFirst = (kBlock - _blocks.begin()) * (uint64_t)_block_records;
+  if (kBlock == _blocks.end()) {
+    return kFirst + (std::partition_point(_last.begin(), _last.end(),
+      [&is_before](const Record &rec) {
+        return is_before(rec.time);
+      }
+    ) - _last.begin());
+  }
+  std::vector<Record> recs(_block_records);
+  DecodeBlock(*kBlock, 0, _block_records, recs.data());
+  return kFirst + (std::partition_point(recs.begin(), recs.end(),
+    [&is_before](const Record &rec) {
+      return is_before(rec.time);
+    }
+  ) - recs.begin());
+}
+
+uint64_t CompressedSampleStore::FindRecord(double time) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return FindBound(time, false);
+}
+
+size_t CompressedSampleStore::ReadTimeRange(double from, double to,
+                                            std::vector<Record> *out) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  const uint64_t kFirst = FindBound(from, false);
+  const uint64_t kEnd   = std::max(FindBound(to, true), kFirst);
+  out->resize(kEnd - kFirst);
+  return ReadLocked(kFirst, out->data(), out->size());
+}
+
+size_t CompressedSampleStore::FindValuesOutside(double low, double high,
+                                                std::vector<Record> *out) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto is_outside = [low, high](double value) {
+    return value < low || value > high;
+  };
+  std::vector<size_t> candidates;
+  for (size_t i = 0; i < _blocks.size(); ++i) {
+    if (is_outside(_blocks[i].min_value) || is_outside(_blocks[i].max_value)) {
+      candidates.push_back(i);
+    }
+  }
+  // every task filters its own block, results are joined in order
+  std::vector<std::vector<Record>> found(candidates.size());
+  auto search = [this, &candidates, &found, &is_outside](size_t index,
+                                                        size_t) {
+    std::vector<Record> recs(_block_records);
+    DecodeBlock(_blocks[candidates[index]], 0, _block_records, recs.data());
+    for (const auto &rec : recs) {
+      if (is_outside(rec.value)) {
+        found[index].push_back(rec);
+      }
+    }
+  };
+  if (candidates.size() >= kParallelBlocks) {
+    ParallelFor(candidates.size(), search, _threads);
+  } else {
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      search(i, 0);
+    }
+  }
+  const size_t kOldSize = out->size();
+  for (const auto &recs : found) {
+    out->insert(out->end(), recs.begin(), recs.end());
+  }
+  for (const auto &rec : _last) {
+    if (is_outside(rec.value)) {
+      out->push_back(rec);
+    }
+  }
+  return out->size() - kOldSize;
+}
+
+CompressedSampleStore::Statistics CompressedSampleStore::GetStatistics() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  Statistics stat;
+  stat.blocks         = _blocks.size();
+  stat.decimal_blocks = _decimal_blocks;
+  stat.records        = stat.blocks * _block_records + _last.size();
+  stat.bytes          = _last.capacity() * sizeof(Record);
+  for (const auto &block : _blocks) {
+    stat.bytes += sizeof(Block) + block.bits.capacity() * sizeof(uint64_t);
+  }
+  return stat;
+}
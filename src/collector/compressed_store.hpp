@@ -0,0 +1,92 @@
+#ifndef COMPRESSED_STORE_HPP
+#define COMPRESSED_STORE_HPP
+
+#include <mutex>
+#include <vector>
+#include "sample_store.hpp"
+
+/**
+ * Storage of raw records in memory, which are compressed without loss in
+ * independent blocks of fixed size. Time labels are coded as differences of
+ * differences (near-uniform labels take 0 - 2 bits). Values are coded as
+ * differences of decimal mantissas, if all values of the block are decimal
+ * numbers with limited amount of digits (so are parsed captures), otherwise
+ * as XOR with the previous value (Gorilla). Differences are packed with the
+ * width, which is chosen for every block, rare big differences are stored
+ * as exceptions. Every block keeps ranges of its time labels and values,
+ * so searching skips blocks, which are out of range, and blocks are decoded
+ * in parallel. The last block is not compressed until it is filled.
+ * Methods are thread safe.
+ */
+class CompressedSampleStore : public SampleStore {
+  public:
+    struct Statistics {
+      Statistics();
+      double GetBytesPerRecord() const;
+
+      uint64_t records;
+      uint64_t blocks;         // compressed blocks
+      uint64_t decimal_blocks; // blocks with decimal coding of values
+      uint64_t bytes;          // memory of blocks and of the last block
+    };
+
+    /**
+     * @param block_records amount of records in block;
+     * @param threads       amount of threads, which decode blocks,
+     *                      0 - amount of hardware threads.
+     */
+    CompressedSampleStore(uint32_t block_records = 4096, size_t threads = 0);
+    virtual ~CompressedSampleStore();
+    virtual bool PushRecord(const Record &rec);
+    virtual uint64_t GetSize() const;
+    virtual size_t ReadRecords(uint64_t first, Record *out,
+                               size_t max_amount);
+    virtual uint64_t FindRecord(double time);
+    /**
+     * Method for reading records with time labels in [from, to] into "out".
+     * @return amount of read records.
+     */
+    size_t ReadTimeRange(double from, double to, std::vector<Record> *out);
+    /**
+     * Method for searching records with values out of [low, high], they are
+     * appended to "out". Only blocks with such values are decoded.
+     * @return amount of found records.
+     */
+    size_t FindValuesOutside(double low, double high,
+                             std::vector<Record> *out);
+    Statistics GetStatistics() const;
+  private:
+    // coding of one column of block
+    struct Coding {
+      Coding();
+
+      uint8_t mode;       // decimal, bits or XOR
+      uint8_t scale;      // decimal digits after point
+      uint8_t width;      // bits of packed differences
+      bool    exceptions; // differences are marked as packed or exceptions
+    };
+    struct Block {
+      double                min_time;
+      double                max_time;
+      double                min_value;
+      double                max_value;
+      Coding                time;
+      Coding                value;
+      uint64_t              value_pos; // position of values in "bits"
+      std::vector<uint64_t> bits;
+    };
+
+    void SealBlock();
+    uint64_t FindBound(double time, bool upper) const;
+    size_t ReadLocked(uint64_t first, Record *out, size_t max_amount) const;
+    static void DecodeBlock(const Block &block, size_t skip, size_t amount,
+                            Record *out);
+
+    const uint32_t      _block_records;
+    const size_t        _threads;
+    mutable std::mutex  _mutex;
+    std::vector<Block>  _blocks;
+    std::vector<Record> _last;     // records of the last (not full) block
+    uint64_t            _decimal_blocks;
+};
+#endif
@@ -1,6 +1,7 @@
 #include "compressor.hpp"
 #include <boost/lexical_cast.hpp>
 #include <iostream>
+#include <algorithm>
 
 std::ostream& operator<< (std::ostream &s, const Compressor::Range &rng) {
   s << std::fixed << rng.first << " - " << std::fixed << rng.second;
@@ -17,64 +18,50 @@ std::ostream& operator<< (std::ostream &s, const Compressor::Record &rec) {
 Compressor::Record::Record(double time, double value)
     : time(time, std::nan("")),
       value(value, std::nan("")),
+      extreme_time(time, std::nan("")),
       amount(1) {
 }
 
 Compressor::Record::Record(const Range &time, const Range &value)
     : time(time),
       value(value),
+      extreme_time(time),
       amount(1) {
   if (not std::isnan(time.second)) {
     ++amount;
   }
 }
 
-Compressor::Record::Record(const VoidDataSource::Record &rec)
-    : time(rec.time, std::nan("")),
-      value(rec.value, std::nan("")),
-      amount(1) {
+Compressor::Record::Record(const Record &src)
+    : time(src.time),
+      value(src.value),
+      extreme_time(src.extreme_time),
+      amount(src.amount),
+      sketch(src.sketch ? new QuantileSketch(*src.sketch) : 0) {
 }
 
-static
-void SwapIfGreater(double &f, double &s) {
-  if (s > f || std::isnan(f)) {
-    std::swap(f, s);
+Compressor::Record& Compressor::Record::operator= (const Record &src) {
+  if (this != &src) {
+    time         = src.time;
+    value        = src.value;
+    extreme_time = src.extreme_time;
+    amount       = src.amount;
+    sketch.reset(src.sketch ? new QuantileSketch(*src.sketch) : 0);
   }
+  return *this;
 }
 
-bool Compressor::Record::MergeWith(const Record &src) {
-  // merging old record (src) with new (this)
-  if (src.time.first > time.first ||
-      (not std::isnan(src.time.second) && src.time.second > time.first)
-     ) {
-    return false;
-  }
-  // extending "time" range with values from "src"
-  // if we are here, it means that "src" "time" range < this "time" range. 
-  // this "time" [5, 6]; "src" "time" [3, 4]
-  // Swap        [5, 6]; "src" "time" [3, 4] nothing was changed, because 5 < 6
-  // copy        [3, 6]; ...
-  SwapIfGreater(time.second, time.first);
-  time.first = src.time.first;
-  // extending "value" range with values from "src"
-  // if "src" "value" < this "value"
-  // this "value" [7, 8]; "src" "value" [1, 2]
-  // Swap         [7, 8]; ... nothing was changed, because 7 < 8
-  // copy         [1, 8]; ...
-  if (src.value.first < value.first) {
-    SwapIfGreater(value.second, value.first);
-    value.first = src.value.first;
-  }
-  double t_sec = src.value.second;
-  if (std::isnan(t_sec)) {
-    t_sec = src.value.first;
-  }
-  // additional checks for making range valid, it is when first
-  // element is lesser than second
-  SwapIfGreater(value.second, t_sec);
-  SwapIfGreater(value.second, value.first);
-  amount += src.amount;
-  return true;
+double Compressor::Record::GetQuantile(double q) const {
+  return sketch ? sketch->GetQuantile(q, value.first, value.second)
+                : std::nan("");
+}
+// class Compressor::State
+Compressor::State::State()
+    : rec_capacity(1),
+      merge_position(0),
+      time_scale(std::nan(""), std::nan("")),
+      value_scale(std::nan(""), std::nan("")),
+      pushed(0) {
 }
 // class Compressor
 Compressor::Compressor(uint32_t max_size)
@@ -82,85 +69,30 @@ Compressor::Compressor(uint32_t max_size)
       _pushed_records(0),
       _rec_capacity(1),
       _time_scale(std::nan(""), std::nan("")),
-      _value_scale(std::nan(""), std::nan("")) {
+      _value_scale(std::nan(""), std::nan("")),
+      _quantiles(false) {
 }
 
 Compressor::~Compressor() {
 }
 
-void Compressor::PrecalculateScales(const Record &rec) {
-  ++_pushed_records;
-  if (std::isnan(_time_scale.first) || 
-      rec.time.first < _time_scale.first) {
-     _time_scale.first = rec.time.first;
-  }
-  if (std::isnan(_time_scale.second) ||
-      rec.time.first > _time_scale.second) {
-    _time_scale.second = rec.time.first;
-  }
-  if (std::isnan(_value_scale.first) || 
-      rec.value.first < _value_scale.first) {
-    _value_scale.first = rec.value.first;
-  }
-  if (std::isnan(_value_scale.second) || 
-      rec.value.first > _value_scale.second) {
-    _value_scale.second = rec.value.first;
-  }
+void Compressor::UseQuantiles(bool enable) {
+  _quantiles = enable;
 }
 
-bool Compressor::PushRecord(Record &&new_rec) {
-  PrecalculateScales(new_rec);
-  const auto kAmountOfRecs = _records.size();
-  // simple filling in buffer, until it reach limit
-  if (kAmountOfRecs < _max_size) {
-    _records.push_back(new_rec);
-    if (kAmountOfRecs == 1) {
-      _record_it = _records.begin();
-    }
-    return true;
-  }
-  bool was_merged = false;
-  auto prev_rec   = *_record_it;
-  bool select_last_pushed = false;
-  // if size of buffer is equal to limit,
-  // we need to free some space, for new records
-  _record_it = _records.erase(_record_it);
-  if (_record_it != _records.end()) {
-    // if current position in buffer is not at the end,
-    // we will merge two nearest records into one. Until its
-    // capacity will not reach global value "_rec_capacity"
-    was_merged = _record_it->MergeWith(prev_rec);
-    if (_record_it->amount > _rec_capacity) {
-      _rec_capacity = _record_it->amount;
-    }
-    if (_record_it->amount == _rec_capacity) {
-      ++_record_it;
-    }
-    if (_record_it == _records.end()) {
-      select_last_pushed = true;
-    }
-  } else {
-    // doing same at the end of buffer,
-    // and moving "compress" iterator to the beginning, when
-    // there are no space for merging at the end
-    was_merged = new_rec.MergeWith(prev_rec);
-    if (new_rec.amount == _rec_capacity) {
-      _record_it = _records.begin();
-    } else {
-      select_last_pushed = true;
-    }
-  }
-  if (not was_merged) {
-    SetMessage("Failed to push record! Record #" 
-      + boost::lexical_cast<std::string>(_pushed_records)
-    );
-    return false;
-  }
-  _records.push_back(new_rec);
-  if (select_last_pushed) {
-    _record_it = --_records.end();
-  }
-  return true;
+bool Compressor::IsQuantilesUsed() const {
+  return _quantiles;
+}
+
+uint32_t Compressor::GetMaxSize() const {
+  return _max_size;
+}
+
+bool Compressor::ReportFailedMerge() {
+  SetMessage("Failed to push record! Record #"
+    + boost::lexical_cast<std::string>(_pushed_records)
+  );
+  return false;
 }
 
 uint8_t Compressor::CastRecordToScales(const Record &rec, Range out[2]) const {
@@ -184,16 +116,123 @@ uint8_t Compressor::CastRecordToScales(const Record &rec, Range out[2]) const {
   return 2;
 }
 
+bool Compressor::CastQuantileToScales(const Record &rec, double q,
+                                      Range *out) const {
+  const double kTimeScaleLen  = _time_scale.second - _time_scale.first;
+  const double kValueScaleLen = _value_scale.second - _value_scale.first;
+  const double kValue         = rec.GetQuantile(q);
+  if (kTimeScaleLen == 0.0 || kValueScaleLen == 0.0 || std::isnan(kValue)) {
+    return false;
+  }
+  const double kTime = std::isnan(rec.time.second)
+                     ? rec.time.first
+                     : (rec.time.first + rec.time.second) / 2;
+  *out = Range(
+    (kTime - _time_scale.first) / kTimeScaleLen,
+    (kValue - _value_scale.first) / kValueScaleLen
+  );
+  return true;
+}
+
 const Compressor::Record::List& Compressor::GetRecords() const {
   return _records;
 }
 
+void Compressor::SubtractTrend(
+    const std::function<double(double)> &trend) {
+  _value_scale = Range(std::nan(""), std::nan(""));
+  for (auto &rec : _records) {
+    Range value(rec.value.first - trend(rec.extreme_time.first),
+                std::nan(""));
+    Range value_time(rec.extreme_time);
+    if (not std::isnan(rec.value.second)) {
+      value.second = rec.value.second - trend(rec.extreme_time.second);
+      // the lowest value can become the highest one after correction
+      if (value.second < value.first) {
+        std::swap(value.first, value.second);
+        std::swap(value_time.first, value_time.second);
+      }
+    }
+    if (rec.sketch) {
+      const double kTime = std::isnan(rec.time.second)
+                         ? rec.time.first
+                         : (rec.time.first + rec.time.second) / 2;
+      rec.sketch->Shift(-trend(kTime));
+    }
+    rec.value        = value;
+    rec.extreme_time = value_time;
+    const double kHighest = std::isnan(value.second) ? value.first
+                                                     : value.second;
+    if (std::isnan(_value_scale.first) || value.first < _value_scale.first) {
+      _value_scale.first = value.first;
+    }
+    if (std::isnan(_value_scale.second) || kHighest > _value_scale.second) {
+      _value_scale.second = kHighest;
+    }
+  }
+}
+
+void Compressor::Assign(Record::List &&records, const Range &time_scale,
+                        const Range &value_scale, size_t pushed) {
+  _records.swap(records);
+  _time_scale     = time_scale;
+  _value_scale    = value_scale;
+  _pushed_records = pushed;
+  _rec_capacity   = 1;
+  for (const auto &rec : _records) {
+    _rec_capacity = std::max(_rec_capacity, rec.amount);
+  }
+  _record_it = _records.begin();
+}
+
+void Compressor::GetState(State *out) const {
+  out->records      = _records;
+  out->rec_capacity = _rec_capacity;
+  // iterator of merging is set, when the second record is pushed
+  out->merge_position = _records.size() < 2
+                      ? 0
+                      : std::distance(_records.begin(),
+                                      Record::List::const_iterator(_record_it));
+  out->time_scale  = _time_scale;
+  out->value_scale = _value_scale;
+  out->pushed      = _pushed_records;
+}
+
+bool Compressor::SetState(State &&state) {
+  if (state.records.size() > _max_size ||
+      (state.records.size() > 1 &&
+       state.merge_position >= state.records.size())) {
+    SetMessage("Invalid state of compressor");
+    return false;
+  }
+  _records.swap(state.records);
+  _rec_capacity   = state.rec_capacity;
+  _time_scale     = state.time_scale;
+  _value_scale    = state.value_scale;
+  _pushed_records = state.pushed;
+  _record_it      = _records.begin();
+  std::advance(_record_it, _records.size() < 2 ? 0 : state.merge_position);
+  return true;
+}
+
+size_t Compressor::GetPushedRecords() const {
+  return _pushed_records;
+}
+
+const Compressor::Range& Compressor::GetTimeScale() const {
+  return _time_scale;
+}
+
+const Compressor::Range& Compressor::GetValueScale() const {
+  return _value_scale;
+}
+
 double Compressor::GetTimeScaleLen() const {
   return (_time_scale.second - _time_scale.first);
 }
 
 double Compressor::GetValueScaleLen() const {
-  return (_value_scale.second - _time_scale.first);
+  return (_value_scale.second - _value_scale.first);
 }
 
 const std::string& Compressor::GetMessage() const {
@@ -2,7 +2,12 @@
 #define COMPRESSOR_HPP
 
 #include <list>
+#include <cmath>
+#include <memory>
+#include <algorithm>
+#include <functional>
 #include "data_source.hpp"
+#include "quantile_sketch.hpp"
 
 /** UTF8
 Разбор алгортма сжатия записей по шагам.
@@ -48,6 +53,9 @@
 **/
 /**
  * Class for compressing big amount of records into small buffer.
+ * Methods of pushing are defined in the header, so they can be inlined
+ * into the loading loop of "BasicCollector" with the static type of
+ * compressor.
  */
 class Compressor {
   public:
@@ -59,6 +67,11 @@ class Compressor {
      * - time  : range of time labels
      * - value : range of values into the time interval
      * - amount: amount of records into the time interval
+     * - extreme_time: time labels of the lowest and the highest values,
+     *                 they allow to correct values after compression
+     * - sketch: distribution of values, it is allocated only if quantiles
+     *           are used by compressor, so records without quantiles stay
+     *           small
      */
     class Record {
       public:
@@ -67,6 +80,11 @@ class Compressor {
         Record(double time, double value);
         Record(const Range &time, const Range &value);
         Record(const VoidDataSource::Record &rec);
+        // copies of records get their own copies of sketches
+        Record(const Record &src);
+        Record(Record &&src) = default;
+        Record& operator= (const Record &src);
+        Record& operator= (Record &&src) = default;
         /**
          * Method for merging two records into one.
          * For better understanding please look at 
@@ -77,10 +95,42 @@ class Compressor {
          * @return true if merging was finished.              
          */
         bool MergeWith(const Record &src);
+        /**
+         * @param q level of quantile [0, 1];
+         * @return estimated value of quantile or NaN if there is no sketch.
+         */
+        double GetQuantile(double q) const;
+
+        Range                           time;
+        Range                           value;
+        Range                           extreme_time;
+        uint32_t                        amount;
+        std::unique_ptr<QuantileSketch> sketch; // null without quantiles
+      private:
+        static void SwapIfGreater(double &f, double &s);
+        /**
+         * @return time label of "value", which is one of extremes of
+         *         merged records: "values" with time labels "times" and
+         *         "src".
+         */
+        static double GetExtremeTime(double value, const Range &values,
+                                     const Range &times, const Record &src);
+    };
 
-        Range    time;
-        Range    value;
-        uint32_t amount;
+    /**
+     * The whole state of compressor, which is needed for continuing of
+     * pushing (please look at "Checkpoint").
+     */
+    struct State {
+      State();
+
+      Record::List records;
+      uint32_t     rec_capacity;
+      uint32_t     merge_position; // index of record, which is merged by
+                                   // the next pushing
+      Range        time_scale;
+      Range        value_scale;
+      uint64_t     pushed;
     };
 
     Compressor(uint32_t max_size);
@@ -95,6 +145,14 @@ class Compressor {
      * @return true if pushing was finished.
      */
     virtual bool PushRecord(Record &&new_rec);
+    /**
+     * Method for enabling sketches of values distribution in records, so
+     * quantiles of buckets can be drawn instead of value ranges.
+     * It must be called before pushing of records.
+     */
+    void UseQuantiles(bool enable);
+    bool IsQuantilesUsed() const;
+    uint32_t GetMaxSize() const;
     /**
      * Method for calculating scales: time, values;
      * @param rec reference for record
@@ -108,12 +166,58 @@ class Compressor {
      * @return amount of ratios in output
      */
     uint8_t CastRecordToScales(const Record &rec, Range out[2]) const;
+    /**
+     * Method for getting ratios of record quantile projected on scales,
+     * it is placed at the middle of record time range.
+     * @param rec record with sketch;
+     * @param q   level of quantile [0, 1];
+     * @param out values of ratios, it is an output parameter;
+     * @return false if record has no sketch or scales are empty.
+     */
+    bool CastQuantileToScales(const Record &rec, double q, Range *out) const;
     const Record::List& GetRecords() const;
+    /**
+     * Method for subtracting the trend from compressed records after
+     * pushing, so loading does not need the second pass. Extreme values
+     * are corrected by the trend at their own time labels, sketches are
+     * shifted by the trend at the middle of the record. Ranges of records
+     * are approximate: another record of the bucket can become extreme
+     * after correction, so the error is bounded by the rate of the trend
+     * multiplied by the time span of the record. Scale of values is
+     * recalculated.
+     * @param trend functor: double (double time).
+     */
+    void SubtractTrend(const std::function<double(double)> &trend);
+    /**
+     * Method for replacing the whole state of compressor, for example by
+     * the snapshot of another compressor (please look at "SharedView").
+     * Pushing after it continues merging from the first record.
+     * @param records records of buffer, their amount must not be greater
+     *                than the limit of buffer;
+     * @param time_scale  range of time labels;
+     * @param value_scale range of values;
+     * @param pushed      amount of pushed records.
+     */
+    void Assign(Record::List &&records, const Range &time_scale,
+                const Range &value_scale, size_t pushed);
+    /**
+     * Methods for copying the state, compressor with restored state pushes
+     * next records exactly like the original one.
+     * @return false if state has more records than the limit of buffer or
+     *         position of merging is invalid.
+     */
+    void GetState(State *out) const;
+    bool SetState(State &&state);
+    size_t GetPushedRecords() const;
+    const Range& GetTimeScale() const;
+    const Range& GetValueScale() const;
     double GetTimeScaleLen() const;
     double GetValueScaleLen() const;
   protected:
     void SetMessage(const std::string &msg);
   private:
+    bool ReportFailedMerge();
+
     size_t                 _pushed_records;
     uint32_t               _rec_capacity;
     std::string            _message;
@@ -122,8 +226,168 @@ class Compressor {
     const uint32_t         _max_size;
     Record::List           _records;
     Record::List::iterator _record_it;
+    bool                   _quantiles;
 };
 
 std::ostream& operator<< (std::ostream &s, const Compressor::Range &rng);
 std::ostream& operator<< (std::ostream &s, const Compressor::Record &rec);
+// class Compressor::Record
+inline
+Compressor::Record::Record(const VoidDataSource::Record &rec)
+    : time(rec.time, std::nan("")),
+      value(rec.value, std::nan("")),
+      extreme_time(rec.time, std::nan("")),
+      amount(1) {
+}
+
+inline
+void Compressor::Record::SwapIfGreater(double &f, double &s) {
+  if (s > f || std::isnan(f)) {
+    std::swap(f, s);
+  }
+}
+
+inline
+double Compressor::Record::GetExtremeTime(double value, const Range &values,
+                                          const Range &times,
+                                          const Record &src) {
+  if (value == src.value.first) {
+    return src.extreme_time.first;
+  }
+  if (value == src.value.second) {
+    return src.extreme_time.second;
+  }
+  if (value == values.second) {
+    return times.second;
+  }
+  return times.first;
+}
+
+inline
+bool Compressor::Record::MergeWith(const Record &src) {
+  // merging old record (src) with new (this)
+  if (src.time.first > time.first ||
+      (not std::isnan(src.time.second) && src.time.second > time.first)
+     ) {
+    return false;
+  }
+  const Range kValue(value);
+  const Range kExtremeTime(extreme_time);
+  // extending "time" range with values from "src"
+  // if we are here, it means that "src" "time" range < this "time" range. 
+  // this "time" [5, 6]; "src" "time" [3, 4]
+  // Swap        [5, 6]; "src" "time" [3, 4] nothing was changed, because 5 < 6
+  // copy        [3, 6]; ...
+  SwapIfGreater(time.second, time.first);
+  time.first = src.time.first;
+  // extending "value" range with values from "src"
+  // if "src" "value" < this "value"
+  // this "value" [7, 8]; "src" "value" [1, 2]
+  // Swap         [7, 8]; ... nothing was changed, because 7 < 8
+  // copy         [1, 8]; ...
+  if (src.value.first < value.first) {
+    SwapIfGreater(value.second, value.first);
+    value.first = src.value.first;
+  }
+  double t_sec = src.value.second;
+  if (std::isnan(t_sec)) {
+    t_sec = src.value.first;
+  }
+  // additional checks for making range valid, it is when first
+  // element is lesser than second
+  SwapIfGreater(value.second, t_sec);
+  SwapIfGreater(value.second, value.first);
+  extreme_time.first  = GetExtremeTime(value.first, kValue, kExtremeTime,
+                                       src);
+  extreme_time.second = GetExtremeTime(value.second, kValue, kExtremeTime,
+                                       src);
+  amount += src.amount;
+  if (src.sketch && not sketch) {
+    sketch.reset(new QuantileSketch(*src.sketch));
+  } else if (src.sketch) {
+    sketch->MergeWith(*src.sketch);
+  }
+  return true;
+}
+// class Compressor
+inline
+void Compressor::PrecalculateScales(const Record &rec) {
+  ++_pushed_records;
+  if (std::isnan(_time_scale.first) || 
+      rec.time.first < _time_scale.first) {
+     _time_scale.first = rec.time.first;
+  }
+  if (std::isnan(_time_scale.second) ||
+      rec.time.first > _time_scale.second) {
+    _time_scale.second = rec.time.first;
+  }
+  if (std::isnan(_value_scale.first) || 
+      rec.value.first < _value_scale.first) {
+    _value_scale.first = rec.value.first;
+  }
+  if (std::isnan(_value_scale.second) || 
+      rec.value.first > _value_scale.second) {
+    _value_scale.second = rec.value.first;
+  }
+}
+
+inline
+bool Compressor::PushRecord(Record &&new_rec) {
+  PrecalculateScales(new_rec);
+  if (_quantiles && not new_rec.sketch) {
+    new_rec.sketch.reset(new QuantileSketch());
+    new_rec.sketch->Add(new_rec.value.first);
+    if (new_rec.amount > 1 && not std::isnan(new_rec.value.second)) {
+      new_rec.sketch->Add(new_rec.value.second);
+    }
+  }
+  const auto kAmountOfRecs = _records.size();
+  // simple filling in buffer, until it reach limit
+  if (kAmountOfRecs < _max_size) {
+    _records.push_back(std::move(new_rec));
+    if (kAmountOfRecs == 1) {
+      _record_it = _records.begin();
+    }
+    return true;
+  }
+  bool was_merged = false;
+  Record prev_rec(std::move(*_record_it));
+  bool select_last_pushed = false;
+  // if size of buffer is equal to limit,
+  // we need to free some space, for new records
+  _record_it = _records.erase(_record_it);
+  if (_record_it != _records.end()) {
+    // if current position in buffer is not at the end,
+    // we will merge two nearest records into one. Until its
+    // capacity will not reach global value "_rec_capacity"
+    was_merged = _record_it->MergeWith(prev_rec);
+    if (_record_it->amount > _rec_capacity) {
+      _rec_capacity = _record_it->amount;
+    }
+    if (_record_it->amount == _rec_capacity) {
+      ++_record_it;
+    }
+    if (_record_it == _records.end()) {
+      select_last_pushed = true;
+    }
+  } else {
+    // doing same at the end of buffer,
+    // and moving "compress" iterator to the beginning, when
+    // there are no space for merging at the end
+    was_merged = new_rec.MergeWith(prev_rec);
+    if (new_rec.amount == _rec_capacity) {
+      _record_it = _records.begin();
+    } else {
+      select_last_pushed = true;
+    }
+  }
+  if (not was_merged) {
+    return ReportFailedMerge();
+  }
+  _records.push_back(std::move(new_rec));
+  if (select_last_pushed) {
+    _record_it = --_records.end();
+  }
+  return true;
+}
 #endif
\ No newline at end of file
@@ -0,0 +1,277 @@
+#include "cornered_hat.hpp"
+#include "parallel.hpp"
+#include <cmath>
+#include <algorithm>
+#include <boost/lexical_cast.hpp>
+
+typedef VoidDataSource::Record Record;
+
+// the lowest amount of terms in sum of Allan variance
+static const size_t kMinTerms = 2;
+
+// class CorneredHat::Settings
+CorneredHat::Settings::Settings()
+    : tolerance(1e-3),
+      nominal(std::nan("")),
+      threads(0) {
+}
+// class CorneredHat
+CorneredHat::CorneredHat(const Settings &settings)
+    : _settings(settings),
+      _oscillators(0),
+      _tau0(std::nan("")) {
+}
+
+void CorneredHat::AddPair(uint8_t first, uint8_t second,
+                          VoidDataSource *source) {
+  _pairs.push_back(Pair());
+  _pairs.back().first  = first;
+  _pairs.back().second = second;
+  _pairs.back().source.reset(source);
+}
+
+bool CorneredHat::CheckPairs() {
+  _oscillators = 0;
+  for (const auto &pair : _pairs) {
+    _oscillators = std::max<size_t>(_oscillators,
+                                    std::max(pair.first, pair.second) + 1);
+  }
+  if (_oscillators < 3) {
+    SetMessage("At least three oscillators are needed");
+    return false;
+  }
+  // every pair must be measured exactly once
+  std::vector<int> measured(_oscillators * _oscillators, 0);
+  for (const auto &pair : _pairs) {
+    const size_t kLow  = std::min(pair.first, pair.second);
+    const size_t kHigh = std::max(pair.first, pair.second);
+    if (kLow == kHigh || ++measured[kLow * _oscillators + kHigh] > 1) {
+      SetMessage("Invalid pair of oscillators: "
+        + boost::lexical_cast<std::string>(kLow) + "-"
+        + boost::lexical_cast<std::string>(kHigh)
+      );
+      return false;
+    }
+  }
+  if (_pairs.size() != _oscillators * (_oscillators - 1) / 2) {
+    SetMessage("Not all pairs of oscillators are measured");
+    return false;
+  }
+  return true;
+}
+
+bool CorneredHat::LoadPairs() {
+  std::vector<std::string> errors(_pairs.size());
+  // loading is limited by reading and parsing, so every capture gets its
+  // own thread
+  ParallelFor(_pairs.size(), [this, &errors](size_t index, size_t) {
+    Pair           &pair = _pairs[index];
+    VoidDataSource *src  = pair.source.get();
+    pair.records.clear();
+    if (not src->OccupySource()) {
+      errors[index] = src->GetMessage();
+      return;
+    }
+    Record rec;
+    while (not src->IsAtTheEnd()) {
+      if (src->GetRecord(&rec)) {
+        pair.records.push_back(rec);
+      }
+    }
+    // skipped lines would shift epochs of the pair, so errors of parsing
+    // fail loading as well as errors of reading
+    errors[index] = src->GetMessage();
+    src->ReleaseSource();
+  }, _pairs.size());
+  for (size_t i = 0; i < _pairs.size(); ++i) {
+    if (not errors[i].empty()) {
+      SetMessage("Failed to load pair #"
+        + boost::lexical_cast<std::string>(i) + ": " + errors[i]
+      );
+      return false;
+    }
+  }
+  return true;
+}
+
+bool CorneredHat::AlignPairs() {
+  const auto &master = _pairs.front().records;
+  const size_t kEpochs = master.size();
+  // indexes of records, which are aligned with records of the first pair
+  std::vector<std::vector<int64_t>> aligned(_pairs.size());
+  ParallelFor(_pairs.size(), [this, &master, &aligned, kEpochs](size_t p,
+                                                                size_t) {
+    const auto &recs = _pairs[p].records;
+    auto       &out  = aligned[p];
+    out.assign(kEpochs, -1);
+    size_t pos = 0;
+    for (size_t k = 0; k < kEpochs && not recs.empty(); ++k) {
+      const double kTime = master[k].time;
+      while (pos + 1 < recs.size() && recs[pos + 1].time <= kTime) {
+        ++pos;
+      }
+      size_t nearest = pos;
+      if (pos + 1 < recs.size() &&
+          recs[pos + 1].time - kTime < std::fabs(kTime - recs[pos].time)) {
+        nearest = pos + 1;
+      }
+      if (std::fabs(recs[nearest].time - kTime) <= _settings.tolerance) {
+        out[k] = nearest;
+      }
+    }
+  }, _settings.threads);
+  std::vector<size_t> epochs;
+  for (size_t k = 0; k < kEpochs; ++k) {
+    bool complete = true;
+    for (size_t p = 0; p < _pairs.size() && complete; ++p) {
+      complete = aligned[p][k] >= 0;
+    }
+    if (complete) {
+      epochs.push_back(k);
+    }
+  }
+  if (epochs.size() < 2 * kMinTerms + 1) {
+    SetMessage("Not enough aligned records: "
+      + boost::lexical_cast<std::string>(epochs.size())
+    );
+    return false;
+  }
+  // median interval is not changed by gaps
+  Curve intervals(kEpochs - 1);
+  for (size_t k = 1; k < kEpochs; ++k) {
+    intervals[k - 1] = master[k].time - master[k - 1].time;
+  }
+  const auto kMedian = intervals.begin() + intervals.size() / 2;
+  std::nth_element(intervals.begin(), kMedian, intervals.end());
+  _tau0 = *kMedian;
+  if (not (_tau0 > 0)) {
+    SetMessage("Invalid interval of records");
+    return false;
+  }
+  // phase is cumulative sum of frequency, mean frequency does not change
+  // Allan variance, so it is removed for precision of sums
+  const bool kFractional = not std::isnan(_settings.nominal);
+  _phases.assign(_pairs.size(), Curve());
+  ParallelFor(_pairs.size(), [&](size_t p, size_t) {
+    const auto &recs = _pairs[p].records;
+    Curve       freq(epochs.size());
+    for (size_t i = 0; i < epochs.size(); ++i) {
+      const double kValue = recs[aligned[p][epochs[i]]].value;
+      freq[i] = kFractional ? (kValue - _settings.nominal) / _settings.nominal
+                            : kValue;
+    }
+    double mean = 0;
+    for (auto value : freq) {
+      mean += value;
+    }
+    mean /= freq.size();
+    Curve &phase = _phases[p];
+    phase.resize(freq.size() + 1);
+    phase[0] = 0;
+    for (size_t i = 0; i < freq.size(); ++i) {
+      phase[i + 1] = phase[i] + (freq[i] - mean) * _tau0;
+    }
+  }, _settings.threads);
+  return true;
+}
+
+double CorneredHat::CalculateAllanVariance(const double *phase, size_t size,
+                                           uint32_t factor, double tau0) {
+  if (factor == 0 || size < 2 * (size_t)factor + kMinTerms) {
+    return std::nan("");
+  }
+  const size_t kTerms = size - 2 * factor;
+  double sum = 0;
+  for (size_t k = 0; k < kTerms; ++k) {
+    const double kDiff = phase[k + 2 * factor] - 2 * phase[k + factor]
+                       + phase[k];
+    sum += kDiff * kDiff;
+  }
+  const double kTau = factor * tau0;
+  return sum / (2 * kTau * kTau * kTerms);
+}
+
+bool CorneredHat::Calculate() {
+  _taus.clear();
+  _pair_devs.clear();
+  _devs.clear();
+  _phases.clear();
+  if (not CheckPairs() || not LoadPairs() || not AlignPairs()) {
+    return false;
+  }
+  // records are not needed after aligning
+  for (auto &pair : _pairs) {
+    std::vector<Record>().swap(pair.records);
+  }
+  const size_t kSize = _phases.front().size();
+  std::vector<uint32_t> factors;
+  for (uint64_t m = 1; kSize >= 2 * m + kMinTerms; m *= 2) {
+    factors.push_back(m);
+    _taus.push_back(m * _tau0);
+  }
+  const size_t kTaus = factors.size();
+  std::vector<Curve> vars(_pairs.size(), Curve(kTaus));
+  ParallelFor(_pairs.size() * kTaus, [&](size_t index, size_t) {
+    const size_t kPair = index / kTaus;
+    const size_t kTau  = index % kTaus;
+    vars[kPair][kTau] = CalculateAllanVariance(_phases[kPair].data(), kSize,
+                                               factors[kTau], _tau0);
+  }, _settings.threads);
+  for (const auto &var : vars) {
+    _pair_devs.emplace_back(var.size());
+    std::transform(var.begin(), var.end(), _pair_devs.back().begin(),
+                   [](double value) { return std::sqrt(value); });
+  }
+  const double kN = _oscillators;
+  _devs.assign(_oscillators, Curve(kTaus));
+  for (size_t t = 0; t < kTaus; ++t) {
+    double total = 0;
+    for (const auto &var : vars) {
+      total += var[t];
+    }
+    for (size_t osc = 0; osc < _oscillators; ++osc) {
+      double own = 0;
+      for (size_t p = 0; p < _pairs.size(); ++p) {
+        if (_pairs[p].first == osc || _pairs[p].second == osc) {
+          own += vars[p][t];
+        }
+      }
+      const double kVar = (own - total / (kN - 1)) / (kN - 2);
+      _devs[osc][t] = kVar >= 0 ? std::sqrt(kVar) : std::nan("");
+    }
+  }
+  return true;
+}
+
+size_t CorneredHat::GetOscillatorsAmount() const {
+  return _oscillators;
+}
+
+uint64_t CorneredHat::GetAlignedRecords() const {
+  return _phases.empty() ? 0 : _phases.front().size() - 1;
+}
+
+double CorneredHat::GetSampleInterval() const {
+  return _tau0;
+}
+
+const CorneredHat::Curve& CorneredHat::GetTaus() const {
+  return _taus;
+}
+
+const std::vector<CorneredHat::Curve>&
+CorneredHat::GetPairDeviations() const {
+  return _pair_devs;
+}
+
+const std::vector<CorneredHat::Curve>& CorneredHat::GetDeviations() const {
+  return _devs;
+}
+
+const std::string& CorneredHat::GetMessage() const {
+  return _message;
+}
+
+void CorneredHat::SetMessage(const std::string &msg) {
+  _message = msg;
+}
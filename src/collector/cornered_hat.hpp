@@ -0,0 +1,106 @@
+#ifndef CORNERED_HAT_HPP
+#define CORNERED_HAT_HPP
+
+#include <vector>
+#include "data_source.hpp"
+
+/**
+ * Separation of instabilities of N >= 3 oscillators, which are measured
+ * against each other (three-cornered hat, N-cornered hat by Barnes).
+ * Every pair of oscillators has its own capture of frequency difference,
+ * all N * (N - 1) / 2 pairs are needed. Captures are loaded by several
+ * threads and aligned by time labels of the first pair: epochs, which
+ * are not present in all captures (in the tolerance), are skipped, gaps
+ * are not filled.
+ * Overlapping Allan variance of pairs is calculated from cumulative sums
+ * of frequency (phase), so every tau costs O(n), pairs and taus are
+ * calculated in parallel. Variance of the oscillator "i":
+ * s_i^2 = 1/(N-2) * (sum_j s_ij^2 - 1/(N-1) * sum_{k<l} s_kl^2).
+ */
+class CorneredHat {
+  public:
+    struct Settings {
+      Settings();
+
+      double   tolerance; // the highest distance between time labels of
+                          // aligned records (seconds)
+      double   nominal;   // Hz, values are converted into fractional
+                          // frequency if it is not NaN
+      size_t   threads;   // 0 - amount of hardware threads
+    };
+    typedef std::vector<double> Curve;
+
+    CorneredHat(const Settings &settings = Settings());
+    /**
+     * Method for adding capture of the pair of oscillators. Sign of
+     * difference does not matter.
+     * @param first  index of oscillator [0, N);
+     * @param second index of another oscillator [0, N);
+     * @param source source of records, it is owned by created object.
+     */
+    void AddPair(uint8_t first, uint8_t second, VoidDataSource *source);
+    /**
+     * Method for loading, aligning and calculating of deviations for
+     * taus: tau0 * 2^k, where tau0 is the median interval of records.
+     * @return false if pairs are incomplete, captures are not loaded (or
+     *         have lines, which are not parsed) or there are not enough
+     *         aligned records.
+     */
+    bool Calculate();
+    size_t GetOscillatorsAmount() const;
+    uint64_t GetAlignedRecords() const;
+    double GetSampleInterval() const;
+    /**
+     * @return taus of curves (seconds).
+     */
+    const Curve& GetTaus() const;
+    /**
+     * @return Allan deviation of pairs in order of adding.
+     */
+    const std::vector<Curve>& GetPairDeviations() const;
+    /**
+     * @return Allan deviation of oscillators, NaN if estimated variance
+     *         is negative (it happens, when noise of the oscillator is
+     *         much lower than noises of others).
+     */
+    const std::vector<Curve>& GetDeviations() const;
+    const std::string& GetMessage() const;
+    /**
+     * Method for calculating overlapping Allan variance from phase:
+     * 1/(2 * (m * tau0)^2 * (n - 2m)) * sum (x[k+2m] - 2x[k+m] + x[k])^2.
+     * @param phase  cumulative sums of frequency multiplied by tau0;
+     * @param size   amount of phase points (n);
+     * @param factor averaging factor (m);
+     * @param tau0   interval of frequency records (seconds);
+     * @return NaN if there are not enough points.
+     */
+    static double CalculateAllanVariance(const double *phase, size_t size,
+                                         uint32_t factor, double tau0);
+  private:
+    struct Pair {
+      uint8_t             first;
+      uint8_t             second;
+      VoidDataSource::ShrPtr source;
+      std::vector<VoidDataSource::Record> records;
+    };
+
+    bool CheckPairs();
+    bool LoadPairs();
+    /**
+     * Method for aligning records of pairs by time labels of the first
+     * pair, aligned values are placed into "_phases" as frequency.
+     */
+    bool AlignPairs();
+    void SetMessage(const std::string &msg);
+
+    Settings            _settings;
+    std::vector<Pair>   _pairs;
+    size_t              _oscillators;
+    std::vector<Curve>  _phases;
+    double              _tau0;
+    Curve               _taus;
+    std::vector<Curve>  _pair_devs;
+    std::vector<Curve>  _devs;
+    std::string         _message;
+};
+#endif
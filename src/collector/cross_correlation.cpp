@@ -0,0 +1,291 @@
+#include "cross_correlation.hpp"
+#include "parallel.hpp"
+#include <cmath>
+#include <algorithm>
+#include <boost/lexical_cast.hpp>
+
+// records of one read during scanning of captures
+static const size_t kScanRecords = 65536;
+// the lowest FFT size, shorter blocks are dominated by lags
+static const size_t kMinBlock = 4096;
+// allowed relative difference of sample rates of captures
+static const double kRateTolerance = 1e-3;
+
+// class CrossCorrelation::Settings
+CrossCorrelation::Settings::Settings()
+    : max_lag(1000),
+      block_length(0),
+      batch_blocks(16),
+      sample_rate(std::nan("")),
+      threads(0) {
+}
+// class CrossCorrelation
+CrossCorrelation::CrossCorrelation(const Settings &settings)
+    : _settings(settings),
+      _inputs(),
+      _offset(0),
+      _blocks(0),
+      _peak_lag(std::nan("")),
+      _peak_value(std::nan("")) {
+}
+
+bool CrossCorrelation::ScanInput(SampleStore *store, Input *out) {
+  out->store      = store;
+  out->size       = store->GetSize();
+  out->first_time = std::nan("");
+  out->rate       = _settings.sample_rate;
+  out->mean       = 0;
+  out->deviation  = 0;
+  if (out->size < 2) {
+    SetMessage("Not enough records for correlation: "
+      + boost::lexical_cast<std::string>(out->size)
+    );
+    return false;
+  }
+  // values are shifted by the first one, so sums of squares keep
+  // precision of small variations of big values (frequency)
+  std::vector<SampleStore::Record> recs(kScanRecords);
+  double shift  = 0;
+  double sum    = 0;
+  double sum_sq = 0;
+  double last_time = 0;
+  for (uint64_t first = 0; first < out->size; first += recs.size()) {
+    const size_t kAmount = std::min<uint64_t>(recs.size(),
+                                              out->size - first);
+    if (store->ReadRecords(first, recs.data(), kAmount) != kAmount) {
+      SetMessage("Failed to read records: " + store->GetMessage());
+      return false;
+    }
+    if (first == 0) {
+      shift           = recs[0].value;
+      out->first_time = recs[0].time;
+    }
+    for (size_t i = 0; i < kAmount; ++i) {
+      const double kValue = recs[i].value - shift;
+      sum    += kValue;
+      sum_sq += kValue * kValue;
+    }
+    last_time = recs[kAmount - 1].time;
+  }
+  const double kMean = sum / out->size;
+  out->mean      = shift + kMean;
+  out->deviation = std::sqrt(std::max(0.0, sum_sq / out->size
+                                           - kMean * kMean));
+  if (std::isnan(out->rate)) {
+    out->rate = (out->size - 1) / (last_time - out->first_time);
+  }
+  if (not (std::isfinite(out->rate) && out->rate > 0)) {
+    SetMessage("Failed to calculate sample rate");
+    return false;
+  }
+  if (not (out->deviation > 0)) {
+    SetMessage("Values of capture are constant");
+    return false;
+  }
+  return true;
+}
+
+bool CrossCorrelation::ReadValues(const Input &input, int64_t first,
+                                  size_t amount,
+                                  std::vector<SampleStore::Record> *recs,
+                                  double *out) {
+  std::fill(out, out + amount, 0.0);
+  const int64_t kFrom = std::max<int64_t>(first, 0);
+  const int64_t kTo   = std::min<int64_t>(first + amount, input.size);
+  if (kFrom >= kTo) {
+    return true;
+  }
+  const size_t kAmount = kTo - kFrom;
+  recs->resize(std::max(recs->size(), kAmount));
+  if (input.store->ReadRecords(kFrom, recs->data(), kAmount) != kAmount) {
+    SetMessage("Failed to read records: " + input.store->GetMessage());
+    return false;
+  }
+  double *dst = out + (kFrom - first);
+  for (size_t i = 0; i < kAmount; ++i) {
+    dst[i] = (*recs)[i].value - input.mean;
+  }
+  return true;
+}
+
+void CrossCorrelation::AccumulateBlock(const Fft &fft, const double *x,
+                                       size_t valid, const double *y,
+                                       Fft::Complex *work,
+                                       std::vector<double> *acc) const {
+  const size_t kLength = fft.GetSize();
+  for (size_t i = 0; i < kLength; ++i) {
+    work[i] = Fft::Complex(i < valid ? x[i] : 0.0, y[i]);
+  }
+  fft.Transform(work);
+  // spectra of real blocks are separated from z = x + i*y:
+  // X[k] = (Z[k] + conj(Z[n-k])) / 2, Y[k] = (Z[k] - conj(Z[n-k])) / 2i,
+  // spectrum of correlation is C[k] = conj(X[k]) * Y[k] and
+  // C[n-k] = conj(C[k]), because blocks are real
+  const Fft::Complex kHalfI(0, 0.5);
+  for (size_t k = 0; k <= kLength / 2; ++k) {
+    const size_t       kMirror = (kLength - k) & (kLength - 1);
+    const Fft::Complex kDirect = work[k];
+    const Fft::Complex kConj   = std::conj(work[kMirror]);
+    const Fft::Complex kX      = 0.5 * (kDirect + kConj);
+    const Fft::Complex kY      = -kHalfI * (kDirect - kConj);
+    const Fft::Complex kC      = std::conj(kX) * kY;
+    work[k]       = kC;
+    work[kMirror] = std::conj(kC);
+  }
+  fft.Transform(work, true);
+  // lag "l" is at index "l + max_lag", because "y" starts earlier
+  double *out = acc->data();
+  for (size_t m = 0; m < acc->size(); ++m) {
+    out[m] += work[m].real() / kLength;
+  }
+}
+
+bool CrossCorrelation::Calculate(SampleStore *first, SampleStore *second) {
+  _correlation.clear();
+  _offset     = 0;
+  _blocks     = 0;
+  _peak_lag   = std::nan("");
+  _peak_value = std::nan("");
+  const size_t kMaxLag = _settings.max_lag;
+  const size_t kLags   = 2 * kMaxLag + 1;
+  if (kMaxLag == 0) {
+    SetMessage("The highest lag must be > 0");
+    return false;
+  }
+  const Fft kFft(_settings.block_length
+                 ? _settings.block_length
+                 : std::max(kMinBlock, 4 * kLags));
+  const size_t kLength = kFft.GetSize();
+  if (kLength <= 2 * kMaxLag) {
+    SetMessage("Block is too short for lags: "
+      + boost::lexical_cast<std::string>(kLength) + " <= "
+      + boost::lexical_cast<std::string>(2 * kMaxLag)
+    );
+    return false;
+  }
+  if (not ScanInput(first, &_inputs[0]) ||
+      not ScanInput(second, &_inputs[1])) {
+    return false;
+  }
+  const Input &x = _inputs[0];
+  const Input &y = _inputs[1];
+  if (std::fabs(x.rate - y.rate) > kRateTolerance * x.rate) {
+    SetMessage("Sample rates of captures are different: "
+      + boost::lexical_cast<std::string>(x.rate) + " Hz, "
+      + boost::lexical_cast<std::string>(y.rate) + " Hz"
+    );
+    return false;
+  }
+  // lags are counted from records of "y", which have the same time labels
+  // as records of "x"
+  _offset = std::llround((y.first_time - x.first_time) * x.rate);
+  const size_t kBlock   = kLength - 2 * kMaxLag;
+  const size_t kBatch   = std::max<uint32_t>(_settings.batch_blocks, 1);
+  const size_t kWorkers = GetWorkersAmount(_settings.threads);
+  _blocks = (x.size + kBlock - 1) / kBlock;
+  std::vector<std::vector<double>> accs(kWorkers,
+                                        std::vector<double>(kLags, 0.0));
+  std::vector<std::vector<Fft::Complex>> works(kWorkers,
+    std::vector<Fft::Complex>(kLength)
+  );
+  std::vector<SampleStore::Record> recs;
+  std::vector<double> x_values(kBatch * kBlock);
+  std::vector<double> y_values(kBatch * kBlock + 2 * kMaxLag);
+  for (uint64_t block = 0; block < _blocks; block += kBatch) {
+    const size_t  kAmount = std::min<uint64_t>(kBatch, _blocks - block);
+    const int64_t kStart  = block * kBlock;
+    if (not ReadValues(x, kStart, kAmount * kBlock, &recs,
+                       x_values.data()) ||
+        not ReadValues(y, kStart - _offset - kMaxLag,
+                       kAmount * kBlock + 2 * kMaxLag, &recs,
+                       y_values.data())) {
+      return false;
+    }
+    ParallelFor(kAmount, [&](size_t index, size_t worker) {
+      const size_t kOffset = index * kBlock;
+      const size_t kValid  = std::min<uint64_t>(kBlock,
+                                                x.size - kStart - kOffset);
+      AccumulateBlock(kFft, x_values.data() + kOffset, kValid,
+                      y_values.data() + kOffset, works[worker].data(),
+                      &accs[worker]);
+    }, kWorkers);
+  }
+  // reduction of per-thread accumulators, every lag is normalized by
+  // amount of overlapped records
+  _correlation.assign(kLags, 0.0);
+  for (const auto &acc : accs) {
+    for (size_t m = 0; m < kLags; ++m) {
+      _correlation[m] += acc[m];
+    }
+  }
+  const double kNorm = x.deviation * y.deviation;
+  for (size_t m = 0; m < kLags; ++m) {
+    const int64_t kShift   = (int64_t)m - (int64_t)kMaxLag - _offset;
+    const int64_t kOverlap = std::min<int64_t>(x.size, y.size - kShift)
+                           - std::max<int64_t>(0, -kShift);
+    _correlation[m] = kOverlap > 0 ? _correlation[m] / (kOverlap * kNorm)
+                                   : 0.0;
+  }
+  FindPeak();
+  return true;
+}
+
+void CrossCorrelation::FindPeak() {
+  const size_t kPeak = std::max_element(_correlation.begin(),
+                                        _correlation.end())
+                     - _correlation.begin();
+  double delta = 0;
+  _peak_value = _correlation[kPeak];
+  if (kPeak > 0 && kPeak + 1 < _correlation.size()) {
+    // vertex of parabola through the peak and its neighbours
+    const double kLeft  = _correlation[kPeak - 1];
+    const double kRight = _correlation[kPeak + 1];
+    const double kCurve = kLeft - 2 * _peak_value + kRight;
+    if (kCurve < 0) {
+      delta       = 0.5 * (kLeft - kRight) / kCurve;
+      _peak_value = _peak_value - 0.25 * (kLeft - kRight) * delta;
+    }
+  }
+  _peak_lag = (double)kPeak - _settings.max_lag + delta;
+}
+
+const std::vector<double>& CrossCorrelation::GetCorrelation() const {
+  return _correlation;
+}
+
+std::vector<double> CrossCorrelation::GetLagTimes() const {
+  std::vector<double> out(_correlation.size());
+  for (size_t m = 0; m < out.size(); ++m) {
+    out[m] = ((double)m - _settings.max_lag) / _inputs[0].rate;
+  }
+  return out;
+}
+
+double CrossCorrelation::GetPeakLag() const {
+  return _peak_lag;
+}
+
+double CrossCorrelation::GetPeakCorrelation() const {
+  return _peak_value;
+}
+
+double CrossCorrelation::GetDelay() const {
+  return _inputs[1].first_time - _inputs[0].first_time
+         + (_peak_lag - _offset) / _inputs[0].rate;
+}
+
+double CrossCorrelation::GetSampleRate() const {
+  return _blocks ? _inputs[0].rate : std::nan("");
+}
+
+uint64_t CrossCorrelation::GetBlocksAmount() const {
+  return _blocks;
+}
+
+const std::string& CrossCorrelation::GetMessage() const {
+  return _message;
+}
+
+void CrossCorrelation::SetMessage(const std::string &msg) {
+  _message = msg;
+}
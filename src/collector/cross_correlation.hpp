@@ -0,0 +1,111 @@
+#ifndef CROSS_CORRELATION_HPP
+#define CROSS_CORRELATION_HPP
+
+#include <vector>
+#include "fft.hpp"
+#include "sample_store.hpp"
+
+/**
+ * Estimation of time lag between two captures (for example, delay of
+ * cable between inputs of counter) by the peak of their cross-correlation
+ * r[l] = sum_n x[n] * y[n + l], l in [-max_lag, max_lag].
+ * Correlation is calculated by overlap-save with FFT: "x" is split into
+ * blocks of (FFT size - 2 * max_lag) records, every block is padded by
+ * zeros and correlated with the segment of "y", which covers all lags, so
+ * circular wrapping does not touch the needed lags. Every lag costs
+ * O(log n) per record instead of O(n). Records are read from storages by
+ * batches of blocks, so memory does not depend on amount of records,
+ * blocks of the batch are processed by several threads with their own
+ * accumulators. Both blocks are transformed by one complex FFT.
+ * Records are matched by index from records with the same time label
+ * (lag 0), both captures must have the same sample rate, mean values are
+ * removed.
+ */
+class CrossCorrelation {
+  public:
+    struct Settings {
+      Settings();
+
+      uint32_t max_lag;      // the highest lag (records)
+      uint32_t block_length; // FFT size, it is rounded up to the power of
+                             // two, 0 - chosen by "max_lag"
+      uint32_t batch_blocks; // amount of blocks read at once
+      double   sample_rate;  // Hz, NaN - calculated from time labels
+      size_t   threads;      // 0 - amount of threads of the scheduler
+    };
+
+    CrossCorrelation(const Settings &settings = Settings());
+    /**
+     * Method for calculating correlation of all records of storages.
+     * @param first  records "x";
+     * @param second records "y", positive lag means, that "y" is late.
+     * @return false if there are not enough records, sample rates are
+     *         different or settings are invalid.
+     */
+    bool Calculate(SampleStore *first, SampleStore *second);
+    /**
+     * @return correlation coefficients of lags [-max_lag, max_lag].
+     */
+    const std::vector<double>& GetCorrelation() const;
+    /**
+     * @return lags of "GetCorrelation()" (seconds).
+     */
+    std::vector<double> GetLagTimes() const;
+    /**
+     * @return lag of the maximum correlation (records), it is refined
+     *         between records by parabola through three points.
+     */
+    double GetPeakLag() const;
+    double GetPeakCorrelation() const;
+    /**
+     * @return delay of "y" relatively to "x" (seconds): the peak lag and
+     *         the rest of difference of the first time labels, which is
+     *         lesser than the interval of records.
+     */
+    double GetDelay() const;
+    double GetSampleRate() const;
+    uint64_t GetBlocksAmount() const;
+    const std::string& GetMessage() const;
+  private:
+    /**
+     * Statistics of the capture, which are gathered by the first pass.
+     */
+    struct Input {
+      SampleStore *store;
+      uint64_t     size;
+      double       first_time;
+      double       rate;
+      double       mean;
+      double       deviation;
+    };
+
+    bool ScanInput(SampleStore *store, Input *out);
+    /**
+     * Method for reading values [first, first + amount) without mean,
+     * records outside of the storage are zeros.
+     */
+    bool ReadValues(const Input &input, int64_t first, size_t amount,
+                    std::vector<SampleStore::Record> *recs, double *out);
+    /**
+     * Method for adding correlation of the block into "acc".
+     * @param x     block of "x" (it is padded by zeros in "work");
+     * @param y     segment of "y", which starts "max_lag" records earlier;
+     * @param valid amount of records in the block of "x".
+     */
+    void AccumulateBlock(const Fft &fft, const double *x, size_t valid,
+                         const double *y, Fft::Complex *work,
+                         std::vector<double> *acc) const;
+    void FindPeak();
+    void SetMessage(const std::string &msg);
+
+    Settings            _settings;
+    Input               _inputs[2];
+    int64_t             _offset;  // difference of the first time labels
+                                  // (records)
+    uint64_t            _blocks;
+    std::vector<double> _correlation;
+    double              _peak_lag;
+    double              _peak_value;
+    std::string         _message;
+};
+#endif
@@ -2,15 +2,25 @@
 #include <list>
 #include <regex>
 #include <cmath>
+#include <cstdlib>
+#include <cerrno>
+#include <algorithm>
 #include <boost/lexical_cast.hpp>
+#include <sys/stat.h>
 
 // class VoidDataSource
 VoidDataSource::VoidDataSource()
     : _occupied(false),
       _end_of_source(false),
+      _failed(false),
+      _read_failed(false),
+      _indexing(true),
       _header(new Header()),
       _rows_amount(0),
-      _prev_time_label(std::nan("")) {
+      _prev_time_label(std::nan("")),
+      _window_from(std::nan("")),
+      _window_to(std::nan("")) {
+  SelectChannels(Channels(1, 0));
 }
 
 VoidDataSource::~VoidDataSource() {
@@ -44,7 +54,7 @@ void CreateFieldsHandlers(Field::List *list) {
       out->created_by.name    = m[1];
       out->created_by.version = m[2];
   });
-  list->emplace_back("FREQUENCY A",
+  list->emplace_back("(FREQUENCY|PERIOD|TIME INTERVAL) [AB](-[AB])?",
     [](const std::smatch &m, VoidDataSource::Header *out) {
       out->type_of_measurement = m[0];
     }
@@ -86,10 +96,43 @@ void CreateFieldsHandlers(Field::List *list) {
   );
 }
 
+/**
+ * Function for getting handlers of header fields. Compiling of regular
+ * expressions is much slower than parsing of the header, so they are
+ * compiled once and shared by all sources (matching does not change them).
+ */
+static
+const Field::List& GetFieldsHandlers() {
+  static const Field::List kFields = []() {
+    Field::List list;
+    CreateFieldsHandlers(&list);
+    return list;
+  }();
+  return kFields;
+}
+
+void VoidDataSource::ResetParsing() {
+  _occupied        = true;
+  _end_of_source   = false;
+  _failed          = false;
+  _read_failed     = false;
+  _rows_amount     = 0;
+  _prev_time_label = std::nan("");
+  _message.clear();
+  _read_message.clear();
+}
+
+void VoidDataSource::OccupyWithHeader(const Header &header) {
+  ResetParsing();
+  *_header = header;
+}
+
 bool VoidDataSource::OccupySource() {
-  _occupied = true;
-  Field::List fields;
-  CreateFieldsHandlers(&fields);
+  ResetParsing();
+  std::list<const Field*> fields;
+  for (const auto &field : GetFieldsHandlers()) {
+    fields.push_back(&field);
+  }
   // reading header
   while (fields.size() > 0 && GetLine(_line, kLineSize) >= 0) {
     if (_line[0] != '#') {
@@ -98,21 +141,86 @@ bool VoidDataSource::OccupySource() {
     std::smatch m;
     for (auto fit = fields.begin(); fit != fields.end(); ++fit) {
       std::string t_str(_line);
-      if (std::regex_search(t_str, m, fit->regex)) {
-        fit->handler(m, _header);
+      if (std::regex_search(t_str, m, (*fit)->regex)) {
+        (*fit)->handler(m, _header);
         fields.erase(fit);
         ++_rows_amount;
         break;
       }
     }
   }
+  if (_read_failed) {
+    SetMessage(_read_message);
+    return false;
+  }
   if (fields.size() > 0) {
     SetMessage("Invalid header!");
     return false;
   }
+  if (std::isfinite(_window_from)) {
+    SeekToTime(_window_from);
+  }
+  return true;
+}
+
+bool VoidDataSource::SeekToTime(double) {
+  return false;
+}
+
+bool VoidDataSource::GetOffset(uint64_t*) const {
+  return false;
+}
+
+bool VoidDataSource::SeekToOffset(uint64_t) {
+  return false;
+}
+
+bool VoidDataSource::GetIdentity(uint64_t*, int64_t*) const {
+  return false;
+}
+
+bool VoidDataSource::GetPosition(Position *out) const {
+  if (not GetOffset(&out->offset)) {
+    return false;
+  }
+  out->line      = _rows_amount;
+  out->prev_time = _prev_time_label;
+  if (not GetIdentity(&out->file_size, &out->file_time)) {
+    out->file_size = 0;
+    out->file_time = 0;
+  }
+  return true;
+}
+
+bool VoidDataSource::SetPosition(const Position &pos) {
+  uint64_t size = 0;
+  int64_t  time = 0;
+  if (GetIdentity(&size, &time) &&
+      (size != pos.file_size || time != pos.file_time)) {
+    SetMessage("File of data source is changed after saving of position");
+    return false;
+  }
+  if (not SeekToOffset(pos.offset)) {
+    SetMessage("Data source does not support positions");
+    return false;
+  }
+  _rows_amount     = pos.line;
+  _prev_time_label = pos.prev_time;
   return true;
 }
 
+void VoidDataSource::IndexRecord(double) {
+}
+
+void VoidDataSource::SetTimeWindow(double from, double to) {
+  _window_from = from;
+  _window_to   = to;
+}
+
+void VoidDataSource::SetLineNumber(uint32_t line) {
+  _rows_amount = line;
+}
+
 void VoidDataSource::ReleaseSource() {
   _occupied = false;
 }
@@ -121,44 +229,93 @@ const VoidDataSource::Header& VoidDataSource::GetHeader() {
   return *_header;
 }
 
-bool VoidDataSource::IsAtTheEnd() const {
-  return _end_of_source;
+void VoidDataSource::SetAtTheEnd() {
+  _end_of_source = true;
 }
 
 bool VoidDataSource::GetRecord(Record *out) {
-  const auto kGetLen = GetLine(_line, kLineSize);
-  if (kGetLen < 0) {
-    _end_of_source = true;
+  return ParseLine(_line, ReadLine(_line), out);
+}
+
+int16_t VoidDataSource::ReadLine(char *line) {
+  return GetLine(line, kLineSize);
+}
+
+void VoidDataSource::SetIndexing(bool enabled) {
+  _indexing = enabled;
+}
+
+bool VoidDataSource::SelectChannels(const Channels &channels) {
+  if (channels.empty() || channels.size() > kMaxColumns) {
+    SetMessage("Invalid amount of channels");
     return false;
   }
-  ++_rows_amount;
-  std::string::size_type next;
-  try {
-    out->time  = std::stod(_line, &next);
-    out->value = std::stod(_line + next);
-  } catch (...) {
-    if (kGetLen > 2) {
-      SetMessage("Failed to parse line #"
-        + boost::lexical_cast<std::string>(_rows_amount)
+  int8_t slots[kMaxColumns];
+  std::fill(slots, slots + kMaxColumns, -1);
+  uint8_t last = 0;
+  for (size_t i = 0; i < channels.size(); ++i) {
+    if (channels[i] >= kMaxColumns || slots[channels[i]] >= 0) {
+      SetMessage("Invalid channel: "
+        + boost::lexical_cast<std::string>((unsigned)channels[i])
       );
+      return false;
     }
-    return false;
+    slots[channels[i]] = i;
+    last = std::max(last, channels[i]);
   }
-  if (not std::isnan(_prev_time_label) &&
-      out->time < _prev_time_label) {
-    SetMessage("Invalid time label at line #"
+  std::copy(slots, slots + kMaxColumns, _channel_slots);
+  _last_column = last;
+  _channels    = channels;
+  return true;
+}
+
+const VoidDataSource::Channels& VoidDataSource::GetChannels() const {
+  return _channels;
+}
+
+bool VoidDataSource::GetRow(Row *out) {
+  return ParseRow(_line, ReadLine(_line), out);
+}
+
+void VoidDataSource::ReportBrokenLine(int16_t len) {
+  // empty lines (only line feed) are skipped silently
+  if (len > 2) {
+    SetMessage("Failed to parse line #"
       + boost::lexical_cast<std::string>(_rows_amount)
     );
-    return false;
   }
-  _prev_time_label = out->time;
-  return true;
+}
+
+bool VoidDataSource::ReportInvalidTime() {
+  SetMessage("Invalid time label at line #"
+    + boost::lexical_cast<std::string>(_rows_amount)
+  );
+  return false;
+}
+
+bool VoidDataSource::IsFailed() const {
+  return _failed;
 }
 
 const std::string& VoidDataSource::GetMessage() const {
   return _message;
 }
 
+void VoidDataSource::SetFailure(const std::string &msg) {
+  _end_of_source = true;
+  _failed        = true;
+  _message       = msg;
+}
+
+void VoidDataSource::SetReadFailure(const std::string &msg) {
+  _read_failed  = true;
+  _read_message = msg;
+}
+
+bool VoidDataSource::IsReadFailed() const {
+  return _read_failed;
+}
+
 void VoidDataSource::SetMessage(const std::string &msg) {
   _message = msg;
 }
@@ -198,33 +355,163 @@ VoidDataSource::Record::Record()
     : time(std::nan("")),
       value(std::nan("")) {
 }
-VoidDataSource::Record::Record(double time, double value)
-    : time(time),
-      value(value) {
+// class VoidDataSource::Position
+VoidDataSource::Position::Position()
+    : offset(0),
+      line(0),
+      prev_time(std::nan("")),
+      file_size(0),
+      file_time(0) {
 }
 // class FileDataSource
 FileDataSource::FileDataSource(const std::string &path)
     : VoidDataSource(),
-      _file(path) {
+      _file(path),
+      _data_offset(0),
+      _line_offset(0),
+      _next_offset(0),
+      _file_size(0),
+      _file_time(0),
+      _sequential(true) {
+}
+
+const TimeIndex& FileDataSource::GetTimeIndex() const {
+  return _index;
 }
 
 bool FileDataSource::OccupySource() {
-  _source.open(_file);
-  if (not _source.is_open()) {
+  _source.open(_file, std::ios_base::in | std::ios_base::binary);
+  struct stat st;
+  if (not _source.is_open() || ::stat(_file.c_str(), &st) != 0) {
+    _source.close();
     SetMessage("Failed to open file: " + _file);
     return false;
   }
+  _file_size   = st.st_size;
+  _file_time   = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+  _line_offset = 0;
+  _next_offset = 0;
+  _sequential  = true;
+  // header is parsed inside, and data offset is known only after it,
+  // so seeking to the time window is done by the base class after all
   return VoidDataSource::OccupySource();
 }
 
-int16_t FileDataSource::GetLine(char *line, uint8_t max_len) {
-  if (_source.good()) {
-    return _source.getline(line, max_len).gcount();
-  }
-  return -1;
-}
-
 void FileDataSource::ReleaseSource() {
   _source.close();
   VoidDataSource::ReleaseSource();  
+}
+
+void FileDataSource::IndexRecord(double time) {
+  // index must be a continuous prefix of the file, so records read
+  // after seeking by binary search are not indexed
+  if (_sequential) {
+    _index.AddEntry(TimeIndex::Entry(time, _line_offset, GetLineNumber()));
+  }
+}
+
+bool FileDataSource::GetOffset(uint64_t *out) const {
+  *out = _next_offset;
+  return true;
+}
+
+bool FileDataSource::GetIdentity(uint64_t *size, int64_t *time) const {
+  *size = _file_size;
+  *time = _file_time;
+  return true;
+}
+
+bool FileDataSource::SeekToOffset(uint64_t offset) {
+  // records before the offset are not read, so index is not a prefix
+  _sequential = false;
+  MoveToOffset(offset);
+  return true;
+}
+
+void FileDataSource::MoveToOffset(uint64_t offset) {
+  _source.clear();
+  _source.seekg(offset);
+  _line_offset = offset;
+  _next_offset = offset;
+}
+
+bool FileDataSource::ReadTimeAt(uint64_t offset, uint64_t *line_offset,
+                                double *time) {
+  char line[kLineSize];
+  MoveToOffset(offset);
+  if (offset > _data_offset) {
+    // skipping the tail of the line, which contains "offset"
+    if (GetLine(line, kLineSize) < 0) {
+      return false;
+    }
+  }
+  *line_offset = _next_offset;
+  if (GetLine(line, kLineSize) <= 0) {
+    return false;
+  }
+  char *end = line;
+  *time = std::strtod(line, &end);
+  return end != line;
+}
+
+bool FileDataSource::SeekToTime(double time) {
+  // header is parsed before, so the data offset is still unknown here
+  _data_offset = _next_offset;
+  TimeIndex::Entry entry;
+  if (not _index.IsEmpty() && time <= _index.GetLast().time) {
+    uint64_t offset = _data_offset;
+    uint32_t line   = GetLineNumber();
+    if (_index.FindBefore(time, &entry)) {
+      offset = entry.offset;
+      line   = entry.line - 1;
+    }
+    MoveToOffset(offset);
+    SetLineNumber(line);
+    return true;
+  }
+  _sequential = false;
+  uint64_t low  = _data_offset;
+  uint32_t line = GetLineNumber();
+  if (_index.FindBefore(time, &entry)) {
+    low  = entry.offset;
+    line = entry.line - 1;
+  }
+  const uint64_t kKnown = low;
+  _source.clear();
+  _source.seekg(0, std::ios_base::end);
+  uint64_t high = _source.tellg();
+  // "low" is always at the beginning of the line with time label lesser
+  // than "time", so records of the window are never skipped
+  while (low + kLinearScanSpan < high) {
+    const uint64_t kMiddle = low + (high - low) / 2;
+    uint64_t line_offset = 0;
+    double   line_time   = 0;
+    if (ReadTimeAt(kMiddle, &line_offset, &line_time) && line_time < time) {
+      low = line_offset;
+    } else {
+      high = kMiddle;
+    }
+  }
+  // lines between the known position and "low" are only counted, it is
+  // much faster than parsing them
+  SetLineNumber(line + CountLines(kKnown, low));
+  MoveToOffset(low);
+  return true;
+}
+
+uint32_t FileDataSource::CountLines(uint64_t from, uint64_t to) {
+  static const size_t kBlockSize = 1 << 16;
+  std::vector<char> block(kBlockSize);
+  uint32_t lines = 0;
+  MoveToOffset(from);
+  while (from < to) {
+    const size_t kSize = std::min<uint64_t>(kBlockSize, to - from);
+    const size_t kRead = _source.read(block.data(), kSize).gcount();
+    if (kRead == 0) {
+      break;
+    }
+    lines += std::count(block.begin(), block.begin() + kRead, '\n');
+    from  += kRead;
+  }
+  return lines;
 }
\ No newline at end of file
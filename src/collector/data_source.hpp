@@ -3,14 +3,27 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 #include <fstream>
+#include <cmath>
+#include <cerrno>
+#include <cstdlib>
+#include "time_index.hpp"
 
 class VoidDataSource {
   public:
     typedef std::shared_ptr<VoidDataSource> ShrPtr;
 
+    static const uint8_t kLineSize   = 255;
+    static const uint8_t kMaxColumns = 16; // columns of values after time
+    static const int16_t kFailedLine = -2; // length of line after error
+
+    typedef std::vector<uint8_t> Channels;
+
     struct Header;
     struct Record;
+    struct Row;
+    struct Position;
 
     VoidDataSource();
     virtual ~VoidDataSource();
@@ -18,22 +31,169 @@ class VoidDataSource {
     virtual void ReleaseSource();
 
     const Header& GetHeader();
-    bool GetRecord(Record *out);
+    virtual bool GetRecord(Record *out);
+    /**
+     * Methods "ReadLine" and "ParseLine" are the two halves of "GetRecord",
+     * they allow to read and to parse lines in different threads.
+     * Error of reading is registered by parsing of the returned length,
+     * so state of parsing is changed only by the parsing thread.
+     * @param line buffer with at least "kLineSize" chars;
+     * @return length of the line, -1 at the end of the source or
+     *         "kFailedLine" if reading has failed.
+     */
+    int16_t ReadLine(char *line);
+    /**
+     * @param line text of the line, which was read by "ReadLine";
+     * @param len  value returned by "ReadLine";
+     * @param out  parsed record, its value is the first selected channel;
+     * @return false if the line has no record (please look at "GetRecord").
+     */
+    bool ParseLine(const char *line, int16_t len, Record *out);
+    /**
+     * Method for getting time label and values of all selected channels
+     * of the next row. Channels are columns of values after the time
+     * label, only selected columns are converted, others are skipped.
+     * @return false if the line has no record (please look at "GetRecord").
+     */
+    virtual bool GetRow(Row *out);
+    bool ParseRow(const char *line, int16_t len, Row *out);
+    /**
+     * Method for selecting columns, which are parsed by "GetRow".
+     * By default only the first column of values is selected.
+     * @param channels indexes of columns (0 - the first column after time
+     *                 label), values of rows are placed in the same order;
+     * @return false if channels are empty or invalid.
+     */
+    bool SelectChannels(const Channels &channels);
+    const Channels& GetChannels() const;
+    /**
+     * Method for enabling of calling "IndexRecord" during parsing. When
+     * lines are read ahead of parsing, position of the parsed line is
+     * unknown, so indexing must be disabled.
+     */
+    void SetIndexing(bool enabled);
     bool IsAtTheEnd() const;
+    /**
+     * @return true if the source has reached its end because of error of
+     *         reading, so records after it are lost. The error is returned
+     *         by "GetMessage".
+     */
+    bool IsFailed() const;
     const std::string& GetMessage() const;
+    /**
+     * Method for limiting records, which will be returned by "GetRecord",
+     * with time window. Records before "from" are skipped, the source
+     * reaches its end at the first record after "to". Sources, which
+     * support random access, will seek to "from" while occupying.
+     * NaN value means that the window is not limited from this side.
+     * @param from the lowest time label of the window;
+     * @param to   the highest time label of the window.
+     */
+    void SetTimeWindow(double from, double to);
+    uint32_t GetLineNumber() const;
+    /**
+     * Method for getting position of the next line and state of parsing,
+     * so reading can be continued from it by another object (for example
+     * after restart of the process).
+     * @return false if the source does not support positions.
+     */
+    bool GetPosition(Position *out) const;
+    /**
+     * Method for moving occupied source to the position, which was got by
+     * "GetPosition" from the source of the same file.
+     * @return false if the source does not support positions or the file
+     *         was changed after getting of the position.
+     */
+    bool SetPosition(const Position &pos);
   protected:
+    static const uint32_t kIndexStride = 1024;
+
     virtual int16_t GetLine(char *line, uint8_t max_len) = 0;
+    /**
+     * Method for moving the source to the position before the first
+     * record with time label >= "time". Default implementation does
+     * nothing, so records will be filtered by "GetRecord" only.
+     * @param time time label, that we want to reach;
+     * @return true if position was changed.
+     */
+    virtual bool SeekToTime(double time);
+    /**
+     * Method is called for every "kIndexStride" record, it allows to build
+     * an index of the source during sequential reading.
+     * @param time time label of the last returned record.
+     */
+    virtual void IndexRecord(double time);
+    /**
+     * Methods for getting and setting offset of the next line, default
+     * implementations do not support offsets.
+     * @return false if offsets are not supported.
+     */
+    virtual bool GetOffset(uint64_t *out) const;
+    virtual bool SeekToOffset(uint64_t offset);
+    /**
+     * Method for getting identity of the read file, so positions are not
+     * applied to another file, default implementation has no identity.
+     * @param size size of the file (bytes);
+     * @param time time of the last modification of the file (ns);
+     * @return false if the source has no identity.
+     */
+    virtual bool GetIdentity(uint64_t *size, int64_t *time) const;
+    /**
+     * Method for occupying sources, which do not read the header from
+     * their lines (for example, sources of records derived from other
+     * sources): state of parsing is reset and the header is copied.
+     */
+    void OccupyWithHeader(const Header &header);
+    /**
+     * Method for checking order of time labels and the time window, it
+     * finishes parsing of both records and rows.
+     */
+    bool AcceptTime(double time);
+    /**
+     * Method for finishing sources, which return records without parsing
+     * of lines.
+     */
+    void SetAtTheEnd();
+    /**
+     * Method for finishing the source by error of reading.
+     */
+    void SetFailure(const std::string &msg);
+    /**
+     * Method for "GetLine", which has failed and returns "kFailedLine":
+     * the message is kept, until the length is parsed (it may be done by
+     * another thread, which gets the length after it).
+     */
+    void SetReadFailure(const std::string &msg);
+    bool IsReadFailed() const;
     void SetMessage(const std::string &msg);
+    void SetLineNumber(uint32_t line);
   private:
-    static const uint8_t kLineSize = 255;
+    /**
+     * Methods for parsing of fields, they are defined in the header with
+     * the whole parsing, so it is inlined into loading loops.
+     */
+    static bool ParseDouble(const char *str, const char **end, double *out);
+    static bool SkipField(const char *str, const char **end);
+    void ReportBrokenLine(int16_t len);
+    bool ReportInvalidTime();
+    void ResetParsing();
 
     bool         _occupied;
     bool         _end_of_source;
+    bool         _failed;
+    bool         _read_failed; // they are changed only by reading thread
+    std::string  _read_message;
+    bool         _indexing;
     Header      *_header;
     char         _line[kLineSize];
     std::string  _message;
     uint32_t     _rows_amount;
     double       _prev_time_label;
+    double       _window_from;
+    double       _window_to;
+    Channels     _channels;
+    int8_t       _channel_slots[kMaxColumns]; // index in row or -1
+    uint8_t      _last_column;
 };
 
 struct VoidDataSource::Header {
@@ -70,15 +230,215 @@ struct VoidDataSource::Record {
   double value;
 };
 
+struct VoidDataSource::Position {
+  Position();
+  uint64_t offset;    // offset of the next line (bytes)
+  uint32_t line;      // amount of read lines
+  double   prev_time; // time label of the last parsed record
+  uint64_t file_size; // identity of the file (please look at
+  int64_t  file_time; // "GetIdentity"), zeros if it is unknown
+};
+
+struct VoidDataSource::Row {
+  Row();
+  /**
+   * @return record with the time label and value of selected channel.
+   */
+  Record GetRecord(uint8_t channel) const;
+  double  time;
+  uint8_t amount; // amount of channels
+  double  values[kMaxColumns];
+};
+
+/**
+ * Data source for reading records from text file. During sequential
+ * reading it builds sparse time index, which is used for seeking to the
+ * beginning of time window. If index does not cover the window, position
+ * is found by binary search over file offsets, so seeking costs O(log n)
+ * parsed lines. Lines before the found position are not parsed, they are
+ * only counted (from the last entry of index), so line numbers of messages
+ * stay absolute.
+ */
 class FileDataSource : public VoidDataSource {
   public:
     FileDataSource(const std::string &path);
+    /**
+     * Methods "GetRecord" and "GetLine" are defined here, so they are
+     * inlined into the loading loop of "BasicCollector<FileDataSource, ...>".
+     */
+    virtual bool GetRecord(Record *out) {
+      return ParseLine(_record_line,
+                       FileDataSource::GetLine(_record_line, kLineSize), out);
+    }
+    virtual bool GetRow(Row *out) {
+      return ParseRow(_record_line,
+                      FileDataSource::GetLine(_record_line, kLineSize), out);
+    }
+    const TimeIndex& GetTimeIndex() const;
   protected:
     virtual bool OccupySource();
-    virtual int16_t GetLine(char *line, uint8_t max_len);
+    virtual int16_t GetLine(char *line, uint8_t max_len) {
+      if (_source.good()) {
+        const auto kLen = _source.getline(line, max_len).gcount();
+        _line_offset  = _next_offset;
+        _next_offset += kLen;
+        return kLen;
+      }
+      return -1;
+    }
     virtual void ReleaseSource();
+    virtual bool SeekToTime(double time);
+    virtual void IndexRecord(double time);
+    virtual bool GetOffset(uint64_t *out) const;
+    virtual bool SeekToOffset(uint64_t offset);
+    virtual bool GetIdentity(uint64_t *size, int64_t *time) const;
   private:
+    static const uint32_t kLinearScanSpan = 4096;
+
+    bool ReadTimeAt(uint64_t offset, uint64_t *line_offset, double *time);
+    void MoveToOffset(uint64_t offset);
+    /**
+     * @return amount of line ends between offsets, position of the file is
+     *         changed.
+     */
+    uint32_t CountLines(uint64_t from, uint64_t to);
+
     std::string  _file;
     std::fstream _source;
+    uint64_t     _data_offset;
+    uint64_t     _line_offset;
+    uint64_t     _next_offset;
+    uint64_t     _file_size; // identity of the file at occupying
+    int64_t      _file_time;
+    bool         _sequential;
+    TimeIndex    _index;
+    char         _record_line[kLineSize];
 };
+// class VoidDataSource
+inline
+bool VoidDataSource::ParseDouble(const char *str, const char **end,
+                                 double *out) {
+  char *t_end = 0;
+  errno = 0;
+  *out = std::strtod(str, &t_end);
+  *end = t_end;
+  return t_end != str && errno != ERANGE;
+}
+
+inline
+bool VoidDataSource::SkipField(const char *str, const char **end) {
+  while (*str == ' ' || *str == '\t') {
+    ++str;
+  }
+  const char *begin = str;
+  while (*str != 0 && *str != ' ' && *str != '\t' && *str != '\n' &&
+         *str != '\r') {
+    ++str;
+  }
+  *end = str;
+  return str != begin;
+}
+
+inline
+bool VoidDataSource::IsAtTheEnd() const {
+  return _end_of_source;
+}
+
+inline
+uint32_t VoidDataSource::GetLineNumber() const {
+  return _rows_amount;
+}
+
+inline
+bool VoidDataSource::ParseRow(const char *line, int16_t len, Row *out) {
+  if (len < 0) {
+    if (len == kFailedLine) {
+      SetFailure(_read_message);
+    }
+    _end_of_source = true;
+    return false;
+  }
+  ++_rows_amount;
+  // one pass through the line, columns after the last selected one are
+  // not touched at all
+  const char *next   = line;
+  bool        parsed = ParseDouble(line, &next, &out->time);
+  for (uint8_t col = 0; parsed && col <= _last_column; ++col) {
+    const int8_t kSlot = _channel_slots[col];
+    parsed = kSlot < 0 ? SkipField(next, &next)
+                       : ParseDouble(next, &next, &out->values[kSlot]);
+  }
+  out->amount = _channels.size();
+  if (not parsed) {
+    ReportBrokenLine(len);
+    return false;
+  }
+  return AcceptTime(out->time);
+}
+
+inline
+bool VoidDataSource::ParseLine(const char *line, int16_t len, Record *out) {
+  if (_last_column > 0) {
+    // record gets the first selected channel, which is not the first column
+    Row row;
+    if (not ParseRow(line, len, &row)) {
+      return false;
+    }
+    *out = row.GetRecord(0);
+    return true;
+  }
+  if (len < 0) {
+    if (len == kFailedLine) {
+      SetFailure(_read_message);
+    }
+    _end_of_source = true;
+    return false;
+  }
+  ++_rows_amount;
+  const char *next = line;
+  if (not ParseDouble(line, &next, &out->time) ||
+      not ParseDouble(next, &next, &out->value)) {
+    ReportBrokenLine(len);
+    return false;
+  }
+  return AcceptTime(out->time);
+}
+
+inline
+bool VoidDataSource::AcceptTime(double time) {
+  if (not std::isnan(_prev_time_label) &&
+      time < _prev_time_label) {
+    return ReportInvalidTime();
+  }
+  _prev_time_label = time;
+  if (_indexing && _rows_amount % kIndexStride == 0) {
+    IndexRecord(time);
+  }
+  // comparing with NaN is always false, so unlimited window passes all
+  if (time < _window_from) {
+    return false;
+  }
+  if (time > _window_to) {
+    _end_of_source = true;
+    return false;
+  }
+  return true;
+}
+// class VoidDataSource::Record
+inline
+VoidDataSource::Record::Record(double time, double value)
+    : time(time),
+      value(value) {
+}
+// class VoidDataSource::Row
+inline
+VoidDataSource::Row::Row()
+    : time(std::nan("")),
+      amount(0) {
+}
+
+inline
+VoidDataSource::Record VoidDataSource::Row::GetRecord(uint8_t channel) const {
+  return Record(time, values[channel]);
+}
 #endif
\ No newline at end of file
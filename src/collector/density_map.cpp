@@ -0,0 +1,255 @@
+#include "density_map.hpp"
+#include "parallel.hpp"
+#include <cmath>
+#include <algorithm>
+
+typedef VoidDataSource::Record Record;
+
+// records, which are read and binned by one task
+static const size_t   kChunkRecords = 1 << 16;
+// color of chart background (please look at "ChartArea")
+static const uint32_t kEmptyColor   = 0x1a1a1a;
+
+/**
+ * Mapping of positions onto bins. Range of zero length is mapped onto the
+ * middle bin.
+ */
+struct DensityAxis {
+  DensityAxis(const Compressor::Range &range, uint32_t size)
+      : from(range.first),
+        to(range.second),
+        scale(range.second > range.first ? size / (range.second - range.first)
+                                         : 0),
+        size(size) {
+  }
+
+  bool GetBin(double pos, uint32_t *out) const {
+    // NaN is not in range
+    if (not (pos >= from && pos <= to)) {
+      return false;
+    }
+    if (scale == 0) {
+      *out = size / 2;
+      return true;
+    }
+    *out = std::min<uint32_t>((pos - from) * scale, size - 1);
+    return true;
+  }
+
+  double   from;
+  double   to;
+  double   scale;
+  uint32_t size;
+};
+// class DensityMap
+DensityMap::DensityMap()
+    : _width(0),
+      _height(0),
+      _time(0, 0),
+      _value(0, 0),
+      _max_count(0),
+      _total(0) {
+}
+
+void DensityMap::Reset(uint32_t width, uint32_t height, const Range &time,
+                       const Range &value) {
+  _width  = width;
+  _height = height;
+  _time   = time;
+  _value  = value;
+  _counts.assign((size_t)width * height, 0);
+  _max_count = 0;
+  _total     = 0;
+}
+
+bool DensityMap::AddRecords(SampleStore *store, size_t threads,
+                            const std::atomic<bool> *cancel) {
+  if (_counts.empty()) {
+    return true;
+  }
+  const uint64_t kFirst = store->FindRecord(_time.first);
+  const uint64_t kEnd   = std::max(
+    store->FindRecord(std::nextafter(_time.second, HUGE_VAL)), kFirst
+  );
+  const size_t kChunks  = (kEnd - kFirst + kChunkRecords - 1) / kChunkRecords;
+  const size_t kWorkers = GetWorkersAmount(threads);
+  const DensityAxis kTimeAxis(_time,   _width);
+  const DensityAxis kValueAxis(_value, _height);
+  // tiles and buffers are allocated by workers, which take tasks
+  std::vector<Tile>                tiles(kWorkers);
+  std::vector<std::vector<Record>> buffers(kWorkers);
+  std::atomic<bool>                failed(false);
+  ParallelFor(kChunks, [&](size_t index, size_t worker) {
+    if (failed || (cancel != 0 && *cancel)) {
+      return;
+    }
+    Tile                &tile   = tiles[worker];
+    std::vector<Record> &buffer = buffers[worker];
+    if (tile.empty()) {
+      tile.assign(_counts.size(), 0);
+      buffer.resize(kChunkRecords);
+    }
+    const uint64_t kPos    = kFirst + index * kChunkRecords;
+    const size_t   kAmount = std::min<uint64_t>(kChunkRecords, kEnd - kPos);
+    if (store->ReadRecords(kPos, buffer.data(), kAmount) != kAmount) {
+      failed = true;
+      return;
+    }
+    for (size_t i = 0; i < kAmount; ++i) {
+      uint32_t col;
+      uint32_t row;
+      if (kTimeAxis.GetBin(buffer[i].time, &col) &&
+          kValueAxis.GetBin(buffer[i].value, &row)) {
+        ++tile[(size_t)(_height - 1 - row) * _width + col];
+      }
+    }
+  }, threads);
+  if (failed) {
+    SetMessage("Failed to read records: " + store->GetMessage());
+    return false;
+  }
+  if (cancel != 0 && *cancel) {
+    SetMessage("Binning of records was cancelled");
+    return false;
+  }
+  // reduction of tiles, every task sums one row
+  ParallelFor(_height, [this, &tiles](size_t row, size_t) {
+    uint32_t *counts = &_counts[row * _width];
+    for (const auto &tile : tiles) {
+      if (tile.empty()) {
+        continue;
+      }
+      const uint32_t *src = &tile[row * _width];
+      for (uint32_t col = 0; col < _width; ++col) {
+        counts[col] += src[col];
+      }
+    }
+  }, threads);
+  _max_count = *std::max_element(_counts.begin(), _counts.end());
+  _total     = 0;
+  for (auto count : _counts) {
+    _total += count;
+  }
+  return true;
+}
+
+void DensityMap::AddBuckets(const Compressor &comp) {
+  if (_counts.empty()) {
+    return;
+  }
+  const DensityAxis kTimeAxis(_time,   _width);
+  const DensityAxis kValueAxis(_value, _height);
+  auto clamp = [](double pos, const Range &range) {
+    return std::min(std::max(pos, range.first), range.second);
+  };
+  for (const auto &rec : comp.GetRecords()) {
+    const double kTimeLast = std::isnan(rec.time.second) ? rec.time.first
+                                                         : rec.time.second;
+    const double kValueLow  = std::isnan(rec.value.second)
+                            ? rec.value.first
+                            : std::min(rec.value.first, rec.value.second);
+    const double kValueHigh = std::isnan(rec.value.second)
+                            ? rec.value.first
+                            : std::max(rec.value.first, rec.value.second);
+    if (kTimeLast < _time.first || rec.time.first > _time.second ||
+        kValueHigh < _value.first || kValueLow > _value.second) {
+      continue;
+    }
+    uint32_t cols[2];
+    uint32_t rows[2];
+    if (not kTimeAxis.GetBin(clamp(rec.time.first, _time), &cols[0]) ||
+        not kTimeAxis.GetBin(clamp(kTimeLast, _time), &cols[1]) ||
+        not kValueAxis.GetBin(clamp(kValueLow, _value), &rows[0]) ||
+        not kValueAxis.GetBin(clamp(kValueHigh, _value), &rows[1])) {
+      continue;
+    }
+    // remainder of dividing is given to the first bins
+    const uint64_t kBins  = (uint64_t)(cols[1] - cols[0] + 1)
+                          * (rows[1] - rows[0] + 1);
+    const uint32_t kShare = rec.amount / kBins;
+    uint64_t       rest   = rec.amount % kBins;
+    for (uint32_t row = rows[0]; row <= rows[1]; ++row) {
+      uint32_t *counts = &_counts[(size_t)(_height - 1 - row) * _width];
+      for (uint32_t col = cols[0]; col <= cols[1]; ++col) {
+        counts[col] += kShare + (rest > 0 ? 1 : 0);
+        rest        -= rest > 0 ? 1 : 0;
+      }
+    }
+    _total += rec.amount;
+  }
+  _max_count = *std::max_element(_counts.begin(), _counts.end());
+}
+
+uint32_t DensityMap::GetWidth() const {
+  return _width;
+}
+
+uint32_t DensityMap::GetHeight() const {
+  return _height;
+}
+
+const std::vector<uint32_t>& DensityMap::GetCounts() const {
+  return _counts;
+}
+
+uint32_t DensityMap::GetMaxCount() const {
+  return _max_count;
+}
+
+uint64_t DensityMap::GetTotal() const {
+  return _total;
+}
+
+uint32_t DensityMap::GetColor(double level) {
+  if (not (level > 0)) {
+    return kEmptyColor;
+  }
+  // dark violet, purple, orange (color of graph), light yellow
+  static const double kStops[][4] = {
+    {0.0,  40,  10,  90},
+    {0.35, 150, 30,  110},
+    {0.7,  255, 167, 9},
+    {1.0,  255, 250, 190}
+  };
+  const size_t kStopsNum = sizeof(kStops) / sizeof(kStops[0]);
+  level = std::min(level, 1.0);
+  size_t i = 1;
+  while (i < kStopsNum - 1 && level > kStops[i][0]) {
+    ++i;
+  }
+  const double kPart = (level - kStops[i - 1][0])
+                     / (kStops[i][0] - kStops[i - 1][0]);
+  uint32_t color = 0;
+  for (int c = 1; c <= 3; ++c) {
+    const double kChannel = kStops[i - 1][c]
+                          + kPart * (kStops[i][c] - kStops[i - 1][c]);
+    color = (color << 8) | (uint32_t)std::lround(kChannel);
+  }
+  return color;
+}
+
+void DensityMap::ToImage(uint32_t *pixels, size_t stride) const {
+  const double kLogMax = std::log1p((double)_max_count);
+  // the same counts have the same colors, small counts are the most often
+  std::vector<uint32_t> colors(std::min<uint32_t>(_max_count, 4096) + 1);
+  for (size_t count = 0; count < colors.size(); ++count) {
+    colors[count] = GetColor(std::log1p((double)count) / kLogMax);
+  }
+  for (uint32_t row = 0; row < _height; ++row) {
+    const uint32_t *counts = &_counts[(size_t)row * _width];
+    uint32_t       *line   = pixels + row * stride;
+    for (uint32_t col = 0; col < _width; ++col) {
+      line[col] = counts[col] < colors.size()
+                ? colors[counts[col]]
+                : GetColor(std::log1p((double)counts[col]) / kLogMax);
+    }
+  }
+}
+
+const std::string& DensityMap::GetMessage() const {
+  return _message;
+}
+
+void DensityMap::SetMessage(const std::string &msg) {
+  _message = msg;
+}
@@ -0,0 +1,86 @@
+#ifndef DENSITY_MAP_HPP
+#define DENSITY_MAP_HPP
+
+#include <atomic>
+#include <vector>
+#include "sample_store.hpp"
+
+/**
+ * Two dimensional histogram of records with one bin per pixel of chart:
+ * columns are time labels, rows are values (the row #0 is the highest
+ * value). It shows, where values are concentrated, when the envelope of
+ * buckets is a solid band.
+ * Records of the storage are read by chunks, chunks are binned by several
+ * threads, every thread counts into its own tile of the whole size, tiles
+ * are summed at the end (by rows in parallel). Counts are mapped to colors
+ * with logarithmic scale.
+ */
+class DensityMap {
+  public:
+    typedef Compressor::Range Range;
+
+    DensityMap();
+    /**
+     * Method for setting size of map and ranges of scales, counts are
+     * cleared.
+     * @param width  amount of columns;
+     * @param height amount of rows;
+     * @param time   range of time labels (columns);
+     * @param value  range of values (rows).
+     */
+    void Reset(uint32_t width, uint32_t height, const Range &time,
+               const Range &value);
+    /**
+     * Method for binning records of the storage, which are in ranges.
+     * @param threads amount of threads, 0 - amount of hardware threads;
+     * @param cancel  binning is stopped, if it becomes true (checked for
+     *                every chunk of records), it can be null;
+     * @return false if binning was cancelled or records were not read.
+     */
+    bool AddRecords(SampleStore *store, size_t threads = 0,
+                    const std::atomic<bool> *cancel = 0);
+    /**
+     * Method for binning buckets of compressor (it is used, when raw
+     * records are not kept). Records of bucket are spread uniformly over
+     * bins of its time range and value range.
+     */
+    void AddBuckets(const Compressor &comp);
+    uint32_t GetWidth() const;
+    uint32_t GetHeight() const;
+    /**
+     * @return counts of bins by rows.
+     */
+    const std::vector<uint32_t>& GetCounts() const;
+    uint32_t GetMaxCount() const;
+    /**
+     * @return amount of binned records.
+     */
+    uint64_t GetTotal() const;
+    /**
+     * Method for drawing map into image of the same size, pixels have
+     * format "0x00RRGGBB" (for example "Cairo::FORMAT_RGB24").
+     * @param stride distance between rows of image (pixels).
+     */
+    void ToImage(uint32_t *pixels, size_t stride) const;
+    /**
+     * @param level logarithmic level of count [0, 1];
+     * @return color "0x00RRGGBB", empty bins (level 0) have color of
+     *         chart background.
+     */
+    static uint32_t GetColor(double level);
+    const std::string& GetMessage() const;
+  private:
+    typedef std::vector<uint32_t> Tile;
+
+    void SetMessage(const std::string &msg);
+
+    uint32_t    _width;
+    uint32_t    _height;
+    Range       _time;
+    Range       _value;
+    Tile        _counts;
+    uint32_t    _max_count;
+    uint64_t    _total;
+    std::string _message;
+};
+#endif
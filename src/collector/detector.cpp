@@ -0,0 +1,207 @@
+#include "detector.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+// class RollingMedian
+RollingMedian::RollingMedian(uint16_t window, uint16_t hop)
+    : _window(window > 0 ? window : 1),
+      _hop(hop > 0 ? hop : 1),
+      _ring(_window),
+      _work(_window) {
+  Clear();
+}
+
+void RollingMedian::Clear() {
+  _ring_pos          = 0;
+  _size              = 0;
+  _pushed_after_calc = 0;
+  _median            = std::nan("");
+  _mad               = std::nan("");
+}
+
+bool RollingMedian::IsReady() const {
+  return not std::isnan(_median);
+}
+
+double RollingMedian::GetMedian() const {
+  return _median;
+}
+
+double RollingMedian::GetMad() const {
+  return _mad;
+}
+
+void RollingMedian::Recalculate() {
+  _pushed_after_calc = 0;
+  const auto kBegin = _work.begin();
+  const auto kEnd   = kBegin + _size;
+  const auto kMid   = kBegin + _size / 2;
+  std::copy(_ring.begin(), _ring.begin() + _size, kBegin);
+  std::nth_element(kBegin, kMid, kEnd);
+  _median = *kMid;
+  for (auto it = kBegin; it != kEnd; ++it) {
+    *it = std::fabs(*it - _median);
+  }
+  std::nth_element(kBegin, kMid, kEnd);
+  _mad = *kMid;
+}
+// class Detector::Event
+Detector::Event::Event()
+    : type(kGlitch),
+      time(std::nan("")),
+      value(std::nan("")),
+      line(0),
+      length(0) {
+}
+
+Detector::Event::Event(Type type, double time, double value, uint32_t line)
+    : type(type),
+      time(time),
+      value(value),
+      line(line),
+      length(0) {
+}
+// class Detector::Settings
+Detector::Settings::Settings()
+    : window(64),
+      hop(64),
+      threshold(6.0),
+      jump_length(4),
+      gap_factor(1.5),
+      interval(std::nan("")),
+      max_events(100000) {
+}
+// class Detector
+Detector::Detector(const Settings &settings)
+    : _settings(settings),
+      _interval(settings.interval),
+      _values(settings.window, settings.hop),
+      _intervals(settings.window, settings.hop),
+      _prev_time(std::nan("")),
+      _prev_value(std::nan("")),
+      _resolution(std::nan("")),
+      _outlier_side(0),
+      _dropped_events(0) {
+}
+
+void Detector::UseHeader(const VoidDataSource::Header &hd) {
+  if (std::isnan(_settings.interval)) {
+    _interval = ParseMeasuringTime(hd.measuring_time);
+  }
+}
+
+void Detector::RegisterEvent(const Event &ev) {
+  if (_events.size() < _settings.max_events) {
+    _events.push_back(ev);
+  } else {
+    ++_dropped_events;
+  }
+}
+
+void Detector::FinishOutliersRun() {
+  if (_outlier_side != 0) {
+    RegisterEvent(_outlier);
+    _outlier_side = 0;
+  }
+}
+
+void Detector::PushRecord(const VoidDataSource::Record &rec, uint32_t line) {
+  if (std::isnan(rec.value) || std::isnan(rec.time)) {
+    return;
+  }
+  // searching for gaps
+  if (not std::isnan(_prev_time)) {
+    const double kInterval = rec.time - _prev_time;
+    if (_intervals.IsReady()) {
+      double expected = _intervals.GetMedian();
+      if (_interval > expected) {
+        expected = _interval;
+      }
+      if (kInterval > _settings.gap_factor * expected) {
+        Event ev(Event::kGap, rec.time, rec.value, line);
+        ev.length = kInterval;
+        RegisterEvent(ev);
+      }
+    }
+    _intervals.Push(kInterval);
+  }
+  _prev_time = rec.time;
+  const double kStep = std::fabs(rec.value - _prev_value);
+  if (kStep > 0 && not (kStep >= _resolution)) {
+    _resolution = kStep;
+  }
+  _prev_value = rec.value;
+  // searching for outliers
+  if (_values.IsReady()) {
+    const double kMedian    = _values.GetMedian();
+    const double kDeviation = rec.value - kMedian;
+    // scale factor makes MAD consistent with sigma of normal distribution,
+    // resolution is unknown (NaN) until the first step of values
+    const double kSigma = std::max(1.4826 * _values.GetMad(), _resolution);
+    if (kSigma > 0 && std::fabs(kDeviation) > _settings.threshold * kSigma) {
+      const int8_t kSide = kDeviation > 0 ? 1 : -1;
+      if (_outlier_side != kSide) {
+        FinishOutliersRun();
+        _outlier      = Event(Event::kGlitch, rec.time, rec.value, line);
+        _outlier_side = kSide;
+      }
+      _outlier.length += 1;
+      if (_outlier.length >= _settings.jump_length) {
+        // value stays on the new level, so statistics are restarted
+        _outlier.type = Event::kPhaseJump;
+        FinishOutliersRun();
+        _values.Clear();
+      }
+    } else {
+      FinishOutliersRun();
+    }
+  }
+  _values.Push(rec.value);
+}
+
+void Detector::Finish() {
+  FinishOutliersRun();
+}
+
+const Detector::Event::List& Detector::GetEvents() const {
+  return _events;
+}
+
+size_t Detector::GetDroppedEvents() const {
+  return _dropped_events;
+}
+
+double Detector::ParseMeasuringTime(const std::string &str) {
+  char *end = 0;
+  const double kValue = std::strtod(str.c_str(), &end);
+  if (end == str.c_str()) {
+    return std::nan("");
+  }
+  while (*end == ' ') {
+    ++end;
+  }
+  const std::string kUnit(end);
+  if (kUnit == "s") {
+    return kValue;
+  }
+  if (kUnit == "ms") {
+    return kValue * 1e-3;
+  }
+  if (kUnit == "us" || kUnit == "\xC2\xB5s") {
+    return kValue * 1e-6;
+  }
+  if (kUnit == "ns") {
+    return kValue * 1e-9;
+  }
+  return std::nan("");
+}
+
+const char* GetEventTypeName(Detector::Event::Type type) {
+  switch (type) {
+    case Detector::Event::kGlitch   : return "glitch";
+    case Detector::Event::kPhaseJump: return "phase jump";
+    case Detector::Event::kGap      : return "gap";
+  }
+  return "unknown";
+}
@@ -0,0 +1,132 @@
+#ifndef DETECTOR_HPP
+#define DETECTOR_HPP
+
+#include <vector>
+#include "data_source.hpp"
+
+/**
+ * Median and median absolute deviation (MAD) of the last "window" values.
+ * Statistics are recalculated once per "hop" pushed values with
+ * "nth_element", so pushing has O(1) amortized cost and checking of
+ * the value against statistics costs nothing.
+ */
+class RollingMedian {
+  public:
+    RollingMedian(uint16_t window, uint16_t hop);
+    void Push(double value) {
+      _ring[_ring_pos] = value;
+      _ring_pos = (_ring_pos + 1) % _window;
+      if (_size < _window) {
+        ++_size;
+      }
+      if (++_pushed_after_calc == _hop) {
+        Recalculate();
+      }
+    }
+    void Clear();
+    /**
+     * @return false if statistics were not calculated yet.
+     */
+    bool IsReady() const;
+    double GetMedian() const;
+    double GetMad() const;
+  private:
+    void Recalculate();
+
+    const uint16_t      _window;
+    const uint16_t      _hop;
+    std::vector<double> _ring;
+    std::vector<double> _work;
+    uint16_t            _ring_pos;
+    uint16_t            _size;
+    uint16_t            _pushed_after_calc;
+    double              _median;
+    double              _mad;
+};
+
+/**
+ * Class for detecting glitches, phase jumps and gaps in the stream of
+ * records. Every record is compared with robust statistics (median and
+ * MAD) of previous records:
+ * - glitch    : short run of outliers (< "jump_length" records);
+ * - phase jump: long run of outliers on the same side of median, the
+ *               statistics are restarted from the new level after it;
+ * - gap       : time interval between records is greater than
+ *               "gap_factor" * expected interval. Expected interval is
+ *               the greatest of median interval and "measuring_time"
+ *               from the header.
+ * Quantized values (counters) often have zero MAD, so sigma is not lesser
+ * than the resolution of values (the lowest non-zero step between
+ * records), and steps by one digit are not outliers.
+ */
+class Detector {
+  public:
+    typedef std::shared_ptr<Detector> ShrPtr;
+
+    struct Event {
+      typedef std::vector<Event> List;
+      enum Type {
+        kGlitch,
+        kPhaseJump,
+        kGap
+      };
+      Event();
+      Event(Type type, double time, double value, uint32_t line);
+      Type     type;
+      // first record of the event, for gap it is the record after gap
+      double   time;
+      double   value;
+      uint32_t line;
+      double   length; // gap: duration; glitch, jump: amount of records
+    };
+
+    struct Settings {
+      Settings();
+      uint16_t window;      // amount of records for median and MAD
+      uint16_t hop;         // amount of records between recalculations
+      double   threshold;   // outlier if |value - median| > threshold * sigma
+      uint16_t jump_length; // amount of outliers for detecting phase jump
+      double   gap_factor;  // gap if interval > gap_factor * expected
+      double   interval;    // expected interval between records, seconds
+      size_t   max_events;  // limit of stored events
+    };
+
+    Detector(const Settings &settings = Settings());
+    /**
+     * Method for getting expected interval from "measuring_time" field.
+     * It is used only if interval was not set in settings.
+     * @param hd header of the data source.
+     */
+    void UseHeader(const VoidDataSource::Header &hd);
+    void PushRecord(const VoidDataSource::Record &rec, uint32_t line);
+    /**
+     * Method for registering event, which is still in progress at the end
+     * of the data source.
+     */
+    void Finish();
+    const Event::List& GetEvents() const;
+    size_t GetDroppedEvents() const;
+    /**
+     * Method for converting string like "10 ms" into seconds.
+     * @return NaN if string has invalid format.
+     */
+    static double ParseMeasuringTime(const std::string &str);
+  private:
+    void RegisterEvent(const Event &ev);
+    void FinishOutliersRun();
+
+    const Settings _settings;
+    double         _interval;
+    RollingMedian  _values;
+    RollingMedian  _intervals;
+    double         _prev_time;
+    double         _prev_value;
+    double         _resolution; // the lowest non-zero step of values
+    Event          _outlier;
+    int8_t         _outlier_side;
+    Event::List    _events;
+    size_t         _dropped_events;
+};
+
+const char* GetEventTypeName(Detector::Event::Type type);
+#endif
@@ -0,0 +1,255 @@
+#include "difference_data_source.hpp"
+#include <cmath>
+#include <algorithm>
+
+struct DifferenceDataSource::Batch {
+  Batch(uint32_t size)
+      : recs(size),
+        lines(size),
+        amount(0),
+        last(false) {
+  }
+
+  std::vector<Record>   recs;
+  std::vector<uint32_t> lines;
+  uint32_t              amount;
+  bool                  last;
+};
+
+struct DifferenceDataSource::Input {
+  Input(VoidDataSource *src, uint32_t batch_size, uint32_t depth)
+      : src(src),
+        pool(depth, Batch(batch_size)),
+        full(depth),
+        free(depth),
+        batch(0),
+        pos(0),
+        finished(false) {
+    for (auto &item : pool) {
+      free.TryPush(&item);
+    }
+  }
+
+  VoidDataSource      *src;
+  std::vector<Batch>   pool;
+  SpscRing<Batch*>     full;
+  SpscRing<Batch*>     free;
+  std::thread          thread;
+  Batch               *batch; // batch, which is merged now
+  uint32_t             pos;
+  bool                 finished;
+};
+// class DifferenceDataSource::Settings
+DifferenceDataSource::Settings::Settings()
+    : matching(kInterpolatedMatching),
+      tolerance(1),
+      batch_size(4096),
+      depth(4) {
+}
+// class DifferenceDataSource::Statistics
+DifferenceDataSource::Statistics::Statistics()
+    : matched(0),
+      unmatched(0) {
+}
+// class DifferenceDataSource
+DifferenceDataSource::DifferenceDataSource(VoidDataSource *device,
+                                           VoidDataSource *reference,
+                                           const Settings &settings)
+    : VoidDataSource(),
+      _device_src(device),
+      _reference_src(reference),
+      _settings(settings),
+      _stop(false),
+      _has_prev(false),
+      _has_next(false) {
+}
+
+DifferenceDataSource::~DifferenceDataSource() {
+  StopInputs();
+}
+
+bool DifferenceDataSource::OccupySource() {
+  StopInputs();
+  if (not _device_src->OccupySource()) {
+    SetMessage("Device: " + _device_src->GetMessage());
+    return false;
+  }
+  if (not _reference_src->OccupySource()) {
+    SetMessage("Reference: " + _reference_src->GetMessage());
+    _device_src->ReleaseSource();
+    return false;
+  }
+  OccupyWithHeader(_device_src->GetHeader());
+  const uint32_t kBatchSize = std::max<uint32_t>(_settings.batch_size, 1);
+  const uint32_t kDepth     = std::max<uint32_t>(_settings.depth, 1);
+  _device.reset(new Input(_device_src.get(), kBatchSize, kDepth));
+  _reference.reset(new Input(_reference_src.get(), kBatchSize, kDepth));
+  _stat     = Statistics();
+  _stop     = false;
+  _has_prev = false;
+  _device->thread    = std::thread(&DifferenceDataSource::ParseInput, this,
+                                   _device.get());
+  _reference->thread = std::thread(&DifferenceDataSource::ParseInput, this,
+                                   _reference.get());
+  _has_next = NextRecord(_reference.get(), &_ref_next, 0);
+  return true;
+}
+
+void DifferenceDataSource::ReleaseSource() {
+  StopInputs();
+  _device.reset();
+  _reference.reset();
+  _device_src->ReleaseSource();
+  _reference_src->ReleaseSource();
+  VoidDataSource::ReleaseSource();
+}
+
+void DifferenceDataSource::StopInputs() {
+  _stop = true;
+  _waiter.Notify();
+  for (auto *input : {_device.get(), _reference.get()}) {
+    if (input != 0 && input->thread.joinable()) {
+      input->thread.join();
+    }
+  }
+}
+
+int16_t DifferenceDataSource::GetLine(char*, uint8_t) {
+  return -1;
+}
+
+void DifferenceDataSource::ParseInput(Input *input) {
+  VoidDataSource *src  = input->src;
+  bool            last = false;
+  while (not last) {
+    Batch *batch = 0;
+    if (not _waiter.Pop(&input->free, &batch, _stop)) {
+      break;
+    }
+    const uint32_t kSize = batch->recs.size();
+    batch->amount = 0;
+    while (batch->amount < kSize && not src->IsAtTheEnd()) {
+      if (src->GetRecord(&batch->recs[batch->amount])) {
+        batch->lines[batch->amount++] = src->GetLineNumber();
+      }
+    }
+    last        = src->IsAtTheEnd();
+    batch->last = last;
+    if (not _waiter.Push(&input->full, batch, _stop)) {
+      break;
+    }
+  }
+}
+
+bool DifferenceDataSource::NextRecord(Input *input, Record *out,
+                                      uint32_t *line) {
+  while (not input->finished) {
+    Batch *batch = input->batch;
+    if (batch != 0 && input->pos < batch->amount) {
+      *out = batch->recs[input->pos];
+      if (line != 0) {
+        *line = batch->lines[input->pos];
+      }
+      ++input->pos;
+      return true;
+    }
+    if (batch != 0) {
+      // the batch is merged, so it is returned to the parser
+      input->finished = batch->last;
+      input->batch    = 0;
+      input->free.TryPush(batch);
+      _waiter.Notify();
+      continue;
+    }
+    if (not _waiter.Pop(&input->full, &input->batch, _stop)) {
+      input->finished = true;
+    }
+    input->pos = 0;
+  }
+  return false;
+}
+
+void DifferenceDataSource::ReportInputs() {
+  const std::pair<const char*, VoidDataSource*> kInputs[] = {
+    {"Device: ",    _device_src.get()},
+    {"Reference: ", _reference_src.get()}
+  };
+  // failed reading of any input is reported before errors of parsing
+  for (const auto &input : kInputs) {
+    if (input.second->IsFailed()) {
+      SetFailure(input.first + input.second->GetMessage());
+      return;
+    }
+  }
+  for (const auto &input : kInputs) {
+    if (not input.second->GetMessage().empty()) {
+      SetMessage(input.first + input.second->GetMessage());
+      return;
+    }
+  }
+}
+
+bool DifferenceDataSource::Match(double time, double *ref) const {
+  const double kPrevDist = _has_prev ? time - _ref_prev.time : HUGE_VAL;
+  const double kNextDist = _has_next ? _ref_next.time - time : HUGE_VAL;
+  if (kPrevDist == 0) {
+    *ref = _ref_prev.value;
+    return true;
+  }
+  const double kTolerance = _settings.tolerance;
+  if (_settings.matching == kNearestMatching) {
+    if (std::min(kPrevDist, kNextDist) > kTolerance) {
+      return false;
+    }
+    *ref = kPrevDist <= kNextDist ? _ref_prev.value : _ref_next.value;
+    return true;
+  }
+  if (kPrevDist > kTolerance || kNextDist > kTolerance) {
+    return false;
+  }
+  *ref = _ref_prev.value + (_ref_next.value - _ref_prev.value)
+       * kPrevDist / (kPrevDist + kNextDist);
+  return true;
+}
+
+bool DifferenceDataSource::GetRecord(Record *out) {
+  Record   dev;
+  uint32_t line = 0;
+  if (not _device || not NextRecord(_device.get(), &dev, &line)) {
+    SetAtTheEnd();
+    // parsers are finished, so their messages can be taken
+    StopInputs();
+    ReportInputs();
+    return false;
+  }
+  SetLineNumber(line);
+  // reference is moved, until its next record is after device record
+  while (_has_next && not (_ref_next.time > dev.time)) {
+    _ref_prev = _ref_next;
+    _has_prev = true;
+    _has_next = NextRecord(_reference.get(), &_ref_next, 0);
+  }
+  double ref = 0;
+  if (not Match(dev.time, &ref)) {
+    ++_stat.unmatched;
+    return false;
+  }
+  ++_stat.matched;
+  out->time  = dev.time;
+  out->value = dev.value - ref;
+  return AcceptTime(out->time);
+}
+
+bool DifferenceDataSource::GetRow(Row *out) {
+  Record rec;
+  const bool kOk = GetRecord(&rec);
+  out->time      = rec.time;
+  out->amount    = 1;
+  out->values[0] = rec.value;
+  return kOk;
+}
+
+const DifferenceDataSource::Statistics&
+DifferenceDataSource::GetStatistics() const {
+  return _stat;
+}
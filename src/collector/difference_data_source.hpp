@@ -0,0 +1,103 @@
+#ifndef DIFFERENCE_DATA_SOURCE_HPP
+#define DIFFERENCE_DATA_SOURCE_HPP
+
+#include <memory>
+#include <thread>
+#include "pipeline.hpp"
+
+/**
+ * Data source of differences between two captures, which are sampled at
+ * slightly different times (for example, device under test and reference
+ * oscillator). Records of the device are matched with records of the
+ * reference by time, the difference "device - reference" gets time label
+ * of the device record. Device records without reference in the
+ * tolerance are skipped (like lines without records).
+ * Both inputs are parsed by their own threads and passed by batches
+ * through "SpscRing", records are merged in one pass, so memory does not
+ * depend on length of captures. Time labels of both inputs must grow
+ * (it is checked by inputs).
+ * Lines are not read by the source, so pipelined loading is not
+ * supported (inputs are parsed concurrently anyway).
+ */
+class DifferenceDataSource : public VoidDataSource {
+  public:
+    enum Matching {
+      kNearestMatching,     // value of the nearest reference record
+      kInterpolatedMatching // linear interpolation between the previous
+                            // and the next reference records
+    };
+    struct Settings {
+      Settings();
+
+      Matching matching;
+      double   tolerance;  // the highest distance between time labels of
+                           // matched records (seconds)
+      uint32_t batch_size; // records in batch
+      uint32_t depth;      // amount of batches of every input
+    };
+    struct Statistics {
+      Statistics();
+
+      uint64_t matched;
+      uint64_t unmatched; // device records without reference
+    };
+
+    /**
+     * @param device    source of measured records, it is owned by created
+     *                  object;
+     * @param reference source of reference records, it is owned by
+     *                  created object.
+     */
+    DifferenceDataSource(VoidDataSource *device, VoidDataSource *reference,
+                         const Settings &settings = Settings());
+    virtual ~DifferenceDataSource();
+    virtual bool GetRecord(Record *out);
+    virtual bool GetRow(Row *out);
+    const Statistics& GetStatistics() const;
+  protected:
+    /**
+     * Inputs are occupied in the calling thread, so errors of headers are
+     * reported at once. Header of the device is used.
+     */
+    virtual bool OccupySource();
+    virtual int16_t GetLine(char *line, uint8_t max_len);
+    virtual void ReleaseSource();
+  private:
+    struct Batch;
+    struct Input;
+
+    void ParseInput(Input *input);
+    /**
+     * Method for getting the next record of input in the calling thread.
+     * @param line line number of the record, it can be null;
+     * @return false at the end of input.
+     */
+    bool NextRecord(Input *input, Record *out, uint32_t *line);
+    /**
+     * @param ref value of reference at time label "time";
+     * @return false if there is no reference in tolerance.
+     */
+    bool Match(double time, double *ref) const;
+    void StopInputs();
+    /**
+     * Method for taking messages of finished inputs, failed reading of one
+     * of inputs fails the source.
+     */
+    void ReportInputs();
+
+    const ShrPtr           _device_src;
+    const ShrPtr           _reference_src;
+    const Settings         _settings;
+    std::unique_ptr<Input> _device;
+    std::unique_ptr<Input> _reference;
+    std::atomic<bool>      _stop;
+    RingWaiter             _waiter;
+    Record                 _ref_prev; // the last reference record, which
+                                      // is not after device record
+    Record                 _ref_next; // the first reference record after
+                                      // device record
+    bool                   _has_prev;
+    bool                   _has_next;
+    Statistics             _stat;
+};
+#endif
@@ -0,0 +1,277 @@
+#include "drift.hpp"
+#include "parallel.hpp"
+#include <cmath>
+#include <algorithm>
+
+// records of one chunk, which is processed by one thread
+static const size_t kChunkRecords = 65536;
+
+// class DriftEstimator::Settings
+DriftEstimator::Settings::Settings()
+    : order(1),
+      mode(kReport),
+      origin(std::nan("")) {
+}
+// class DriftEstimator::State
+DriftEstimator::State::State()
+    : order(0),
+      origin(std::nan("")),
+      shift(std::nan("")),
+      diagonal(),
+      factor(),
+      rhs(),
+      rss(0),
+      amount(0),
+      time_range(std::nan(""), std::nan("")) {
+}
+// class DriftEstimator
+DriftEstimator::DriftEstimator(const Settings &settings)
+    : _settings(settings),
+      _params(std::min<int>(std::max<int>(settings.order, 1), kMaxOrder)
+              + 1),
+      _shift(std::nan("")),
+      _diagonal(),
+      _factor(),
+      _rhs(),
+      _rss(0),
+      _coefs(),
+      _amount(0),
+      _time_range(std::nan(""), std::nan("")),
+      _fitted(false) {
+}
+
+uint8_t DriftEstimator::GetParams() const {
+  return _params < kMaxParams ? _params : kMaxParams;
+}
+
+void DriftEstimator::Include(double *row, double value, double weight) {
+  const uint8_t kParams = GetParams();
+  for (uint8_t i = 0; i < kParams && weight != 0; ++i) {
+    const double kX = row[i];
+    if (kX == 0) {
+      continue;
+    }
+    const double kDiagonal = _diagonal[i] + weight * kX * kX;
+    const double kCos      = _diagonal[i] / kDiagonal;
+    const double kSin      = weight * kX / kDiagonal;
+    weight       *= kCos;
+    _diagonal[i]  = kDiagonal;
+    for (uint8_t k = i + 1; k < kParams; ++k) {
+      const double kRow = row[k];
+      row[k]        -= kX * _factor[i][k];
+      _factor[i][k]  = kCos * _factor[i][k] + kSin * kRow;
+    }
+    const double kValue = value;
+    value   -= kX * _rhs[i];
+    _rhs[i]  = kCos * _rhs[i] + kSin * kValue;
+  }
+  // the rest of the row is not explained by the factor
+  _rss += weight * value * value;
+}
+
+void DriftEstimator::PushRecord(const VoidDataSource::Record &rec) {
+  if (std::isnan(_settings.origin)) {
+    _settings.origin = rec.time;
+  }
+  if (_amount == 0) {
+    _shift = rec.value;
+  }
+  const double kTime = rec.time - _settings.origin;
+  double row[kMaxParams];
+  row[0] = 1;
+  for (uint8_t i = 1; i < GetParams(); ++i) {
+    row[i] = row[i - 1] * kTime;
+  }
+  Include(row, rec.value - _shift, 1);
+  if (_amount == 0 || rec.time < _time_range.first) {
+    _time_range.first = rec.time;
+  }
+  if (_amount == 0 || rec.time > _time_range.second) {
+    _time_range.second = rec.time;
+  }
+  ++_amount;
+  _fitted = false;
+}
+
+bool DriftEstimator::MergeWith(const DriftEstimator &src) {
+  if (src._amount == 0) {
+    return true;
+  }
+  if (std::isnan(_settings.origin)) {
+    _settings.origin = src._settings.origin;
+  }
+  if (src._params != _params || src._settings.origin != _settings.origin) {
+    SetMessage("Estimators of drift have different orders or origins");
+    return false;
+  }
+  if (_amount == 0) {
+    _shift = src._shift;
+  }
+  // data of "src" is equal to rows of its factor with weights of diagonal
+  const uint8_t kParams = GetParams();
+  for (uint8_t i = 0; i < kParams; ++i) {
+    if (src._diagonal[i] == 0) {
+      continue;
+    }
+    double row[kMaxParams] = {};
+    row[i] = 1;
+    for (uint8_t k = i + 1; k < kParams; ++k) {
+      row[k] = src._factor[i][k];
+    }
+    // shift of values changes only "c0", it is the first rotated value,
+    // because the factor is unit triangular
+    const double kShift = i == 0 ? src._shift - _shift : 0.0;
+    Include(row, src._rhs[i] + kShift, src._diagonal[i]);
+  }
+  _rss += src._rss;
+  if (_amount == 0 || src._time_range.first < _time_range.first) {
+    _time_range.first = src._time_range.first;
+  }
+  if (_amount == 0 || src._time_range.second > _time_range.second) {
+    _time_range.second = src._time_range.second;
+  }
+  _amount += src._amount;
+  _fitted  = false;
+  return true;
+}
+
+bool DriftEstimator::AddRecords(SampleStore *store, size_t threads) {
+  const uint64_t kSize    = store->GetSize();
+  const size_t   kWorkers = GetWorkersAmount(threads);
+  std::vector<SampleStore::Record> recs(kWorkers * kChunkRecords);
+  for (uint64_t first = 0; first < kSize; first += recs.size()) {
+    const size_t kAmount = std::min<uint64_t>(recs.size(), kSize - first);
+    if (store->ReadRecords(first, recs.data(), kAmount) != kAmount) {
+      SetMessage("Failed to read records: " + store->GetMessage());
+      return false;
+    }
+    // chunks must have the same origin for merging
+    if (std::isnan(_settings.origin)) {
+      _settings.origin = recs[0].time;
+    }
+    const size_t kChunks = (kAmount + kChunkRecords - 1) / kChunkRecords;
+    std::vector<DriftEstimator> chunks(kChunks, DriftEstimator(_settings));
+    ParallelFor(kChunks, [&](size_t index, size_t) {
+      const size_t kFrom = index * kChunkRecords;
+      const size_t kTo   = std::min(kAmount, kFrom + kChunkRecords);
+      for (size_t i = kFrom; i < kTo; ++i) {
+        chunks[index].PushRecord(recs[i]);
+      }
+    }, kWorkers);
+    // chunks are merged in order, so result does not depend on threads
+    for (const auto &chunk : chunks) {
+      MergeWith(chunk);
+    }
+  }
+  return true;
+}
+
+bool DriftEstimator::Fit() {
+  _fitted = false;
+  const uint8_t kParams = GetParams();
+  for (uint8_t i = 0; i < kParams; ++i) {
+    if (not (_diagonal[i] > 0)) {
+      SetMessage("Not enough records with different time labels for fit");
+      return false;
+    }
+  }
+  // back substitution of the unit triangular factor
+  std::fill(_coefs, _coefs + kMaxParams, 0.0);
+  for (int i = kParams - 1; i >= 0; --i) {
+    double coef = _rhs[i];
+    for (uint8_t k = i + 1; k < kParams; ++k) {
+      coef -= _factor[i][k] * _coefs[k];
+    }
+    _coefs[i] = coef;
+  }
+  _coefs[0] += _shift;
+  _fitted    = true;
+  return true;
+}
+
+bool DriftEstimator::SubtractDrift(Compressor *comp) {
+  if (not _fitted) {
+    SetMessage("Drift is not estimated");
+    return false;
+  }
+  comp->SubtractTrend([this](double time) {
+    return GetDrift(time);
+  });
+  return true;
+}
+
+void DriftEstimator::GetState(State *out) const {
+  out->order  = _params - 1;
+  out->origin = _settings.origin;
+  out->shift  = _shift;
+  std::copy(_diagonal, _diagonal + kMaxParams, out->diagonal);
+  std::copy(&_factor[0][0], &_factor[0][0] + kMaxParams * kMaxParams,
+            &out->factor[0][0]);
+  std::copy(_rhs, _rhs + kMaxParams, out->rhs);
+  out->rss        = _rss;
+  out->amount     = _amount;
+  out->time_range = _time_range;
+}
+
+bool DriftEstimator::SetState(const State &state) {
+  if (state.order + 1 != _params) {
+    SetMessage("Invalid state of estimator of drift");
+    return false;
+  }
+  _settings.origin = state.origin;
+  _shift           = state.shift;
+  std::copy(state.diagonal, state.diagonal + kMaxParams, _diagonal);
+  std::copy(&state.factor[0][0],
+            &state.factor[0][0] + kMaxParams * kMaxParams, &_factor[0][0]);
+  std::copy(state.rhs, state.rhs + kMaxParams, _rhs);
+  _rss        = state.rss;
+  _amount     = state.amount;
+  _time_range = state.time_range;
+  _fitted     = false;
+  return true;
+}
+
+double DriftEstimator::GetTrend(double time) const {
+  return _coefs[0] + GetDrift(time);
+}
+
+double DriftEstimator::GetDrift(double time) const {
+  const double kTime = time - _settings.origin;
+  return kTime * (_coefs[1] + kTime * _coefs[2]);
+}
+
+double DriftEstimator::GetRate(double time) const {
+  return _coefs[1] + 2 * _coefs[2] * (time - _settings.origin);
+}
+
+double DriftEstimator::GetCoefficient(uint8_t power) const {
+  return power < kMaxParams ? _coefs[power] : 0.0;
+}
+
+double DriftEstimator::GetResidualRms() const {
+  return _amount ? std::sqrt(_rss / _amount) : std::nan("");
+}
+
+const Compressor::Range& DriftEstimator::GetTimeRange() const {
+  return _time_range;
+}
+
+uint64_t DriftEstimator::GetAmount() const {
+  return _amount;
+}
+
+bool DriftEstimator::IsFitted() const {
+  return _fitted;
+}
+
+const DriftEstimator::Settings& DriftEstimator::GetSettings() const {
+  return _settings;
+}
+
+const std::string& DriftEstimator::GetMessage() const {
+  return _message;
+}
+
+void DriftEstimator::SetMessage(const std::string &msg) {
+  _message = msg;
+}
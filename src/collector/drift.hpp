@@ -0,0 +1,151 @@
+#ifndef DRIFT_HPP
+#define DRIFT_HPP
+
+#include "compressor.hpp"
+#include "sample_store.hpp"
+
+/**
+ * Estimation of drift of values (for example, aging of oscillator) by
+ * least squares fit of polynomial v(t) = c0 + c1 * t + c2 * t^2, where
+ * "t" is counted from the origin of time.
+ * Records are added one by one: every record is rotated into triangular
+ * factor of the fit (square root free Givens rotations, Gentleman's
+ * algorithm), so memory does not depend on amount of records and the sum
+ * of squared residuals is accumulated directly. Unlike sums of normal
+ * equations it keeps precision of small noise, when drift dominates.
+ * Values are shifted by the first one, so big nominal (10 MHz) does not
+ * take precision of the fit.
+ * Estimators of chunks with the same origin are merged by rotating rows
+ * of one factor into another, so chunks can be processed in parallel.
+ */
+class DriftEstimator {
+  public:
+    typedef std::shared_ptr<DriftEstimator> ShrPtr;
+
+    static const uint8_t kMaxOrder = 2;
+
+    enum Mode {
+      kReport,  // drift is only estimated
+      kSubtract // drift is subtracted from compressed records after loading
+    };
+
+    struct Settings {
+      Settings();
+
+      uint8_t order;  // 1 - linear, 2 - quadratic
+      Mode    mode;
+      double  origin; // time label of t = 0, NaN - the first record
+    };
+
+    /**
+     * Accumulated data of the fit, it is enough for continuing estimation
+     * (please look at "Checkpoint").
+     */
+    struct State {
+      State();
+
+      uint8_t           order;
+      double            origin;
+      double            shift;
+      double            diagonal[kMaxOrder + 1];
+      double            factor[kMaxOrder + 1][kMaxOrder + 1];
+      double            rhs[kMaxOrder + 1];
+      double            rss;
+      uint64_t          amount;
+      Compressor::Range time_range;
+    };
+
+    DriftEstimator(const Settings &settings = Settings());
+    void PushRecord(const VoidDataSource::Record &rec);
+    /**
+     * Method for adding records of the estimator of another chunk.
+     * @return false if orders or origins of estimators are different.
+     */
+    bool MergeWith(const DriftEstimator &src);
+    /**
+     * Method for adding all records of the storage, they are read by
+     * batches and chunks of the batch are processed by several threads.
+     * @param threads amount of threads, 0 - threads of the scheduler;
+     * @return false if records can not be read.
+     */
+    bool AddRecords(SampleStore *store, size_t threads = 0);
+    /**
+     * Method for calculating coefficients by added records.
+     * @return false if there are not enough records with different time
+     *         labels.
+     */
+    bool Fit();
+    /**
+     * Method for subtracting the drift (trend without "c0") from records
+     * of compressor, so values keep their level at the origin.
+     * @return false if the fit is not calculated.
+     */
+    bool SubtractDrift(Compressor *comp);
+    void GetState(State *out) const;
+    /**
+     * Method for replacing accumulated data, the fit must be calculated
+     * again.
+     * @return false if order of the state is different.
+     */
+    bool SetState(const State &state);
+    /**
+     * @return value of the fitted polynomial at "time".
+     */
+    double GetTrend(double time) const;
+    /**
+     * @return change of value at "time" relatively to the origin.
+     */
+    double GetDrift(double time) const;
+    /**
+     * @return derivative of the polynomial at "time" (units per second).
+     */
+    double GetRate(double time) const;
+    /**
+     * @param power power of "t" [0, kMaxOrder];
+     * @return coefficient of the fit, 0 for powers above the order.
+     */
+    double GetCoefficient(uint8_t power) const;
+    /**
+     * @return root mean square of residuals of the fit.
+     */
+    double GetResidualRms() const;
+    /**
+     * @return range of time labels of added records.
+     */
+    const Compressor::Range& GetTimeRange() const;
+    uint64_t GetAmount() const;
+    bool IsFitted() const;
+    const Settings& GetSettings() const;
+    const std::string& GetMessage() const;
+  private:
+    static const uint8_t kMaxParams = kMaxOrder + 1;
+
+    /**
+     * Method for rotating the row of the fit into the factor.
+     * @param row    powers of "t", it is changed;
+     * @param value  value of the row;
+     * @param weight weight of the row.
+     */
+    void Include(double *row, double value, double weight);
+    /**
+     * @return amount of coefficients, the bound of arrays is explicit, so
+     *         the compiler sees that loops do not leave them.
+     */
+    uint8_t GetParams() const;
+    void SetMessage(const std::string &msg);
+
+    Settings          _settings;
+    uint8_t           _params;  // amount of coefficients
+    double            _shift;   // value, which is subtracted from values
+    // the factor is D^(1/2) * R, "R" is unit upper triangular
+    double            _diagonal[kMaxParams];
+    double            _factor[kMaxParams][kMaxParams];
+    double            _rhs[kMaxParams]; // rotated values
+    double            _rss;             // sum of squared residuals
+    double            _coefs[kMaxParams];
+    uint64_t          _amount;
+    Compressor::Range _time_range;
+    bool              _fitted;
+    std::string       _message;
+};
+#endif
@@ -0,0 +1,704 @@
+#include "exporter.hpp"
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// exact powers of ten, which are representable by "double"
+static const double kPow10[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+static const int kMaxExactPow10 = 22;
+
+static const char kDigitPairs[] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536"
+  "37383940414243444546474849505152535455565758596061626364656667686970717273"
+  "747576777879808182838485868788899091929394959697989900";
+
+static
+void WriteDigits(uint64_t num, int amount, char *digits) {
+  char *pos = digits + amount;
+  while (pos > digits + 1) {
+    pos -= 2;
+    std::memcpy(pos, kDigitPairs + 2 * (num % 100), 2);
+    num /= 100;
+  }
+  if (pos > digits) {
+    *digits = '0' + num;
+  }
+}
+
+static const int      kFastDigits = 15;
+static const uint64_t kFastMin    = 100000000000000ULL;
+static const uint64_t kFastLimit  = 1000000000000000ULL;
+
+/**
+ * Fast path of formatting: 15 significant digits are calculated by one
+ * multiplication (division) by exact power of ten. Integer with 15 digits
+ * and power of ten are exact, so converting them back by one division
+ * (multiplication) is rounded correctly, like "strtod" does it. If the
+ * result is equal to "value", digits are valid.
+ * @return amount of digits; 0 if 15 digits are not enough, -1 if value
+ *         is not supported.
+ */
+static
+int GetFastDigits(double value, char digits[kFastDigits], int *exp10) {
+  uint64_t bits = 0;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const int kExp2 = (int)((bits >> 52) & 0x7FF) - 1023;
+  if (kExp2 == -1023) {
+    // subnormal numbers
+    return -1;
+  }
+  // value >= 2^kExp2, so floor(kExp2 * log10(2)) is lesser by 1 at most,
+  // 78913 / 2^18 is an approximation of log10(2)
+  int e10 = (kExp2 * 78913) >> 18;
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    const int kScale = kFastDigits - 1 - e10;
+    if (kScale > kMaxExactPow10 || kScale < -kMaxExactPow10) {
+      return -1;
+    }
+    const double kScaled = kScale >= 0 ? value * kPow10[kScale]
+                                       : value / kPow10[-kScale];
+    uint64_t mantissa = (uint64_t)(kScaled + 0.5);
+    if (mantissa >= kFastLimit) {
+      ++e10;
+      continue;
+    }
+    if (mantissa < kFastMin) {
+      --e10;
+      continue;
+    }
+    const double kBack = kScale >= 0 ? (double)mantissa / kPow10[kScale]
+                                     : (double)mantissa * kPow10[-kScale];
+    if (kBack != value) {
+      return 0;
+    }
+    WriteDigits(mantissa, kFastDigits, digits);
+    *exp10 = e10;
+    return kFastDigits;
+  }
+  return -1;
+}
+
+/**
+ * Unsigned 256 bit integer, which is enough for exact calculations of
+ * 16 and 17 digits for most of values.
+ */
+struct Uint256 {
+  Uint256(uint64_t low = 0)
+      : w{low, 0, 0, 0} {
+  }
+  void Multiply(uint64_t mul) {
+    unsigned __int128 carry = 0;
+    for (auto &word : w) {
+      carry += (unsigned __int128)word * mul;
+      word   = (uint64_t)carry;
+      carry >>= 64;
+    }
+  }
+  void AddBit(unsigned bit) {
+    for (unsigned i = bit / 64; i < 4; ++i) {
+      const uint64_t kAdd = i == bit / 64 ? 1ULL << (bit % 64) : 1;
+      w[i] += kAdd;
+      if (w[i] >= kAdd) {
+        break;
+      }
+    }
+  }
+  Uint256 ShiftLeft(unsigned bits) const {
+    Uint256 out;
+    const unsigned kWords = bits / 64;
+    const unsigned kBits  = bits % 64;
+    for (int i = 3; i >= (int)kWords; --i) {
+      out.w[i] = w[i - kWords] << kBits;
+      if (kBits > 0 && i > (int)kWords) {
+        out.w[i] |= w[i - kWords - 1] >> (64 - kBits);
+      }
+    }
+    return out;
+  }
+  uint64_t ShiftRightLow(unsigned bits) const {
+    const unsigned kWords = bits / 64;
+    const unsigned kBits  = bits % 64;
+    uint64_t out = w[kWords] >> kBits;
+    if (kBits > 0 && kWords < 3) {
+      out |= w[kWords + 1] << (64 - kBits);
+    }
+    return out;
+  }
+  int Compare(const Uint256 &other) const {
+    for (int i = 3; i >= 0; --i) {
+      if (w[i] != other.w[i]) {
+        return w[i] < other.w[i] ? -1 : 1;
+      }
+    }
+    return 0;
+  }
+  Uint256 Subtract(const Uint256 &other) const {
+    Uint256  out;
+    uint64_t borrow = 0;
+    for (int i = 0; i < 4; ++i) {
+      const uint64_t kSub = other.w[i] + borrow;
+      out.w[i] = w[i] - kSub;
+      borrow   = (kSub < borrow || w[i] < kSub) ? 1 : 0;
+    }
+    return out;
+  }
+  uint64_t w[4];
+};
+
+static
+void MultiplyByPow10(Uint256 *num, int exp10) {
+  for (; exp10 >= 19; exp10 -= 19) {
+    num->Multiply(10000000000000000000ULL);
+  }
+  num->Multiply((uint64_t)kPow10[exp10]);
+}
+
+/**
+ * Exact path of formatting: value = M * 2^-F, so digits of "value * 10^k"
+ * are calculated as (M * 10^k) >> F. Digits "c" are valid, if they are
+ * inside the half of the gap between neighbour values:
+ * |c * 10^-k - M * 2^-F| < 2^-(F + 1), or |c * 2^(F + 1) - 2 * M * 10^k| < 10^k
+ * 17 digits are always valid. Values, which need too big numbers, and
+ * values with irregular gap (power of two) are not supported.
+ */
+static
+bool IsInsideGap(uint64_t digits, const Uint256 &num, const Uint256 &limit,
+                 unsigned shift, uint64_t mantissa) {
+  const Uint256 kLeft  = Uint256(digits).ShiftLeft(shift + 1);
+  const Uint256 kRight = num.ShiftLeft(1);
+  const Uint256 kDiff  = kLeft.Compare(kRight) >= 0 ? kLeft.Subtract(kRight)
+                                                    : kRight.Subtract(kLeft);
+  const int kCmp = kDiff.Compare(limit);
+  // exact tie is rounded to even mantissa by "strtod"
+  return kCmp < 0 || (kCmp == 0 && mantissa % 2 == 0);
+}
+
+static
+int GetExactDigits(double value, int min_amount, char *digits, int *exp10) {
+  uint64_t bits = 0;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const int      kExp2     = (int)((bits >> 52) & 0x7FF) - 1023;
+  const uint64_t kMantissa = (bits & ((1ULL << 52) - 1)) | (1ULL << 52);
+  const int      kShift    = 52 - kExp2;
+  if (kExp2 == -1023 || kMantissa == (1ULL << 52) ||
+      kShift <= 0 || kShift > 196) {
+    return 0;
+  }
+  int e10 = (kExp2 * 78913) >> 18;
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    const int kScale = kFastDigits - 1 - e10;
+    if (kScale < 0 || kScale > 58) {
+      return 0;
+    }
+    Uint256 num(kMantissa);
+    Uint256 limit(1);
+    MultiplyByPow10(&num,   kScale);
+    MultiplyByPow10(&limit, kScale);
+    Uint256 rounded = num;
+    rounded.AddBit(kShift - 1);
+    const uint64_t kDigits = rounded.ShiftRightLow(kShift);
+    if (kDigits >= kFastLimit) {
+      ++e10;
+      continue;
+    }
+    if (kDigits < kFastMin) {
+      --e10;
+      continue;
+    }
+    for (int amount = kFastDigits; amount <= 17; ++amount) {
+      rounded = num;
+      rounded.AddBit(kShift - 1);
+      const uint64_t kResult = rounded.ShiftRightLow(kShift);
+      if (amount == 17 || (amount >= min_amount &&
+          IsInsideGap(kResult, num, limit, kShift, kMantissa))) {
+        WriteDigits(kResult, amount, digits);
+        *exp10 = e10;
+        return amount;
+      }
+      num.Multiply(10);
+      limit.Multiply(10);
+    }
+  }
+  return 0;
+}
+
+/**
+ * Slow path of formatting: shortest representation with 1-17 digits
+ * is searched by "snprintf" and "strtod". It is used only for values,
+ * which are not supported by other paths (subnormal numbers have less
+ * significant digits, so the search starts from one digit).
+ */
+static
+int GetSlowDigits(double value, char *digits, int *exp10) {
+  char str[kMaxDoubleLen];
+  // 17 digits are always enough
+  for (int prec = 1; prec <= 17; ++prec) {
+    std::snprintf(str, sizeof(str), "%.*e", prec - 1, value);
+    if (std::strtod(str, 0) == value) {
+      break;
+    }
+  }
+  int amount = 0;
+  const char *pos = str;
+  for (; *pos != 'e'; ++pos) {
+    if (*pos != '.') {
+      digits[amount++] = *pos;
+    }
+  }
+  *exp10 = std::atoi(pos + 1);
+  return amount;
+}
+
+static
+size_t ComposeNumber(const char *digits, int amount, int exp10, char *out) {
+  char *pos = out;
+  while (amount > 1 && digits[amount - 1] == '0') {
+    --amount;
+  }
+  if (exp10 >= 0 && exp10 < 17) {
+    // 123.45, 12300
+    const int kIntLen = exp10 + 1;
+    for (int i = 0; i < kIntLen; ++i) {
+      *pos++ = i < amount ? digits[i] : '0';
+    }
+    if (amount > kIntLen) {
+      *pos++ = '.';
+      std::memcpy(pos, digits + kIntLen, amount - kIntLen);
+      pos += amount - kIntLen;
+    }
+  } else if (exp10 < 0 && exp10 >= -5) {
+    // 0.00123
+    *pos++ = '0';
+    *pos++ = '.';
+    for (int i = exp10 + 1; i < 0; ++i) {
+      *pos++ = '0';
+    }
+    std::memcpy(pos, digits, amount);
+    pos += amount;
+  } else {
+    // 1.23e-07
+    *pos++ = digits[0];
+    if (amount > 1) {
+      *pos++ = '.';
+      std::memcpy(pos, digits + 1, amount - 1);
+      pos += amount - 1;
+    }
+    *pos++ = 'e';
+    *pos++ = exp10 < 0 ? '-' : '+';
+    int exp_abs = std::abs(exp10);
+    if (exp_abs >= 100) {
+      *pos++ = '0' + exp_abs / 100;
+      exp_abs %= 100;
+    }
+    std::memcpy(pos, kDigitPairs + 2 * exp_abs, 2);
+    pos += 2;
+  }
+  return pos - out;
+}
+
+size_t FormatDouble(double value, char *out) {
+  if (std::isnan(value)) {
+    std::memcpy(out, "nan", 4);
+    return 3;
+  }
+  char *pos = out;
+  if (std::signbit(value)) {
+    *pos++ = '-';
+    value  = -value;
+  }
+  if (std::isinf(value)) {
+    std::memcpy(pos, "inf", 4);
+    return pos - out + 3;
+  }
+  if (value == 0) {
+    *pos++ = '0';
+    *pos   = 0;
+    return pos - out;
+  }
+  // every path writes at least one digit, it is not obvious for compiler
+  char digits[kMaxDoubleLen] = {'0'};
+  int  exp10  = 0;
+  int  amount = GetFastDigits(value, digits, &exp10);
+  if (amount <= 0) {
+    // if fast path has checked 15 digits, exact path starts from 16
+    amount = GetExactDigits(value, kFastDigits + 1 + amount, digits, &exp10);
+  }
+  if (amount <= 0) {
+    amount = GetSlowDigits(value, digits, &exp10);
+  }
+  pos += ComposeNumber(digits, amount, exp10, pos);
+  *pos = 0;
+  return pos - out;
+}
+// class Exporter
+Exporter::Exporter(const std::string &path)
+    : _path(path),
+      _file(0),
+      _columns(0) {
+}
+
+Exporter::~Exporter() {
+  if (_file != 0) {
+    std::fclose(_file);
+  }
+}
+
+bool Exporter::Open(const Names &columns) {
+  _file = std::fopen(_path.c_str(), "wb");
+  if (_file == 0) {
+    SetMessage("Failed to create file: " + _path);
+    return false;
+  }
+  // all exporters have own buffers
+  std::setvbuf(_file, 0, _IONBF, 0);
+  _columns = columns.size();
+  return true;
+}
+
+bool Exporter::Close() {
+  if (_file == 0) {
+    return false;
+  }
+  const bool kOk = std::fclose(_file) == 0;
+  _file = 0;
+  if (not kOk) {
+    SetMessage("Failed to close file: " + _path);
+  }
+  return kOk;
+}
+
+bool Exporter::IsOpened() const {
+  return _file != 0;
+}
+
+bool Exporter::WriteData(const void *data, size_t size) {
+  if (size > 0 && std::fwrite(data, size, 1, _file) != 1) {
+    SetMessage("Failed to write file: " + _path);
+    return false;
+  }
+  return true;
+}
+
+bool Exporter::Seek(uint64_t offset) {
+  if (std::fseek(_file, offset, SEEK_SET) != 0) {
+    SetMessage("Failed to seek in file: " + _path);
+    return false;
+  }
+  return true;
+}
+
+size_t Exporter::GetColumnsAmount() const {
+  return _columns;
+}
+
+Exporter::Names Exporter::GetRecordColumns() {
+  return {"time", "value"};
+}
+
+Exporter::Names Exporter::GetBucketColumns() {
+  return {"time_first", "time_last", "value_min", "value_max", "amount"};
+}
+
+bool Exporter::WriteRecord(const VoidDataSource::Record &rec) {
+  const double kRow[] = {rec.time, rec.value};
+  return WriteRow(kRow);
+}
+
+bool Exporter::WriteBucket(const Compressor::Record &rec) {
+  // bucket with one record has only first values
+  const double kRow[] = {
+    rec.time.first,
+    std::isnan(rec.time.second) ? rec.time.first : rec.time.second,
+    rec.value.first,
+    std::isnan(rec.value.second) ? rec.value.first : rec.value.second,
+    (double)rec.amount
+  };
+  return WriteRow(kRow);
+}
+
+bool Exporter::WriteBuckets(const Compressor::Record::List &records) {
+  for (auto it = records.begin(); it != records.end(); ++it) {
+    if (not WriteBucket(*it)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Exporter::WriteTable(const Names &names, const Columns &columns) {
+  if (names.size() != columns.size() || columns.empty()) {
+    SetMessage("Invalid columns of the table");
+    return false;
+  }
+  if (not Open(names)) {
+    return false;
+  }
+  std::vector<double> row(columns.size());
+  for (size_t r = 0; r < columns.front().size(); ++r) {
+    for (size_t c = 0; c < columns.size(); ++c) {
+      row[c] = columns[c][r];
+    }
+    if (not WriteRow(row.data())) {
+      Close();
+      return false;
+    }
+  }
+  return Close();
+}
+
+const std::string& Exporter::GetMessage() const {
+  return _message;
+}
+
+void Exporter::SetMessage(const std::string &msg) {
+  _message = msg;
+}
+// class CsvExporter
+CsvExporter::CsvExporter(const std::string &path)
+    : Exporter(path),
+      _used(0) {
+}
+
+CsvExporter::~CsvExporter() {
+  if (IsOpened()) {
+    Close();
+  }
+}
+
+bool CsvExporter::Open(const Names &columns) {
+  if (not Exporter::Open(columns)) {
+    return false;
+  }
+  _buffer.resize(kBufferSize);
+  _used = 0;
+  std::string head;
+  for (auto it = columns.begin(); it != columns.end(); ++it) {
+    head += (it == columns.begin() ? "" : ",") + *it;
+  }
+  head += '\n';
+  return WriteData(head.data(), head.size());
+}
+
+bool CsvExporter::Flush() {
+  const bool kOk = WriteData(_buffer.data(), _used);
+  _used = 0;
+  return kOk;
+}
+
+bool CsvExporter::WriteRow(const double *values) {
+  const size_t kColumns = GetColumnsAmount();
+  if (_used + kColumns * (kMaxDoubleLen + 1) > _buffer.size() &&
+      not Flush()) {
+    return false;
+  }
+  char *pos = _buffer.data() + _used;
+  for (size_t i = 0; i < kColumns; ++i) {
+    pos   += FormatDouble(values[i], pos);
+    *pos++ = ',';
+  }
+  *(pos - 1) = '\n';
+  _used = pos - _buffer.data();
+  return true;
+}
+
+bool CsvExporter::Close() {
+  const bool kFlushOk = IsOpened() && Flush();
+  return Exporter::Close() && kFlushOk;
+}
+// class ColumnarExporter
+const char ColumnarExporter::kMagic[8] = {'O', 'R', 'C', 'O', 'L', 'S', '0', '1'};
+
+static_assert(sizeof(ColumnarExporter::FileHeader) == 64,
+              "Invalid size of columnar file header");
+
+ColumnarExporter::ColumnarExporter(const std::string &path,
+                                   uint32_t           chunk_rows)
+    : Exporter(path),
+      _chunk_rows(chunk_rows > 0 ? chunk_rows : 1),
+      _rows_in_chunk(0) {
+  std::memset(&_header, 0, sizeof(_header));
+}
+
+ColumnarExporter::~ColumnarExporter() {
+  if (IsOpened()) {
+    Close();
+  }
+}
+
+bool ColumnarExporter::Open(const Names &columns) {
+  if (not Exporter::Open(columns)) {
+    return false;
+  }
+  std::memset(&_header, 0, sizeof(_header));
+  std::memcpy(_header.magic, kMagic, sizeof(kMagic));
+  _header.version     = kVersion;
+  _header.columns     = columns.size();
+  _header.data_offset = sizeof(_header) + columns.size() * kNameSize;
+  if (not WriteData(&_header, sizeof(_header))) {
+    return false;
+  }
+  for (auto it = columns.begin(); it != columns.end(); ++it) {
+    char name[kNameSize] = {0};
+    std::strncpy(name, it->c_str(), kNameSize - 1);
+    if (not WriteData(name, kNameSize)) {
+      return false;
+    }
+  }
+  _chunk.resize(columns.size() * _chunk_rows);
+  _rows_in_chunk = 0;
+  return true;
+}
+
+bool ColumnarExporter::WriteRow(const double *values) {
+  for (uint32_t i = 0; i < _header.columns; ++i) {
+    _chunk[i * _chunk_rows + _rows_in_chunk] = values[i];
+  }
+  if (++_rows_in_chunk == _chunk_rows) {
+    return FlushChunk();
+  }
+  return true;
+}
+
+bool ColumnarExporter::FlushChunk() {
+  if (_rows_in_chunk == 0) {
+    return true;
+  }
+  const size_t kColumnSize = _rows_in_chunk * sizeof(double);
+  const ChunkHeader kChunk = {
+    _rows_in_chunk,
+    sizeof(ChunkHeader) + _header.columns * kColumnSize
+  };
+  if (not WriteData(&kChunk, sizeof(kChunk))) {
+    return false;
+  }
+  for (uint32_t i = 0; i < _header.columns; ++i) {
+    if (not WriteData(&_chunk[i * _chunk_rows], kColumnSize)) {
+      return false;
+    }
+  }
+  _header.rows  += _rows_in_chunk;
+  _header.chunks++;
+  _rows_in_chunk = 0;
+  return true;
+}
+
+bool ColumnarExporter::Close() {
+  const bool kOk = (
+    IsOpened() &&
+    FlushChunk() &&
+    Seek(0) &&
+    WriteData(&_header, sizeof(_header))
+  );
+  return Exporter::Close() && kOk;
+}
+// class ColumnarReader
+ColumnarReader::ColumnarReader()
+    : _data(MAP_FAILED),
+      _size(0),
+      _rows(0) {
+}
+
+ColumnarReader::~ColumnarReader() {
+  Close();
+}
+
+bool ColumnarReader::Open(const std::string &path) {
+  typedef ColumnarExporter::FileHeader  FileHeader;
+  typedef ColumnarExporter::ChunkHeader ChunkHeader;
+  Close();
+  const int kFd = ::open(path.c_str(), O_RDONLY);
+  if (kFd < 0) {
+    _message = "Failed to open file: " + path;
+    return false;
+  }
+  struct stat st;
+  if (::fstat(kFd, &st) == 0 && (size_t)st.st_size >= sizeof(FileHeader)) {
+    _size = st.st_size;
+    _data = ::mmap(0, _size, PROT_READ, MAP_SHARED, kFd, 0);
+  }
+  ::close(kFd);
+  if (_data == MAP_FAILED) {
+    _message = "Failed to map file: " + path;
+    return false;
+  }
+  const char *base = (const char*)_data;
+  const FileHeader *head = (const FileHeader*)base;
+  if (std::memcmp(head->magic, ColumnarExporter::kMagic, 8) != 0 ||
+      head->version != ColumnarExporter::kVersion ||
+      head->data_offset > _size ||
+      sizeof(FileHeader) + (uint64_t)head->columns
+                           * ColumnarExporter::kNameSize > head->data_offset) {
+    _message = "Invalid format of file: " + path;
+    Close();
+    return false;
+  }
+  for (uint32_t i = 0; i < head->columns; ++i) {
+    const char *name = base + sizeof(FileHeader)
+                     + i * ColumnarExporter::kNameSize;
+    _columns.emplace_back(name, strnlen(name, ColumnarExporter::kNameSize));
+  }
+  uint64_t offset = head->data_offset;
+  for (uint64_t i = 0; i < head->chunks; ++i) {
+    const ChunkHeader *chunk_head = (const ChunkHeader*)(base + offset);
+    if (offset + sizeof(ChunkHeader) > _size ||
+        chunk_head->size > _size - offset) {
+      _message = "File is truncated: " + path;
+      Close();
+      return false;
+    }
+    // columns of the chunk must fit into its size, so pointers of columns
+    // do not go outside of the file and every chunk moves the offset
+    if (chunk_head->size < sizeof(ChunkHeader) ||
+        (head->columns > 0 &&
+         chunk_head->rows > (chunk_head->size - sizeof(ChunkHeader))
+                            / sizeof(double) / head->columns)) {
+      _message = "Invalid format of file: " + path;
+      Close();
+      return false;
+    }
+    Chunk chunk;
+    chunk.rows = chunk_head->rows;
+    const double *column = (const double*)(base + offset + sizeof(ChunkHeader));
+    for (uint32_t c = 0; c < head->columns; ++c, column += chunk.rows) {
+      chunk.columns.push_back(column);
+    }
+    _chunks.push_back(chunk);
+    _rows  += chunk.rows;
+    offset += chunk_head->size;
+  }
+  return true;
+}
+
+void ColumnarReader::Close() {
+  if (_data != MAP_FAILED) {
+    ::munmap(_data, _size);
+  }
+  _data = MAP_FAILED;
+  _size = 0;
+  _rows = 0;
+  _columns.clear();
+  _chunks.clear();
+}
+
+const Exporter::Names& ColumnarReader::GetColumns() const {
+  return _columns;
+}
+
+const ColumnarReader::Chunks& ColumnarReader::GetChunks() const {
+  return _chunks;
+}
+
+uint64_t ColumnarReader::GetRowsAmount() const {
+  return _rows;
+}
+
+const std::string& ColumnarReader::GetMessage() const {
+  return _message;
+}
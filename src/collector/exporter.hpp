@@ -0,0 +1,169 @@
+#ifndef EXPORTER_HPP
+#define EXPORTER_HPP
+
+#include <vector>
+#include <cstdio>
+#include "compressor.hpp"
+
+const size_t kMaxDoubleLen = 32;
+/**
+ * Function for writing the shortest decimal representation of "value",
+ * which is converted back by "strtod" into the same value. Format is
+ * close to "%g": fixed notation for exponents [-5, 17), otherwise
+ * scientific ("1.5e-07").
+ * @param value number that will be written;
+ * @param out   output buffer, it must have at least "kMaxDoubleLen" chars;
+ * @return amount of written chars (without terminating zero).
+ */
+size_t FormatDouble(double value, char *out);
+
+/**
+ * Base class for writing tables of numbers into the file. Rows are
+ * written into the internal buffer, which is flushed when it is full,
+ * so export can work while records are still loading.
+ */
+class Exporter {
+  public:
+    typedef std::shared_ptr<Exporter> ShrPtr;
+    typedef std::vector<std::string>  Names;
+    typedef std::vector<std::vector<double>> Columns;
+
+    Exporter(const std::string &path);
+    virtual ~Exporter();
+    /**
+     * Method for creating the file and writing the header of the table.
+     * @param columns names of columns;
+     * @return false if file was not created.
+     */
+    virtual bool Open(const Names &columns);
+    /**
+     * Method for writing one row of the table.
+     * @param values array with value for every column;
+     * @return false if writing has failed.
+     */
+    virtual bool WriteRow(const double *values) = 0;
+    virtual bool Close();
+    bool IsOpened() const;
+    const std::string& GetMessage() const;
+    /**
+     * Helpers for exporting records of data source (raw samples) and
+     * compressed records (buckets).
+     */
+    static Names GetRecordColumns();
+    static Names GetBucketColumns();
+    bool WriteRecord(const VoidDataSource::Record &rec);
+    bool WriteBucket(const Compressor::Record &rec);
+    bool WriteBuckets(const Compressor::Record::List &records);
+    /**
+     * Method for writing the whole table of analysis results: opening,
+     * writing of rows and closing.
+     * @param names   names of columns;
+     * @param columns values of columns, all columns have the same size;
+     * @return false if writing has failed.
+     */
+    bool WriteTable(const Names &names, const Columns &columns);
+  protected:
+    bool WriteData(const void *data, size_t size);
+    bool Seek(uint64_t offset);
+    size_t GetColumnsAmount() const;
+    void SetMessage(const std::string &msg);
+  private:
+    const std::string _path;
+    std::FILE        *_file;
+    size_t            _columns;
+    std::string       _message;
+};
+
+/**
+ * Exporter into CSV file. Numbers are formatted by "FormatDouble" into
+ * the big buffer, which is written by one call.
+ */
+class CsvExporter : public Exporter {
+  public:
+    CsvExporter(const std::string &path);
+    virtual ~CsvExporter();
+    virtual bool Open(const Names &columns);
+    virtual bool WriteRow(const double *values);
+    virtual bool Close();
+  private:
+    static const size_t kBufferSize = 4 << 20;
+
+    bool Flush();
+
+    std::vector<char> _buffer;
+    size_t            _used;
+};
+
+/**
+ * Exporter into binary columnar file, which can be mapped into memory.
+ * All numbers are stored as native (little endian) "double", all fields
+ * are aligned by 8 bytes:
+ * - header : FileHeader;
+ * - columns: FileHeader::columns * kNameSize bytes, zero padded names;
+ * - chunks : ChunkHeader and "ChunkHeader::rows" values of every column,
+ *            columns are stored one after another.
+ * Fields "rows" and "chunks" of the header are written on closing.
+ */
+class ColumnarExporter : public Exporter {
+  public:
+    static const char     kMagic[8];
+    static const uint32_t kVersion  = 1;
+    static const size_t   kNameSize = 32;
+
+    struct FileHeader {
+      char     magic[8];
+      uint32_t version;
+      uint32_t columns;
+      uint64_t rows;
+      uint64_t chunks;
+      uint64_t data_offset;
+      uint64_t reserved[3];
+    };
+    struct ChunkHeader {
+      uint64_t rows;
+      uint64_t size; // size of the chunk including header
+    };
+
+    ColumnarExporter(const std::string &path, uint32_t chunk_rows = 65536);
+    virtual ~ColumnarExporter();
+    virtual bool Open(const Names &columns);
+    virtual bool WriteRow(const double *values);
+    virtual bool Close();
+  private:
+    bool FlushChunk();
+
+    const uint32_t      _chunk_rows;
+    std::vector<double> _chunk;
+    uint32_t            _rows_in_chunk;
+    FileHeader          _header;
+};
+
+/**
+ * Reader of files, which were written by "ColumnarExporter". File is
+ * mapped into memory, so columns are accessed without copying.
+ */
+class ColumnarReader {
+  public:
+    struct Chunk {
+      uint64_t                   rows;
+      std::vector<const double*> columns;
+    };
+    typedef std::vector<Chunk> Chunks;
+
+    ColumnarReader();
+    ~ColumnarReader();
+    bool Open(const std::string &path);
+    void Close();
+    const Exporter::Names& GetColumns() const;
+    const Chunks& GetChunks() const;
+    uint64_t GetRowsAmount() const;
+    const std::string& GetMessage() const;
+  private:
+    void           *_data;
+    size_t          _size;
+    Exporter::Names _columns;
+    Chunks          _chunks;
+    uint64_t        _rows;
+    std::string     _message;
+};
+#endif
@@ -0,0 +1,69 @@
+#include "fft.hpp"
+#include <cmath>
+
+Fft::Fft(size_t size)
+    : _size(RoundUp(size)),
+      _twiddles(_size / 2),
+      _reversed(_size) {
+  for (size_t i = 0; i < _twiddles.size(); ++i) {
+    const double kAngle = -2.0 * M_PI * i / _size;
+    _twiddles[i] = Complex(std::cos(kAngle), std::sin(kAngle));
+  }
+  size_t bits = 0;
+  while (((size_t)1 << bits) < _size) {
+    ++bits;
+  }
+  for (size_t i = 0; i < _size; ++i) {
+    size_t rev = 0;
+    for (size_t b = 0; b < bits; ++b) {
+      rev |= ((i >> b) & 1) << (bits - 1 - b);
+    }
+    _reversed[i] = rev;
+  }
+}
+
+size_t Fft::GetSize() const {
+  return _size;
+}
+
+bool Fft::IsPowerOfTwo(size_t value) {
+  return value > 0 && (value & (value - 1)) == 0;
+}
+
+size_t Fft::RoundUp(size_t value) {
+  size_t out = 1;
+  while (out < value) {
+    out <<= 1;
+  }
+  return out;
+}
+
+void Fft::Transform(Complex *data, bool inverse) const {
+  for (size_t i = 0; i < _size; ++i) {
+    if (i < _reversed[i]) {
+      std::swap(data[i], data[_reversed[i]]);
+    }
+  }
+  for (size_t len = 2; len <= _size; len <<= 1) {
+    const size_t kHalf   = len / 2;
+    const size_t kStride = _size / len;
+    for (size_t start = 0; start < _size; start += len) {
+      Complex *low  = data + start;
+      Complex *high = low + kHalf;
+      for (size_t k = 0; k < kHalf; ++k) {
+        Complex w = _twiddles[k * kStride];
+        if (inverse) {
+          w = std::conj(w);
+        }
+        // multiplication is written explicitly, because "operator*" of
+        // std::complex checks NaN and infinity
+        const Complex kProduct(
+          high[k].real() * w.real() - high[k].imag() * w.imag(),
+          high[k].real() * w.imag() + high[k].imag() * w.real()
+        );
+        high[k] = low[k] - kProduct;
+        low[k] += kProduct;
+      }
+    }
+  }
+}
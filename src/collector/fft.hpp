@@ -0,0 +1,38 @@
+#ifndef FFT_HPP
+#define FFT_HPP
+
+#include <vector>
+#include <complex>
+
+/**
+ * Iterative radix-2 fast Fourier transform. Twiddle factors and the bit
+ * reversal permutation are calculated once in constructor, so one object
+ * can be used by many threads at the same time ("Transform" is const).
+ */
+class Fft {
+  public:
+    typedef std::complex<double> Complex;
+
+    /**
+     * @param size amount of points, it is rounded up to the power of two.
+     */
+    Fft(size_t size);
+    size_t GetSize() const;
+    /**
+     * Method for transforming "data" in place. Inverse transform is
+     * not normalized (result is multiplied by size).
+     * @param data array with "GetSize()" points;
+     * @param inverse direction of the transform.
+     */
+    void Transform(Complex *data, bool inverse = false) const;
+    static bool IsPowerOfTwo(size_t value);
+    /**
+     * @return the lowest power of two, which is >= "value".
+     */
+    static size_t RoundUp(size_t value);
+  private:
+    size_t               _size;
+    std::vector<Complex> _twiddles;
+    std::vector<size_t>  _reversed;
+};
+#endif
@@ -0,0 +1,34 @@
+#include "parallel.hpp"
+#include "scheduler.hpp"
+#include <atomic>
+#include <algorithm>
+
+size_t GetWorkersAmount(size_t threads) {
+  if (threads == 0) {
+    threads = TaskScheduler::GetShared().GetThreadsAmount();
+  }
+  return std::max<size_t>(threads, 1);
+}
+
+void ParallelFor(size_t amount,
+                 const std::function<void(size_t index, size_t worker)> &task,
+                 size_t threads) {
+  const size_t kWorkers = std::min(GetWorkersAmount(threads),
+                                   std::max<size_t>(amount, 1));
+  std::atomic<size_t> next(0);
+  auto work = [&next, &task, amount](size_t worker) {
+    for (size_t i = next++; i < amount; i = next++) {
+      task(i, worker);
+    }
+  };
+  // workers are tasks of the shared scheduler, so nested loops and
+  // parallel jobs do not create more threads than it has
+  TaskScheduler        &scheduler = TaskScheduler::GetShared();
+  TaskScheduler::Group  group;
+  for (size_t w = 1; w < kWorkers; ++w) {
+    scheduler.Run([&work, w]() { work(w); },
+                  TaskScheduler::GetCurrentPriority(), &group);
+  }
+  work(0);
+  scheduler.Wait(&group);
+}
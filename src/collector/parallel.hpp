@@ -0,0 +1,31 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <functional>
+#include <cstddef>
+
+/**
+ * Function for getting amount of worker threads.
+ * @param threads wanted amount, 0 means amount of threads of the shared
+ *                scheduler (please look at "scheduler.hpp");
+ * @return amount of threads, it is always > 0.
+ */
+size_t GetWorkersAmount(size_t threads = 0);
+
+/**
+ * Function for calling "task(index, worker)" for every index in
+ * [0, amount) in parallel. Tasks are taken by workers one by one, so
+ * long and short tasks are balanced. "worker" is the index of the thread
+ * in [0, GetWorkersAmount(threads)), it allows to use per-thread
+ * accumulators without locking. The calling thread is the worker #0,
+ * others are tasks of the shared scheduler with priority of the calling
+ * task, so "threads" limits parallelism, but does not create threads.
+ * @param amount  amount of tasks;
+ * @param task    function of the task;
+ * @param threads amount of workers, 0 means amount of threads of the
+ *                shared scheduler.
+ */
+void ParallelFor(size_t amount,
+                 const std::function<void(size_t index, size_t worker)> &task,
+                 size_t threads = 0);
+#endif
@@ -0,0 +1,166 @@
+#include "pipeline.hpp"
+#include <chrono>
+#include <thread>
+
+typedef std::chrono::steady_clock Clock;
+
+static
+double GetSeconds(const Clock::time_point &from, const Clock::time_point &to) {
+  return std::chrono::duration<double>(to - from).count();
+}
+// class RingWaiter
+void RingWaiter::Notify() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (_sleepers.load(std::memory_order_relaxed) > 0) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _changed.notify_all();
+  }
+}
+// class LoadingPipeline::StageStatistics
+LoadingPipeline::StageStatistics::StageStatistics()
+    : busy(0),
+      wait(0) {
+}
+
+double LoadingPipeline::StageStatistics::GetUtilization() const {
+  const double kTotal = busy + wait;
+  return kTotal > 0 ? busy / kTotal : 0;
+}
+// class LoadingPipeline::LinesBatch
+LoadingPipeline::LinesBatch::LinesBatch(uint32_t size)
+    : text(size * VoidDataSource::kLineSize),
+      lengths(size),
+      amount(0),
+      last(false) {
+}
+// class LoadingPipeline::RecordsBatch
+LoadingPipeline::RecordsBatch::RecordsBatch(uint32_t size)
+    : recs(size),
+      lines(size),
+      amount(0),
+      last(false) {
+}
+// class LoadingPipeline
+LoadingPipeline::LoadingPipeline(uint32_t batch_size, uint32_t depth)
+    : _batch_size(batch_size > 0 ? batch_size : 1),
+      _depth(depth > 0 ? depth : 1),
+      _lines_pool(_depth, LinesBatch(_batch_size)),
+      _records_pool(_depth, RecordsBatch(_batch_size)),
+      _lines_full(_depth),
+      _lines_free(_depth),
+      _records_full(_depth),
+      _records_free(_depth),
+      _cancel(false),
+      _stop_reading(false) {
+}
+
+void LoadingPipeline::ReadLines(VoidDataSource *src) {
+  const auto kStart = Clock::now();
+  double *wait = &_stat.reader.wait;
+  bool    last = false;
+  while (not last) {
+    LinesBatch *batch = 0;
+    if (not _waiter.Pop(&_lines_free, &batch, _stop_reading, wait)) {
+      break;
+    }
+    char *line = batch->text.data();
+    for (batch->amount = 0; batch->amount < _batch_size && not last;
+         ++batch->amount) {
+      const auto kLen = src->ReadLine(line);
+      batch->lengths[batch->amount] = kLen;
+      line += VoidDataSource::kLineSize;
+      last  = kLen < 0;
+    }
+    batch->last = last;
+    if (not _waiter.Push(&_lines_full, batch, _stop_reading, wait)) {
+      break;
+    }
+  }
+  _stat.reader.busy = GetSeconds(kStart, Clock::now()) - _stat.reader.wait;
+}
+
+void LoadingPipeline::ParseLines(VoidDataSource *src) {
+  const auto kStart = Clock::now();
+  double *wait = &_stat.parser.wait;
+  bool    last = false;
+  while (not last) {
+    LinesBatch   *lines = 0;
+    RecordsBatch *recs  = 0;
+    if (not _waiter.Pop(&_lines_full, &lines, _cancel, wait) ||
+        not _waiter.Pop(&_records_free, &recs, _cancel, wait)) {
+      break;
+    }
+    const char *line = lines->text.data();
+    recs->amount = 0;
+    for (uint32_t i = 0; i < lines->amount; ++i) {
+      if (src->ParseLine(line, lines->lengths[i], &recs->recs[recs->amount])) {
+        recs->lines[recs->amount++] = src->GetLineNumber();
+      }
+      if (src->IsAtTheEnd()) {
+        // end of the time window, following lines are not needed
+        _stop_reading = true;
+        _waiter.Notify();
+        break;
+      }
+      line += VoidDataSource::kLineSize;
+    }
+    last       = lines->last || src->IsAtTheEnd();
+    recs->last = last;
+    _lines_free.TryPush(lines);
+    _waiter.Notify();
+    if (not _waiter.Push(&_records_full, recs, _cancel, wait)) {
+      break;
+    }
+  }
+  _stat.parser.busy = GetSeconds(kStart, Clock::now()) - _stat.parser.wait;
+}
+
+bool LoadingPipeline::Run(VoidDataSource *src, const Consumer &consume) {
+  const auto kStart = Clock::now();
+  LinesBatch   *t_lines = 0;
+  RecordsBatch *t_recs  = 0;
+  // batches of the previous run are returned into pools
+  while (_lines_full.TryPop(&t_lines) || _lines_free.TryPop(&t_lines)) {
+  }
+  while (_records_full.TryPop(&t_recs) || _records_free.TryPop(&t_recs)) {
+  }
+  for (uint32_t i = 0; i < _depth; ++i) {
+    _lines_free.TryPush(&_lines_pool[i]);
+    _records_free.TryPush(&_records_pool[i]);
+  }
+  _stat         = Statistics();
+  _cancel       = false;
+  _stop_reading = false;
+  src->SetIndexing(false);
+  std::thread reader(&LoadingPipeline::ReadLines, this, src);
+  std::thread parser(&LoadingPipeline::ParseLines, this, src);
+  bool consume_ok = true;
+  bool last       = false;
+  while (not last && consume_ok) {
+    RecordsBatch *batch = 0;
+    if (not _waiter.Pop(&_records_full, &batch, _cancel,
+                        &_stat.consumer.wait)) {
+      break;
+    }
+    consume_ok = consume(batch->recs.data(), batch->lines.data(),
+                         batch->amount);
+    last = batch->last;
+    _records_free.TryPush(batch);
+    _waiter.Notify();
+  }
+  if (not consume_ok) {
+    _cancel       = true;
+    _stop_reading = true;
+    _waiter.Notify();
+  }
+  reader.join();
+  parser.join();
+  src->SetIndexing(true);
+  _stat.consumer.busy = GetSeconds(kStart, Clock::now())
+                      - _stat.consumer.wait;
+  return consume_ok;
+}
+
+const LoadingPipeline::Statistics& LoadingPipeline::GetStatistics() const {
+  return _stat;
+}
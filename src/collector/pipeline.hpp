@@ -0,0 +1,254 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include <atomic>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include "data_source.hpp"
+
+/**
+ * Lock-free ring buffer for one producer thread and one consumer thread.
+ * Capacity is rounded up to the power of two. Positions of the producer
+ * and the consumer are kept in different cache lines.
+ */
+template <class T>
+class SpscRing {
+  public:
+    SpscRing(size_t capacity)
+        : _mask(RoundCapacity(capacity) - 1),
+          _items(_mask + 1),
+          _head(0),
+          _tail(0) {
+    }
+    /**
+     * Method is called by the producer only.
+     * @return false if the ring is full.
+     */
+    bool TryPush(const T &item) {
+      const size_t kTail = _tail.load(std::memory_order_relaxed);
+      if (kTail - _head.load(std::memory_order_acquire) > _mask) {
+        return false;
+      }
+      _items[kTail & _mask] = item;
+      _tail.store(kTail + 1, std::memory_order_release);
+      return true;
+    }
+    /**
+     * Method is called by the consumer only.
+     * @return false if the ring is empty.
+     */
+    bool TryPop(T *out) {
+      const size_t kHead = _head.load(std::memory_order_relaxed);
+      if (kHead == _tail.load(std::memory_order_acquire)) {
+        return false;
+      }
+      *out = _items[kHead & _mask];
+      _head.store(kHead + 1, std::memory_order_release);
+      return true;
+    }
+    size_t GetCapacity() const {
+      return _mask + 1;
+    }
+  private:
+    static const size_t kCacheLine = 64;
+
+    static size_t RoundCapacity(size_t capacity) {
+      size_t out = 1;
+      while (out < capacity) {
+        out <<= 1;
+      }
+      return out;
+    }
+
+    const size_t        _mask;
+    std::vector<T>      _items;
+    char                _pad_0[kCacheLine];
+    std::atomic<size_t> _head;
+    char                _pad_1[kCacheLine];
+    std::atomic<size_t> _tail;
+    char                _pad_2[kCacheLine];
+};
+
+/**
+ * Waiting of "SpscRing" by threads, which exchange items through several
+ * rings. Waiting thread spins shortly and then sleeps until another
+ * thread changes one of rings, so stalled threads do not occupy CPU.
+ */
+class RingWaiter {
+  public:
+    RingWaiter()
+        : _sleepers(0) {
+    }
+    /**
+     * Methods for waiting of the ring, they fail after "stop" is set.
+     * @param wait time of waiting is added to it (seconds), it can be null.
+     */
+    template <class T>
+    bool Push(SpscRing<T> *ring, const T &item,
+              const std::atomic<bool> &stop, double *wait = 0) {
+      if (ring->TryPush(item)) {
+        Notify();
+        return true;
+      }
+      return Wait([ring, &item]() { return ring->TryPush(item); }, stop,
+                  wait);
+    }
+    template <class T>
+    bool Pop(SpscRing<T> *ring, T *out,
+             const std::atomic<bool> &stop, double *wait = 0) {
+      if (ring->TryPop(out)) {
+        Notify();
+        return true;
+      }
+      return Wait([ring, out]() { return ring->TryPop(out); }, stop, wait);
+    }
+    /**
+     * Method for waking sleeping threads, it must be called after changes
+     * of rings and flags of stopping, which are done without "Push" and
+     * "Pop".
+     */
+    void Notify();
+  private:
+    // attempts before sleeping, short stalls are not worth system calls
+    static const uint32_t kSpins   = 64;
+    // the longest sleep, it limits delay of missed notification
+    static const uint32_t kSleepMs = 10;
+
+    /**
+     * Method for waiting until "attempt" succeeds or "stop" is set.
+     * @param attempt functor: bool ();
+     * @return result of the last attempt.
+     */
+    template <class Attempt>
+    bool Wait(const Attempt &attempt, const std::atomic<bool> &stop,
+              double *wait);
+
+    std::mutex              _mutex;
+    std::condition_variable _changed;
+    std::atomic<uint32_t>   _sleepers; // amount of sleeping threads
+};
+
+template <class Attempt>
+bool RingWaiter::Wait(const Attempt &attempt, const std::atomic<bool> &stop,
+                      double *wait) {
+  const auto kStart = std::chrono::steady_clock::now();
+  bool done = false;
+  for (uint32_t spin = 0; spin < kSpins && not done &&
+                          not stop.load(std::memory_order_relaxed); ++spin) {
+    std::this_thread::yield();
+    done = attempt();
+  }
+  while (not done && not stop.load(std::memory_order_relaxed)) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _sleepers.fetch_add(1);
+    // pairs with the fence of "Notify": either the change is seen here,
+    // or this thread is counted there and woken
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    done = attempt();
+    if (not done && not stop.load(std::memory_order_relaxed)) {
+      _changed.wait_for(lock, std::chrono::milliseconds(kSleepMs));
+      done = attempt();
+    }
+    _sleepers.fetch_sub(1);
+  }
+  if (wait != 0) {
+    *wait += std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                           - kStart).count();
+  }
+  if (done) {
+    Notify();
+  }
+  return done;
+}
+
+/**
+ * Pipelined loading of records, every stage works in its own thread:
+ * - reader  : reads lines of the source ("VoidDataSource::ReadLine");
+ * - parser  : parses lines into records ("VoidDataSource::ParseLine");
+ * - consumer: passes records to the consumer function, it works in the
+ *             thread, which has called "Run".
+ * Stages exchange batches through "SpscRing", empty batches are returned
+ * back by another ring, so memory is allocated only once. When the next
+ * stage is slow, rings become full and the previous stage waits
+ * (backpressure). Waiting stage spins shortly and then sleeps until the
+ * ring is changed by another stage, so stalled stages do not occupy CPU.
+ * Order of records is preserved.
+ */
+class LoadingPipeline {
+  public:
+    typedef std::shared_ptr<LoadingPipeline> ShrPtr;
+    /**
+     * Function for consuming the batch of parsed records.
+     * @param recs   records;
+     * @param lines  line numbers of records;
+     * @param amount amount of records;
+     * @return false for stopping of loading.
+     */
+    typedef std::function<bool(const VoidDataSource::Record *recs,
+                               const uint32_t *lines,
+                               size_t amount)> Consumer;
+    /**
+     * Time, which was spent by the stage: "busy" - processing,
+     * "wait" - waiting for the previous or the next stage (seconds).
+     */
+    struct StageStatistics {
+      StageStatistics();
+      double GetUtilization() const;
+
+      double busy;
+      double wait;
+    };
+    struct Statistics {
+      StageStatistics reader;
+      StageStatistics parser;
+      StageStatistics consumer;
+    };
+
+    LoadingPipeline(uint32_t batch_size = 4096, uint32_t depth = 8);
+    /**
+     * Method for loading of all records of occupied source. Indexing of
+     * the source is disabled during loading.
+     * @return false if loading was stopped by the consumer.
+     */
+    bool Run(VoidDataSource *src, const Consumer &consume);
+    const Statistics& GetStatistics() const;
+  private:
+    struct LinesBatch {
+      LinesBatch(uint32_t size);
+
+      std::vector<char>    text;
+      std::vector<int16_t> lengths;
+      uint32_t             amount;
+      bool                 last;
+    };
+    struct RecordsBatch {
+      RecordsBatch(uint32_t size);
+
+      std::vector<VoidDataSource::Record> recs;
+      std::vector<uint32_t>               lines;
+      uint32_t                            amount;
+      bool                                last;
+    };
+    typedef SpscRing<LinesBatch*>   LinesRing;
+    typedef SpscRing<RecordsBatch*> RecordsRing;
+
+    void ReadLines(VoidDataSource *src);
+    void ParseLines(VoidDataSource *src);
+    const uint32_t            _batch_size;
+    const uint32_t            _depth;
+    std::vector<LinesBatch>   _lines_pool;
+    std::vector<RecordsBatch> _records_pool;
+    LinesRing                 _lines_full;
+    LinesRing                 _lines_free;
+    RecordsRing               _records_full;
+    RecordsRing               _records_free;
+    std::atomic<bool>         _cancel;       // consumer has failed
+    std::atomic<bool>         _stop_reading; // parser does not need lines
+    RingWaiter                _waiter;
+    Statistics                _stat;
+};
+#endif
@@ -0,0 +1,227 @@
+#include "psd.hpp"
+#include "parallel.hpp"
+#include <cmath>
+#include <algorithm>
+#include <boost/lexical_cast.hpp>
+
+// class WelchPsd::Settings
+WelchPsd::Settings::Settings()
+    : segment_length(4096),
+      overlap(0.5),
+      window(kHann),
+      sample_rate(std::nan("")),
+      nominal(std::nan("")),
+      batch_segments(64),
+      threads(0) {
+}
+// class WelchPsd
+WelchPsd::WelchPsd(const Settings &settings)
+    : _settings(settings),
+      _window_power(0),
+      _sample_rate(std::nan("")),
+      _segments(0) {
+}
+
+bool WelchPsd::ParseWindow(const std::string &name, Window *out) {
+  if (name == "rect") {
+    *out = kRectangular;
+  } else if (name == "hann") {
+    *out = kHann;
+  } else if (name == "hamming") {
+    *out = kHamming;
+  } else if (name == "blackman") {
+    *out = kBlackman;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void WelchPsd::FillWindow(size_t length) {
+  _window.resize(length);
+  _window_power = 0;
+  for (size_t i = 0; i < length; ++i) {
+    // periodic windows are used, they are better for spectral analysis
+    const double kPhase = 2.0 * M_PI * i / length;
+    switch (_settings.window) {
+      case kRectangular:
+        _window[i] = 1.0;
+        break;
+      case kHann:
+        _window[i] = 0.5 - 0.5 * std::cos(kPhase);
+        break;
+      case kHamming:
+        _window[i] = 0.54 - 0.46 * std::cos(kPhase);
+        break;
+      case kBlackman:
+        _window[i] = 0.42 - 0.5 * std::cos(kPhase)
+                   + 0.08 * std::cos(2 * kPhase);
+        break;
+    }
+    _window_power += _window[i] * _window[i];
+  }
+}
+
+bool WelchPsd::CalculateSampleRate(SampleStore *store) {
+  _sample_rate = _settings.sample_rate;
+  if (not std::isnan(_sample_rate)) {
+    return _sample_rate > 0;
+  }
+  SampleStore::Record first;
+  SampleStore::Record last;
+  const uint64_t kSize = store->GetSize();
+  if (store->ReadRecords(0, &first, 1) != 1 ||
+      store->ReadRecords(kSize - 1, &last, 1) != 1) {
+    return false;
+  }
+  _sample_rate = (kSize - 1) / (last.time - first.time);
+  return std::isfinite(_sample_rate) && _sample_rate > 0;
+}
+
+static
+double GetMean(const double *values, size_t length) {
+  double sum = 0;
+  for (size_t i = 0; i < length; ++i) {
+    sum += values[i];
+  }
+  return sum / length;
+}
+
+void WelchPsd::AccumulatePair(const Fft &fft, const double *first,
+                              const double *second, Fft::Complex *work,
+                              Spectrum *acc) const {
+  const size_t kLength = fft.GetSize();
+  const double kMeanFirst  = GetMean(first, kLength);
+  const double kMeanSecond = second ? GetMean(second, kLength) : 0;
+  for (size_t i = 0; i < kLength; ++i) {
+    work[i] = Fft::Complex(
+      (first[i] - kMeanFirst) * _window[i],
+      second ? (second[i] - kMeanSecond) * _window[i] : 0.0
+    );
+  }
+  fft.Transform(work);
+  // spectra of real signals a and b are separated from z = a + i*b:
+  // A[k] = (Z[k] + conj(Z[n-k])) / 2, B[k] = (Z[k] - conj(Z[n-k])) / 2i,
+  // so |A|^2 + |B|^2 = (|Z[k]|^2 + |Z[n-k]|^2) / 2
+  double *out = acc->data();
+  for (size_t k = 0; k <= kLength / 2; ++k) {
+    const Fft::Complex &direct = work[k];
+    const Fft::Complex &mirror = work[(kLength - k) & (kLength - 1)];
+    out[k] += 0.5 * (std::norm(direct) + std::norm(mirror));
+  }
+}
+
+bool WelchPsd::Calculate(SampleStore *store) {
+  _frequencies.clear();
+  _density.clear();
+  _segments = 0;
+  const Fft      kFft(_settings.segment_length);
+  const size_t   kLength = kFft.GetSize();
+  const uint64_t kSize   = store->GetSize();
+  if (not (_settings.overlap >= 0 && _settings.overlap < 1)) {
+    SetMessage("Overlap of segments must be in [0, 1)");
+    return false;
+  }
+  if (kSize < kLength || kLength < 2) {
+    SetMessage("Not enough records for spectrum: "
+      + boost::lexical_cast<std::string>(kSize) + " < "
+      + boost::lexical_cast<std::string>(kLength)
+    );
+    return false;
+  }
+  if (not CalculateSampleRate(store)) {
+    SetMessage("Failed to calculate sample rate");
+    return false;
+  }
+  FillWindow(kLength);
+  const size_t kStep = std::max<size_t>(1,
+    kLength - (size_t)std::llround(_settings.overlap * kLength)
+  );
+  _segments = (kSize - kLength) / kStep + 1;
+  const size_t kBatch   = std::max<uint32_t>(_settings.batch_segments, 2);
+  const size_t kWorkers = GetWorkersAmount(_settings.threads);
+  const size_t kBins    = kLength / 2 + 1;
+  std::vector<Spectrum> accs(kWorkers, Spectrum(kBins, 0.0));
+  std::vector<std::vector<Fft::Complex>> works(kWorkers,
+    std::vector<Fft::Complex>(kLength)
+  );
+  std::vector<SampleStore::Record> recs((kBatch - 1) * kStep + kLength);
+  std::vector<double>              values(recs.size());
+  const bool   kFractional = not std::isnan(_settings.nominal);
+  const double kNominal    = _settings.nominal;
+  for (uint64_t seg = 0; seg < _segments; seg += kBatch) {
+    const size_t   kAmount = std::min<uint64_t>(kBatch, _segments - seg);
+    const size_t   kRead   = (kAmount - 1) * kStep + kLength;
+    const uint64_t kFirst  = seg * kStep;
+    if (store->ReadRecords(kFirst, recs.data(), kRead) != kRead) {
+      SetMessage("Failed to read records: " + store->GetMessage());
+      return false;
+    }
+    for (size_t i = 0; i < kRead; ++i) {
+      values[i] = kFractional ? (recs[i].value - kNominal) / kNominal
+                              : recs[i].value;
+    }
+    ParallelFor((kAmount + 1) / 2, [&](size_t pair, size_t worker) {
+      const size_t kSeg = pair * 2;
+      const double *first  = values.data() + kSeg * kStep;
+      const double *second = kSeg + 1 < kAmount ? first + kStep : 0;
+      AccumulatePair(kFft, first, second, works[worker].data(),
+                     &accs[worker]);
+    }, kWorkers);
+  }
+  // reduction of per-thread accumulators
+  _density.assign(kBins, 0.0);
+  for (const auto &acc : accs) {
+    for (size_t k = 0; k < kBins; ++k) {
+      _density[k] += acc[k];
+    }
+  }
+  const double kScale = 1.0 / (_segments * _sample_rate * _window_power);
+  _frequencies.resize(kBins);
+  for (size_t k = 0; k < kBins; ++k) {
+    // power of negative frequencies is added to positive ones
+    const bool kEdge = k == 0 || k == kLength / 2;
+    _density[k]    *= kScale * (kEdge ? 1.0 : 2.0);
+    _frequencies[k] = k * _sample_rate / kLength;
+  }
+  return true;
+}
+
+const std::vector<double>& WelchPsd::GetFrequencies() const {
+  return _frequencies;
+}
+
+const std::vector<double>& WelchPsd::GetDensity() const {
+  return _density;
+}
+
+std::vector<double> WelchPsd::GetPhaseNoise() const {
+  std::vector<double> out;
+  if (std::isnan(_settings.nominal)) {
+    return out;
+  }
+  out.resize(_density.size());
+  for (size_t k = 0; k < _density.size(); ++k) {
+    const double kRatio = _settings.nominal / _frequencies[k];
+    out[k] = _frequencies[k] > 0
+           ? 10.0 * std::log10(0.5 * kRatio * kRatio * _density[k])
+           : std::nan("");
+  }
+  return out;
+}
+
+uint64_t WelchPsd::GetSegmentsAmount() const {
+  return _segments;
+}
+
+double WelchPsd::GetSampleRate() const {
+  return _sample_rate;
+}
+
+const std::string& WelchPsd::GetMessage() const {
+  return _message;
+}
+
+void WelchPsd::SetMessage(const std::string &msg) {
+  _message = msg;
+}
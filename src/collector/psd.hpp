@@ -0,0 +1,94 @@
+#ifndef PSD_HPP
+#define PSD_HPP
+
+#include <vector>
+#include "fft.hpp"
+#include "sample_store.hpp"
+
+/**
+ * Estimation of one-sided power spectral density by Welch method: records
+ * are split into overlapped segments, every segment is multiplied by the
+ * window and transformed by FFT, squared magnitudes are averaged.
+ * Records are read from the storage by batches of segments, so memory
+ * does not depend on amount of records. Segments of the batch are
+ * processed by several threads, every thread accumulates spectra into its
+ * own buffer, buffers are summed after all batches. Two real segments are
+ * transformed by one complex FFT.
+ */
+class WelchPsd {
+  public:
+    enum Window {
+      kRectangular,
+      kHann,
+      kHamming,
+      kBlackman
+    };
+    struct Settings {
+      Settings();
+
+      uint32_t segment_length; // it is rounded up to the power of two
+      double   overlap;        // part of segment length, [0, 1)
+      Window   window;
+      double   sample_rate;    // Hz, NaN - calculated from time labels
+      double   nominal;        // Hz, values are converted into fractional
+                               // frequency if it is not NaN
+      uint32_t batch_segments; // amount of segments read at once
+      size_t   threads;        // 0 - amount of hardware threads
+    };
+
+    WelchPsd(const Settings &settings = Settings());
+    /**
+     * Method for calculating spectrum of all records of the storage.
+     * Mean value of every segment is removed before windowing.
+     * @return false if there are not enough records or settings are
+     *         invalid.
+     */
+    bool Calculate(SampleStore *store);
+    /**
+     * @return frequencies of spectrum bins [0, sample_rate / 2], Hz.
+     */
+    const std::vector<double>& GetFrequencies() const;
+    /**
+     * @return density of bins: units^2 / Hz (1 / Hz for fractional
+     *         frequency).
+     */
+    const std::vector<double>& GetDensity() const;
+    /**
+     * Method for getting single sideband phase noise:
+     * L(f) = 10 * log10(S_phi(f) / 2), S_phi(f) = (nominal / f)^2 * S_y(f).
+     * @return values in dBc/Hz (NaN for zero frequency) or empty vector if
+     *         nominal frequency is not set.
+     */
+    std::vector<double> GetPhaseNoise() const;
+    uint64_t GetSegmentsAmount() const;
+    double GetSampleRate() const;
+    const std::string& GetMessage() const;
+    /**
+     * @param name one of: rect, hann, hamming, blackman;
+     * @return false if name is unknown.
+     */
+    static bool ParseWindow(const std::string &name, Window *out);
+  private:
+    typedef std::vector<double> Spectrum;
+
+    void FillWindow(size_t length);
+    bool CalculateSampleRate(SampleStore *store);
+    /**
+     * Method for adding squared spectra of segments "first" and "second"
+     * (it may be null) into "acc".
+     */
+    void AccumulatePair(const Fft &fft, const double *first,
+                        const double *second, Fft::Complex *work,
+                        Spectrum *acc) const;
+    void SetMessage(const std::string &msg);
+
+    Settings            _settings;
+    std::vector<double> _window;
+    double              _window_power;
+    double              _sample_rate;
+    uint64_t            _segments;
+    std::vector<double> _frequencies;
+    std::vector<double> _density;
+    std::string         _message;
+};
+#endif
@@ -0,0 +1,136 @@
+#include "quantile_sketch.hpp"
+#include <cmath>
+#include <algorithm>
+
+// class QuantileSketch
+QuantileSketch::QuantileSketch()
+    : _base(0),
+      _size(0) {
+}
+
+bool QuantileSketch::IsEmpty() const {
+  return _size == 0;
+}
+
+uint32_t QuantileSketch::GetWeight() const {
+  uint32_t weight = 0;
+  for (uint8_t i = 0; i < _size; ++i) {
+    weight += _weights[i];
+  }
+  return weight;
+}
+
+uint8_t QuantileSketch::GetCentroidsAmount() const {
+  return _size;
+}
+
+void QuantileSketch::Add(double value) {
+  QuantileSketch single;
+  single._base       = value;
+  single._means[0]   = 0;
+  single._weights[0] = 1;
+  single._size       = 1;
+  MergeWith(single);
+}
+
+void QuantileSketch::MergeWith(const QuantileSketch &src) {
+  if (src._size == 0) {
+    return;
+  }
+  if (_size == 0) {
+    *this = src;
+    return;
+  }
+  // centroids of both sketches are merged by means, relative to own base
+  double   means[kCentroids * 2];
+  uint32_t weights[kCentroids * 2];
+  const double kSrcOffset = src._base - _base;
+  size_t size = 0;
+  uint8_t i = 0;
+  uint8_t j = 0;
+  while (i < _size || j < src._size) {
+    const double kOwn   = i < _size ? _means[i] : INFINITY;
+    const double kOther = j < src._size ? src._means[j] + kSrcOffset
+                                        : INFINITY;
+    if (kOwn <= kOther) {
+      means[size]   = kOwn;
+      weights[size] = _weights[i++];
+    } else {
+      means[size]   = kOther;
+      weights[size] = src._weights[j++];
+    }
+    ++size;
+  }
+  _size = Compress(means, weights, size);
+  for (i = 0; i < _size; ++i) {
+    _means[i]   = means[i];
+    _weights[i] = weights[i];
+  }
+}
+
+void QuantileSketch::Shift(double delta) {
+  // means are offsets from the base, so they are not changed
+  _base += delta;
+}
+
+size_t QuantileSketch::Compress(double *means, uint32_t *weights,
+                                size_t size) {
+  while (size > kCentroids) {
+    size_t best      = 0;
+    double best_cost = INFINITY;
+    for (size_t i = 0; i + 1 < size; ++i) {
+      // increase of variance after merging of two centroids
+      const double kGap  = means[i + 1] - means[i];
+      const double kCost = (double)weights[i] * weights[i + 1]
+                         / ((double)weights[i] + weights[i + 1])
+                         * kGap * kGap;
+      if (kCost < best_cost) {
+        best_cost = kCost;
+        best      = i;
+      }
+    }
+    const double kWeight = (double)weights[best] + weights[best + 1];
+    means[best] = (means[best] * weights[best]
+                 + means[best + 1] * weights[best + 1]) / kWeight;
+    weights[best] += weights[best + 1];
+    for (size_t i = best + 1; i + 1 < size; ++i) {
+      means[i]   = means[i + 1];
+      weights[i] = weights[i + 1];
+    }
+    --size;
+  }
+  return size;
+}
+
+double QuantileSketch::GetQuantile(double q, double min, double max) const {
+  if (_size == 0) {
+    return std::nan("");
+  }
+  if (std::isnan(max)) {
+    max = min;
+  }
+  const double kTotal  = GetWeight();
+  const double kTarget = std::min(std::max(q, 0.0), 1.0) * kTotal;
+  // every centroid is placed at the middle of its weight
+  double prev_pos   = 0;
+  double prev_value = min - _base;
+  double pos        = _weights[0] / 2.0;
+  double result     = NAN;
+  for (uint8_t i = 0; i <= _size; ++i) {
+    const double kValue = i < _size ? _means[i] : max - _base;
+    if (kTarget <= pos) {
+      const double kRatio = pos > prev_pos
+                          ? (kTarget - prev_pos) / (pos - prev_pos) : 0;
+      result = prev_value + (kValue - prev_value) * kRatio;
+      break;
+    }
+    prev_pos   = pos;
+    prev_value = kValue;
+    pos = i + 1 < _size ? pos + (_weights[i] + _weights[i + 1]) / 2.0
+                        : kTotal;
+  }
+  if (std::isnan(result)) {
+    result = max - _base;
+  }
+  return std::min(std::max(_base + result, min), max);
+}
@@ -0,0 +1,59 @@
+#ifndef QUANTILE_SKETCH_HPP
+#define QUANTILE_SKETCH_HPP
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Compact mergeable sketch of values distribution (simplified t-digest).
+ * It keeps a fixed amount of centroids (mean value and weight), which are
+ * sorted by means. When there are too many centroids, neighbours, which
+ * give the lowest increase of variance, are merged. So dense parts of
+ * distribution are merged first and outliers at tails are kept apart.
+ * Means are stored as float offsets from the first added value, because
+ * measured values usually have big nominal (10 MHz) and small deviations.
+ * The size of sketch is fixed and it does not allocate memory.
+ */
+class QuantileSketch {
+  public:
+    static const uint8_t kCentroids = 16;
+
+    QuantileSketch();
+    bool IsEmpty() const;
+    /**
+     * @return amount of added values.
+     */
+    uint32_t GetWeight() const;
+    uint8_t GetCentroidsAmount() const;
+    void Add(double value);
+    /**
+     * Method for merging distribution of "src" into current sketch.
+     */
+    void MergeWith(const QuantileSketch &src);
+    /**
+     * Method for shifting all added values by "delta".
+     */
+    void Shift(double delta);
+    /**
+     * Method for estimating value of quantile. Values between centroids
+     * are interpolated linearly, "min" and "max" are used for the tails.
+     * @param q   level of quantile [0, 1];
+     * @param min minimal added value;
+     * @param max maximal added value;
+     * @return estimated value or NaN if sketch is empty.
+     */
+    double GetQuantile(double q, double min, double max) const;
+  private:
+    /**
+     * Method for merging neighbour centroids, until their amount is
+     * greater than "kCentroids".
+     * @return amount of centroids after merging.
+     */
+    static size_t Compress(double *means, uint32_t *weights, size_t size);
+
+    double   _base;
+    float    _means[kCentroids];
+    uint32_t _weights[kCentroids];
+    uint8_t  _size;
+};
+#endif
@@ -0,0 +1,212 @@
+#include "sample_store.hpp"
+#include <algorithm>
+#include <unistd.h>
+
+// class SampleStore
+SampleStore::SampleStore() {
+}
+
+SampleStore::~SampleStore() {
+}
+
+uint64_t SampleStore::FindRecord(double time) {
+  uint64_t low  = 0;
+  uint64_t high = GetSize();
+  Record   rec;
+  while (low < high) {
+    const uint64_t kMiddle = low + (high - low) / 2;
+    if (ReadRecords(kMiddle, &rec, 1) != 1) {
+      return GetSize();
+    }
+    if (rec.time < time) {
+      low = kMiddle + 1;
+    } else {
+      high = kMiddle;
+    }
+  }
+  return low;
+}
+
+bool SampleStore::FillCompressor(double from, double to, Compressor *out) {
+  const size_t kBlockSize = 4096;
+  std::vector<Record> block(kBlockSize);
+  uint64_t pos = FindRecord(from);
+  while (true) {
+    const size_t kRead = ReadRecords(pos, block.data(), kBlockSize);
+    for (size_t i = 0; i < kRead; ++i) {
+      if (block[i].time > to) {
+        return true;
+      }
+      if (not out->PushRecord(block[i])) {
+        SetMessage(out->GetMessage());
+        return false;
+      }
+    }
+    if (kRead < kBlockSize) {
+      return true;
+    }
+    pos += kRead;
+  }
+}
+
+const std::string& SampleStore::GetMessage() const {
+  return _message;
+}
+
+void SampleStore::SetMessage(const std::string &msg) {
+  _message = msg;
+}
+// class SpillSampleStore::Chunk
+SpillSampleStore::Chunk::Chunk()
+    : on_disk(false) {
+}
+// class SpillSampleStore
+SpillSampleStore::SpillSampleStore(size_t mem_limit, uint32_t chunk_records)
+    : SampleStore(),
+      _chunk_records(chunk_records > 0 ? chunk_records : 1),
+      // chunk, which is filled, and chunk, which is read, must fit
+      _max_resident(std::max<size_t>(2,
+        mem_limit / (2 * sizeof(double) * _chunk_records))),
+      _size(0),
+      _spilled_bytes(0),
+      _spill_file(0) {
+}
+
+SpillSampleStore::~SpillSampleStore() {
+  if (_spill_file != 0) {
+    std::fclose(_spill_file);
+  }
+}
+
+bool SpillSampleStore::GetFreeBuffer(Buffer *out) {
+  if (_lru.size() < _max_resident) {
+    out->reset(new double[2 * _chunk_records]);
+    return true;
+  }
+  const size_t kChunkBytes = 2 * sizeof(double) * _chunk_records;
+  auto victim_it = std::prev(_lru.end());
+  // chunk, which is not filled yet, is never written
+  if (*victim_it == _chunks.size() - 1 && _size % _chunk_records != 0) {
+    --victim_it;
+  }
+  Chunk &victim = _chunks[*victim_it];
+  if (not victim.on_disk) {
+    if (_spill_file == 0) {
+      _spill_file = std::tmpfile();
+      if (_spill_file == 0) {
+        SetMessage("Failed to create temporary file for records");
+        return false;
+      }
+    }
+    const char *data   = (const char*)victim.data.get();
+    off_t       offset = (off_t)*victim_it * kChunkBytes;
+    size_t      left   = kChunkBytes;
+    while (left > 0) {
+      const auto kWritten = ::pwrite(fileno(_spill_file), data, left, offset);
+      if (kWritten <= 0) {
+        SetMessage("Failed to write records into temporary file");
+        return false;
+      }
+      data   += kWritten;
+      offset += kWritten;
+      left   -= kWritten;
+    }
+    victim.on_disk  = true;
+    _spilled_bytes += kChunkBytes;
+  }
+  *out = std::move(victim.data);
+  _lru.erase(victim_it);
+  return true;
+}
+
+bool SpillSampleStore::LoadChunk(size_t index) {
+  const size_t kChunkBytes = 2 * sizeof(double) * _chunk_records;
+  Buffer buffer;
+  if (not GetFreeBuffer(&buffer)) {
+    return false;
+  }
+  char  *data   = (char*)buffer.get();
+  off_t  offset = (off_t)index * kChunkBytes;
+  size_t left   = kChunkBytes;
+  while (left > 0) {
+    const auto kRead = ::pread(fileno(_spill_file), data, left, offset);
+    if (kRead <= 0) {
+      SetMessage("Failed to read records from temporary file");
+      return false;
+    }
+    data   += kRead;
+    offset += kRead;
+    left   -= kRead;
+  }
+  Chunk &chunk = _chunks[index];
+  chunk.data = std::move(buffer);
+  _lru.push_front(index);
+  chunk.lru_pos = _lru.begin();
+  return true;
+}
+
+bool SpillSampleStore::PushRecord(const Record &rec) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  const size_t kOffset = _size % _chunk_records;
+  if (kOffset == 0) {
+    Chunk chunk;
+    if (not GetFreeBuffer(&chunk.data)) {
+      return false;
+    }
+    _chunks.push_back(std::move(chunk));
+    _lru.push_front(_chunks.size() - 1);
+    _chunks.back().lru_pos = _lru.begin();
+  }
+  double *data = _chunks.back().data.get();
+  data[kOffset]                  = rec.time;
+  data[_chunk_records + kOffset] = rec.value;
+  ++_size;
+  return true;
+}
+
+uint64_t SpillSampleStore::GetSize() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _size;
+}
+
+size_t SpillSampleStore::ReadRecords(uint64_t first, Record *out,
+                                     size_t max_amount) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  size_t amount = 0;
+  while (amount < max_amount && first + amount < _size) {
+    const uint64_t kPos    = first + amount;
+    const size_t   kIndex  = kPos / _chunk_records;
+    const size_t   kOffset = kPos % _chunk_records;
+    Chunk &chunk = _chunks[kIndex];
+    if (chunk.data) {
+      _lru.splice(_lru.begin(), _lru, chunk.lru_pos);
+    } else if (not LoadChunk(kIndex)) {
+      break;
+    }
+    const size_t kAmount = std::min<uint64_t>(
+      std::min<uint64_t>(max_amount - amount, _chunk_records - kOffset),
+      _size - kPos
+    );
+    const double *times  = chunk.data.get() + kOffset;
+    const double *values = times + _chunk_records;
+    for (size_t i = 0; i < kAmount; ++i) {
+      out[amount + i] = Record(times[i], values[i]);
+    }
+    amount += kAmount;
+  }
+  return amount;
+}
+
+size_t SpillSampleStore::GetMaxResidentChunks() const {
+  return _max_resident;
+}
+
+size_t SpillSampleStore::GetResidentChunks() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _lru.size();
+}
+
+uint64_t SpillSampleStore::GetSpilledBytes() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _spilled_bytes;
+}
@@ -0,0 +1,96 @@
+#ifndef SAMPLE_STORE_HPP
+#define SAMPLE_STORE_HPP
+
+#include <list>
+#include <mutex>
+#include <vector>
+#include <cstdio>
+#include "compressor.hpp"
+
+/**
+ * Base class for storages of raw (not compressed) records. Records are
+ * accessed by index, so analysis can read any part of the loaded data
+ * without knowing, where it is kept.
+ */
+class SampleStore {
+  public:
+    typedef std::shared_ptr<SampleStore> ShrPtr;
+    typedef VoidDataSource::Record       Record;
+
+    SampleStore();
+    virtual ~SampleStore();
+    /**
+     * Method for appending record to the end of the storage.
+     * @return false if record was not stored.
+     */
+    virtual bool PushRecord(const Record &rec) = 0;
+    virtual uint64_t GetSize() const = 0;
+    /**
+     * Method for reading records [first, first + max_amount) into "out".
+     * @return amount of read records, it is lesser than "max_amount" only
+     *         at the end of the storage or on error.
+     */
+    virtual size_t ReadRecords(uint64_t first, Record *out,
+                               size_t max_amount) = 0;
+    /**
+     * Method for searching the first record with time label >= "time".
+     * Records are sorted by time, so it is a binary search.
+     * @return index of the record or "GetSize()" if there is no such record.
+     */
+    virtual uint64_t FindRecord(double time);
+    /**
+     * Method for compressing records of time window [from, to] into
+     * "out", it is used for showing details of loaded data.
+     * @return false if pushing into compressor has failed.
+     */
+    bool FillCompressor(double from, double to, Compressor *out);
+    const std::string& GetMessage() const;
+  protected:
+    void SetMessage(const std::string &msg);
+  private:
+    std::string _message;
+};
+
+/**
+ * Storage with limited memory. Records are kept in chunks of fixed size,
+ * time labels and values are stored in separate arrays. When amount of
+ * chunks in memory reaches the limit, the least recently used chunk is
+ * written into the temporary file (only once, full chunks are never
+ * changed), and its memory is used for another chunk. Chunks are read
+ * back on demand. Methods are thread safe.
+ */
+class SpillSampleStore : public SampleStore {
+  public:
+    SpillSampleStore(size_t mem_limit, uint32_t chunk_records = 65536);
+    virtual ~SpillSampleStore();
+    virtual bool PushRecord(const Record &rec);
+    virtual uint64_t GetSize() const;
+    virtual size_t ReadRecords(uint64_t first, Record *out,
+                               size_t max_amount);
+    size_t GetMaxResidentChunks() const;
+    size_t GetResidentChunks() const;
+    uint64_t GetSpilledBytes() const;
+  private:
+    typedef std::unique_ptr<double[]> Buffer;
+    typedef std::list<size_t>         LruList;
+
+    struct Chunk {
+      Chunk();
+      Buffer            data;   // time labels, then values
+      bool              on_disk;
+      LruList::iterator lru_pos;
+    };
+
+    bool LoadChunk(size_t index);
+    bool GetFreeBuffer(Buffer *out);
+
+    const uint32_t     _chunk_records;
+    const size_t       _max_resident;
+    mutable std::mutex _mutex;
+    std::vector<Chunk> _chunks;
+    LruList            _lru;
+    uint64_t           _size;
+    uint64_t           _spilled_bytes;
+    std::FILE         *_spill_file;
+};
+#endif
@@ -0,0 +1,190 @@
+#include "scheduler.hpp"
+#include <algorithm>
+
+// worker, which is executed by the current thread
+static thread_local TaskScheduler          *t_scheduler = 0;
+static thread_local size_t                  t_worker    = 0;
+static thread_local TaskScheduler::Priority t_priority  =
+  TaskScheduler::kHighPriority;
+
+static std::mutex g_shared_mutex;
+static size_t     g_shared_threads = 0;
+static bool       g_shared_created = false;
+
+static
+size_t FixSharedThreads() {
+  std::lock_guard<std::mutex> lock(g_shared_mutex);
+  g_shared_created = true;
+  return g_shared_threads;
+}
+// class TaskScheduler
+TaskScheduler::TaskScheduler(size_t threads)
+    : _queued(0),
+      _next_worker(0),
+      _stolen(0),
+      _stop(false) {
+  if (threads == 0) {
+    threads = std::thread::hardware_concurrency();
+  }
+  threads = std::max<size_t>(threads, 1);
+  for (size_t i = 0; i < threads; ++i) {
+    _workers.emplace_back(new Worker());
+  }
+  for (size_t i = 0; i < threads; ++i) {
+    _threads.emplace_back(&TaskScheduler::WorkerLoop, this, i);
+  }
+}
+
+TaskScheduler::~TaskScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _changed.notify_all();
+  for (auto &thread : _threads) {
+    thread.join();
+  }
+}
+
+void TaskScheduler::Run(const Task &task, Priority priority, Group *group,
+                        const CancelToken::ShrPtr &token) {
+  if (group) {
+    group->_unfinished.fetch_add(1, std::memory_order_relaxed);
+  }
+  // workers keep their tasks, other threads spread tasks over workers
+  const size_t kIndex = t_scheduler == this
+                      ? t_worker
+                      : _next_worker++ % _workers.size();
+  Worker &worker = *_workers[kIndex];
+  // the counter is increased before publishing, so taking of the task
+  // can not decrease it below zero
+  _queued.fetch_add(1);
+  {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.queues[priority].push_back(Item{task, priority, group, token});
+  }
+  {
+    // sleeping thread has either seen the counter or gets the notification
+    std::lock_guard<std::mutex> lock(_mutex);
+  }
+  // waiting threads can not take tasks of lower priorities, so all
+  // threads are notified
+  _changed.notify_all();
+}
+
+bool TaskScheduler::TakeTask(size_t index, Priority lowest, Item *out) {
+  if (_queued.load() == 0) {
+    return false;
+  }
+  const size_t kAmount = _workers.size();
+  for (int p = kHighPriority; p <= lowest; ++p) {
+    if (index < kAmount) {
+      Worker &own = *_workers[index];
+      std::lock_guard<std::mutex> lock(own.mutex);
+      auto &queue = own.queues[p];
+      if (not queue.empty()) {
+        *out = std::move(queue.back());
+        queue.pop_back();
+        --_queued;
+        return true;
+      }
+    }
+    const size_t kVictims = index < kAmount ? kAmount - 1 : kAmount;
+    for (size_t k = 1; k <= kVictims; ++k) {
+      Worker &victim = *_workers[(index + k) % kAmount];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      auto &queue = victim.queues[p];
+      if (not queue.empty()) {
+        *out = std::move(queue.front());
+        queue.pop_front();
+        --_queued;
+        // tasks, which are taken by waiting threads, are not stolen
+        if (index < kAmount) {
+          ++_stolen;
+        }
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void TaskScheduler::Execute(Item &item) {
+  if (not item.token || not item.token->IsCancelled()) {
+    const Priority kPrevious = t_priority;
+    t_priority = item.priority;
+    item.task();
+    t_priority = kPrevious;
+  }
+  Group *group = item.group;
+  item = Item();
+  if (group && group->_unfinished.fetch_sub(1, std::memory_order_acq_rel)
+               == 1) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+    }
+    _changed.notify_all();
+  }
+}
+
+void TaskScheduler::WorkerLoop(size_t index) {
+  t_scheduler = this;
+  t_worker    = index;
+  Item item;
+  while (true) {
+    if (TakeTask(index, kLowPriority, &item)) {
+      Execute(item);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(_mutex);
+    _changed.wait(lock, [this]() { return _stop || _queued.load() > 0; });
+    if (_stop && _queued.load() == 0) {
+      break;
+    }
+  }
+}
+
+void TaskScheduler::Wait(Group *group) {
+  const size_t   kIndex  = t_scheduler == this ? t_worker : _workers.size();
+  const Priority kLowest = GetCurrentPriority();
+  Item item;
+  while (not group->IsFinished()) {
+    if (TakeTask(kIndex, kLowest, &item)) {
+      Execute(item);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (group->IsFinished()) {
+      break;
+    }
+    // queued tasks can have too low priority for this thread, so it
+    // sleeps until any change instead of checking the counter
+    _changed.wait_for(lock, std::chrono::milliseconds(1));
+  }
+}
+
+size_t TaskScheduler::GetThreadsAmount() const {
+  return _threads.size();
+}
+
+uint64_t TaskScheduler::GetStolenTasks() const {
+  return _stolen.load();
+}
+
+TaskScheduler& TaskScheduler::GetShared() {
+  static TaskScheduler shared(FixSharedThreads());
+  return shared;
+}
+
+bool TaskScheduler::SetSharedThreads(size_t threads) {
+  std::lock_guard<std::mutex> lock(g_shared_mutex);
+  if (g_shared_created) {
+    return false;
+  }
+  g_shared_threads = threads;
+  return true;
+}
+
+TaskScheduler::Priority TaskScheduler::GetCurrentPriority() {
+  return t_priority;
+}
@@ -0,0 +1,148 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <cstdint>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+/**
+ * Flag for cancelling of tasks and loading, it is shared by the owner of
+ * job and the job itself.
+ */
+class CancelToken {
+  public:
+    typedef std::shared_ptr<CancelToken> ShrPtr;
+
+    CancelToken() : _cancelled(false) {}
+    void Cancel() {
+      _cancelled.store(true, std::memory_order_relaxed);
+    }
+    bool IsCancelled() const {
+      return _cancelled.load(std::memory_order_relaxed);
+    }
+  private:
+    std::atomic<bool> _cancelled;
+};
+
+/**
+ * Pool of worker threads with work stealing, which is shared by all
+ * parallel jobs of the collector, so they do not create their own threads
+ * and do not oversubscribe the host.
+ * Every worker has its own deques (one per priority): tasks, which are
+ * added by the worker, are taken by it from the back (the newest task is
+ * hot in cache), idle workers steal the oldest tasks from the front of
+ * deques of other workers. Tasks of the high priority (they are waited by
+ * GUI) are taken before tasks of the low priority (batch jobs) in all
+ * deques. Tasks must not block waiting for other tasks, except through
+ * "Wait", which executes tasks while it waits.
+ */
+class TaskScheduler {
+  public:
+    enum Priority {
+      kHighPriority = 0,
+      kLowPriority,
+      kPrioritiesAmount
+    };
+    typedef std::function<void()> Task;
+
+    /**
+     * Counter of unfinished tasks, which are waited together.
+     */
+    class Group {
+      public:
+        Group() : _unfinished(0) {}
+        bool IsFinished() const {
+          return _unfinished.load(std::memory_order_acquire) == 0;
+        }
+      private:
+        friend class TaskScheduler;
+
+        std::atomic<size_t> _unfinished;
+    };
+
+    /**
+     * @param threads amount of worker threads, 0 means amount of hardware
+     *                threads.
+     */
+    TaskScheduler(size_t threads = 0);
+    /**
+     * Queued tasks are executed before destroying.
+     */
+    ~TaskScheduler();
+    /**
+     * Method for adding the task.
+     * @param task     function of the task;
+     * @param priority priority of the task;
+     * @param group    group, which waits the task (it can be 0);
+     * @param token    the task is skipped, if it is cancelled before
+     *                 starting (it can be empty).
+     */
+    void Run(const Task &task, Priority priority, Group *group = 0,
+             const CancelToken::ShrPtr &token = CancelToken::ShrPtr());
+    /**
+     * Method for waiting all tasks of the group, the calling thread
+     * executes queued tasks meanwhile (not lower than its own priority,
+     * so GUI thread does not get a batch task), so it can be called by
+     * tasks.
+     */
+    void Wait(Group *group);
+    size_t GetThreadsAmount() const;
+    /**
+     * @return amount of tasks, which were taken by workers from deques of
+     *         other workers.
+     */
+    uint64_t GetStolenTasks() const;
+    /**
+     * @return the scheduler of process, it is created by the first call.
+     */
+    static TaskScheduler& GetShared();
+    /**
+     * Method for setting amount of threads of the shared scheduler, it
+     * must be called before the first call of "GetShared".
+     * @return false if the shared scheduler is already created.
+     */
+    static bool SetSharedThreads(size_t threads);
+    /**
+     * @return priority of the task, which is executed by the calling
+     *         thread, or the high priority outside of tasks (the thread
+     *         waits for results).
+     */
+    static Priority GetCurrentPriority();
+  private:
+    struct Item {
+      Task                task;
+      Priority            priority;
+      Group              *group;
+      CancelToken::ShrPtr token;
+    };
+    struct Worker {
+      std::mutex       mutex;
+      std::deque<Item> queues[kPrioritiesAmount];
+    };
+
+    void WorkerLoop(size_t index);
+    /**
+     * Method for taking the task: the own deque first, then deques of
+     * other workers, for every priority.
+     * @param index  index of worker or amount of workers for other threads;
+     * @param lowest the lowest taken priority.
+     */
+    bool TakeTask(size_t index, Priority lowest, Item *out);
+    void Execute(Item &item);
+
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::vector<std::thread>             _threads;
+    std::atomic<size_t>                  _queued;
+    std::atomic<size_t>                  _next_worker;
+    std::atomic<uint64_t>                _stolen;
+    std::mutex                           _mutex;
+    std::condition_variable              _changed;
+    bool                                 _stop;
+};
+#endif
@@ -0,0 +1,345 @@
+#include "shared_view.hpp"
+#include <new>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <boost/lexical_cast.hpp>
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+              "Atomic counters must be lock free for sharing by processes");
+static_assert(std::is_trivially_copyable<QuantileSketch>::value,
+              "Sketches are copied into shared memory as bytes");
+
+static const uint64_t kSegmentMagic  = 0x5745495644524f4fULL; // "OORDVIEW"
+static const uint32_t kSegmentLayout = 1;
+static const size_t   kAlignment     = 64;
+// attempts of reading, while writer changes the slot
+static const int      kReadAttempts  = 64;
+
+// layout of segment: header, slot #0, slot #1
+struct SegmentHeader {
+  uint64_t              magic;
+  uint32_t              layout;
+  uint32_t              max_records;
+  uint64_t              slot_size;
+  std::atomic<uint64_t> version; // the last publication, its slot is
+                                 // "version % 2"
+};
+
+struct SlotHeader {
+  std::atomic<uint64_t> sequence; // it is odd while slot is written
+  uint64_t              version;
+  uint64_t              pushed;
+  uint32_t              size;
+  uint8_t               finished;
+  uint8_t               quantiles;
+  double                time_scale[2];
+  double                value_scale[2];
+};
+
+struct SharedBucket {
+  double         time[2];
+  double         value[2];
+  uint32_t       amount;
+  QuantileSketch sketch;
+};
+
+static
+size_t AlignSize(size_t size) {
+  return (size + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+static
+size_t GetSlotSize(uint32_t max_records) {
+  return AlignSize(sizeof(SlotHeader) + max_records * sizeof(SharedBucket));
+}
+
+static
+size_t GetSegmentSize(uint32_t max_records) {
+  return AlignSize(sizeof(SegmentHeader)) + 2 * GetSlotSize(max_records);
+}
+
+static
+uint8_t* GetSlot(const void *memory, uint64_t version) {
+  const auto *header = (const SegmentHeader*)memory;
+  return (uint8_t*)memory + AlignSize(sizeof(SegmentHeader))
+       + (version % 2) * header->slot_size;
+}
+
+/**
+ * Names of POSIX shared memory objects must start with '/'.
+ */
+static
+std::string GetSegmentName(const std::string &name) {
+  return (name.empty() || name[0] != '/') ? "/" + name : name;
+}
+// class SharedViewWriter
+SharedViewWriter::SharedViewWriter(const std::string &name,
+                                   uint32_t max_records, double period)
+    : _name(GetSegmentName(name)),
+      _max_records(max_records),
+      _period(std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(period)
+      )),
+      _next_publication(Clock::now()),
+      _unchecked(0),
+      _version(0),
+      _size(0),
+      _memory(0) {
+}
+
+SharedViewWriter::~SharedViewWriter() {
+  if (_memory != 0) {
+    ::munmap(_memory, _size);
+    ::shm_unlink(_name.c_str());
+  }
+}
+
+bool SharedViewWriter::Open() {
+  if (_memory != 0) {
+    return true;
+  }
+  // readers of the old segment keep their mapping
+  ::shm_unlink(_name.c_str());
+  const int kFile = ::shm_open(_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (kFile < 0) {
+    SetMessage("Failed to create shared memory: " + _name);
+    return false;
+  }
+  const size_t kSize = GetSegmentSize(_max_records);
+  void *memory = MAP_FAILED;
+  if (::ftruncate(kFile, kSize) == 0) {
+    memory = ::mmap(0, kSize, PROT_READ | PROT_WRITE, MAP_SHARED, kFile, 0);
+  }
+  ::close(kFile);
+  if (memory == MAP_FAILED) {
+    SetMessage("Failed to map shared memory: " + _name);
+    ::shm_unlink(_name.c_str());
+    return false;
+  }
+  auto *header = new (memory) SegmentHeader();
+  header->max_records = _max_records;
+  header->slot_size   = GetSlotSize(_max_records);
+  header->version.store(0);
+  for (uint64_t slot = 0; slot < 2; ++slot) {
+    new (GetSlot(memory, slot)) SlotHeader();
+  }
+  header->layout = kSegmentLayout;
+  // magic is written the last, readers check it
+  std::atomic_thread_fence(std::memory_order_release);
+  header->magic = kSegmentMagic;
+  _memory  = memory;
+  _size    = kSize;
+  _version = 0;
+  return true;
+}
+
+bool SharedViewWriter::IsOpened() const {
+  return _memory != 0;
+}
+
+bool SharedViewWriter::Publish(const Compressor &comp, bool finished) {
+  const auto &records = comp.GetRecords();
+  if (_memory == 0) {
+    SetMessage("Shared memory is not opened");
+    return false;
+  }
+  if (records.size() > _max_records) {
+    SetMessage("Too many buckets for shared memory: "
+      + boost::lexical_cast<std::string>(records.size())
+    );
+    return false;
+  }
+  auto *header = (SegmentHeader*)_memory;
+  // slot of the previous publication is not touched, so readers of it
+  // are not disturbed
+  const uint64_t kVersion  = _version + 1;
+  uint8_t       *memory    = GetSlot(_memory, kVersion);
+  auto          *slot      = (SlotHeader*)memory;
+  const uint64_t kSequence = slot->sequence.load(std::memory_order_relaxed);
+  slot->sequence.store(kSequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot->version        = kVersion;
+  slot->pushed         = comp.GetPushedRecords();
+  slot->size           = records.size();
+  slot->finished       = finished;
+  slot->quantiles      = comp.IsQuantilesUsed();
+  slot->time_scale[0]  = comp.GetTimeScale().first;
+  slot->time_scale[1]  = comp.GetTimeScale().second;
+  slot->value_scale[0] = comp.GetValueScale().first;
+  slot->value_scale[1] = comp.GetValueScale().second;
+  auto *bucket = (SharedBucket*)(memory + sizeof(SlotHeader));
+  for (const auto &rec : records) {
+    bucket->time[0]  = rec.time.first;
+    bucket->time[1]  = rec.time.second;
+    bucket->value[0] = rec.value.first;
+    bucket->value[1] = rec.value.second;
+    bucket->amount   = rec.amount;
+    bucket->sketch   = rec.sketch ? *rec.sketch : QuantileSketch();
+    ++bucket;
+  }
+  slot->sequence.store(kSequence + 2, std::memory_order_release);
+  header->version.store(kVersion, std::memory_order_release);
+  _version          = kVersion;
+  _next_publication = Clock::now() + _period;
+  return true;
+}
+
+uint64_t SharedViewWriter::GetVersion() const {
+  return _version;
+}
+
+const std::string& SharedViewWriter::GetMessage() const {
+  return _message;
+}
+
+void SharedViewWriter::SetMessage(const std::string &msg) {
+  _message = msg;
+}
+// class SharedViewReader::Statistics
+SharedViewReader::Statistics::Statistics()
+    : version(0),
+      pushed(0),
+      finished(false) {
+}
+// class SharedViewReader
+SharedViewReader::SharedViewReader()
+    : _size(0),
+      _memory(0),
+      _version(0) {
+}
+
+SharedViewReader::~SharedViewReader() {
+  Detach();
+}
+
+bool SharedViewReader::Attach(const std::string &name) {
+  Detach();
+  const std::string kName = GetSegmentName(name);
+  const int kFile = ::shm_open(kName.c_str(), O_RDONLY, 0);
+  if (kFile < 0) {
+    SetMessage("Failed to open shared memory: " + kName);
+    return false;
+  }
+  struct stat info;
+  void *memory = MAP_FAILED;
+  if (::fstat(kFile, &info) == 0 &&
+      (size_t)info.st_size >= sizeof(SegmentHeader)) {
+    memory = ::mmap(0, info.st_size, PROT_READ, MAP_SHARED, kFile, 0);
+  }
+  ::close(kFile);
+  if (memory == MAP_FAILED) {
+    SetMessage("Failed to map shared memory: " + kName);
+    return false;
+  }
+  const auto *header = (const SegmentHeader*)memory;
+  if (header->magic != kSegmentMagic || header->layout != kSegmentLayout ||
+      header->slot_size != GetSlotSize(header->max_records) ||
+      (size_t)info.st_size < GetSegmentSize(header->max_records)) {
+    ::munmap(memory, info.st_size);
+    SetMessage("Invalid shared memory: " + kName);
+    return false;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  _memory  = memory;
+  _size    = info.st_size;
+  _version = 0;
+  _buffer.resize(header->slot_size);
+  return true;
+}
+
+void SharedViewReader::Detach() {
+  if (_memory != 0) {
+    ::munmap((void*)_memory, _size);
+    _memory = 0;
+    _size   = 0;
+  }
+}
+
+bool SharedViewReader::IsAttached() const {
+  return _memory != 0;
+}
+
+uint32_t SharedViewReader::GetMaxRecords() const {
+  return _memory != 0 ? ((const SegmentHeader*)_memory)->max_records : 0;
+}
+
+bool SharedViewReader::HasNewVersion() const {
+  if (_memory == 0) {
+    return false;
+  }
+  const auto *header = (const SegmentHeader*)_memory;
+  return header->version.load(std::memory_order_acquire) != _version;
+}
+
+bool SharedViewReader::Read(Compressor *out, Statistics *stat) {
+  if (_memory == 0) {
+    SetMessage("Shared memory is not attached");
+    return false;
+  }
+  const auto *header = (const SegmentHeader*)_memory;
+  const auto *copy   = (const SlotHeader*)_buffer.data();
+  bool consistent = false;
+  for (int i = 0; i < kReadAttempts && not consistent; ++i) {
+    const uint64_t kVersion = header->version.load(std::memory_order_acquire);
+    if (kVersion == 0) {
+      SetMessage("Nothing is published yet");
+      return false;
+    }
+    const uint8_t *memory   = GetSlot(_memory, kVersion);
+    const auto    *slot     = (const SlotHeader*)memory;
+    const uint64_t kBefore  = slot->sequence.load(std::memory_order_acquire);
+    if (kBefore % 2 != 0) {
+      continue;
+    }
+    // size is taken from the copy, so it can not exceed the buffer
+    std::memcpy(_buffer.data(), memory, sizeof(SlotHeader));
+    const size_t kSize = std::min<size_t>(copy->size, header->max_records);
+    std::memcpy(_buffer.data() + sizeof(SlotHeader),
+                memory + sizeof(SlotHeader), kSize * sizeof(SharedBucket));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    consistent = slot->sequence.load(std::memory_order_relaxed) == kBefore;
+  }
+  if (not consistent) {
+    SetMessage("Failed to read consistent state of shared memory");
+    return false;
+  }
+  Compressor::Record::List records;
+  const auto *bucket = (const SharedBucket*)(_buffer.data()
+                                             + sizeof(SlotHeader));
+  for (size_t i = 0; i < copy->size && i < header->max_records; ++i) {
+    records.emplace_back(Compressor::Range(bucket[i].time[0],
+                                           bucket[i].time[1]),
+                         Compressor::Range(bucket[i].value[0],
+                                           bucket[i].value[1]));
+    records.back().amount = bucket[i].amount;
+    if (copy->quantiles) {
+      records.back().sketch.reset(new QuantileSketch(bucket[i].sketch));
+    }
+  }
+  out->UseQuantiles(copy->quantiles != 0);
+  out->Assign(std::move(records),
+              Compressor::Range(copy->time_scale[0],  copy->time_scale[1]),
+              Compressor::Range(copy->value_scale[0], copy->value_scale[1]),
+              copy->pushed);
+  _version = copy->version;
+  if (stat != 0) {
+    stat->version  = copy->version;
+    stat->pushed   = copy->pushed;
+    stat->finished = copy->finished != 0;
+  }
+  return true;
+}
+
+const std::string& SharedViewReader::GetMessage() const {
+  return _message;
+}
+
+void SharedViewReader::SetMessage(const std::string &msg) {
+  _message = msg;
+}
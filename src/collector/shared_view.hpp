@@ -0,0 +1,135 @@
+#ifndef SHARED_VIEW_HPP
+#define SHARED_VIEW_HPP
+
+#include <chrono>
+#include "compressor.hpp"
+
+/**
+ * Publication of compressor state (buckets, scales and amount of pushed
+ * records) into POSIX shared memory, so other local processes can show
+ * the same live view without loading the file.
+ *
+ * Segment has two slots. Writer fills the slot, which is not published,
+ * and then publishes it by the version counter. Every slot is protected by
+ * a sequence counter (seqlock): it is odd while slot is written. Reader
+ * copies the published slot and checks, that its sequence was not changed,
+ * otherwise copying is repeated. So readers do not block writer, do not
+ * lock anything and do not make system calls after attaching.
+ */
+class SharedViewWriter {
+  public:
+    typedef std::shared_ptr<SharedViewWriter> ShrPtr;
+
+    /**
+     * @param name        name of segment (for example "/orolia_demo");
+     * @param max_records the biggest amount of buckets of compressor;
+     * @param period      the lowest interval between publications by
+     *                    "Update()" (seconds).
+     */
+    SharedViewWriter(const std::string &name, uint32_t max_records,
+                     double period = 0.1);
+    /**
+     * Segment is removed, readers, which are attached, keep their mapping.
+     */
+    ~SharedViewWriter();
+    /**
+     * Method for creating segment, existing segment with the same name is
+     * replaced.
+     * @return false if segment can not be created.
+     */
+    bool Open();
+    bool IsOpened() const;
+    /**
+     * Method for publishing state of compressor.
+     * @param finished the final state, loading is over;
+     * @return false if segment is not opened or compressor has too many
+     *         buckets.
+     */
+    bool Publish(const Compressor &comp, bool finished = false);
+    /**
+     * Method for calling from the loading loop after every pushed record.
+     * State is published, if "period" has passed since the previous
+     * publication, time is checked only once per "kCheckRecords" calls.
+     */
+    void Update(const Compressor &comp) {
+      if (++_unchecked < kCheckRecords) {
+        return;
+      }
+      _unchecked = 0;
+      if (Clock::now() >= _next_publication) {
+        Publish(comp);
+      }
+    }
+    uint64_t GetVersion() const;
+    const std::string& GetMessage() const;
+  private:
+    typedef std::chrono::steady_clock Clock;
+
+    static const uint32_t kCheckRecords = 16384;
+
+    void SetMessage(const std::string &msg);
+
+    const std::string     _name;
+    const uint32_t        _max_records;
+    const Clock::duration _period;
+    Clock::time_point     _next_publication;
+    uint32_t              _unchecked;
+    uint64_t              _version;
+    size_t                _size;
+    void                 *_memory;
+    std::string           _message;
+};
+
+/**
+ * Reader of the segment, which is published by "SharedViewWriter".
+ */
+class SharedViewReader {
+  public:
+    typedef std::shared_ptr<SharedViewReader> ShrPtr;
+    /**
+     * State of publication, which is read together with buckets.
+     */
+    struct Statistics {
+      Statistics();
+
+      uint64_t version;  // number of publication
+      uint64_t pushed;   // amount of records pushed into compressor
+      bool     finished; // writer has published the final state
+    };
+
+    SharedViewReader();
+    ~SharedViewReader();
+    /**
+     * Method for mapping segment, which was created by "SharedViewWriter".
+     * @return false if segment does not exist or it is invalid.
+     */
+    bool Attach(const std::string &name);
+    void Detach();
+    bool IsAttached() const;
+    /**
+     * @return the biggest amount of buckets in the segment.
+     */
+    uint32_t GetMaxRecords() const;
+    /**
+     * @return true if there is a publication, which was not read yet.
+     */
+    bool HasNewVersion() const;
+    /**
+     * Method for reading consistent snapshot of the published state.
+     * @param out  compressor, which gets buckets and scales;
+     * @param stat statistics of publication, it can be null;
+     * @return false if nothing was published yet or consistent snapshot
+     *         was not read (writer is too fast), "out" is not changed.
+     */
+    bool Read(Compressor *out, Statistics *stat = 0);
+    const std::string& GetMessage() const;
+  private:
+    void SetMessage(const std::string &msg);
+
+    size_t               _size;
+    const void          *_memory;
+    uint64_t             _version; // the last read publication
+    std::vector<uint8_t> _buffer;  // copy of slot
+    std::string          _message;
+};
+#endif
@@ -0,0 +1,56 @@
+#include "time_index.hpp"
+#include <algorithm>
+#include <cmath>
+
+// class TimeIndex::Entry
+TimeIndex::Entry::Entry()
+    : time(std::nan("")),
+      offset(0),
+      line(0) {
+}
+
+TimeIndex::Entry::Entry(double time, uint64_t offset, uint32_t line)
+    : time(time),
+      offset(offset),
+      line(line) {
+}
+// class TimeIndex
+TimeIndex::TimeIndex() {
+}
+
+bool TimeIndex::AddEntry(const Entry &entry) {
+  if (not _entries.empty() && entry.offset <= _entries.back().offset) {
+    return false;
+  }
+  _entries.push_back(entry);
+  return true;
+}
+
+bool TimeIndex::FindBefore(double time, Entry *out) const {
+  auto it = std::lower_bound(_entries.begin(), _entries.end(), time,
+    [](const Entry &entry, double tm) {
+      return entry.time < tm;
+    }
+  );
+  if (it == _entries.begin()) {
+    return false;
+  }
+  *out = *(--it);
+  return true;
+}
+
+bool TimeIndex::IsEmpty() const {
+  return _entries.empty();
+}
+
+const TimeIndex::Entry& TimeIndex::GetLast() const {
+  return _entries.back();
+}
+
+const TimeIndex::Entries& TimeIndex::GetEntries() const {
+  return _entries;
+}
+
+void TimeIndex::Clear() {
+  _entries.clear();
+}
@@ -0,0 +1,54 @@
+#ifndef TIME_INDEX_HPP
+#define TIME_INDEX_HPP
+
+#include <vector>
+#include <cstdint>
+
+/**
+ * Sparse index, which maps time labels of records to byte offsets of
+ * lines in the source. Entries are added during sequential scanning
+ * (every N-th record), so they are always sorted by time and offset.
+ */
+class TimeIndex {
+  public:
+    /**
+     * Indexed position in the source.
+     * - time  : time label of the record
+     * - offset: byte offset of the line with the record
+     * - line  : number of the line (starting from 1, including header)
+     */
+    struct Entry {
+      Entry();
+      Entry(double time, uint64_t offset, uint32_t line);
+      double   time;
+      uint64_t offset;
+      uint32_t line;
+    };
+    typedef std::vector<Entry> Entries;
+
+    TimeIndex();
+    /**
+     * Method for adding entry into the index. Entries with offset lesser
+     * or equal to the offset of the last entry are ignored, so the same
+     * source can be scanned many times.
+     * @param entry position that will be added;
+     * @return true if entry was added.
+     */
+    bool AddEntry(const Entry &entry);
+    /**
+     * Method for searching the last entry with time label lesser than
+     * "time". Reading from this entry guarantees that no records with
+     * time label >= "time" will be missed.
+     * @param time time label that we want to find;
+     * @param out  found entry, it is an output parameter;
+     * @return false if there is no such entry.
+     */
+    bool FindBefore(double time, Entry *out) const;
+    bool IsEmpty() const;
+    const Entry& GetLast() const;
+    const Entries& GetEntries() const;
+    void Clear();
+  private:
+    Entries _entries;
+};
+#endif
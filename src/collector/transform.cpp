@@ -0,0 +1,80 @@
+#include "transform.hpp"
+#include <cstdlib>
+
+// the highest window of moving average, the ring of values is allocated
+static const double kMaxWindow = 1 << 20;
+// the highest factor of decimation, it is "uint32_t"
+static const double kMaxFactor = 4294967295.0;
+
+// class TransformChain
+TransformChain::TransformChain() {
+}
+
+void TransformChain::AddStage(const Stage &stage) {
+  _stages.push_back(stage);
+}
+
+static
+bool ParseArgument(const std::string &str, double *out) {
+  char *end = 0;
+  *out = std::strtod(str.c_str(), &end);
+  return not str.empty() && *end == 0 && std::isfinite(*out);
+}
+
+/**
+ * @return true if "value" is integer in [1, max].
+ */
+static
+bool IsCount(double value, double max) {
+  return value >= 1 && value <= max && std::floor(value) == value;
+}
+
+bool TransformChain::AddStages(const std::string &desc) {
+  std::vector<Stage> stages;
+  size_t pos = 0;
+  while (pos <= desc.size()) {
+    size_t end = desc.find(',', pos);
+    if (end == std::string::npos) {
+      end = desc.size();
+    }
+    const std::string kItem(desc, pos, end - pos);
+    pos = end + 1;
+    const size_t kColon = kItem.find(':');
+    if (kColon == std::string::npos) {
+      _message = "Stage without argument: \"" + kItem + "\"";
+      return false;
+    }
+    const std::string kName(kItem, 0, kColon);
+    double arg = 0;
+    if (not ParseArgument(kItem.substr(kColon + 1), &arg)) {
+      _message = "Invalid argument of stage: \"" + kItem + "\"";
+      return false;
+    }
+    if (kName == "scale") {
+      stages.push_back(transform::Scale(arg));
+    } else if (kName == "offset") {
+      stages.push_back(transform::Scale(1, arg));
+    } else if (kName == "ffreq" && arg != 0) {
+      stages.push_back(transform::FractionalFrequency(arg));
+    } else if (kName == "ma" && IsCount(arg, kMaxWindow)) {
+      stages.push_back(transform::MovingAverage(arg));
+    } else if (kName == "decimate" && IsCount(arg, kMaxFactor)) {
+      stages.push_back(transform::Decimate(arg));
+    } else if (kName == "drift") {
+      stages.push_back(transform::RemoveDrift(arg));
+    } else {
+      _message = "Unknown stage: \"" + kItem + "\"";
+      return false;
+    }
+  }
+  _stages.insert(_stages.end(), stages.begin(), stages.end());
+  return true;
+}
+
+bool TransformChain::IsEmpty() const {
+  return _stages.empty();
+}
+
+const std::string& TransformChain::GetMessage() const {
+  return _message;
+}
@@ -0,0 +1,233 @@
+#ifndef TRANSFORM_HPP
+#define TRANSFORM_HPP
+
+#include <vector>
+#include <functional>
+#include <cmath>
+#include "data_source.hpp"
+
+/**
+ * Stages for pre-processing of records between data source and consumers
+ * (compressor, exporter, ...). Every stage is a functor:
+ *   bool operator()(VoidDataSource::Record &rec);
+ * which changes the record in place and returns false if the record must
+ * be dropped. Stages are composed by "Compose" at compile time, so the
+ * whole chain is inlined into the loading loop of "Collector" and records
+ * are never copied into intermediate buffers.
+ */
+namespace transform {
+
+typedef VoidDataSource::Record Record;
+
+/**
+ * Stage, which does nothing.
+ */
+struct Identity {
+  bool operator()(Record &rec) const {
+    (void)rec;
+    return true;
+  }
+};
+
+/**
+ * Linear conversion of units: value * factor + offset.
+ */
+class Scale {
+  public:
+    Scale(double factor, double offset = 0)
+        : _factor(factor),
+          _offset(offset) {
+    }
+    bool operator()(Record &rec) const {
+      rec.value = rec.value * _factor + _offset;
+      return true;
+    }
+  private:
+    double _factor;
+    double _offset;
+};
+
+/**
+ * Conversion of frequency into fractional frequency (f - f0) / f0, where
+ * f0 is a nominal frequency.
+ */
+class FractionalFrequency {
+  public:
+    FractionalFrequency(double nominal)
+        : _nominal(nominal),
+          _ratio(1.0 / nominal) {
+    }
+    bool operator()(Record &rec) const {
+      rec.value = (rec.value - _nominal) * _ratio;
+      return true;
+    }
+  private:
+    double _nominal;
+    double _ratio;
+};
+
+/**
+ * Moving average of the last "window" values. Until the window is filled
+ * the average of all pushed values is used. Sum is recalculated once per
+ * window, so rounding errors are not accumulated.
+ */
+class MovingAverage {
+  public:
+    MovingAverage(uint32_t window)
+        : _ring(window > 0 ? window : 1),
+          _ring_pos(0),
+          _size(0),
+          _sum(0) {
+    }
+    bool operator()(Record &rec) {
+      if (_size == _ring.size()) {
+        _sum -= _ring[_ring_pos];
+      } else {
+        ++_size;
+      }
+      _ring[_ring_pos] = rec.value;
+      _sum += rec.value;
+      if (++_ring_pos == _ring.size()) {
+        _ring_pos = 0;
+        _sum      = 0;
+        for (uint32_t i = 0; i < _size; ++i) {
+          _sum += _ring[i];
+        }
+      }
+      rec.value = _sum / _size;
+      return true;
+    }
+  private:
+    std::vector<double> _ring;
+    uint32_t            _ring_pos;
+    uint32_t            _size;
+    double              _sum;
+};
+
+/**
+ * Stage, which passes only every "factor"-th record (the first record
+ * always passes).
+ */
+class Decimate {
+  public:
+    Decimate(uint32_t factor)
+        : _factor(factor > 0 ? factor : 1),
+          _counter(0) {
+    }
+    bool operator()(Record &rec) {
+      (void)rec;
+      const bool kPass = _counter == 0;
+      if (++_counter == _factor) {
+        _counter = 0;
+      }
+      return kPass;
+    }
+  private:
+    uint32_t _factor;
+    uint32_t _counter;
+};
+
+/**
+ * Removing of known linear drift: value - rate * (time - t0), where t0 is
+ * the time label of the first record.
+ */
+class RemoveDrift {
+  public:
+    RemoveDrift(double rate)
+        : _rate(rate),
+          _origin(std::nan("")) {
+    }
+    bool operator()(Record &rec) {
+      if (std::isnan(_origin)) {
+        _origin = rec.time;
+      }
+      rec.value -= _rate * (rec.time - _origin);
+      return true;
+    }
+  private:
+    double _rate;
+    double _origin;
+};
+
+/**
+ * Composition of two stages, "second" is called only for records, which
+ * were passed by "first".
+ */
+template <class First, class Second>
+class Chain {
+  public:
+    Chain(First first, Second second)
+        : _first(std::move(first)),
+          _second(std::move(second)) {
+    }
+    bool operator()(Record &rec) {
+      return _first(rec) && _second(rec);
+    }
+  private:
+    First  _first;
+    Second _second;
+};
+
+/**
+ * Function for composing any amount of stages into one:
+ *   auto pipe = transform::Compose(transform::Scale(1e6),
+ *                                  transform::Decimate(10));
+ */
+template <class Stage>
+Stage Compose(Stage stage) {
+  return stage;
+}
+
+template <class First, class Second, class... Rest>
+auto Compose(First first, Second second, Rest... rest)
+    -> decltype(Compose(Chain<First, Second>(first, second), rest...)) {
+  return Compose(Chain<First, Second>(std::move(first), std::move(second)),
+                 std::move(rest)...);
+}
+
+} // namespace transform
+
+/**
+ * Chain of stages, which is configured at runtime (for example from the
+ * command line). Stages are called through "std::function", so it is
+ * slower than composed stages, but records are still processed in one
+ * pass.
+ */
+class TransformChain {
+  public:
+    typedef std::shared_ptr<TransformChain>                   ShrPtr;
+    typedef std::function<bool(VoidDataSource::Record &rec)> Stage;
+
+    TransformChain();
+    void AddStage(const Stage &stage);
+    /**
+     * Method for adding stages from text description: comma separated
+     * list of "name:argument" pairs. Supported stages:
+     * - scale:<factor>      - multiplication of values;
+     * - offset:<value>      - addition to values;
+     * - ffreq:<nominal>     - conversion into fractional frequency;
+     * - ma:<window>         - moving average, window is integer in
+     *                         [1, 2^20];
+     * - decimate:<factor>   - passing of every "factor"-th record, factor
+     *                         is integer in [1, 2^32 - 1];
+     * - drift:<rate>        - removing of linear drift (units per second).
+     * Example: "ffreq:10e6,ma:16,decimate:4".
+     * @return false if description is not valid, stages are not changed.
+     */
+    bool AddStages(const std::string &desc);
+    bool IsEmpty() const;
+    const std::string& GetMessage() const;
+
+    bool operator()(VoidDataSource::Record &rec) {
+      for (auto &stage : _stages) {
+        if (not stage(rec)) {
+          return false;
+        }
+      }
+      return true;
+    }
+  private:
+    std::vector<Stage> _stages;
+    std::string        _message;
+};
+#endif
@@ -1,12 +1,111 @@
 #include <string>
 #include <iostream>
+#include <sstream>
 #include <memory>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
 #include <boost/program_options.hpp>
+#include <boost/format.hpp>
 #include "demo_gui.hpp"
 #include "collector/collector.hpp"
+#include "collector/psd.hpp"
+#include "collector/cross_correlation.hpp"
+#include "collector/compressed_store.hpp"
+#include "collector/difference_data_source.hpp"
+#include "collector/cornered_hat.hpp"
+
+/**
+ * Tasks, which are done after loading of records.
+ */
+struct PostLoadTasks {
+  Exporter::ShrPtr          buckets_exporter;
+  std::shared_ptr<WelchPsd> psd;
+  std::string               psd_export;
+  std::string               attach; // shared view, which is shown instead
+                                    // of loading
+  std::shared_ptr<CorneredHat> hat; // analysis of pairs of oscillators,
+                                    // it is done instead of loading
+  std::string               hat_export;
+  std::string               resume; // checkpoint, from which loading is
+                                    // continued
+  std::shared_ptr<Collector> xcorr_input; // the second capture, it is
+                                          // loaded together with <in>
+  std::shared_ptr<CrossCorrelation> xcorr;
+  std::string               xcorr_export;
+};
+
+static
+Exporter* CreateExporter(const std::string &format, const std::string &path) {
+  if (format == "csv") {
+    return new CsvExporter(path);
+  }
+  if (format == "bin") {
+    return new ColumnarExporter(path);
+  }
+  throw std::invalid_argument("Unknown export format: " + format);
+}
+
+static
+DifferenceDataSource::Matching ParseMatching(const std::string &desc) {
+  if (desc == "nearest") {
+    return DifferenceDataSource::kNearestMatching;
+  }
+  if (desc == "interpolate") {
+    return DifferenceDataSource::kInterpolatedMatching;
+  }
+  throw std::invalid_argument("Unknown matching: " + desc);
+}
 
 static
-bool ParseProgramArguments(int arg_amount, char **arg_values, Collector *out) {
+DriftEstimator::Mode ParseDriftMode(const std::string &desc) {
+  if (desc == "report") {
+    return DriftEstimator::kReport;
+  }
+  if (desc == "subtract") {
+    return DriftEstimator::kSubtract;
+  }
+  throw std::invalid_argument("Unknown mode of drift: " + desc);
+}
+
+/**
+ * Function for adding pair of oscillators: "<first>-<second>:<path>".
+ */
+static
+void AddHatPair(const std::string &desc, CorneredHat *hat) {
+  const auto kDash  = desc.find('-');
+  const auto kColon = desc.find(':');
+  if (kDash == std::string::npos || kColon == std::string::npos ||
+      kDash > kColon) {
+    throw std::invalid_argument("Invalid pair of oscillators: " + desc);
+  }
+  const auto kFirst  = std::stoul(desc.substr(0, kDash));
+  const auto kSecond = std::stoul(desc.substr(kDash + 1, kColon - kDash - 1));
+  if (kFirst > UINT8_MAX || kSecond > UINT8_MAX) {
+    throw std::invalid_argument("Invalid pair of oscillators: " + desc);
+  }
+  hat->AddPair(kFirst, kSecond, new FileDataSource(desc.substr(kColon + 1)));
+}
+
+static
+VoidDataSource::Channels ParseChannels(const std::string &desc) {
+  VoidDataSource::Channels channels;
+  std::stringstream stream(desc);
+  std::string       item;
+  while (std::getline(stream, item, ',')) {
+    const auto kChannel = std::stoul(item);
+    if (kChannel >= VoidDataSource::kMaxColumns) {
+      throw std::invalid_argument("Invalid channel: " + item);
+    }
+    channels.push_back(kChannel);
+  }
+  return channels;
+}
+
+static
+bool ParseProgramArguments(int arg_amount, char **arg_values, Collector *out,
+                           PostLoadTasks *tasks, GuiSettings *gui) {
   namespace po = boost::program_options;
   po::options_description desc("Demo program for OROLIA");
 	desc.add_options()
@@ -14,7 +113,118 @@ bool ParseProgramArguments(int arg_amount, char **arg_values, Collector *out) {
     ("in",   po::value<std::string>()->default_value(""),
              "path to file with source data")
     ("bsize", po::value<unsigned>()->default_value(800),
-             "size of buffer, for storing loaded records");
+             "size of buffer, for storing loaded records")
+    ("channels", po::value<std::string>(),
+             "comma separated indexes of value columns (0 - the first column "
+             "after time), every one is compressed and drawn as a channel")
+    ("quantiles", po::bool_switch()->default_value(false),
+             "keep distribution of values in buffer records and draw "
+             "p5 - p95 band with median")
+    ("async", po::bool_switch()->default_value(false),
+             "read file by asynchronous big blocks (io_uring or pread)")
+    ("block-size", po::value<unsigned>()->default_value(1024),
+             "size of asynchronously read block (KB)")
+    ("queue-depth", po::value<unsigned>()->default_value(4),
+             "amount of asynchronously read blocks in flight")
+    ("direct", po::bool_switch()->default_value(false),
+             "asynchronous reading bypasses the page cache (O_DIRECT)")
+    ("reference", po::value<std::string>(),
+             "path to capture of reference, difference <in> - <reference> "
+             "of records, which are matched by time, is loaded")
+    ("match", po::value<std::string>()->default_value("interpolate"),
+             "matching of reference records: nearest, interpolate (between "
+             "the previous and the next records)")
+    ("tolerance", po::value<double>()->default_value(1),
+             "the highest distance between time labels of matched records "
+             "of <reference> (seconds)")
+    ("hat", po::value<std::vector<std::string>>()->composing(),
+             "capture of pair of oscillators for three-cornered hat: "
+             "<first>-<second>:<path> (for example 0-1:a.txt), all pairs "
+             "are needed, Allan deviation of every oscillator is calculated "
+             "instead of loading <in>")
+    ("hat-tolerance", po::value<double>()->default_value(
+               CorneredHat::Settings().tolerance),
+             "the highest distance between time labels of aligned records "
+             "of <hat> (seconds)")
+    ("hat-nominal", po::value<double>(),
+             "nominal frequency of pairs (Hz), values are converted into "
+             "fractional frequency")
+    ("hat-export", po::value<std::string>(),
+             "path to CSV file, for exporting deviations of pairs and "
+             "oscillators")
+    ("from", po::value<double>(),
+             "time label, from which records will be loaded")
+    ("to",   po::value<double>(),
+             "time label, until which records will be loaded")
+    ("detect", po::bool_switch()->default_value(false),
+             "detect glitches, phase jumps and gaps during loading")
+    ("threads", po::value<unsigned>()->default_value(0),
+             "amount of threads of parallel jobs (spectrum, density, "
+             "analysis), 0 - amount of hardware threads")
+    ("pipeline", po::bool_switch()->default_value(false),
+             "read, parse and compress records in different threads")
+    ("transform", po::value<std::string>(),
+             "comma separated stages for records: scale:<factor>, "
+             "offset:<value>, ffreq:<nominal>, ma:<window>, "
+             "decimate:<factor>, drift:<rate>")
+    ("drift", po::value<std::string>(),
+             "estimate drift of values by least squares during loading: "
+             "report, subtract (drift is removed from buckets after "
+             "loading, raw records keep it, so <psd> and <density> of "
+             "raw records are not supported)")
+    ("drift-order", po::value<unsigned>()->default_value(1),
+             "order of drift polynomial: 1 - linear, 2 - quadratic")
+    ("mem-limit", po::value<unsigned>(),
+             "keep raw records, using not more than <mem-limit> MB of memory "
+             "(the rest is moved into temporary file)")
+    ("compress-raw", po::bool_switch()->default_value(false),
+             "keep raw records in memory, compressed without loss "
+             "(instead of <mem-limit>)")
+    ("psd", po::bool_switch()->default_value(false),
+             "estimate power spectral density of raw records (Welch method)")
+    ("psd-segment", po::value<unsigned>()->default_value(4096),
+             "length of spectrum segment (it is rounded up to power of two)")
+    ("psd-overlap", po::value<double>()->default_value(0.5),
+             "overlap of spectrum segments, part of segment length [0, 1)")
+    ("psd-window", po::value<std::string>()->default_value("hann"),
+             "window of spectrum segments: rect, hann, hamming, blackman")
+    ("psd-nominal", po::value<double>(),
+             "nominal frequency (Hz), records are converted into fractional "
+             "frequency and phase noise is calculated")
+    ("psd-export", po::value<std::string>(),
+             "path to CSV file, for exporting spectrum")
+    ("xcorr", po::value<std::string>(),
+             "path to the second capture, time lag between <in> and it is "
+             "estimated by cross-correlation")
+    ("xcorr-lag", po::value<unsigned>()->default_value(1000),
+             "the highest lag of cross-correlation (records)")
+    ("xcorr-export", po::value<std::string>(),
+             "path to CSV file, for exporting cross-correlation")
+    ("density", po::bool_switch()->default_value(false),
+             "draw density of values (heatmap) instead of the graph, it is "
+             "calculated from raw records, if they are kept, otherwise "
+             "from buckets")
+    ("publish", po::value<std::string>(),
+             "publish buckets into shared memory <publish> during loading, "
+             "so other processes can show them (please look at <attach>)")
+    ("attach", po::value<std::string>(),
+             "show buckets of shared memory <attach>, which are published "
+             "by another process, instead of loading file")
+    ("checkpoint", po::value<std::string>(),
+             "path to file, into which state of loading is periodically "
+             "saved (please look at <resume>)")
+    ("checkpoint-period", po::value<double>()->default_value(10),
+             "the lowest interval between checkpoints (seconds)")
+    ("resume", po::value<std::string>(),
+             "continue loading of <in> from the checkpoint, settings of "
+             "loading must be the same, consumers of raw records are not "
+             "supported")
+    ("export", po::value<std::string>(),
+             "path to file, for exporting records")
+    ("export-format", po::value<std::string>()->default_value("csv"),
+             "format of exported file: csv, bin (columnar)")
+    ("export-data", po::value<std::string>()->default_value("raw"),
+             "exported records: raw (during loading), buckets (compressed)");
 	po::variables_map vm;
 	po::store(po::parse_command_line(arg_amount, arg_values, desc), vm);
 	po::notify(vm);
@@ -22,6 +232,33 @@ bool ParseProgramArguments(int arg_amount, char **arg_values, Collector *out) {
 	  std::cout << desc << std::endl;
 	  return false;
 	}
+  gui->draw_density = vm["density"].as<bool>();
+  // all parallel jobs share the scheduler, so it is set up first
+  TaskScheduler::SetSharedThreads(vm["threads"].as<unsigned>());
+  if (vm.count("attach")) {
+    tasks->attach = vm["attach"].as<std::string>();
+    return true;
+  }
+  if (vm.count("hat")) {
+    try {
+      CorneredHat::Settings hat_opts;
+      hat_opts.tolerance = vm["hat-tolerance"].as<double>();
+      if (vm.count("hat-nominal")) {
+        hat_opts.nominal = vm["hat-nominal"].as<double>();
+      }
+      tasks->hat.reset(new CorneredHat(hat_opts));
+      for (const auto &desc : vm["hat"].as<std::vector<std::string>>()) {
+        AddHatPair(desc, tasks->hat.get());
+      }
+      if (vm.count("hat-export")) {
+        tasks->hat_export = vm["hat-export"].as<std::string>();
+      }
+    } catch (const std::exception &e) {
+      std::cout << e.what() << std::endl;
+      return false;
+    }
+    return true;
+  }
   if (not vm.count("in")) {
     std::cout << "You need to set <in> argument! Please look at <help>"
               << std::endl;
@@ -31,8 +268,206 @@ bool ParseProgramArguments(int arg_amount, char **arg_values, Collector *out) {
     std::cout << "Settings: \n"
               << " * file  : " << vm["in"].as<std::string>() << ";\n"
               << " * buffer: " << vm["bsize"].as<unsigned>() << " records;\n";
-    out->UseCompressor(new Compressor(vm["bsize"].as<unsigned>()));
-    out->UseDataSource(new FileDataSource(vm["in"].as<std::string>()));
+    AsyncFileDataSource::Settings async_opts;
+    async_opts.block_size  = vm["block-size"].as<unsigned>() << 10;
+    async_opts.queue_depth = vm["queue-depth"].as<unsigned>();
+    async_opts.direct      = vm["direct"].as<bool>();
+    if (vm["async"].as<bool>()) {
+      std::cout << " * asynchronous reading: " << async_opts.queue_depth
+                << " x " << vm["block-size"].as<unsigned>() << " KB"
+                << (async_opts.direct ? ", direct" : "") << ";\n";
+    }
+    const double kFrom = vm.count("from") ? vm["from"].as<double>()
+                                          : std::nan("");
+    const double kTo   = vm.count("to")   ? vm["to"].as<double>()
+                                          : std::nan("");
+    if (not std::isnan(kFrom) || not std::isnan(kTo)) {
+      std::cout << " * window: " << kFrom << " - " << kTo << ";\n";
+    }
+    auto create_source = [&vm, &async_opts, kFrom, kTo](
+        const std::string &path) {
+      VoidDataSource *source = 0;
+      if (vm["async"].as<bool>()) {
+        source = new AsyncFileDataSource(path, async_opts);
+      } else {
+        source = new FileDataSource(path);
+      }
+      source->SetTimeWindow(kFrom, kTo);
+      return source;
+    };
+    VoidDataSource *source = create_source(vm["in"].as<std::string>());
+    if (vm.count("reference")) {
+      if (vm["pipeline"].as<bool>() || vm.count("channels")) {
+        throw std::invalid_argument("Difference with reference does not "
+                                    "support <pipeline> and <channels>");
+      }
+      const auto kPath = vm["reference"].as<std::string>();
+      DifferenceDataSource::Settings diff_opts;
+      diff_opts.matching  = ParseMatching(vm["match"].as<std::string>());
+      diff_opts.tolerance = vm["tolerance"].as<double>();
+      std::cout << " * difference with reference: " << kPath << " ("
+                << vm["match"].as<std::string>() << ", tolerance "
+                << diff_opts.tolerance << " s);\n";
+      source = new DifferenceDataSource(source, create_source(kPath),
+                                        diff_opts);
+    }
+    auto comp = new Compressor(vm["bsize"].as<unsigned>());
+    if (vm["quantiles"].as<bool>()) {
+      std::cout << " * quantiles of buffer records are enabled;\n";
+      comp->UseQuantiles(true);
+    }
+    out->UseCompressor(comp);
+    if (vm.count("channels")) {
+      const auto kDesc = vm["channels"].as<std::string>();
+      std::cout << " * channels: " << kDesc << ";\n";
+      out->UseChannels(ParseChannels(kDesc));
+    }
+    out->UseDataSource(source);
+    if (vm["detect"].as<bool>()) {
+      std::cout << " * detection of events is enabled;\n";
+      out->UseDetector(new Detector());
+    }
+    if (vm["pipeline"].as<bool>()) {
+      std::cout << " * pipelined loading is enabled;\n";
+      out->UsePipeline(new LoadingPipeline());
+    }
+    if (vm.count("transform")) {
+      if (vm.count("channels")) {
+        throw std::invalid_argument("Transform of records does not "
+                                    "support <channels>");
+      }
+      const auto kDesc = vm["transform"].as<std::string>();
+      std::unique_ptr<TransformChain> chain(new TransformChain());
+      if (not chain->AddStages(kDesc)) {
+        throw std::invalid_argument(chain->GetMessage());
+      }
+      std::cout << " * transform: " << kDesc << ";\n";
+      out->UseTransform(chain.release());
+    }
+    if (vm.count("drift")) {
+      DriftEstimator::Settings drift_opts;
+      drift_opts.mode  = ParseDriftMode(vm["drift"].as<std::string>());
+      drift_opts.order = std::min(vm["drift-order"].as<unsigned>(),
+                                  (unsigned)DriftEstimator::kMaxOrder);
+      // raw records keep the drift, so views of them do not match buckets
+      const bool kRawKept = vm["compress-raw"].as<bool>() ||
+                            vm.count("mem-limit") || vm.count("xcorr") ||
+                            vm["psd"].as<bool>();
+      if (drift_opts.mode == DriftEstimator::kSubtract &&
+          (vm["psd"].as<bool>() || (vm["density"].as<bool>() && kRawKept))) {
+        throw std::invalid_argument("Drift is not subtracted from raw "
+                                    "records, so <drift> subtract does not "
+                                    "support <psd> and <density> of raw "
+                                    "records");
+      }
+      std::cout << " * drift: " << vm["drift"].as<std::string>()
+                << ", order " << (unsigned)drift_opts.order << ";\n";
+      out->UseDriftEstimator(new DriftEstimator(drift_opts));
+    }
+    if (vm["compress-raw"].as<bool>()) {
+      std::cout << " * raw records: compressed in memory;\n";
+      out->UseSampleStore(new CompressedSampleStore());
+    } else if (vm.count("mem-limit")) {
+      const size_t kLimit = vm["mem-limit"].as<unsigned>();
+      std::cout << " * raw records: " << kLimit << " MB in memory;\n";
+      out->UseSampleStore(new SpillSampleStore(kLimit << 20));
+    }
+    if (vm["psd"].as<bool>()) {
+      WelchPsd::Settings psd_opts;
+      psd_opts.segment_length = vm["psd-segment"].as<unsigned>();
+      psd_opts.overlap        = vm["psd-overlap"].as<double>();
+      if (vm.count("psd-nominal")) {
+        psd_opts.nominal = vm["psd-nominal"].as<double>();
+      }
+      if (not WelchPsd::ParseWindow(vm["psd-window"].as<std::string>(),
+                                    &psd_opts.window)) {
+        throw std::invalid_argument("Unknown window: "
+                                    + vm["psd-window"].as<std::string>());
+      }
+      std::cout << " * spectrum: segments of " << psd_opts.segment_length
+                << " records, " << vm["psd-window"].as<std::string>()
+                << " window;\n";
+      tasks->psd.reset(new WelchPsd(psd_opts));
+      if (vm.count("psd-export")) {
+        tasks->psd_export = vm["psd-export"].as<std::string>();
+      }
+      // spectrum is calculated from raw records
+      if (not out->GetSampleStore()) {
+        const size_t kDefaultLimit = 256;
+        out->UseSampleStore(new SpillSampleStore(kDefaultLimit << 20));
+      }
+    }
+    if (vm.count("xcorr")) {
+      const auto kPath = vm["xcorr"].as<std::string>();
+      CrossCorrelation::Settings xcorr_opts;
+      xcorr_opts.max_lag = vm["xcorr-lag"].as<unsigned>();
+      std::cout << " * cross-correlation with " << kPath << " (lags up to "
+                << xcorr_opts.max_lag << " records);\n";
+      tasks->xcorr.reset(new CrossCorrelation(xcorr_opts));
+      if (vm.count("xcorr-export")) {
+        tasks->xcorr_export = vm["xcorr-export"].as<std::string>();
+      }
+      // correlation is calculated from raw records of both captures
+      const size_t kDefaultLimit = 256;
+      if (not out->GetSampleStore()) {
+        out->UseSampleStore(new SpillSampleStore(kDefaultLimit << 20));
+      }
+      tasks->xcorr_input.reset(new Collector());
+      tasks->xcorr_input->UseCompressor(
+        new Compressor(vm["bsize"].as<unsigned>())
+      );
+      tasks->xcorr_input->UseDataSource(create_source(kPath));
+      tasks->xcorr_input->UseSampleStore(
+        new SpillSampleStore(kDefaultLimit << 20)
+      );
+    }
+    if (vm.count("publish")) {
+      const auto kName = vm["publish"].as<std::string>();
+      std::cout << " * buckets are published into shared memory " << kName
+                << ";\n";
+      out->UsePublisher(new SharedViewWriter(kName,
+                                             vm["bsize"].as<unsigned>()));
+    }
+    if (vm.count("checkpoint")) {
+      const auto   kPath   = vm["checkpoint"].as<std::string>();
+      const double kPeriod = vm["checkpoint-period"].as<double>();
+      std::cout << " * checkpoints: " << kPath << " (every " << kPeriod
+                << " s);\n";
+      out->UseCheckpoints(new CheckpointWriter(kPath, kPeriod));
+    }
+    if (vm.count("resume")) {
+      // states of these consumers are not saved into checkpoints
+      if (out->GetDetector() || out->GetTransform() ||
+          out->GetSampleStore() ||
+          (vm.count("export") &&
+           vm["export-data"].as<std::string>() == "raw")) {
+        throw std::invalid_argument("Loading from checkpoint does not "
+                                    "support <detect>, <transform>, "
+                                    "raw records (<compress-raw>, "
+                                    "<mem-limit>, <psd>, <xcorr>) and "
+                                    "<export> of raw records");
+      }
+      tasks->resume = vm["resume"].as<std::string>();
+      std::cout << " * loading is continued from " << tasks->resume << ";\n";
+    }
+    if (vm.count("export")) {
+      const auto kPath = vm["export"].as<std::string>();
+      const auto kData = vm["export-data"].as<std::string>();
+      auto exporter = CreateExporter(vm["export-format"].as<std::string>(),
+                                     kPath);
+      std::cout << " * export: " << kData << " records to " << kPath << ";\n";
+      if (kData == "raw") {
+        out->UseExporter(exporter);
+      } else if (kData == "buckets") {
+        tasks->buckets_exporter.reset(exporter);
+      } else {
+        delete exporter;
+        throw std::invalid_argument("Unknown exported data: " + kData);
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cout << e.what() << std::endl;
+    return false;
   } catch (...) {
     return false;
   }
@@ -46,22 +481,314 @@ void PrintCollectorMessages(const Collector::Messages &msgs) {
   });
 }
 
+static
+bool ExportBuckets(const Exporter::ShrPtr &exporter,
+                   const Compressor::ShrPtr &comp) {
+  std::cout << "Exporting buckets ..." << std::endl;
+  if (not exporter->Open(Exporter::GetBucketColumns()) ||
+      not exporter->WriteBuckets(comp->GetRecords()) ||
+      not exporter->Close()) {
+    std::cout << "Failed to export buckets: " << exporter->GetMessage()
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+static
+void PrintDetectedEvents(const Detector::ShrPtr &detector) {
+  const size_t kMaxPrinted = 20;
+  const auto &events = detector->GetEvents();
+  std::cout << "Detected events: " << events.size() << std::endl;
+  for (size_t i = 0; i < events.size() && i < kMaxPrinted; ++i) {
+    std::cout << "\t - " << GetEventTypeName(events[i].type)
+              << " at " << events[i].time
+              << " (line #" << events[i].line << ")" << std::endl;
+  }
+  if (events.size() > kMaxPrinted) {
+    std::cout << "\t ..." << std::endl;
+  }
+  if (detector->GetDroppedEvents() > 0) {
+    std::cout << "\t - " << detector->GetDroppedEvents()
+              << " events were not stored" << std::endl;
+  }
+}
+
+static
+void PrintStoreStatistics(const SampleStore::ShrPtr &store) {
+  std::cout << "Stored raw records: " << store->GetSize() << std::endl;
+  auto spill = std::dynamic_pointer_cast<SpillSampleStore>(store);
+  if (spill) {
+    std::cout << "\t - chunks in memory: " << spill->GetResidentChunks()
+              << " of " << spill->GetMaxResidentChunks() << std::endl
+              << "\t - moved into temporary file: "
+              << (spill->GetSpilledBytes() >> 20) << " MB" << std::endl;
+  }
+  auto compressed = std::dynamic_pointer_cast<CompressedSampleStore>(store);
+  if (compressed) {
+    const auto kStat = compressed->GetStatistics();
+    std::cout << "\t - compressed: " << (kStat.bytes >> 20) << " MB, "
+              << boost::format("%.2f") % kStat.GetBytesPerRecord()
+              << " bytes per record" << std::endl
+              << "\t - blocks with decimal values: " << kStat.decimal_blocks
+              << " of " << kStat.blocks << std::endl;
+  }
+}
+
+static
+void PrintDifferenceStatistics(const DifferenceDataSource &diff) {
+  const auto &stat = diff.GetStatistics();
+  std::cout << "Matched records: " << stat.matched << " of "
+            << stat.matched + stat.unmatched << std::endl;
+}
+
+static
+void PrintDriftEstimation(const DriftEstimator &drift) {
+  if (not drift.IsFitted()) {
+    return;
+  }
+  const auto &kTimes = drift.GetTimeRange();
+  std::cout << "Drift of values (" << drift.GetAmount() << " records):"
+            << std::endl
+            << "\t - rate: " << drift.GetRate(kTimes.first) << " per s";
+  if (drift.GetSettings().order > 1) {
+    std::cout << " at the beginning, " << drift.GetRate(kTimes.second)
+              << " per s at the end";
+  }
+  std::cout << std::endl
+            << "\t - total: " << drift.GetDrift(kTimes.second)
+            << ", residual RMS: " << drift.GetResidualRms() << std::endl;
+  if (drift.GetSettings().mode == DriftEstimator::kSubtract) {
+    std::cout << "\t - drift is subtracted from buckets" << std::endl;
+  }
+}
+
+static
+void PrintPipelineStatistics(const LoadingPipeline::ShrPtr &pipeline) {
+  const auto &stat = pipeline->GetStatistics();
+  const std::pair<const char*, const LoadingPipeline::StageStatistics*>
+  kStages[] = {
+    {"reader  ", &stat.reader},
+    {"parser  ", &stat.parser},
+    {"consumer", &stat.consumer}
+  };
+  std::cout << "Utilization of pipeline stages:" << std::endl;
+  for (const auto &stage : kStages) {
+    std::cout << "\t - " << stage.first << ": "
+              << (int)(stage.second->GetUtilization() * 100) << "% (busy "
+              << stage.second->busy << " s, waiting "
+              << stage.second->wait << " s)" << std::endl;
+  }
+}
+
+static
+bool CalculateSpectrum(const PostLoadTasks &tasks, SampleStore *store,
+                       ChartContent *content) {
+  std::cout << "Calculating spectrum ..." << std::endl;
+  WelchPsd &psd = *tasks.psd;
+  if (not psd.Calculate(store)) {
+    std::cout << "Failed to calculate spectrum: " << psd.GetMessage()
+              << std::endl;
+    return false;
+  }
+  std::cout << "\t - segments: " << psd.GetSegmentsAmount()
+            << ", sample rate: " << psd.GetSampleRate() << " Hz" << std::endl;
+  const auto kPhaseNoise = psd.GetPhaseNoise();
+  if (not tasks.psd_export.empty()) {
+    Exporter::Names   names   = {"frequency", "psd"};
+    Exporter::Columns columns = {psd.GetFrequencies(), psd.GetDensity()};
+    if (not kPhaseNoise.empty()) {
+      names.push_back("phase_noise");
+      columns.push_back(kPhaseNoise);
+    }
+    CsvExporter exporter(tasks.psd_export);
+    if (not exporter.WriteTable(names, columns)) {
+      std::cout << "Failed to export spectrum: " << exporter.GetMessage()
+                << std::endl;
+      return false;
+    }
+  }
+  LogLogPlot plot;
+  plot.title   = "Power spectral density";
+  plot.x_label = "Frequency, Hz";
+  plot.y_label = kPhaseNoise.empty() ? "PSD, units^2/Hz" : "PSD, 1/Hz";
+  plot.series.push_back({"PSD", psd.GetFrequencies(), psd.GetDensity()});
+  content->plots.push_back(plot);
+  return true;
+}
+
+static
+bool CalculateCrossCorrelation(const PostLoadTasks &tasks, bool loaded,
+                               SampleStore *store) {
+  const Collector &input = *tasks.xcorr_input;
+  if (not loaded) {
+    std::cout << "Failed to read records of the second capture: "
+              << std::endl;
+    PrintCollectorMessages(input.GetMessages());
+    return false;
+  }
+  std::cout << "Calculating cross-correlation ..." << std::endl;
+  CrossCorrelation &xcorr = *tasks.xcorr;
+  if (not xcorr.Calculate(store, input.GetSampleStore().get())) {
+    std::cout << "Failed to calculate cross-correlation: "
+              << xcorr.GetMessage() << std::endl;
+    return false;
+  }
+  std::cout << "\t - blocks: " << xcorr.GetBlocksAmount()
+            << ", sample rate: " << xcorr.GetSampleRate() << " Hz"
+            << std::endl;
+  std::cout << boost::format("\t - peak lag: %.3f records, delay: %.9g s, "
+                             "correlation: %.4f")
+               % xcorr.GetPeakLag() % xcorr.GetDelay()
+               % xcorr.GetPeakCorrelation() << std::endl;
+  if (not tasks.xcorr_export.empty()) {
+    CsvExporter exporter(tasks.xcorr_export);
+    if (not exporter.WriteTable({"lag", "correlation"},
+                                {xcorr.GetLagTimes(),
+                                 xcorr.GetCorrelation()})) {
+      std::cout << "Failed to export cross-correlation: "
+                << exporter.GetMessage() << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+static
+int ShowSharedView(const std::string &name, const GuiSettings &gui_opts) {
+  auto reader = std::make_shared<SharedViewReader>();
+  if (not reader->Attach(name)) {
+    std::cout << reader->GetMessage() << std::endl;
+    return 1;
+  }
+  std::cout << "Showing shared memory " << name << " ..." << std::endl;
+  ChartContent content;
+  // buckets are assigned by publications, so the limit is not used
+  content.comp.reset(new Compressor(reader->GetMaxRecords()));
+  content.live = reader;
+  CreateWindowWithChart(content, gui_opts);
+  return 0;
+}
+
+static
+int ShowCorneredHat(const PostLoadTasks &tasks, const GuiSettings &gui_opts) {
+  std::cout << "Calculating three-cornered hat ..." << std::endl;
+  CorneredHat &hat = *tasks.hat;
+  if (not hat.Calculate()) {
+    std::cout << "Failed to calculate three-cornered hat: "
+              << hat.GetMessage() << std::endl;
+    return 1;
+  }
+  std::cout << "\t - oscillators: " << hat.GetOscillatorsAmount()
+            << ", aligned records: " << hat.GetAlignedRecords()
+            << ", tau0: " << hat.GetSampleInterval() << " s" << std::endl;
+  Exporter::Names   names   = {"tau"};
+  Exporter::Columns columns = {hat.GetTaus()};
+  LogLogPlot plot;
+  plot.title   = "Three-cornered hat";
+  plot.x_label = "Tau, s";
+  plot.y_label = "Allan deviation";
+  for (size_t osc = 0; osc < hat.GetOscillatorsAmount(); ++osc) {
+    const auto kName = "osc_" + std::to_string(osc);
+    names.push_back(kName);
+    columns.push_back(hat.GetDeviations()[osc]);
+    plot.series.push_back({kName, hat.GetTaus(), hat.GetDeviations()[osc]});
+  }
+  for (size_t p = 0; p < hat.GetPairDeviations().size(); ++p) {
+    names.push_back("pair_" + std::to_string(p));
+    columns.push_back(hat.GetPairDeviations()[p]);
+  }
+  if (not tasks.hat_export.empty()) {
+    CsvExporter exporter(tasks.hat_export);
+    if (not exporter.WriteTable(names, columns)) {
+      std::cout << "Failed to export deviations: " << exporter.GetMessage()
+                << std::endl;
+      return 1;
+    }
+  }
+  ChartContent content;
+  content.comp.reset(new Compressor(1));
+  content.plots.push_back(plot);
+  CreateWindowWithChart(content, gui_opts);
+  return 0;
+}
+
 int main(int arg_amount, char **arg_values) {
-  Collector   cl;
-  GuiSettings gui_opts;
-  if (not ParseProgramArguments(arg_amount, arg_values, &cl)) {
+  Collector     cl;
+  GuiSettings   gui_opts;
+  ChartContent  content;
+  PostLoadTasks tasks;
+  if (not ParseProgramArguments(arg_amount, arg_values, &cl, &tasks,
+                             &gui_opts)) {
     return 0;
   }
+  if (not tasks.attach.empty()) {
+    return ShowSharedView(tasks.attach, gui_opts);
+  }
+  if (tasks.hat) {
+    return ShowCorneredHat(tasks, gui_opts);
+  }
   std::cout << "Loading records ..." << std::endl;
-  if (not cl.Begin() || not cl.FetchAllRecords()) {
+  // the second capture of correlation is loaded by workers meanwhile
+  TaskScheduler::Group xcorr_loading;
+  bool                 xcorr_loaded = false;
+  if (tasks.xcorr_input) {
+    TaskScheduler::GetShared().Run([&tasks, &xcorr_loaded]() {
+      Collector &input = *tasks.xcorr_input;
+      xcorr_loaded = input.Begin() && input.FetchAllRecords();
+      input.End();
+    }, TaskScheduler::kLowPriority, &xcorr_loading);
+  }
+  if (not cl.Begin() ||
+      (not tasks.resume.empty() && not cl.Resume(tasks.resume)) ||
+      not cl.FetchAllRecords()) {
     std::cout << "Failed to read records: " << std::endl;
     PrintCollectorMessages(cl.GetMessages());
     cl.End();
+    TaskScheduler::GetShared().Wait(&xcorr_loading);
     return 1;
   }
   cl.End();
+  TaskScheduler::GetShared().Wait(&xcorr_loading);
+  if (tasks.buckets_exporter &&
+      not ExportBuckets(tasks.buckets_exporter, cl.GetCompressor())) {
+    return 1;
+  }
   std::cout << "Drawing graph ... " << std::endl;
   PrintCollectorMessages(cl.GetMessages());
-  CreateWindowWithChart(cl.GetCompressor(), gui_opts);
+  content.comp     = cl.GetCompressor();
+  content.detector = cl.GetDetector();
+  content.store    = cl.GetSampleStore();
+  for (size_t ch = 1; ch < cl.GetChannelsAmount(); ++ch) {
+    content.channels.push_back(cl.GetCompressor(ch));
+  }
+  if (content.detector) {
+    PrintDetectedEvents(content.detector);
+  }
+  auto diff = std::dynamic_pointer_cast<DifferenceDataSource>(
+    cl.GetDataSource()
+  );
+  if (diff) {
+    PrintDifferenceStatistics(*diff);
+  }
+  if (cl.GetPipeline()) {
+    PrintPipelineStatistics(cl.GetPipeline());
+  }
+  if (cl.GetSampleStore()) {
+    PrintStoreStatistics(cl.GetSampleStore());
+  }
+  if (cl.GetDriftEstimator()) {
+    PrintDriftEstimation(*cl.GetDriftEstimator());
+  }
+  if (tasks.psd &&
+      not CalculateSpectrum(tasks, cl.GetSampleStore().get(), &content)) {
+    return 1;
+  }
+  if (tasks.xcorr &&
+      not CalculateCrossCorrelation(tasks, xcorr_loaded,
+                                    cl.GetSampleStore().get())) {
+    return 1;
+  }
+  CreateWindowWithChart(content, gui_opts);
   return 0;
 }
\ No newline at end of file
@@ -1,26 +1,60 @@
 #include <gtkmm.h>
 #include <gtkmm/drawingarea.h>
 #include <boost/format.hpp>
+#include <list>
+#include <memory>
+#include <atomic>
 #include "demo_gui.hpp"
+#include "collector/density_map.hpp"
+#include "collector/scheduler.hpp"
 
 GuiSettings::GuiSettings()
-    : draw_scales(true) {
+    : draw_scales(true),
+      draw_events(true),
+      draw_quantiles(true),
+      refresh_period(200),
+      draw_density(false) {
+}
+
+ChartContent::ChartContent() {
 }
 
 class ChartArea : public Gtk::DrawingArea {
   public:
-    ChartArea(const Compressor::ShrPtr &ptr, 
-              const GuiSettings        &settings)
+    ChartArea(const ChartContent &content,
+              const GuiSettings  &settings)
         : Gtk::DrawingArea(),
-          _comp(ptr),
-          _settings(settings) {
+          _comp(content.comp),
+          _detector(content.detector),
+          _channels(content.channels),
+          _store(content.store),
+          _settings(settings),
+          _density_stale(true),
+          _density_restart(false),
+          _density_running(false),
+          _density_cancel(false),
+          _density_ok(false) {
       auto layout = create_pango_layout("0.0");
       int text_width;
       int text_height;
       layout->get_pixel_size(text_width, text_height);
       _label_h = std::abs(text_height / 2);
+      _density_want[0] = _density_want[1] = 0;
+      _density_size[0] = _density_size[1] = 0;
+      _density_ready.connect(sigc::mem_fun(*this, &ChartArea::OnDensityReady));
+    }
+    virtual ~ChartArea() {
+      _density_cancel = true;
+      TaskScheduler::GetShared().Wait(&_density_job);
+    }
+    /**
+     * Method for redrawing after changing of compressor (by shared view),
+     * density is calculated again.
+     */
+    void Update() {
+      _density_stale = true;
+      queue_draw();
     }
-    virtual ~ChartArea() {}
   protected:
     typedef Cairo::RefPtr<Cairo::Context> ContextRef;
 
@@ -29,14 +63,35 @@ class ChartArea : public Gtk::DrawingArea {
       _wnd_w = allocation.get_width();
       _wnd_h = allocation.get_height();
       DrawBackground(ctx_ref);
+      // shared view can be empty until the first publication
+      if (_comp->GetRecords().empty()) {
+        return true;
+      }
+      if (_settings.draw_density) {
+        DrawDensity(ctx_ref);
+      }
       if (_settings.draw_scales) {
         DrawScales(ctx_ref);
       }
-      DrawGraph(ctx_ref);
+      if (_settings.draw_density) {
+        // density replaces the graph and the band of quantiles
+      } else if (_settings.draw_quantiles && _comp->IsQuantilesUsed()) {
+        DrawQuantiles(ctx_ref);
+      }
+      if (not _settings.draw_density) {
+        DrawGraph(ctx_ref);
+      }
+      if (_settings.draw_events && _detector) {
+        DrawEvents(ctx_ref);
+      }
       return true;
     }
   private:
-    static const uint16_t kVPadding = 10;
+    static const uint16_t kVPadding    = 10;
+    static const uint16_t kEventRadius = 4;
+    static constexpr double kBandLow    = 0.05;
+    static constexpr double kMedian     = 0.5;
+    static constexpr double kBandHigh   = 0.95;
 
     void DrawBackground(const ContextRef &ctx) {
       ctx->set_source_rgb(0.1, 0.1, 0.1);
@@ -44,6 +99,95 @@ class ChartArea : public Gtk::DrawingArea {
       ctx->fill();
     }
 
+    /**
+     * Method for drawing density of values. Density is calculated by
+     * another thread only for new size of chart or new compressor state,
+     * until it is ready the previous image is stretched.
+     */
+    void DrawDensity(const ContextRef &ctx) {
+      const unsigned kWidth  = _wnd_w;
+      const unsigned kHeight = _wnd_h > kVPadding ? _wnd_h - kVPadding : 0;
+      if (_density_stale || _density_want[0] != kWidth ||
+          _density_want[1] != kHeight) {
+        _density_stale   = false;
+        _density_want[0] = kWidth;
+        _density_want[1] = kHeight;
+        RequestDensity();
+      }
+      if (not _density_image) {
+        return;
+      }
+      ctx->save();
+      ctx->translate(0, kVPadding);
+      ctx->scale((double)kWidth  / _density_size[0],
+                 (double)kHeight / _density_size[1]);
+      ctx->set_source(_density_image, 0, 0);
+      ctx->paint();
+      ctx->restore();
+    }
+
+    void RequestDensity() {
+      if (_density_running) {
+        // running calculation is obsolete, it is restarted when finished
+        _density_cancel  = true;
+        _density_restart = true;
+        return;
+      }
+      if (_density_want[0] == 0 || _density_want[1] == 0) {
+        return;
+      }
+      _density_cancel  = false;
+      _density_running = true;
+      // compressor can be changed by GUI thread, so job has its own copy
+      auto comp  = std::make_shared<Compressor>(*_comp);
+      auto store = _store;
+      const unsigned kWidth  = _density_want[0];
+      const unsigned kHeight = _density_want[1];
+      // the picture is waited by user, so it goes before batch jobs
+      TaskScheduler::GetShared().Run([this, comp, store, kWidth, kHeight]() {
+        DensityMap map;
+        map.Reset(kWidth, kHeight, comp->GetTimeScale(),
+                  comp->GetValueScale());
+        _density_ok = true;
+        if (store) {
+          _density_ok = map.AddRecords(store.get(), 0, &_density_cancel);
+        } else {
+          map.AddBuckets(*comp);
+        }
+        if (_density_ok) {
+          const int kStride = Cairo::ImageSurface::format_stride_for_width(
+            Cairo::FORMAT_RGB24, kWidth
+          );
+          _density_next.resize(kStride / sizeof(uint32_t) * kHeight);
+          map.ToImage(_density_next.data(), kStride / sizeof(uint32_t));
+          _density_next_size[0] = kWidth;
+          _density_next_size[1] = kHeight;
+        }
+        _density_ready.emit();
+      }, TaskScheduler::kHighPriority, &_density_job);
+    }
+
+    void OnDensityReady() {
+      _density_running = false;
+      if (_density_ok) {
+        // the previous surface is released together with its pixels
+        _density_pixels.swap(_density_next);
+        _density_size[0] = _density_next_size[0];
+        _density_size[1] = _density_next_size[1];
+        _density_image = Cairo::ImageSurface::create(
+          (unsigned char*)_density_pixels.data(), Cairo::FORMAT_RGB24,
+          _density_size[0], _density_size[1],
+          Cairo::ImageSurface::format_stride_for_width(Cairo::FORMAT_RGB24,
+                                                       _density_size[0])
+        );
+      }
+      if (_density_restart) {
+        _density_restart = false;
+        RequestDensity();
+      }
+      queue_draw();
+    }
+
     void DrawScales(const ContextRef &ctx) {
       auto records = _comp->GetRecords();
       const uint16_t kScaleLines  = 50;
@@ -75,8 +219,13 @@ class ChartArea : public Gtk::DrawingArea {
     }
 
     uint8_t RecToGraphPoints(const Compressor::Record &rec, uint16_t out[2][2]) {
+      return RecToGraphPoints(*_comp, rec, out);
+    }
+
+    uint8_t RecToGraphPoints(const Compressor &comp,
+                             const Compressor::Record &rec, uint16_t out[2][2]) {
       Compressor::Range ratio[2];
-      const auto kNum = _comp->CastRecordToScales(rec, ratio);
+      const auto kNum = comp.CastRecordToScales(rec, ratio);
       auto i = 0;
       for (; i < kNum; ++i) {
         out[i][0] = (uint16_t)(ratio[i].first * _wnd_w);
@@ -85,14 +234,87 @@ class ChartArea : public Gtk::DrawingArea {
       return i;
     }
 
+    bool QuantileToGraphPoint(const Compressor::Record &rec, double q,
+                              double out[2]) {
+      Compressor::Range ratio;
+      if (not _comp->CastQuantileToScales(rec, q, &ratio)) {
+        return false;
+      }
+      out[0] = ratio.first * _wnd_w;
+      out[1] = _wnd_h - ratio.second * (_wnd_h - kVPadding);
+      return true;
+    }
+
+    void DrawQuantiles(const ContextRef &ctx) {
+      const auto &records = _comp->GetRecords();
+      double pt[2];
+      // band is drawn forward by the high quantile and back by the low one
+      bool started = false;
+      for (auto rec_it = records.begin(); rec_it != records.end(); ++rec_it) {
+        if (not QuantileToGraphPoint(*rec_it, kBandHigh, pt)) {
+          continue;
+        }
+        if (started) {
+          ctx->line_to(pt[0], pt[1]);
+        } else {
+          ctx->move_to(pt[0], pt[1]);
+          started = true;
+        }
+      }
+      for (auto rec_it = records.rbegin(); rec_it != records.rend(); ++rec_it) {
+        if (QuantileToGraphPoint(*rec_it, kBandLow, pt)) {
+          ctx->line_to(pt[0], pt[1]);
+        }
+      }
+      if (not started) {
+        return;
+      }
+      ctx->close_path();
+      ctx->set_source_rgba(0.3, 0.5, 0.9, 0.35);
+      ctx->fill();
+      started = false;
+      for (const auto &rec : records) {
+        if (not QuantileToGraphPoint(rec, kMedian, pt)) {
+          continue;
+        }
+        if (started) {
+          ctx->line_to(pt[0], pt[1]);
+        } else {
+          ctx->move_to(pt[0], pt[1]);
+          started = true;
+        }
+      }
+      ctx->set_source_rgb(0.5, 0.7, 1.0);
+      ctx->stroke();
+    }
+
     void DrawGraph(const ContextRef &ctx) {
-      typedef Compressor::Record::List RecList;
-      auto records = _comp->GetRecords();
+      // other channels are drawn under the main one
+      const double kColors[][3] = {
+        {0.2, 0.8, 0.9},
+        {0.4, 0.9, 0.3},
+        {0.9, 0.3, 0.8},
+        {0.9, 0.9, 0.9}
+      };
+      const size_t kColorsNum = sizeof(kColors) / sizeof(kColors[0]);
+      for (size_t i = 0; i < _channels.size(); ++i) {
+        const auto &color = kColors[i % kColorsNum];
+        DrawChannel(ctx, *_channels[i]);
+        ctx->set_source_rgb(color[0], color[1], color[2]);
+        ctx->stroke();
+      }
+      DrawChannel(ctx, *_comp);
+      ctx->set_source_rgb(1, (float)167 / 256, (float)9 / 256);
+      ctx->stroke();
+    }
+
+    void DrawChannel(const ContextRef &ctx, const Compressor &comp) {
+      const auto &records = comp.GetRecords();
       auto rec_it  = records.begin();
       uint16_t pt[2][2];
       uint8_t  prev_num = 0;
       for (; rec_it != records.end(); ++rec_it) {
-        const auto kNum = RecToGraphPoints(*rec_it, pt);
+        const auto kNum = RecToGraphPoints(comp, *rec_it, pt);
         for (auto i = 0; i < kNum; ++i) {
           if (prev_num == 0) {
             ctx->move_to(pt[i][0], pt[i][1]);  
@@ -103,26 +325,253 @@ class ChartArea : public Gtk::DrawingArea {
         }
         prev_num = kNum;
       }
-      ctx->set_source_rgb(1, (float)167 / 256, (float)9 / 256);
+    }
+
+    void DrawEvents(const ContextRef &ctx) {
+      typedef Detector::Event Event;
+      const auto &events = _detector->GetEvents();
+      std::vector<double> dashes = {4, 4};
+      uint16_t pt[2][2];
+      // gaps are drawn as vertical lines through the whole chart
+      ctx->save();
+      ctx->set_dash(dashes, 0);
+      for (auto ev = events.begin(); ev != events.end(); ++ev) {
+        if (ev->type == Event::kGap &&
+            RecToGraphPoints(Compressor::Record(ev->time, ev->value), pt)) {
+          ctx->move_to(pt[0][0], 0);
+          ctx->line_to(pt[0][0], _wnd_h);
+        }
+      }
+      ctx->set_source_rgb(0.5, 0.5, 0.5);
       ctx->stroke();
+      ctx->restore();
+      // glitches and phase jumps are drawn as circles at the first record
+      const Event::Type kMarked[] = {Event::kGlitch, Event::kPhaseJump};
+      for (auto type : kMarked) {
+        for (auto ev = events.begin(); ev != events.end(); ++ev) {
+          if (ev->type == type &&
+              RecToGraphPoints(Compressor::Record(ev->time, ev->value), pt)) {
+            ctx->move_to(pt[0][0] + kEventRadius, pt[0][1]);
+            ctx->arc(pt[0][0], pt[0][1], kEventRadius, 0, 2 * M_PI);
+          }
+        }
+        if (type == Event::kGlitch) {
+          ctx->set_source_rgb(0.9, 0.2, 0.2);
+        } else {
+          ctx->set_source_rgb(0.2, 0.8, 0.9);
+        }
+        ctx->stroke();
+      }
     }
 
     unsigned           _wnd_w;
     unsigned           _wnd_h;
     Compressor::ShrPtr _comp;
+    Detector::ShrPtr   _detector;
+    std::vector<Compressor::ShrPtr> _channels;
+    SampleStore::ShrPtr _store;
     GuiSettings        _settings;
     unsigned           _label_h;
+    // density is calculated by the task "_density_job", which fills
+    // "_density_next" and notifies GUI thread by "_density_ready"
+    unsigned           _density_want[2];
+    unsigned           _density_size[2];
+    unsigned           _density_next_size[2];
+    bool               _density_stale;
+    bool               _density_restart;
+    bool               _density_running;
+    std::atomic<bool>  _density_cancel;
+    bool               _density_ok;
+    TaskScheduler::Group _density_job;
+    Glib::Dispatcher   _density_ready;
+    std::vector<uint32_t> _density_pixels;
+    std::vector<uint32_t> _density_next;
+    Cairo::RefPtr<Cairo::ImageSurface> _density_image;
+};
+
+class PlotArea : public Gtk::DrawingArea {
+  public:
+    PlotArea(const LogLogPlot &plot)
+        : Gtk::DrawingArea(),
+          _plot(plot) {
+    }
+    virtual ~PlotArea() {}
+  protected:
+    typedef Cairo::RefPtr<Cairo::Context> ContextRef;
+
+    bool on_draw(const ContextRef &ctx_ref) override {
+      Gtk::Allocation allocation = get_allocation();
+      _wnd_w = allocation.get_width();
+      _wnd_h = allocation.get_height();
+      ctx_ref->set_source_rgb(0.1, 0.1, 0.1);
+      ctx_ref->rectangle(0, 0, _wnd_w, _wnd_h);
+      ctx_ref->fill();
+      if (not CalculateDecades()) {
+        return true;
+      }
+      DrawScales(ctx_ref);
+      DrawSeries(ctx_ref);
+      return true;
+    }
+  private:
+    static const uint16_t kPadding = 60;
+
+    /**
+     * Method for calculating ranges of scales, they are rounded to the
+     * whole decades.
+     * @return false if there are no positive values.
+     */
+    bool CalculateDecades() {
+      double min_x = INFINITY, max_x = -INFINITY;
+      double min_y = INFINITY, max_y = -INFINITY;
+      for (const auto &ser : _plot.series) {
+        for (size_t i = 0; i < ser.x.size() && i < ser.y.size(); ++i) {
+          if (ser.x[i] > 0 && ser.y[i] > 0) {
+            min_x = std::min(min_x, ser.x[i]);
+            max_x = std::max(max_x, ser.x[i]);
+            min_y = std::min(min_y, ser.y[i]);
+            max_y = std::max(max_y, ser.y[i]);
+          }
+        }
+      }
+      if (not std::isfinite(min_x) || not std::isfinite(min_y)) {
+        return false;
+      }
+      _dec_x[0] = std::floor(std::log10(min_x));
+      _dec_x[1] = std::max(std::ceil(std::log10(max_x)), _dec_x[0] + 1);
+      _dec_y[0] = std::floor(std::log10(min_y));
+      _dec_y[1] = std::max(std::ceil(std::log10(max_y)), _dec_y[0] + 1);
+      return true;
+    }
+
+    double ToX(double x) const {
+      const double kW = _wnd_w - 2.0 * kPadding;
+      return kPadding
+           + (std::log10(x) - _dec_x[0]) / (_dec_x[1] - _dec_x[0]) * kW;
+    }
+
+    double ToY(double y) const {
+      const double kH = _wnd_h - 2.0 * kPadding;
+      return _wnd_h - kPadding
+           - (std::log10(y) - _dec_y[0]) / (_dec_y[1] - _dec_y[0]) * kH;
+    }
+
+    void DrawScales(const ContextRef &ctx) {
+      // lines of decades and their subdivisions
+      for (double dec = _dec_x[0]; dec < _dec_x[1]; ++dec) {
+        for (int i = 1; i < 10; ++i) {
+          const double kX = ToX(i * std::pow(10.0, dec));
+          ctx->move_to(kX, kPadding);
+          ctx->line_to(kX, _wnd_h - kPadding);
+        }
+      }
+      for (double dec = _dec_y[0]; dec < _dec_y[1]; ++dec) {
+        for (int i = 1; i < 10; ++i) {
+          const double kY = ToY(i * std::pow(10.0, dec));
+          ctx->move_to(kPadding,          kY);
+          ctx->line_to(_wnd_w - kPadding, kY);
+        }
+      }
+      ctx->set_source_rgb(0.15, 0.15, 0.15);
+      ctx->stroke();
+      ctx->set_source_rgb(0.5, 0.5, 0.5);
+      for (double dec = _dec_x[0]; dec <= _dec_x[1]; ++dec) {
+        ctx->move_to(ToX(std::pow(10.0, dec)) - 10, _wnd_h - kPadding + 15);
+        ctx->show_text(boost::str(boost::format("1e%d") % (int)dec));
+      }
+      for (double dec = _dec_y[0]; dec <= _dec_y[1]; ++dec) {
+        ctx->move_to(5, ToY(std::pow(10.0, dec)) + 4);
+        ctx->show_text(boost::str(boost::format("1e%d") % (int)dec));
+      }
+      ctx->move_to(kPadding, kPadding / 2);
+      ctx->show_text(_plot.title);
+      ctx->move_to(_wnd_w / 2, _wnd_h - kPadding / 4);
+      ctx->show_text(_plot.x_label);
+      ctx->save();
+      ctx->move_to(15, _wnd_h / 2);
+      ctx->rotate(M_PI / -2);
+      ctx->show_text(_plot.y_label);
+      ctx->restore();
+    }
+
+    void DrawSeries(const ContextRef &ctx) {
+      const double kColors[][3] = {
+        {1, (float)167 / 256, (float)9 / 256},
+        {0.2, 0.8, 0.9},
+        {0.9, 0.2, 0.2},
+        {0.4, 0.9, 0.3}
+      };
+      const size_t kColorsNum = sizeof(kColors) / sizeof(kColors[0]);
+      for (size_t s = 0; s < _plot.series.size(); ++s) {
+        const auto &ser   = _plot.series[s];
+        const auto &color = kColors[s % kColorsNum];
+        bool drawing = false;
+        for (size_t i = 0; i < ser.x.size() && i < ser.y.size(); ++i) {
+          if (not (ser.x[i] > 0 && ser.y[i] > 0)) {
+            drawing = false;
+            continue;
+          }
+          if (drawing) {
+            ctx->line_to(ToX(ser.x[i]), ToY(ser.y[i]));
+          } else {
+            ctx->move_to(ToX(ser.x[i]), ToY(ser.y[i]));
+            drawing = true;
+          }
+        }
+        ctx->set_source_rgb(color[0], color[1], color[2]);
+        ctx->stroke();
+        ctx->move_to(_wnd_w - 2 * kPadding, kPadding / 2 + 12 * s);
+        ctx->show_text(ser.name);
+      }
+    }
+
+    unsigned   _wnd_w;
+    unsigned   _wnd_h;
+    LogLogPlot _plot;
+    double     _dec_x[2];
+    double     _dec_y[2];
 };
 
-void CreateWindowWithChart(const Compressor::ShrPtr &comp_ptr,
-                           const GuiSettings        &settings) {
+void CreateWindowWithChart(const ChartContent &content,
+                           const GuiSettings  &settings) {
   int    args = 0;
   char **argv = 0;
   auto app = Gtk::Application::create(args, argv, "org.gtkmm.examples.base");
   Gtk::Window window;
-  ChartArea   area(comp_ptr, settings);
+  ChartArea   area(content, settings);
   window.set_default_size(800, 600);
-  window.add(area);
-  area.show();
+  sigc::connection refresh;
+  if (content.live) {
+    refresh = Glib::signal_timeout().connect([&content, &area, &window]() {
+      SharedViewReader::Statistics stat;
+      if (content.live->HasNewVersion() &&
+          content.live->Read(content.comp.get(), &stat)) {
+        window.set_title(boost::str(boost::format("%u records%s")
+          % stat.pushed % (stat.finished ? "" : " (loading)")
+        ));
+        area.Update();
+      }
+      return true;
+    }, settings.refresh_period);
+  }
+  if (content.plots.empty()) {
+    window.add(area);
+    area.show();
+    app->run(window);
+    refresh.disconnect();
+    return;
+  }
+  // records and analysis results are placed on pages of notebook
+  Gtk::Notebook                        notebook;
+  std::list<std::unique_ptr<PlotArea>> plot_areas;
+  notebook.append_page(area, "Records");
+  for (const auto &plot : content.plots) {
+    plot_areas.emplace_back(new PlotArea(plot));
+    notebook.append_page(*plot_areas.back(), plot.title);
+  }
+  window.add(notebook);
+  notebook.show_all_children();
+  notebook.show();
   app->run(window);
+  refresh.disconnect();
 }
\ No newline at end of file
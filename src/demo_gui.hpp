@@ -2,12 +2,47 @@
 #define DEMO_GUI_HPP
 
 #include "collector/compressor.hpp"
+#include "collector/detector.hpp"
+#include "collector/shared_view.hpp"
+#include "collector/sample_store.hpp"
 
 struct GuiSettings {
   GuiSettings();
   bool draw_scales;
+  bool draw_events;
+  bool draw_quantiles; // p5 - p95 band and median, if compressor has them
+  unsigned refresh_period; // ms, period of checking shared view
+  bool draw_density; // density of values (heatmap) instead of the graph
 };
 
-void CreateWindowWithChart(const Compressor::ShrPtr &comp_ptr,
-                           const GuiSettings        &settings);
+/**
+ * Curves of analysis results (spectra, deviations), which are drawn with
+ * logarithmic scales. Non positive values are skipped.
+ */
+struct LogLogPlot {
+  struct Series {
+    std::string         name;
+    std::vector<double> x;
+    std::vector<double> y;
+  };
+  std::string         title;
+  std::string         x_label;
+  std::string         y_label;
+  std::vector<Series> series;
+};
+
+struct ChartContent {
+  ChartContent();
+  Compressor::ShrPtr      comp;
+  Detector::ShrPtr        detector;
+  std::vector<Compressor::ShrPtr> channels; // other channels, own scales
+  std::vector<LogLogPlot> plots; // every plot is drawn on its own page
+  SampleStore::ShrPtr     store; // raw records for density, without them
+                                 // density is calculated from buckets
+  SharedViewReader::ShrPtr live; // publications of another process are
+                                 // read into "comp" and drawn
+};
+
+void CreateWindowWithChart(const ChartContent &content,
+                           const GuiSettings  &settings);
 #endif
\ No newline at end of file
@@ -0,0 +1,132 @@
+#include <chrono>
+#include <iostream>
+#include <functional>
+#include <cmath>
+#include "../src/collector/collector.hpp"
+#include "../src/collector/cornered_hat.hpp"
+#include "test_capture.hpp"
+
+/**
+ * Benchmark of loading loop: "Collector" (virtual calls) versus
+ * "BasicCollector" with static types of data source and compressor, and
+ * scaling of the task scheduler from 1 to <threads> threads.
+ * Usage: bench_collector [amount of records] [repetitions] [threads]
+ */
+typedef std::function<bool(const std::string &path)> LoadFunc;
+
+static
+double MeasureBest(const std::string &path, size_t repeats,
+                   const LoadFunc &load) {
+  double best = -1;
+  for (size_t i = 0; i < repeats; ++i) {
+    const auto kStart = std::chrono::steady_clock::now();
+    if (not load(path)) {
+      std::cout << "Failed to load records" << std::endl;
+      return -1;
+    }
+    const double kTime = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - kStart
+    ).count();
+    if (best < 0 || kTime < best) {
+      best = kTime;
+    }
+  }
+  return best;
+}
+
+template <class Coll>
+static
+bool Load(Coll *cl) {
+  const bool kOk = cl->Begin() && cl->FetchAllRecords();
+  cl->End();
+  return kOk;
+}
+
+/**
+ * Function for measuring batch job (Allan variance of many taus) by the
+ * scheduler with the given amount of threads.
+ * @return the best time (seconds).
+ */
+static
+double MeasureScheduler(size_t threads, size_t repeats,
+                        const std::vector<double> &phase) {
+  const size_t  kTasks = 256;
+  TaskScheduler scheduler(threads);
+  double        best = -1;
+  for (size_t i = 0; i < repeats; ++i) {
+    std::vector<double>  vars(kTasks);
+    TaskScheduler::Group group;
+    const auto kStart = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < kTasks; ++t) {
+      scheduler.Run([&phase, &vars, t]() {
+        vars[t] = CorneredHat::CalculateAllanVariance(phase.data(),
+                                                      phase.size(),
+                                                      t % 64 + 1, 1);
+      }, TaskScheduler::kLowPriority, &group);
+    }
+    scheduler.Wait(&group);
+    const double kTime = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - kStart
+    ).count();
+    if (best < 0 || kTime < best) {
+      best = kTime;
+    }
+  }
+  return best;
+}
+
+int main(int arg_amount, char **arg_values) {
+  const size_t kRecords = arg_amount > 1 ? std::stoul(arg_values[1])
+                                         : 2000000;
+  const size_t kRepeats = arg_amount > 2 ? std::stoul(arg_values[2]) : 5;
+  const size_t kThreads = arg_amount > 3 ? std::stoul(arg_values[3]) : 64;
+  TestCapture capture("bench_collector");
+  for (size_t i = 0; i < kRecords; ++i) {
+    capture.AddRecord(i * 0.01, 1e7 + std::sin(0.001 * i));
+  }
+  capture.Close();
+  const LoadFunc kLoaders[] = {
+    [](const std::string &path) {
+      Collector cl;
+      cl.UseCompressor(new Compressor(800));
+      cl.UseDataSource(new FileDataSource(path));
+      return Load(&cl);
+    },
+    [](const std::string &path) {
+      BasicCollector<FileDataSource, Compressor> cl;
+      cl.UseCompressor(new Compressor(800));
+      cl.UseDataSource(new FileDataSource(path));
+      return Load(&cl);
+    }
+  };
+  const char *kNames[] = {
+    "Collector (virtual calls)",
+    "BasicCollector<FileDataSource, Compressor> (static calls)"
+  };
+  std::cout << "Records: " << kRecords << ", best of " << kRepeats
+            << std::endl;
+  for (size_t i = 0; i < 2; ++i) {
+    const double kTime = MeasureBest(capture.path, kRepeats, kLoaders[i]);
+    std::cout << kNames[i] << ": " << kTime * 1e3 << " ms, "
+              << kRecords / kTime * 1e-6 << " M records/s" << std::endl;
+  }
+  // the calling thread does not execute low priority tasks, so workers
+  // of the scheduler are the only threads of the job
+  std::vector<double> phase(kRecords / 4);
+  for (size_t i = 1; i < phase.size(); ++i) {
+    phase[i] = phase[i - 1] + std::sin(0.001 * i);
+  }
+  std::cout << "Scheduler (hardware threads: "
+            << std::thread::hardware_concurrency() << ")" << std::endl;
+  double single = -1;
+  for (size_t threads = 1; threads <= kThreads; threads *= 2) {
+    const double kTime = MeasureScheduler(threads, kRepeats, phase);
+    if (single < 0) {
+      single = kTime;
+    }
+    std::cout << "  " << threads << " threads: " << kTime * 1e3
+              << " ms, speedup " << single / kTime << ", efficiency "
+              << single / kTime / threads << std::endl;
+  }
+  return 0;
+}
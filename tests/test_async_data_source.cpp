@@ -0,0 +1,113 @@
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include "../src/collector/collector.hpp"
+#include "test_capture.hpp"
+
+struct AsyncDataSourceTestFixture {
+  AsyncDataSourceTestFixture()
+      : capture("async_source") {
+    for (size_t i = 0; i < kRecords; ++i) {
+      capture.AddRecord(i * 0.01, 1e7 + std::sin(0.1 * i));
+      if (i == 777) {
+        capture.AddLine("");
+        capture.AddLine("broken line");
+      }
+    }
+    // the last line has no line feed
+    capture.AddLine("1e4 5");
+    capture.Close();
+    // removing the last line feed
+    const auto kSize = ReadAll(capture.path).size();
+    BOOST_REQUIRE(::truncate(capture.path.c_str(), kSize - 1) == 0);
+  }
+
+  static std::string ReadAll(const std::string &path) {
+    std::ifstream in(path, std::ios_base::binary);
+    return std::string(std::istreambuf_iterator<char>(in),
+                       std::istreambuf_iterator<char>());
+  }
+
+  static const size_t kRecords = 20000;
+  TestCapture capture;
+};
+// -----------------------------------------------------------------------------
+// Инициализация набора тестов
+BOOST_FIXTURE_TEST_SUITE(AsyncDataSourceTestSuite, AsyncDataSourceTestFixture)
+
+BOOST_AUTO_TEST_CASE(AsyncSameRecordsTest) {
+  std::string expected_msg;
+  FileDataSource file(capture.path);
+  std::vector<VoidDataSource::Record> expected;
+  BOOST_REQUIRE(LoadRecords(&file, &expected, &expected_msg));
+  BOOST_REQUIRE_EQUAL(expected.size(), kRecords + 1);
+  BOOST_CHECK(not expected_msg.empty());
+  const AsyncFileDataSource::Backend kBackends[] = {
+    AsyncFileDataSource::kAutoBackend,
+    AsyncFileDataSource::kPreadBackend
+  };
+  for (const auto kBackend : kBackends) {
+    for (const bool kDirect : {false, true}) {
+      AsyncFileDataSource::Settings settings;
+      // small blocks, so many lines cross borders of blocks
+      settings.block_size  = 5000;
+      settings.queue_depth = 3;
+      settings.direct      = kDirect;
+      settings.backend     = kBackend;
+      AsyncFileDataSource async(capture.path, settings);
+      std::string msg;
+      std::vector<VoidDataSource::Record> recs;
+      BOOST_REQUIRE(LoadRecords(&async, &recs, &msg));
+      BOOST_CHECK_EQUAL(msg, expected_msg);
+      BOOST_REQUIRE_EQUAL(recs.size(), expected.size());
+      for (size_t i = 0; i < recs.size(); ++i) {
+        BOOST_REQUIRE_EQUAL(recs[i].time,  expected[i].time);
+        BOOST_REQUIRE_EQUAL(recs[i].value, expected[i].value);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(AsyncWindowTest) {
+  AsyncFileDataSource async(capture.path);
+  async.SetTimeWindow(50.005, 60);
+  std::string msg;
+  std::vector<VoidDataSource::Record> recs;
+  BOOST_REQUIRE(LoadRecords(&async, &recs, &msg));
+  BOOST_REQUIRE_EQUAL(recs.size(), 1000);
+  BOOST_CHECK_CLOSE(recs.front().time, 50.01, 1e-9);
+  BOOST_CHECK(async.GetBackendName().empty());
+  AsyncFileDataSource missing("/tmp/orolia_missing_file.txt");
+  VoidDataSource *missing_src = &missing;
+  BOOST_CHECK(not missing_src->OccupySource());
+  BOOST_CHECK(not missing.GetMessage().empty());
+}
+
+BOOST_AUTO_TEST_CASE(AsyncFailureTest) {
+  // failed reading is not the end of records, loading fails
+  TestCapture broken("async_broken");
+  for (int i = 0; i < 1000; ++i) {
+    broken.AddRecord(i * 0.01, 1e7);
+  }
+  broken.AddLine(std::string(1000, '1'));
+  broken.AddRecord(10, 1e7);
+  broken.Close();
+  // in the pipelined mode the error is passed from the reading thread
+  // to the parsing one with lines
+  for (bool pipelined : {false, true}) {
+    Collector cl;
+    cl.UseCompressor(new Compressor(100));
+    cl.UseDataSource(new AsyncFileDataSource(broken.path));
+    if (pipelined) {
+      cl.UsePipeline(new LoadingPipeline(100, 4));
+    }
+    BOOST_REQUIRE(cl.Begin());
+    BOOST_CHECK(not cl.FetchAllRecords());
+    cl.End();
+    BOOST_CHECK_EQUAL(cl.GetCompressor()->GetPushedRecords(), 1000);
+    BOOST_REQUIRE_EQUAL(cl.GetMessages().size(), 1);
+    BOOST_CHECK_EQUAL(cl.GetMessages().front(),
+                      "Too long line in file: " + broken.path);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
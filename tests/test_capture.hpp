@@ -0,0 +1,97 @@
+#ifndef TEST_CAPTURE_HPP
+#define TEST_CAPTURE_HPP
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <unistd.h>
+#include "../src/collector/compressor.hpp"
+
+/**
+ * Helper for creating temporary capture files in TimeView32 format.
+ * File is removed in destructor.
+ */
+class TestCapture {
+  public:
+    TestCapture(const std::string &name,
+                const std::string &dir     = "/tmp",
+                const std::string &type    = "FREQUENCY A",
+                const std::string &start   = "MON May 12 13:13:23 2003",
+                const std::string &ref_osc = "Internal")
+        : path(dir + "/orolia_test_" + name + "_"
+               + std::to_string(::getpid()) + ".txt"),
+          _out(path) {
+      _out << "# Pendulum Instruments AB, TimeView32 V1.01\n"
+           << "# " << type << "\n"
+           << "# " << start << "\n"
+           << "# Measuring time: 10 ms                       Single: Off\n"
+           << "# Input A: Auto, 1M., AC, X1, Pos             Filter: Off\n"
+           << "# Input B: Auto, 1M., AC, X1, Pos             Common: On\n"
+           << "# Ext.arm: Off                                Ref.osc: "
+           << ref_osc << "\n"
+           << "# Hold off: Off                               Statistics: Off\n";
+      _out.precision(13);
+      _out << std::scientific;
+    }
+    ~TestCapture() {
+      std::remove(path.c_str());
+    }
+    void AddRecord(double time, double value) {
+      _out << time << " " << value << "\n";
+    }
+    void AddLine(const std::string &line) {
+      _out << line << "\n";
+    }
+    void Close() {
+      _out.close();
+    }
+    const std::string path;
+  private:
+    std::ofstream _out;
+};
+
+/**
+ * Compressor, which fails after "limit" pushed records.
+ */
+class LimitedCompressor : public Compressor {
+  public:
+    LimitedCompressor(size_t limit)
+        : Compressor(100),
+          _limit(limit) {
+    }
+    virtual bool PushRecord(Record &&new_rec) {
+      if (GetPushedRecords() >= _limit) {
+        SetMessage("Limit of records");
+        return false;
+      }
+      return Compressor::PushRecord(std::move(new_rec));
+    }
+  private:
+    const size_t _limit;
+};
+
+/**
+ * Function for reading all records of the source without collector.
+ * @param msg message of the source after reading, it may be null;
+ * @return false if the source can not be occupied or has invalid header.
+ */
+inline
+bool LoadRecords(VoidDataSource *src, std::vector<VoidDataSource::Record> *out,
+                 std::string *msg = 0) {
+  VoidDataSource::Record rec;
+  if (not src->OccupySource() || not src->GetHeader().IsValid()) {
+    return false;
+  }
+  while (not src->IsAtTheEnd()) {
+    if (src->GetRecord(&rec)) {
+      out->push_back(rec);
+    }
+  }
+  if (msg) {
+    *msg = src->GetMessage();
+  }
+  src->ReleaseSource();
+  return true;
+}
+#endif
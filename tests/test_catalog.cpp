@@ -0,0 +1,133 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+#include <cmath>
+#include "../src/collector/catalog.hpp"
+#include "test_capture.hpp"
+
+struct CatalogTestFixture {
+  CatalogTestFixture()
+      : dir("/tmp/orolia_test_catalog_" + std::to_string(::getpid())),
+        index(dir + ".idx") {
+    boost::filesystem::create_directories(dir + "/may");
+    boost::filesystem::create_directories(dir + "/june");
+  }
+  ~CatalogTestFixture() {
+    boost::filesystem::remove_all(dir);
+    std::remove(index.c_str());
+  }
+
+  static void Fill(TestCapture *capture, double from, size_t amount) {
+    for (size_t i = 0; i < amount; ++i) {
+      capture->AddRecord(from + i * 0.01, 1e7);
+    }
+    capture->Close();
+  }
+
+  static CaptureCatalog::Entries Find(const CaptureCatalog &catalog,
+                                      const std::string &type,
+                                      const std::string &ref_osc) {
+    CaptureCatalog::Query query;
+    query.type    = type;
+    query.ref_osc = ref_osc;
+    return catalog.Find(query);
+  }
+
+  const std::string dir;
+  const std::string index;
+};
+// -----------------------------------------------------------------------------
+// Инициализация набора тестов
+BOOST_FIXTURE_TEST_SUITE(CatalogTestSuite, CatalogTestFixture)
+
+BOOST_AUTO_TEST_CASE(StartTimeTest) {
+  BOOST_CHECK_EQUAL(CaptureCatalog::ParseStartTime("MON May 12 13:13:23 2003"),
+                    1052745203.0);
+  BOOST_CHECK(std::isnan(CaptureCatalog::ParseStartTime("yesterday")));
+}
+
+BOOST_AUTO_TEST_CASE(ReadEntryTest) {
+  TestCapture capture("entry", dir, "TIME INTERVAL A-B",
+                      "TUE Jun 3 10:00:00 2003", "External");
+  Fill(&capture, 5.0, 1000);
+  CaptureCatalog::Entry entry;
+  BOOST_REQUIRE(CaptureCatalog::ReadEntry(capture.path, &entry));
+  BOOST_CHECK(entry.valid);
+  BOOST_CHECK_EQUAL(entry.size, boost::filesystem::file_size(capture.path));
+  BOOST_CHECK_EQUAL(entry.header.type_of_measurement, "TIME INTERVAL A-B");
+  BOOST_CHECK_EQUAL(entry.header.ref_osc, "External");
+  BOOST_CHECK_CLOSE(entry.first_time, 5.0, 1e-9);
+  BOOST_CHECK_CLOSE(entry.last_time, 5.0 + 999 * 0.01, 1e-9);
+  BOOST_CHECK_CLOSE(entry.GetDuration(), 9.99, 1e-6);
+  // file without header
+  std::ofstream(dir + "/junk.txt") << "some text\n";
+  BOOST_REQUIRE(CaptureCatalog::ReadEntry(dir + "/junk.txt", &entry));
+  BOOST_CHECK(not entry.valid);
+  BOOST_CHECK(not CaptureCatalog::ReadEntry(dir + "/absent.txt", &entry));
+}
+
+BOOST_AUTO_TEST_CASE(ScanAndQueryTest) {
+  TestCapture may_int("may_int", dir + "/may", "FREQUENCY A",
+                      "MON May 12 13:13:23 2003", "Internal");
+  TestCapture may_ext("may_ext", dir + "/may", "FREQUENCY A",
+                      "TUE May 13 08:00:00 2003", "External");
+  TestCapture june_ext("june_ext", dir + "/june", "FREQUENCY A",
+                       "MON Jun 2 08:00:00 2003", "External");
+  TestCapture june_ti("june_ti", dir + "/june", "TIME INTERVAL A-B",
+                      "MON Jun 2 09:00:00 2003", "External");
+  Fill(&may_int,  0, 100);
+  Fill(&may_ext,  0, 5000);
+  Fill(&june_ext, 0, 100);
+  Fill(&june_ti,  0, 100);
+  std::ofstream(dir + "/notes.md") << "# not a capture\n";
+  CaptureCatalog catalog;
+  BOOST_REQUIRE(catalog.Scan(dir, ".txt", 4));
+  BOOST_CHECK_EQUAL(catalog.GetSize(), 4);
+  BOOST_CHECK_EQUAL(catalog.GetScanStatistics().read, 4);
+  // all FREQUENCY A captures with external reference from May
+  CaptureCatalog::Query query;
+  query.type       = "frequency a";
+  query.ref_osc    = "external";
+  query.start_from = CaptureCatalog::ParseStartTime("THU May 1 00:00:00 2003");
+  query.start_to   = CaptureCatalog::ParseStartTime("SUN Jun 1 00:00:00 2003");
+  auto found = catalog.Find(query);
+  BOOST_REQUIRE_EQUAL(found.size(), 1);
+  BOOST_CHECK_EQUAL(found[0].path, may_ext.path);
+  BOOST_CHECK_EQUAL(Find(catalog, "", "External").size(), 3);
+  query = CaptureCatalog::Query();
+  query.min_duration = 10;
+  BOOST_CHECK_EQUAL(catalog.Find(query).size(), 1);
+  // persistence
+  BOOST_REQUIRE(catalog.Save(index));
+  CaptureCatalog loaded;
+  BOOST_REQUIRE(loaded.Load(index));
+  BOOST_CHECK_EQUAL(loaded.GetSize(), 4);
+  found = Find(loaded, "TIME INTERVAL", "");
+  BOOST_REQUIRE_EQUAL(found.size(), 1);
+  BOOST_CHECK_EQUAL(found[0].path, june_ti.path);
+  BOOST_CHECK_EQUAL(found[0].header.input_a, "Auto, 1M., AC, X1, Pos");
+  BOOST_CHECK(found[0].header.common);
+  BOOST_CHECK_CLOSE(found[0].last_time, 0.99, 1e-9);
+  // rescanning reads only changed and new files
+  std::remove(june_ext.path.c_str());
+  TestCapture added("added", dir + "/june");
+  Fill(&added, 0, 10);
+  BOOST_REQUIRE(loaded.Scan(dir, ".txt", 2));
+  const auto &stat = loaded.GetScanStatistics();
+  BOOST_CHECK_EQUAL(stat.files,     4);
+  BOOST_CHECK_EQUAL(stat.read,      1);
+  BOOST_CHECK_EQUAL(stat.unchanged, 3);
+  BOOST_CHECK_EQUAL(stat.removed,   1);
+  BOOST_CHECK_EQUAL(loaded.GetSize(), 4);
+  BOOST_CHECK_EQUAL(Find(loaded, "", "External").size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(InvalidIndexTest) {
+  CaptureCatalog catalog;
+  BOOST_CHECK(not catalog.Load(index));
+  std::ofstream(index) << "# orolia capture catalog v1\nbroken\tline\n";
+  BOOST_CHECK(not catalog.Load(index));
+  BOOST_CHECK(not catalog.GetMessage().empty());
+  BOOST_CHECK(not catalog.Scan(dir + "/absent"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,258 @@
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include "../src/collector/collector.hpp"
+#include "test_capture.hpp"
+
+/**
+ * Compressor, which fails like killed process after the limit of records.
+ */
+class FailingCompressor : public Compressor {
+  public:
+    FailingCompressor(uint32_t max_size, size_t limit)
+        : Compressor(max_size),
+          _limit(limit) {
+    }
+    virtual bool PushRecord(Record &&new_rec) {
+      if (GetPushedRecords() >= _limit) {
+        SetMessage("Loading is interrupted");
+        return false;
+      }
+      return Compressor::PushRecord(std::move(new_rec));
+    }
+  private:
+    const size_t _limit;
+};
+
+struct CheckpointTestFixture {
+  CheckpointTestFixture()
+      : capture("checkpoint"),
+        path(capture.path + ".ckpt") {
+    for (int i = 0; i < kAmount; ++i) {
+      capture.AddRecord(0.01 * i, 1e7 + std::sin(0.001 * i) + (i % 13) * 0.1);
+      if (i == 5000) {
+        capture.AddLine("broken line");
+      }
+    }
+    capture.Close();
+  }
+  ~CheckpointTestFixture() {
+    std::remove(path.c_str());
+  }
+
+  // second values of single records are NaN
+  static bool IsSame(const std::pair<double, double> &a,
+                     const std::pair<double, double> &b) {
+    return a.first == b.first &&
+           (a.second == b.second ||
+            (std::isnan(a.second) && std::isnan(b.second)));
+  }
+
+  static void CheckSame(const Compressor &expected, const Compressor &comp) {
+    BOOST_CHECK_EQUAL(comp.GetPushedRecords(), expected.GetPushedRecords());
+    BOOST_CHECK(comp.GetTimeScale()  == expected.GetTimeScale());
+    BOOST_CHECK(comp.GetValueScale() == expected.GetValueScale());
+    const auto &kExpected = expected.GetRecords();
+    const auto &kRecords  = comp.GetRecords();
+    BOOST_REQUIRE_EQUAL(kRecords.size(), kExpected.size());
+    auto exp_it = kExpected.begin();
+    for (const auto &rec : kRecords) {
+      BOOST_REQUIRE(IsSame(rec.time,  exp_it->time));
+      BOOST_REQUIRE(IsSame(rec.value, exp_it->value));
+      BOOST_REQUIRE_EQUAL(rec.amount,       exp_it->amount);
+      if (expected.IsQuantilesUsed()) {
+        BOOST_REQUIRE_EQUAL(rec.GetQuantile(0.5), exp_it->GetQuantile(0.5));
+      }
+      ++exp_it;
+    }
+  }
+
+  static const int kAmount = 100000;
+  TestCapture       capture;
+  const std::string path;
+};
+// -----------------------------------------------------------------------------
+// Инициализация набора тестов
+BOOST_FIXTURE_TEST_SUITE(CheckpointTestSuite, CheckpointTestFixture)
+
+BOOST_AUTO_TEST_CASE(CompressorStateTest) {
+  Compressor original(30);
+  Compressor restored(30);
+  for (int i = 0; i < 1000; ++i) {
+    BOOST_REQUIRE(original.PushRecord(Compressor::Record(i, i % 7)));
+  }
+  Compressor::State state;
+  original.GetState(&state);
+  BOOST_REQUIRE(restored.SetState(std::move(state)));
+  // merging continues from the same record
+  for (int i = 1000; i < 3000; ++i) {
+    BOOST_REQUIRE(original.PushRecord(Compressor::Record(i, i % 7)));
+    BOOST_REQUIRE(restored.PushRecord(Compressor::Record(i, i % 7)));
+  }
+  CheckSame(original, restored);
+  // state with too many records
+  Compressor small(10);
+  original.GetState(&state);
+  BOOST_CHECK(not small.SetState(std::move(state)));
+}
+
+BOOST_AUTO_TEST_CASE(FileTest) {
+  Checkpoint saved;
+  saved.max_size  = 100;
+  saved.quantiles = true;
+  saved.channels  = {2, 0};
+  saved.messages  = {"first", "second"};
+  saved.source.offset    = 12345;
+  saved.source.line      = 77;
+  saved.source.prev_time = 0.5;
+  Compressor comp(100);
+  comp.UseQuantiles(true);
+  for (int i = 0; i < 500; ++i) {
+    BOOST_REQUIRE(comp.PushRecord(Compressor::Record(i, i % 11)));
+  }
+  saved.comps.resize(1);
+  comp.GetState(&saved.comps[0]);
+  BOOST_REQUIRE(saved.Save(path));
+  Checkpoint loaded;
+  BOOST_REQUIRE_MESSAGE(loaded.Load(path), loaded.GetMessage());
+  BOOST_CHECK_EQUAL(loaded.max_size, 100);
+  BOOST_CHECK(loaded.quantiles);
+  BOOST_CHECK(loaded.channels == saved.channels);
+  BOOST_CHECK(loaded.messages == saved.messages);
+  BOOST_CHECK_EQUAL(loaded.source.offset,    12345);
+  BOOST_CHECK_EQUAL(loaded.source.line,      77);
+  BOOST_CHECK_EQUAL(loaded.source.prev_time, 0.5);
+  BOOST_REQUIRE_EQUAL(loaded.comps.size(), 1);
+  Compressor restored(100);
+  restored.UseQuantiles(true);
+  BOOST_REQUIRE(restored.SetState(std::move(loaded.comps[0])));
+  CheckSame(comp, restored);
+  // damaged file is not loaded
+  BOOST_REQUIRE(::truncate(path.c_str(), 100) == 0);
+  BOOST_CHECK(not loaded.Load(path));
+  BOOST_CHECK(not loaded.Load(path + ".none"));
+}
+
+BOOST_AUTO_TEST_CASE(ResumeTest) {
+  Collector whole;
+  whole.UseCompressor(new Compressor(100));
+  whole.GetCompressor()->UseQuantiles(true);
+  whole.UseDataSource(new FileDataSource(capture.path));
+  BOOST_REQUIRE(whole.Begin() && whole.FetchAllRecords());
+  whole.End();
+  // the first loading is interrupted after several checkpoints
+  Collector first;
+  first.UseCompressor(new FailingCompressor(100, 70000));
+  first.GetCompressor()->UseQuantiles(true);
+  first.UseDataSource(new FileDataSource(capture.path));
+  first.UseCheckpoints(new CheckpointWriter(path, 0));
+  BOOST_REQUIRE(first.Begin());
+  BOOST_CHECK(not first.FetchAllRecords());
+  first.End();
+  BOOST_CHECK(first.GetCheckpoints()->GetWritten() > 0);
+  // checkpoint is not applied to another file
+  TestCapture changed("checkpoint_changed");
+  changed.AddRecord(0, 1e7);
+  changed.Close();
+  Collector another;
+  another.UseCompressor(new Compressor(100));
+  another.GetCompressor()->UseQuantiles(true);
+  another.UseDataSource(new FileDataSource(changed.path));
+  BOOST_REQUIRE(another.Begin());
+  BOOST_CHECK(not another.Resume(path));
+  another.End();
+  BOOST_REQUIRE(not another.GetMessages().empty());
+  BOOST_CHECK_EQUAL(another.GetMessages().back(),
+                    "File of data source is changed after saving of position");
+  // settings of loading must be the same
+  Collector other;
+  other.UseCompressor(new Compressor(200));
+  other.UseDataSource(new FileDataSource(capture.path));
+  BOOST_REQUIRE(other.Begin());
+  BOOST_CHECK(not other.Resume(path));
+  other.End();
+  // the same amount of channels, but another selection
+  Collector selected;
+  selected.UseCompressor(new Compressor(100));
+  selected.GetCompressor()->UseQuantiles(true);
+  selected.UseChannels({0});
+  selected.UseDataSource(new FileDataSource(capture.path));
+  BOOST_REQUIRE(selected.Begin());
+  BOOST_CHECK(not selected.Resume(path));
+  selected.End();
+  // state of detector is not saved, so it would miss earlier records
+  Collector detected;
+  detected.UseCompressor(new Compressor(100));
+  detected.GetCompressor()->UseQuantiles(true);
+  detected.UseDataSource(new FileDataSource(capture.path));
+  detected.UseDetector(new Detector());
+  BOOST_REQUIRE(detected.Begin());
+  BOOST_CHECK(not detected.Resume(path));
+  detected.End();
+  BOOST_REQUIRE(not detected.GetMessages().empty());
+  BOOST_CHECK_EQUAL(detected.GetMessages().back(),
+                    "Loading with detector, exporter, storage or "
+                    "transformation is not continued from checkpoint");
+  Collector second;
+  second.UseCompressor(new Compressor(100));
+  second.GetCompressor()->UseQuantiles(true);
+  second.UseDataSource(new FileDataSource(capture.path));
+  second.UseCheckpoints(new CheckpointWriter(path, 0));
+  BOOST_REQUIRE(second.Begin());
+  BOOST_REQUIRE(second.Resume(path));
+  BOOST_CHECK(second.GetCompressor()->GetPushedRecords() < 70000);
+  BOOST_REQUIRE(second.FetchAllRecords());
+  second.End();
+  CheckSame(*whole.GetCompressor(), *second.GetCompressor());
+  // the final checkpoint has the whole state
+  Checkpoint final;
+  BOOST_REQUIRE(final.Load(path));
+  BOOST_CHECK_EQUAL(final.comps.at(0).pushed, (uint64_t)kAmount);
+}
+
+BOOST_AUTO_TEST_CASE(DriftResumeTest) {
+  DriftEstimator::Settings opts;
+  opts.order = 2;
+  opts.mode  = DriftEstimator::kSubtract;
+  Collector whole;
+  whole.UseCompressor(new Compressor(100));
+  whole.UseDataSource(new FileDataSource(capture.path));
+  whole.UseDriftEstimator(new DriftEstimator(opts));
+  BOOST_REQUIRE(whole.Begin() && whole.FetchAllRecords());
+  whole.End();
+  Collector first;
+  first.UseCompressor(new FailingCompressor(100, 70000));
+  first.UseDataSource(new FileDataSource(capture.path));
+  first.UseDriftEstimator(new DriftEstimator(opts));
+  first.UseCheckpoints(new CheckpointWriter(path, 0));
+  BOOST_REQUIRE(first.Begin());
+  BOOST_CHECK(not first.FetchAllRecords());
+  first.End();
+  // estimator of drift must be used by both loadings
+  Collector plain;
+  plain.UseCompressor(new Compressor(100));
+  plain.UseDataSource(new FileDataSource(capture.path));
+  BOOST_REQUIRE(plain.Begin());
+  BOOST_CHECK(not plain.Resume(path));
+  plain.End();
+  // the fit includes records before the checkpoint
+  Collector second;
+  second.UseCompressor(new Compressor(100));
+  second.UseDataSource(new FileDataSource(capture.path));
+  second.UseDriftEstimator(new DriftEstimator(opts));
+  BOOST_REQUIRE(second.Begin());
+  BOOST_REQUIRE(second.Resume(path));
+  BOOST_REQUIRE(second.FetchAllRecords());
+  second.End();
+  const DriftEstimator &kExpected = *whole.GetDriftEstimator();
+  const DriftEstimator &kDrift    = *second.GetDriftEstimator();
+  BOOST_REQUIRE(kDrift.IsFitted());
+  BOOST_CHECK_EQUAL(kDrift.GetAmount(), kExpected.GetAmount());
+  BOOST_CHECK(kDrift.GetTimeRange() == kExpected.GetTimeRange());
+  for (uint8_t p = 0; p <= DriftEstimator::kMaxOrder; ++p) {
+    BOOST_CHECK_EQUAL(kDrift.GetCoefficient(p), kExpected.GetCoefficient(p));
+  }
+  BOOST_CHECK_EQUAL(kDrift.GetResidualRms(), kExpected.GetResidualRms());
+  CheckSame(*whole.GetCompressor(), *second.GetCompressor());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
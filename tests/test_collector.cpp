@@ -0,0 +1,82 @@
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include "../src/collector/collector.hpp"
+#include "test_capture.hpp"
+
+struct CollectorTestFixture {
+  CollectorTestFixture()
+      : capture("collector") {
+    for (size_t i = 0; i < 10000; ++i) {
+      capture.AddRecord(i * 0.01, 1e7 + std::sin(0.01 * i));
+    }
+    capture.Close();
+  }
+
+  TestCapture capture;
+};
+// -----------------------------------------------------------------------------
+// Инициализация набора тестов
+BOOST_FIXTURE_TEST_SUITE(CollectorTestSuite, CollectorTestFixture)
+
+BOOST_AUTO_TEST_CASE(CollectorStaticDispatchTest) {
+  Collector dyn;
+  dyn.UseCompressor(new Compressor(50));
+  dyn.UseDataSource(new FileDataSource(capture.path));
+  BasicCollector<FileDataSource, Compressor> st;
+  st.UseCompressor(new Compressor(50));
+  st.UseDataSource(new FileDataSource(capture.path));
+  BOOST_REQUIRE(dyn.Begin() && dyn.FetchAllRecords());
+  BOOST_REQUIRE(st.Begin() && st.FetchAllRecords());
+  dyn.End();
+  st.End();
+  const auto &dyn_recs = dyn.GetCompressor()->GetRecords();
+  const auto &st_recs  = st.GetCompressor()->GetRecords();
+  BOOST_REQUIRE_EQUAL(dyn_recs.size(), st_recs.size());
+  auto st_it = st_recs.begin();
+  for (const auto &rec : dyn_recs) {
+    BOOST_CHECK_EQUAL(rec.time.first,  st_it->time.first);
+    BOOST_CHECK_EQUAL(rec.value.first, st_it->value.first);
+    BOOST_CHECK_EQUAL(rec.amount,      st_it->amount);
+    ++st_it;
+  }
+  BOOST_CHECK(st.GetDataSource()->GetTimeIndex().GetEntries().size() > 0);
+}
+
+BOOST_AUTO_TEST_CASE(CollectorChannelsTest) {
+  TestCapture multi("collector_channels");
+  for (size_t i = 0; i < 10000; ++i) {
+    multi.AddLine(std::to_string(i * 0.01) + " " + std::to_string(i) + " "
+                  + std::to_string(-(double)i) + " "
+                  + std::to_string(2.0 * i));
+  }
+  multi.Close();
+  Collector cl;
+  cl.UseCompressor(new Compressor(50));
+  cl.UseDataSource(new FileDataSource(multi.path));
+  cl.UseChannels({2, 0});
+  BOOST_REQUIRE(cl.Begin() && cl.FetchAllRecords());
+  cl.End();
+  BOOST_REQUIRE_EQUAL(cl.GetChannelsAmount(), 2);
+  BOOST_CHECK(not cl.GetCompressor(2));
+  const auto &doubled = cl.GetCompressor(0)->GetRecords();
+  const auto &first   = cl.GetCompressor(1)->GetRecords();
+  // buckets of channels have the same time ranges
+  BOOST_REQUIRE_EQUAL(doubled.size(), first.size());
+  auto first_it = first.begin();
+  for (const auto &rec : doubled) {
+    BOOST_CHECK_EQUAL(rec.time.first, first_it->time.first);
+    BOOST_CHECK_EQUAL(rec.amount,     first_it->amount);
+    BOOST_CHECK_EQUAL(rec.value.first, 2.0 * first_it->value.first);
+    ++first_it;
+  }
+  // several channels can not be loaded by pipeline
+  Collector pip;
+  pip.UseCompressor(new Compressor(50));
+  pip.UseDataSource(new FileDataSource(multi.path));
+  pip.UsePipeline(new LoadingPipeline());
+  pip.UseChannels({0, 1});
+  BOOST_CHECK(not pip.Begin());
+  BOOST_CHECK_EQUAL(pip.GetMessages().size(), 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
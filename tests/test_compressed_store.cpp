@@ -0,0 +1,166 @@
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include "../src/collector/compressed_store.hpp"
+
+struct CompressedStoreTestFixture {
+  typedef VoidDataSource::Record Record;
+  typedef std::vector<Record>    Records;
+
+  static const uint32_t kBlockRecords = 1000;
+
+  /**
+   * Method for converting number into text and back, as it is done for
+   * captures by the counter and by the data source.
+   */
+  static double Reparse(double value) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.13e", value);
+    return std::strtod(text, 0);
+  }
+
+  static Records MakeCapture(size_t amount, double noise, double drift) {
+    std::mt19937 gen(7);
+    std::normal_distribution<double> noise_dist(0, noise);
+    Records recs(amount);
+    for (size_t i = 0; i < amount; ++i) {
+      recs[i].time  = Reparse(0.01 * i);
+      recs[i].value = Reparse(1e7 + drift * std::sin(1e-4 * i)
+                              + noise_dist(gen));
+    }
+    return recs;
+  }
+
+  static bool IsSame(double left, double right) {
+    return std::memcmp(&left, &right, sizeof(double)) == 0;
+  }
+
+  static void Fill(const Records &recs, SampleStore *out) {
+    for (const auto &rec : recs) {
+      BOOST_REQUIRE(out->PushRecord(rec));
+    }
+  }
+
+  static void CheckRecords(const Records &expected, uint64_t first,
+                           const Records &recs, size_t amount) {
+    for (size_t i = 0; i < amount; ++i) {
+      BOOST_REQUIRE(IsSame(recs[i].time,  expected[first + i].time));
+      BOOST_REQUIRE(IsSame(recs[i].value, expected[first + i].value));
+    }
+  }
+};
+// -----------------------------------------------------------------------------
+// Инициализация набора тестов
+BOOST_FIXTURE_TEST_SUITE(CompressedStoreTestSuite, CompressedStoreTestFixture)
+
+BOOST_AUTO_TEST_CASE(DecimalCodingTest) {
+  const Records kDrifting = MakeCapture(100500, 0.001, 5);
+  const Records kNoisy    = MakeCapture(100500, 0.3,   0);
+  for (const auto *expected : {&kDrifting, &kNoisy}) {
+    CompressedSampleStore store(kBlockRecords);
+    Fill(*expected, &store);
+    BOOST_REQUIRE_EQUAL(store.GetSize(), expected->size());
+    Records recs(expected->size());
+    BOOST_REQUIRE_EQUAL(store.ReadRecords(0, recs.data(), recs.size()),
+                        recs.size());
+    CheckRecords(*expected, 0, recs, recs.size());
+    const auto kStat = store.GetStatistics();
+    BOOST_CHECK_EQUAL(kStat.records, expected->size());
+    BOOST_CHECK_EQUAL(kStat.blocks, 100);
+    BOOST_CHECK_EQUAL(kStat.decimal_blocks, 100);
+  }
+  // slowly changing values take 2 - 3 bytes, white noise of 14 digits can
+  // not be compressed so much
+  CompressedSampleStore drifting(kBlockRecords);
+  CompressedSampleStore noisy(kBlockRecords);
+  Fill(kDrifting, &drifting);
+  Fill(kNoisy,    &noisy);
+  BOOST_CHECK_LT(drifting.GetStatistics().GetBytesPerRecord(), 3);
+  BOOST_CHECK_LT(noisy.GetStatistics().GetBytesPerRecord(),    4.5);
+}
+
+BOOST_AUTO_TEST_CASE(XorCodingTest) {
+  Records expected(5432);
+  for (size_t i = 0; i < expected.size(); ++i) {
+    expected[i] = Record(0.001 * i * i, std::sin(0.001 * i) + i);
+  }
+  expected[10].value   = std::numeric_limits<double>::quiet_NaN();
+  expected[11].value   = -0.0;
+  expected[12].value   = HUGE_VAL;
+  expected[2000].value = expected[2001].value;
+  expected[2500].time  = expected[2499].time;
+  CompressedSampleStore store(kBlockRecords);
+  Fill(expected, &store);
+  Records recs(expected.size());
+  BOOST_REQUIRE_EQUAL(store.ReadRecords(0, recs.data(), recs.size()),
+                      recs.size());
+  CheckRecords(expected, 0, recs, recs.size());
+  BOOST_CHECK_EQUAL(store.GetStatistics().decimal_blocks, 0);
+  BOOST_CHECK_LT(store.GetStatistics().GetBytesPerRecord(), 16);
+}
+
+BOOST_AUTO_TEST_CASE(RandomAccessTest) {
+  const Records kExpected = MakeCapture(50321, 0.01, 1);
+  CompressedSampleStore store(kBlockRecords, 3);
+  Fill(kExpected, &store);
+  std::mt19937 gen(17);
+  std::uniform_int_distribution<uint64_t> pos_dist(0, kExpected.size() - 1);
+  Records recs(6000);
+  for (int i = 0; i < 200; ++i) {
+    const uint64_t kFirst  = pos_dist(gen);
+    const size_t   kAmount = 1 + pos_dist(gen) % recs.size();
+    const size_t   kRead   = store.ReadRecords(kFirst, recs.data(), kAmount);
+    BOOST_REQUIRE_EQUAL(kRead, std::min<uint64_t>(kAmount,
+                                                  kExpected.size() - kFirst));
+    CheckRecords(kExpected, kFirst, recs, kRead);
+  }
+  BOOST_CHECK_EQUAL(store.ReadRecords(kExpected.size(), recs.data(), 1), 0);
+  // searching in compressed blocks and in the last block
+  BOOST_CHECK_EQUAL(store.FindRecord(-1.0), 0);
+  BOOST_CHECK_EQUAL(store.FindRecord(kExpected[12345].time), 12345);
+  BOOST_CHECK_EQUAL(store.FindRecord(kExpected[12345].time - 0.005), 12345);
+  BOOST_CHECK_EQUAL(store.FindRecord(kExpected[50100].time), 50100);
+  BOOST_CHECK_EQUAL(store.FindRecord(1e9), kExpected.size());
+  Compressor comp(100);
+  BOOST_REQUIRE(store.FillCompressor(kExpected[20000].time,
+                                     kExpected[29999].time, &comp));
+  uint64_t pushed = 0;
+  for (const auto &rec : comp.GetRecords()) {
+    pushed += rec.amount;
+  }
+  BOOST_CHECK_EQUAL(pushed, 10000);
+}
+
+BOOST_AUTO_TEST_CASE(RangeTest) {
+  Records expected = MakeCapture(20000, 0.01, 0);
+  const size_t kGlitches[] = {5, 7777, 7778, 19999};
+  for (auto idx : kGlitches) {
+    expected[idx].value = 2e7;
+  }
+  CompressedSampleStore serial(kBlockRecords, 1);
+  CompressedSampleStore parallel(kBlockRecords, 4);
+  Fill(expected, &serial);
+  Fill(expected, &parallel);
+  Records recs;
+  BOOST_REQUIRE_EQUAL(parallel.ReadTimeRange(expected[1500].time,
+                                             expected[9499].time, &recs),
+                      8000);
+  CheckRecords(expected, 1500, recs, recs.size());
+  BOOST_CHECK_EQUAL(parallel.ReadTimeRange(1e9, 2e9, &recs), 0);
+  // only blocks with glitches are decoded, results are in order
+  for (auto *store : {&serial, &parallel}) {
+    Records found;
+    BOOST_REQUIRE_EQUAL(store->FindValuesOutside(9e6, 1.1e7, &found), 4);
+    for (size_t i = 0; i < found.size(); ++i) {
+      BOOST_CHECK_EQUAL(found[i].time, expected[kGlitches[i]].time);
+    }
+    found.clear();
+    BOOST_CHECK_EQUAL(store->FindValuesOutside(0, 3e7, &found), 0);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -126,6 +126,8 @@ BOOST_AUTO_TEST_CASE(CompressorPrecalculateScalesTest) {
   BOOST_CHECK(num == 1);
   BOOST_CHECK(pt[0].first  == 0.5);
   BOOST_CHECK(pt[0].second == 0.5);
+  BOOST_CHECK(cpr.GetTimeScaleLen()  == 1);
+  BOOST_CHECK(cpr.GetValueScaleLen() == 10);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
@@ -0,0 +1,132 @@
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <random>
+#include "../src/collector/cornered_hat.hpp"
+#include "test_capture.hpp"
+
+struct CorneredHatTestFixture {
+  CorneredHatTestFixture()
+      : pair_01("hat_01"),
+        pair_02("hat_02"),
+        pair_12("hat_12") {
+    // white frequency noise of oscillators, captures of pairs have
+    // slightly different time labels
+    std::mt19937 gen(5);
+    std::normal_distribution<double> noise(0, 1);
+    for (int i = 0; i < kAmount; ++i) {
+      double y[3];
+      for (int osc = 0; osc < 3; ++osc) {
+        y[osc] = kSigmas[osc] * noise(gen);
+      }
+      const double kTime = 0.1 * i;
+      pair_01.AddRecord(kTime,          kNominal * (1 + y[0] - y[1]));
+      pair_02.AddRecord(kTime + 0.0002, kNominal * (1 + y[0] - y[2]));
+      // one epoch is lost
+      if (i != 777) {
+        pair_12.AddRecord(kTime - 0.0001, kNominal * (1 + y[1] - y[2]));
+      }
+    }
+    pair_01.Close();
+    pair_02.Close();
+    pair_12.Close();
+  }
+
+  static CorneredHat::Settings GetSettings() {
+    CorneredHat::Settings settings;
+    settings.nominal = kNominal;
+    return settings;
+  }
+
+  static const int    kAmount = 100000;
+  static const double kNominal;
+  static const double kSigmas[3];
+  TestCapture pair_01;
+  TestCapture pair_02;
+  TestCapture pair_12;
+};
+
+const double CorneredHatTestFixture::kNominal   = 1e7;
+const double CorneredHatTestFixture::kSigmas[3] = {2e-11, 3e-11, 4e-11};
+// -----------------------------------------------------------------------------
+// Инициализация набора тестов
+BOOST_FIXTURE_TEST_SUITE(CorneredHatTestSuite, CorneredHatTestFixture)
+
+BOOST_AUTO_TEST_CASE(AllanVarianceTest) {
+  // linear drift of frequency: y[k] = d * k, so AVAR = (m * d)^2 / 2
+  const double kDrift = 1e-3;
+  const double kTau0  = 0.5;
+  std::vector<double> phase(1, 0);
+  for (int k = 0; k < 100; ++k) {
+    phase.push_back(phase.back() + kDrift * k * kTau0);
+  }
+  for (uint32_t m = 1; m <= 8; m *= 2) {
+    BOOST_CHECK_CLOSE(CorneredHat::CalculateAllanVariance(phase.data(),
+                                                          phase.size(), m,
+                                                          kTau0),
+                      m * m * kDrift * kDrift / 2, 1e-6);
+  }
+  BOOST_CHECK(std::isnan(CorneredHat::CalculateAllanVariance(phase.data(),
+                                                             phase.size(),
+                                                             50, kTau0)));
+}
+
+BOOST_AUTO_TEST_CASE(SeparationTest) {
+  CorneredHat hat(GetSettings());
+  hat.AddPair(0, 1, new FileDataSource(pair_01.path));
+  hat.AddPair(2, 0, new FileDataSource(pair_02.path));
+  hat.AddPair(1, 2, new FileDataSource(pair_12.path));
+  BOOST_REQUIRE_MESSAGE(hat.Calculate(), hat.GetMessage());
+  BOOST_CHECK_EQUAL(hat.GetOscillatorsAmount(), 3);
+  BOOST_CHECK_EQUAL(hat.GetAlignedRecords(), kAmount - 1);
+  BOOST_CHECK_CLOSE(hat.GetSampleInterval(), 0.1, 1e-6);
+  const auto &taus = hat.GetTaus();
+  BOOST_REQUIRE(taus.size() > 10);
+  BOOST_CHECK_CLOSE(taus[3], 0.8, 1e-6);
+  // white frequency noise: ADEV(tau0) = sigma, ADEV ~ 1 / sqrt(tau)
+  const auto &pairs = hat.GetPairDeviations();
+  BOOST_REQUIRE_EQUAL(pairs.size(), 3);
+  BOOST_CHECK_CLOSE(pairs[0][0], std::hypot(kSigmas[0], kSigmas[1]), 2);
+  BOOST_CHECK_CLOSE(pairs[0][2], pairs[0][0] / 2, 5);
+  const auto &devs = hat.GetDeviations();
+  BOOST_REQUIRE_EQUAL(devs.size(), 3);
+  for (int osc = 0; osc < 3; ++osc) {
+    BOOST_REQUIRE_EQUAL(devs[osc].size(), taus.size());
+    BOOST_CHECK_CLOSE(devs[osc][0], kSigmas[osc], 5);
+    BOOST_CHECK_CLOSE(devs[osc][2], kSigmas[osc] / 2, 10);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(InvalidPairsTest) {
+  CorneredHat two(GetSettings());
+  two.AddPair(0, 1, new FileDataSource(pair_01.path));
+  BOOST_CHECK(not two.Calculate());
+  CorneredHat repeated(GetSettings());
+  repeated.AddPair(0, 1, new FileDataSource(pair_01.path));
+  repeated.AddPair(1, 0, new FileDataSource(pair_01.path));
+  repeated.AddPair(1, 2, new FileDataSource(pair_12.path));
+  BOOST_CHECK(not repeated.Calculate());
+  CorneredHat missing(GetSettings());
+  missing.AddPair(0, 1, new FileDataSource(pair_01.path));
+  missing.AddPair(0, 2, new FileDataSource(pair_02.path));
+  missing.AddPair(1, 2, new FileDataSource("/tmp/orolia_no_such_file"));
+  BOOST_CHECK(not missing.Calculate());
+  BOOST_CHECK(missing.GetMessage().find("pair #2") != std::string::npos);
+  // line in the middle of the capture is not parsed
+  TestCapture broken("hat_broken");
+  for (int i = 0; i < 1000; ++i) {
+    broken.AddRecord(0.1 * i, kNominal);
+    if (i == 500) {
+      broken.AddLine("broken line");
+    }
+  }
+  broken.Close();
+  CorneredHat parsed(GetSettings());
+  parsed.AddPair(0, 1, new FileDataSource(pair_01.path));
+  parsed.AddPair(0, 2, new FileDataSource(broken.path));
+  parsed.AddPair(1, 2, new FileDataSource(pair_12.path));
+  BOOST_CHECK(not parsed.Calculate());
+  BOOST_CHECK_EQUAL(parsed.GetMessage(),
+                    "Failed to load pair #1: Failed to parse line #510");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,169 @@
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <random>
+#include "../src/collector/cross_correlation.hpp"
+
+struct CrossCorrelationTestFixture {
+  static const uint32_t kChunkRecords = 4096;
+
+  /**
+   * Storage, which keeps only few chunks in memory, so correlation is
+   * calculated from spilled records.
+   */
+  static SampleStore* CreateStore() {
+    return new SpillSampleStore(4 * kChunkRecords * 2 * sizeof(double),
+                                kChunkRecords);
+  }
+
+  static std::vector<double> CreateNoise(size_t amount, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::normal_distribution<double> dist(0, 1);
+    std::vector<double> out(amount);
+    for (auto &value : out) {
+      value = dist(gen);
+    }
+    return out;
+  }
+  /**
+   * Method for filling the storage by values [first, first + amount),
+   * values outside of "values" are zeros.
+   */
+  static void Fill(const std::vector<double> &values, int64_t first,
+                   size_t amount, double start_time, double offset,
+                   SampleStore *out) {
+    for (size_t i = 0; i < amount; ++i) {
+      const int64_t kIndex = first + i;
+      const double  kValue = kIndex >= 0 && kIndex < (int64_t)values.size()
+                           ? values[kIndex] : 0.0;
+      BOOST_REQUIRE(out->PushRecord(VoidDataSource::Record(
+        start_time + i * kStep, offset + kValue
+      )));
+    }
+  }
+
+  static constexpr double kStep = 0.001;
+};
+// -----------------------------------------------------------------------------
+// Инициализация набора тестов
+BOOST_FIXTURE_TEST_SUITE(CrossCorrelationTestSuite,
+                         CrossCorrelationTestFixture)
+
+BOOST_AUTO_TEST_CASE(DirectTest) {
+  const size_t kSize   = 5000;
+  const int    kMaxLag = 50;
+  const auto   kX = CreateNoise(kSize, 1);
+  const auto   kY = CreateNoise(kSize - 300, 2);
+  std::unique_ptr<SampleStore> x(CreateStore());
+  std::unique_ptr<SampleStore> y(CreateStore());
+  Fill(kX, 0, kX.size(), 0, 1e7, x.get());
+  Fill(kY, 0, kY.size(), 0, -5, y.get());
+  CrossCorrelation::Settings opts;
+  opts.max_lag      = kMaxLag;
+  opts.block_length = 256;
+  opts.batch_blocks = 4;
+  opts.threads      = 3;
+  CrossCorrelation xcorr(opts);
+  BOOST_REQUIRE_MESSAGE(xcorr.Calculate(x.get(), y.get()),
+                        xcorr.GetMessage());
+  // blocks of 156 records, the last one is not full
+  BOOST_CHECK_EQUAL(xcorr.GetBlocksAmount(), (kSize + 155) / 156);
+  BOOST_CHECK_CLOSE(xcorr.GetSampleRate(), 1 / kStep, 1e-6);
+  // direct calculation of coefficients
+  auto mean = [](const std::vector<double> &values) {
+    double sum = 0;
+    for (auto value : values) {
+      sum += value;
+    }
+    return sum / values.size();
+  };
+  auto deviation = [](const std::vector<double> &values, double mean) {
+    double sum = 0;
+    for (auto value : values) {
+      sum += (value - mean) * (value - mean);
+    }
+    return std::sqrt(sum / values.size());
+  };
+  const double kMeanX = mean(kX);
+  const double kMeanY = mean(kY);
+  const double kNorm  = deviation(kX, kMeanX) * deviation(kY, kMeanY);
+  const auto  &corr   = xcorr.GetCorrelation();
+  BOOST_REQUIRE_EQUAL(corr.size(), 2 * kMaxLag + 1);
+  for (int lag = -kMaxLag; lag <= kMaxLag; ++lag) {
+    double sum     = 0;
+    int    overlap = 0;
+    for (int n = 0; n < (int)kX.size(); ++n) {
+      if (n + lag >= 0 && n + lag < (int)kY.size()) {
+        sum += (kX[n] - kMeanX) * (kY[n + lag] - kMeanY);
+        ++overlap;
+      }
+    }
+    BOOST_REQUIRE_SMALL(corr[lag + kMaxLag] - sum / overlap / kNorm, 1e-9);
+  }
+  BOOST_CHECK_CLOSE(xcorr.GetLagTimes().front(), -kMaxLag * kStep, 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE(DelayTest) {
+  const size_t kSize  = 200000;
+  const int    kDelay = 37;
+  const auto   kX = CreateNoise(kSize + kDelay, 3);
+  std::unique_ptr<SampleStore> x(CreateStore());
+  std::unique_ptr<SampleStore> y(CreateStore());
+  // "y" is late by "kDelay" records and starts 2 seconds later
+  Fill(kX, 0, kSize, 0, 1e7, x.get());
+  Fill(kX, 2000 - kDelay, kSize, 2.0, 1e7, y.get());
+  CrossCorrelation::Settings opts;
+  opts.max_lag = 500;
+  CrossCorrelation xcorr(opts);
+  BOOST_REQUIRE_MESSAGE(xcorr.Calculate(x.get(), y.get()),
+                        xcorr.GetMessage());
+  // lags are counted from records with the same time labels
+  BOOST_CHECK_SMALL(xcorr.GetPeakLag() - kDelay, 0.1);
+  BOOST_CHECK_SMALL(xcorr.GetDelay() - kDelay * kStep, 0.1 * kStep);
+  BOOST_CHECK(xcorr.GetPeakCorrelation() > 0.95);
+  // swapped captures have the opposite delay
+  BOOST_REQUIRE(xcorr.Calculate(y.get(), x.get()));
+  BOOST_CHECK_SMALL(xcorr.GetDelay() + kDelay * kStep, 0.1 * kStep);
+}
+
+BOOST_AUTO_TEST_CASE(SubSampleTest) {
+  // smooth signal with delay between records
+  const double kDelay = 12.3;
+  std::unique_ptr<SampleStore> x(CreateStore());
+  std::unique_ptr<SampleStore> y(CreateStore());
+  auto signal = [](double index) {
+    return std::sin(0.05 * index) + 0.5 * std::sin(0.0313 * index + 1);
+  };
+  for (int i = 0; i < 50000; ++i) {
+    BOOST_REQUIRE(x->PushRecord(VoidDataSource::Record(i * kStep,
+                                                       signal(i))));
+    BOOST_REQUIRE(y->PushRecord(VoidDataSource::Record(i * kStep,
+                                                       signal(i - kDelay))));
+  }
+  CrossCorrelation::Settings opts;
+  opts.max_lag = 40;
+  CrossCorrelation xcorr(opts);
+  BOOST_REQUIRE(xcorr.Calculate(x.get(), y.get()));
+  BOOST_CHECK_SMALL(xcorr.GetPeakLag() - kDelay, 0.05);
+}
+
+BOOST_AUTO_TEST_CASE(InvalidTest) {
+  std::unique_ptr<SampleStore> x(CreateStore());
+  std::unique_ptr<SampleStore> y(CreateStore());
+  Fill(CreateNoise(1000, 4), 0, 1000, 0, 0, x.get());
+  CrossCorrelation::Settings opts;
+  opts.max_lag = 10;
+  CrossCorrelation xcorr(opts);
+  // empty capture
+  BOOST_CHECK(not xcorr.Calculate(x.get(), y.get()));
+  // another sample rate
+  for (int i = 0; i < 1000; ++i) {
+    BOOST_REQUIRE(y->PushRecord(VoidDataSource::Record(i * 2 * kStep, i)));
+  }
+  BOOST_CHECK(not xcorr.Calculate(x.get(), y.get()));
+  // lags do not fit into the block
+  opts.max_lag      = 100;
+  opts.block_length = 128;
+  BOOST_CHECK(not CrossCorrelation(opts).Calculate(x.get(), x.get()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
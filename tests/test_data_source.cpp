@@ -90,4 +90,50 @@ BOOST_AUTO_TEST_CASE(VoidDataSourceReadRecordFailTest) {
   BOOST_CHECK(not src.GetRecord(&rec));
 }
 
+BOOST_AUTO_TEST_CASE(VoidDataSourceTimeIntervalHeaderTest) {
+  TestSource src;
+  src.data
+    << "# Pendulum Instruments AB, TimeView32 V1.01" << std::endl
+    << "# TIME INTERVAL A-B" << std::endl
+    << "# MON May 12 13:13:23 2003" << std::endl
+    << "# Measuring time: 10 ms                       Single: Off" << std::endl
+    << "# Input A: Auto, 1M., AC, X1, Pos             Filter: Off" << std::endl
+    << "# Input B: Auto, 1M., AC, X1, Pos             Common: On" << std::endl
+    << "# Ext.arm: Off                                Ref.osc: Internal" << std::endl
+    << "# Hold off: Off                               Statistics: Off"  << std::endl;
+  BOOST_CHECK(src.OccupySource());
+  BOOST_CHECK(src.GetHeader().type_of_measurement == "TIME INTERVAL A-B");
+}
+
+BOOST_AUTO_TEST_CASE(VoidDataSourceReadRowTest) {
+  TestSource src;
+  src.data
+    << "1.0 10.0 20.0 30.0 40.0" << std::endl
+    << "2.0\t11.0\t21.0\t31.0\t41.0" << std::endl
+    << "3.0 12.0 22.0" << std::endl;
+  BOOST_CHECK_EQUAL(src.GetChannels().size(), 1);
+  BOOST_CHECK(not src.SelectChannels(VoidDataSource::Channels()));
+  BOOST_CHECK(not src.SelectChannels({1, 1}));
+  BOOST_CHECK(not src.SelectChannels({VoidDataSource::kMaxColumns}));
+  // values are placed in order of selection
+  BOOST_REQUIRE(src.SelectChannels({3, 1}));
+  VoidDataSource::Row row;
+  BOOST_REQUIRE(src.GetRow(&row));
+  BOOST_CHECK_EQUAL(row.time, 1.0);
+  BOOST_CHECK_EQUAL(row.amount, 2);
+  BOOST_CHECK_EQUAL(row.values[0], 40.0);
+  BOOST_CHECK_EQUAL(row.values[1], 20.0);
+  // record gets the first selected channel
+  VoidDataSource::Record rec;
+  BOOST_REQUIRE(src.GetRecord(&rec));
+  BOOST_CHECK_EQUAL(rec.time,  2.0);
+  BOOST_CHECK_EQUAL(rec.value, 41.0);
+  // the row has no selected column
+  BOOST_CHECK(not src.GetRow(&row));
+  BOOST_CHECK(not src.GetMessage().empty());
+  while (src.GetRow(&row)) {
+    BOOST_FAIL("Unexpected row");
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
\ No newline at end of file
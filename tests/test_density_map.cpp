@@ -0,0 +1,109 @@
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <random>
+#include "../src/collector/density_map.hpp"
+
+struct DensityMapTestFixture {
+  typedef VoidDataSource::Record Record;
+
+  DensityMapTestFixture()
+      : store(1 << 30, 4096) {
+    // two levels of values: 90% of records are near 0, 10% are near 10
+    std::mt19937 gen(3);
+    std::normal_distribution<double> noise(0, 0.1);
+    for (int i = 0; i < kAmount; ++i) {
+      const double kLevel = i % 10 == 0 ? 10 : 0;
+      BOOST_REQUIRE(store.PushRecord(Record(0.001 * i, kLevel + noise(gen))));
+    }
+  }
+
+  static uint64_t SumRows(const DensityMap &map, uint32_t from, uint32_t to) {
+    uint64_t sum = 0;
+    for (uint32_t row = from; row < to; ++row) {
+      for (uint32_t col = 0; col < map.GetWidth(); ++col) {
+        sum += map.GetCounts()[row * map.GetWidth() + col];
+      }
+    }
+    return sum;
+  }
+
+  static const int kAmount = 300000;
+  SpillSampleStore store;
+};
+// -----------------------------------------------------------------------------
+// Инициализация набора тестов
+BOOST_FIXTURE_TEST_SUITE(DensityMapTestSuite, DensityMapTestFixture)
+
+BOOST_AUTO_TEST_CASE(RecordsTest) {
+  const DensityMap::Range kTime(0, 0.001 * (kAmount - 1));
+  const DensityMap::Range kValue(-5, 15);
+  DensityMap serial;
+  DensityMap parallel;
+  serial.Reset(200, 100, kTime, kValue);
+  parallel.Reset(200, 100, kTime, kValue);
+  BOOST_REQUIRE(serial.AddRecords(&store, 1));
+  BOOST_REQUIRE(parallel.AddRecords(&store, 4));
+  BOOST_CHECK_EQUAL(serial.GetTotal(), (uint64_t)kAmount);
+  BOOST_CHECK(serial.GetCounts() == parallel.GetCounts());
+  BOOST_CHECK_EQUAL(serial.GetMaxCount(), parallel.GetMaxCount());
+  // the row #0 is the highest value
+  BOOST_CHECK_EQUAL(SumRows(serial, 0,  50),  kAmount / 10);
+  BOOST_CHECK_EQUAL(SumRows(serial, 50, 100), kAmount - kAmount / 10);
+  // only records in ranges are binned
+  DensityMap part;
+  part.Reset(50, 50, DensityMap::Range(100.0005, 200.0005),
+             DensityMap::Range(-1, 1));
+  BOOST_REQUIRE(part.AddRecords(&store, 3));
+  BOOST_CHECK_EQUAL(part.GetTotal(), 90000);
+  // cancelled binning
+  std::atomic<bool> cancel(true);
+  BOOST_CHECK(not parallel.AddRecords(&store, 2, &cancel));
+}
+
+BOOST_AUTO_TEST_CASE(BucketsTest) {
+  Compressor comp(100);
+  for (int i = 0; i < 1000; ++i) {
+    BOOST_REQUIRE(comp.PushRecord(Compressor::Record(i, i % 20)));
+  }
+  DensityMap map;
+  map.Reset(20, 20, comp.GetTimeScale(), comp.GetValueScale());
+  map.AddBuckets(comp);
+  BOOST_CHECK_EQUAL(map.GetTotal(), 1000);
+  uint64_t sum = 0;
+  for (auto count : map.GetCounts()) {
+    sum += count;
+  }
+  BOOST_CHECK_EQUAL(sum, 1000);
+  // constant values are placed at the middle row
+  Compressor flat(10);
+  for (int i = 0; i < 100; ++i) {
+    BOOST_REQUIRE(flat.PushRecord(Compressor::Record(i, 5)));
+  }
+  map.Reset(10, 11, flat.GetTimeScale(), flat.GetValueScale());
+  map.AddBuckets(flat);
+  BOOST_CHECK_EQUAL(SumRows(map, 5, 6), 100);
+}
+
+BOOST_AUTO_TEST_CASE(ColorTest) {
+  BOOST_CHECK_EQUAL(DensityMap::GetColor(0), 0x1a1a1a);
+  BOOST_CHECK_EQUAL(DensityMap::GetColor(0.7), 0xffa709);
+  // brightness grows with level
+  uint32_t prev = 0;
+  for (double level = 0.01; level <= 1; level += 0.01) {
+    const uint32_t kColor = DensityMap::GetColor(level);
+    const uint32_t kSum   = (kColor >> 16) + ((kColor >> 8) & 0xff)
+                          + (kColor & 0xff);
+    BOOST_REQUIRE(kSum >= prev);
+    prev = kSum;
+  }
+  DensityMap map;
+  map.Reset(4, 2, DensityMap::Range(0, 4), DensityMap::Range(0, 2));
+  BOOST_REQUIRE(map.AddRecords(&store));
+  std::vector<uint32_t> image(6 * 2, 7);
+  map.ToImage(image.data(), 6);
+  BOOST_CHECK_EQUAL(image[4], 7);
+  BOOST_CHECK_EQUAL(image[0], DensityMap::GetColor(0));
+  BOOST_CHECK(image[6] != DensityMap::GetColor(0));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,85 @@
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include "../src/collector/detector.hpp"
+
+struct DetectorTestFixture {
+  DetectorTestFixture() {}
+  ~DetectorTestFixture() {}
+
+  // noise-like deterministic values around "level"
+  static double Noise(size_t i, double level) {
+    return level + ((i * 7919) % 17) * 0.1 - 0.8;
+  }
+};
+// -----------------------------------------------------------------------------
+// Инициализация набора тестов
+BOOST_FIXTURE_TEST_SUITE(DetectorTestSuite, DetectorTestFixture)
+
+BOOST_AUTO_TEST_CASE(RollingMedianTest) {
+  RollingMedian med(5, 7);
+  const double kValues[] = {5, 1, 4, 2, 3, 100, 100};
+  for (size_t i = 0; i < 6; ++i) {
+    med.Push(kValues[i]);
+  }
+  BOOST_CHECK(not med.IsReady());
+  med.Push(kValues[6]);
+  // window: 4, 2, 3, 100, 100
+  BOOST_CHECK(med.IsReady());
+  BOOST_CHECK(med.GetMedian() == 4);
+  // deviations: 0, 2, 1, 96, 96
+  BOOST_CHECK(med.GetMad() == 2);
+}
+
+BOOST_AUTO_TEST_CASE(DetectorMeasuringTimeTest) {
+  BOOST_CHECK(std::fabs(Detector::ParseMeasuringTime("10 ms") - 0.01) < 1e-12);
+  BOOST_CHECK(std::fabs(Detector::ParseMeasuringTime("2 s") - 2.0) < 1e-12);
+  BOOST_CHECK(std::isnan(Detector::ParseMeasuringTime("ten ms")));
+}
+
+BOOST_AUTO_TEST_CASE(DetectorEventsTest) {
+  Detector det;
+  uint32_t line = 0;
+  double   time = 0;
+  for (size_t i = 0; i < 1000; ++i, ++line) {
+    double value = Noise(i, i < 600 ? 1000 : 1100);
+    if (i == 300) {
+      value = 2000;
+    }
+    if (i == 400) {
+      time += 1.0;
+    }
+    time += 0.1;
+    det.PushRecord({time, value}, line);
+  }
+  det.Finish();
+  const auto &events = det.GetEvents();
+  BOOST_REQUIRE(events.size() == 3);
+  BOOST_CHECK(events[0].type == Detector::Event::kGlitch);
+  BOOST_CHECK(events[0].line == 300);
+  BOOST_CHECK(events[0].length == 1);
+  BOOST_CHECK(events[1].type == Detector::Event::kGap);
+  BOOST_CHECK(events[1].line == 400);
+  BOOST_CHECK(std::fabs(events[1].length - 1.1) < 1e-9);
+  BOOST_CHECK(events[2].type == Detector::Event::kPhaseJump);
+  BOOST_CHECK(events[2].line == 600);
+}
+
+BOOST_AUTO_TEST_CASE(DetectorQuantizedTest) {
+  // counter values: MAD is zero, steps are by one digit
+  const double kDigit = 1e-3;
+  Detector det;
+  for (size_t i = 0; i < 1000; ++i) {
+    double value = 1e7 + (i % 50 == 0 ? kDigit : 0.0);
+    if (i == 700) {
+      value = 1e7 + 100 * kDigit;
+    }
+    det.PushRecord({i * 0.1, value}, i);
+  }
+  det.Finish();
+  const auto &events = det.GetEvents();
+  BOOST_REQUIRE(events.size() == 1);
+  BOOST_CHECK(events[0].type == Detector::Event::kGlitch);
+  BOOST_CHECK(events[0].line == 700);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
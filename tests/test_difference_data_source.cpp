@@ -0,0 +1,154 @@
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include "../src/collector/collector.hpp"
+#include "../src/collector/difference_data_source.hpp"
+#include "test_capture.hpp"
+
+struct DifferenceDataSourceTestFixture {
+  typedef VoidDataSource::Record Record;
+
+  DifferenceDataSourceTestFixture()
+      : device("diff_device"),
+        reference("diff_reference") {
+    // device is sampled 3 ms later and has offset 5, reference has a gap
+    for (int i = 0; i < kAmount; ++i) {
+      const double kTime = 0.01 * i;
+      device.AddRecord(kTime + 0.003, GetValue(kTime + 0.003) + 5);
+      if (i < 1000 || i >= 1100) {
+        reference.AddRecord(kTime, GetValue(kTime));
+      }
+    }
+    device.Close();
+    reference.Close();
+  }
+
+  static double GetValue(double time) {
+    return 1e7 + 10 * std::sin(time);
+  }
+
+  static const int kAmount = 30000;
+  TestCapture device;
+  TestCapture reference;
+};
+// -----------------------------------------------------------------------------
+// Инициализация набора тестов
+BOOST_FIXTURE_TEST_SUITE(DifferenceDataSourceTestSuite,
+                         DifferenceDataSourceTestFixture)
+
+BOOST_AUTO_TEST_CASE(InterpolatedTest) {
+  DifferenceDataSource::Settings settings;
+  settings.tolerance  = 0.015;
+  // small batches, so rings are refilled many times
+  settings.batch_size = 100;
+  settings.depth      = 2;
+  DifferenceDataSource diff(new FileDataSource(device.path),
+                            new FileDataSource(reference.path), settings);
+  std::vector<Record> recs;
+  BOOST_REQUIRE(LoadRecords(&diff, &recs));
+  // device records near the gap and the last one are not between two
+  // reference records in tolerance
+  const uint64_t kUnmatched = 102;
+  BOOST_CHECK_EQUAL(diff.GetStatistics().unmatched, kUnmatched);
+  BOOST_CHECK_EQUAL(diff.GetStatistics().matched, kAmount - kUnmatched);
+  BOOST_REQUIRE_EQUAL(recs.size(), kAmount - kUnmatched);
+  for (const auto &rec : recs) {
+    BOOST_REQUIRE_CLOSE(rec.value, 5, 1e-2);
+  }
+  BOOST_CHECK_CLOSE(recs.front().time, 0.003, 1e-9);
+  // the last device record is after the last reference record
+  BOOST_CHECK_CLOSE(recs.back().time, 0.01 * (kAmount - 2) + 0.003, 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(NearestTest) {
+  DifferenceDataSource::Settings settings;
+  settings.matching  = DifferenceDataSource::kNearestMatching;
+  settings.tolerance = 0.004;
+  DifferenceDataSource diff(new FileDataSource(device.path),
+                            new FileDataSource(reference.path), settings);
+  std::vector<Record> recs;
+  BOOST_REQUIRE(LoadRecords(&diff, &recs));
+  BOOST_CHECK_EQUAL(diff.GetStatistics().unmatched, 100);
+  BOOST_REQUIRE_EQUAL(recs.size(), kAmount - 100);
+  for (const auto &rec : recs) {
+    const double expected = GetValue(rec.time) + 5 - GetValue(rec.time
+                                                               - 0.003);
+    BOOST_REQUIRE_CLOSE(rec.value, expected, 1e-3);
+  }
+  // nothing is in tolerance
+  settings.tolerance = 0.002;
+  DifferenceDataSource far(new FileDataSource(device.path),
+                           new FileDataSource(reference.path), settings);
+  std::vector<Record> far_recs;
+  BOOST_REQUIRE(LoadRecords(&far, &far_recs));
+  BOOST_CHECK(far_recs.empty());
+  BOOST_CHECK_EQUAL(far.GetStatistics().unmatched, (uint64_t)kAmount);
+}
+
+BOOST_AUTO_TEST_CASE(InvalidSourceTest) {
+  DifferenceDataSource diff(new FileDataSource(device.path),
+                            new FileDataSource("/tmp/orolia_no_such_file"));
+  VoidDataSource *src = &diff;
+  BOOST_CHECK(not src->OccupySource());
+  BOOST_CHECK_EQUAL(src->GetMessage().find("Reference: "), 0);
+}
+
+BOOST_AUTO_TEST_CASE(CollectorTest) {
+  DifferenceDataSource::Settings settings;
+  settings.tolerance = 0.015;
+  auto *diff = new DifferenceDataSource(new FileDataSource(device.path),
+                                        new FileDataSource(reference.path),
+                                        settings);
+  Collector cl;
+  cl.UseCompressor(new Compressor(100));
+  cl.UseDataSource(diff);
+  BOOST_REQUIRE(cl.Begin());
+  BOOST_REQUIRE(cl.FetchAllRecords());
+  cl.End();
+  BOOST_CHECK_EQUAL(cl.GetCompressor()->GetPushedRecords(),
+                    diff->GetStatistics().matched);
+  BOOST_CHECK_CLOSE(cl.GetCompressor()->GetValueScale().first,  5, 1e-2);
+  BOOST_CHECK_CLOSE(cl.GetCompressor()->GetValueScale().second, 5, 1e-2);
+}
+
+BOOST_AUTO_TEST_CASE(InputMessagesTest) {
+  TestCapture broken("diff_broken");
+  for (int i = 0; i < 1000; ++i) {
+    broken.AddRecord(0.01 * i, GetValue(0.01 * i));
+    if (i == 500) {
+      broken.AddLine("broken line");
+      broken.AddLine(std::string(1000, '1'));
+    }
+  }
+  broken.Close();
+  DifferenceDataSource::Settings settings;
+  settings.tolerance = 0.015;
+  // errors of parsing of the reference do not stop loading, the last one
+  // is reported (the long line is not parsed by "FileDataSource")
+  Collector parsed;
+  parsed.UseCompressor(new Compressor(100));
+  parsed.UseDataSource(new DifferenceDataSource(
+    new FileDataSource(device.path), new FileDataSource(broken.path),
+    settings
+  ));
+  BOOST_REQUIRE(parsed.Begin());
+  BOOST_CHECK(parsed.FetchAllRecords());
+  parsed.End();
+  BOOST_REQUIRE_EQUAL(parsed.GetMessages().size(), 1);
+  BOOST_CHECK_EQUAL(parsed.GetMessages().front(),
+                    "Reference: Failed to parse line #511");
+  // failed reading of the reference fails loading
+  Collector failed;
+  failed.UseCompressor(new Compressor(100));
+  failed.UseDataSource(new DifferenceDataSource(
+    new FileDataSource(device.path), new AsyncFileDataSource(broken.path),
+    settings
+  ));
+  BOOST_REQUIRE(failed.Begin());
+  BOOST_CHECK(not failed.FetchAllRecords());
+  failed.End();
+  BOOST_REQUIRE_EQUAL(failed.GetMessages().size(), 1);
+  BOOST_CHECK_EQUAL(failed.GetMessages().front(),
+                    "Reference: Too long line in file: " + broken.path);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,185 @@
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <map>
+#include <random>
+#include <algorithm>
+#include "../src/collector/collector.hpp"
+#include "test_capture.hpp"
+
+// aging oscillator: drift and white noise
+static const double kRate  = 1e-2;
+static const double kAging = 2e-6;
+static const double kNoise = 1e-4;
+
+struct DriftTestFixture {
+  DriftTestFixture()
+      : gen(7),
+        noise(0, kNoise) {
+  }
+  double GetValue(double time) {
+    return 1e7 + kRate * time + kAging * time * time + noise(gen);
+  }
+
+  std::mt19937                     gen;
+  std::normal_distribution<double> noise;
+};
+// -----------------------------------------------------------------------------
+// Инициализация набора тестов
+BOOST_FIXTURE_TEST_SUITE(DriftTestSuite, DriftTestFixture)
+
+BOOST_AUTO_TEST_CASE(FitTest) {
+  DriftEstimator::Settings opts;
+  opts.order = 2;
+  DriftEstimator quadratic(opts);
+  opts.order = 1;
+  DriftEstimator linear(opts);
+  for (int i = 0; i < 100000; ++i) {
+    const VoidDataSource::Record kRec(100 + i * 0.01, GetValue(i * 0.01));
+    quadratic.PushRecord(kRec);
+    linear.PushRecord(kRec);
+  }
+  BOOST_REQUIRE_MESSAGE(quadratic.Fit(), quadratic.GetMessage());
+  BOOST_REQUIRE(linear.Fit());
+  // time is counted from the first record
+  BOOST_CHECK_SMALL(quadratic.GetCoefficient(0) - 1e7, 1e-5);
+  BOOST_CHECK_CLOSE(quadratic.GetCoefficient(1), kRate, 1e-3);
+  BOOST_CHECK_CLOSE(quadratic.GetCoefficient(2), kAging, 1e-3);
+  BOOST_CHECK_EQUAL(quadratic.GetCoefficient(3), 0);
+  BOOST_CHECK_CLOSE(quadratic.GetRate(1100), kRate + 2 * kAging * 1000,
+                    1e-3);
+  // residuals are the noise, though drift is 10^5 times greater
+  BOOST_CHECK_CLOSE(quadratic.GetResidualRms(), kNoise, 2);
+  BOOST_CHECK_EQUAL(quadratic.GetAmount(), 100000);
+  BOOST_CHECK_EQUAL(quadratic.GetTimeRange().first, 100);
+  // linear fit of quadratic drift: mean slope and parabolic residuals
+  BOOST_CHECK_CLOSE(linear.GetCoefficient(1), kRate + kAging * 1000, 1e-2);
+  BOOST_CHECK_EQUAL(linear.GetCoefficient(2), 0);
+  BOOST_CHECK(linear.GetResidualRms() > 100 * kNoise);
+}
+
+BOOST_AUTO_TEST_CASE(MergeTest) {
+  const size_t kAmount = 300000;
+  DriftEstimator::Settings opts;
+  opts.order = 2;
+  DriftEstimator serial(opts);
+  std::unique_ptr<SampleStore> store(new SpillSampleStore(1 << 20, 4096));
+  for (size_t i = 0; i < kAmount; ++i) {
+    const VoidDataSource::Record kRec(i * 0.01, GetValue(i * 0.01));
+    serial.PushRecord(kRec);
+    BOOST_REQUIRE(store->PushRecord(kRec));
+  }
+  // chunks of the storage are estimated in parallel and merged
+  DriftEstimator parallel(opts);
+  BOOST_REQUIRE_MESSAGE(parallel.AddRecords(store.get(), 3),
+                        parallel.GetMessage());
+  BOOST_REQUIRE(serial.Fit());
+  BOOST_REQUIRE(parallel.Fit());
+  BOOST_CHECK_EQUAL(parallel.GetAmount(), (uint64_t)kAmount);
+  for (uint8_t p = 0; p <= DriftEstimator::kMaxOrder; ++p) {
+    BOOST_CHECK_CLOSE(parallel.GetCoefficient(p), serial.GetCoefficient(p),
+                      1e-6);
+  }
+  BOOST_CHECK_CLOSE(parallel.GetResidualRms(), serial.GetResidualRms(),
+                    1e-6);
+  // estimators with another origin of time can not be merged
+  opts.origin = 1;
+  DriftEstimator other(opts);
+  other.PushRecord(VoidDataSource::Record(2, 1));
+  BOOST_CHECK(not parallel.MergeWith(other));
+  BOOST_CHECK_EQUAL(parallel.GetAmount(), (uint64_t)kAmount);
+}
+
+BOOST_AUTO_TEST_CASE(ExtremeTimeTest) {
+  // extremes of merged buckets keep their own time labels
+  Compressor comp(10);
+  std::map<double, double> values;
+  for (int i = 0; i < 1000; ++i) {
+    const double kTime  = i;
+    const double kValue = std::sin(i * 0.37) * 100 + i % 7;
+    values[kTime] = kValue;
+    BOOST_REQUIRE(comp.PushRecord(Compressor::Record(kTime, kValue)));
+  }
+  for (const auto &rec : comp.GetRecords()) {
+    BOOST_REQUIRE_EQUAL(values[rec.extreme_time.first], rec.value.first);
+    if (rec.amount == 1) {
+      continue;
+    }
+    BOOST_REQUIRE_EQUAL(values[rec.extreme_time.second], rec.value.second);
+    BOOST_CHECK(rec.extreme_time.first >= rec.time.first &&
+                rec.extreme_time.first <= rec.time.second);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(SubtractTest) {
+  const size_t kAmount = 20000;
+  const double kStep   = 0.1;
+  std::vector<VoidDataSource::Record> recs;
+  TestCapture capture("drift");
+  for (size_t i = 0; i < kAmount; ++i) {
+    recs.emplace_back(i * kStep, GetValue(i * kStep) + std::sin(0.01 * i));
+    capture.AddRecord(recs.back().time, recs.back().value);
+  }
+  capture.Close();
+  DriftEstimator::Settings opts;
+  opts.order = 2;
+  opts.mode  = DriftEstimator::kSubtract;
+  Collector cl;
+  cl.UseCompressor(new Compressor(100));
+  cl.GetCompressor()->UseQuantiles(true);
+  cl.UseDataSource(new FileDataSource(capture.path));
+  cl.UseDriftEstimator(new DriftEstimator(opts));
+  BOOST_REQUIRE(cl.Begin());
+  BOOST_REQUIRE(cl.FetchAllRecords());
+  cl.End();
+  const DriftEstimator &drift = *cl.GetDriftEstimator();
+  BOOST_REQUIRE(drift.IsFitted());
+  BOOST_CHECK_CLOSE(drift.GetCoefficient(1), kRate, 1);
+  // residuals are the sine, values keep their level
+  const auto &kScale = cl.GetCompressor()->GetValueScale();
+  BOOST_CHECK_CLOSE(kScale.second - kScale.first, 2, 5);
+  BOOST_CHECK_SMALL(kScale.first - (1e7 - 1), 0.1);
+  // extremes of buckets are values of records without drift, they are
+  // close to extremes of records of the bucket without drift
+  for (const auto &rec : cl.GetCompressor()->GetRecords()) {
+    double lowest  = INFINITY;
+    double highest = -INFINITY;
+    for (const auto &raw : recs) {
+      // time labels are parsed from the file, so they are compared with
+      // half of the step
+      if (raw.time > rec.time.first - kStep / 2 &&
+          raw.time < rec.time.second + kStep / 2) {
+        const double kValue = raw.value - drift.GetDrift(raw.time);
+        lowest  = std::min(lowest, kValue);
+        highest = std::max(highest, kValue);
+      }
+    }
+    if (rec.amount == 1) {
+      continue;
+    }
+    BOOST_REQUIRE(rec.value.first <= rec.value.second);
+    BOOST_CHECK(rec.value.first >= lowest - 1e-6);
+    BOOST_CHECK(rec.value.second <= highest + 1e-6);
+    const double kLimit = drift.GetRate(rec.time.second)
+                        * (rec.time.second - rec.time.first) + 1e-6;
+    BOOST_CHECK_SMALL(rec.value.first - lowest, kLimit);
+    BOOST_CHECK_SMALL(rec.value.second - highest, kLimit);
+    const double kMedian = rec.GetQuantile(0.5);
+    BOOST_CHECK(kMedian >= rec.value.first && kMedian <= rec.value.second);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(InvalidTest) {
+  DriftEstimator drift;
+  BOOST_CHECK(not drift.Fit());
+  Compressor comp(10);
+  BOOST_CHECK(not drift.SubtractDrift(&comp));
+  // records with the same time label do not define the slope
+  for (int i = 0; i < 10; ++i) {
+    drift.PushRecord(VoidDataSource::Record(5, i));
+  }
+  BOOST_CHECK(not drift.Fit());
+  drift.PushRecord(VoidDataSource::Record(6, 10));
+  BOOST_CHECK(drift.Fit());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
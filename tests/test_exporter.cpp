@@ -0,0 +1,161 @@
+#include <boost/test/unit_test.hpp>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <unistd.h>
+#include "../src/collector/exporter.hpp"
+
+struct ExporterTestFixture {
+  ExporterTestFixture()
+      : path("/tmp/orolia_test_export_" + std::to_string(::getpid())) {
+  }
+  ~ExporterTestFixture() {
+    std::remove(path.c_str());
+  }
+
+  static std::string Format(double value) {
+    char str[kMaxDoubleLen];
+    const auto kLen = FormatDouble(value, str);
+    return std::string(str, kLen);
+  }
+
+  /**
+   * Method for replacing bytes of the file at "offset" by "value".
+   */
+  template <class T>
+  void Patch(uint64_t offset, T value) {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(offset);
+    file.write((const char*)&value, sizeof(value));
+  }
+  template <class T>
+  T Peek(uint64_t offset) {
+    T value = 0;
+    std::ifstream file(path, std::ios::binary);
+    file.seekg(offset);
+    file.read((char*)&value, sizeof(value));
+    return value;
+  }
+  void WriteColumnar(size_t rows) {
+    ColumnarExporter exp(path, 300);
+    BOOST_REQUIRE(exp.Open(Exporter::GetRecordColumns()));
+    for (size_t i = 0; i < rows; ++i) {
+      BOOST_REQUIRE(exp.WriteRecord({i * 0.1, i * 2.0}));
+    }
+    BOOST_REQUIRE(exp.Close());
+  }
+
+  const std::string path;
+};
+// -----------------------------------------------------------------------------
+// Инициализация набора тестов
+BOOST_FIXTURE_TEST_SUITE(ExporterTestSuite, ExporterTestFixture)
+
+BOOST_AUTO_TEST_CASE(FormatDoubleTest) {
+  BOOST_CHECK(Format(0.0)     == "0");
+  BOOST_CHECK(Format(-0.0)    == "-0");
+  BOOST_CHECK(Format(0.1)     == "0.1");
+  BOOST_CHECK(Format(-2.5)    == "-2.5");
+  BOOST_CHECK(Format(1e7)     == "10000000");
+  BOOST_CHECK(Format(1.5e-7)  == "1.5e-07");
+  BOOST_CHECK(Format(1e300)   == "1e+300");
+  BOOST_CHECK(Format(0.00123) == "0.00123");
+  BOOST_CHECK(Format(9.8243659989561e+003) == "9824.3659989561");
+  BOOST_CHECK(Format(0.1 + 0.2) == "0.30000000000000004");
+  BOOST_CHECK(Format(std::nan("")) == "nan");
+  // subnormal numbers and big exponents are the shortest too
+  BOOST_CHECK(Format(5e-324)  == "5e-324");
+  BOOST_CHECK(Format(1e-310)  == "1e-310");
+  BOOST_CHECK(Format(2.5e307) == "2.5e+307");
+}
+
+BOOST_AUTO_TEST_CASE(FormatDoubleRoundTripTest) {
+  std::mt19937_64 gen(42);
+  std::uniform_real_distribution<double> real(-1e8, 1e8);
+  size_t failed = 0;
+  for (size_t i = 0; i < 200000; ++i) {
+    double value = real(gen);
+    if (i % 2 == 1) {
+      // any bit patterns, except NaN and infinity
+      const uint64_t kBits = gen();
+      std::memcpy(&value, &kBits, sizeof(value));
+      if (not std::isfinite(value)) {
+        continue;
+      }
+    }
+    if (std::strtod(Format(value).c_str(), 0) != value) {
+      ++failed;
+    }
+  }
+  BOOST_CHECK(failed == 0);
+}
+
+BOOST_AUTO_TEST_CASE(CsvExporterTest) {
+  {
+    CsvExporter exp(path);
+    BOOST_REQUIRE(exp.Open(Exporter::GetRecordColumns()));
+    BOOST_CHECK(exp.WriteRecord({0.5, 1e7}));
+    BOOST_CHECK(exp.WriteRecord({1.0, 10000000.25}));
+    BOOST_CHECK(exp.Close());
+  }
+  std::ifstream in(path);
+  std::stringstream content;
+  content << in.rdbuf();
+  BOOST_CHECK(content.str() == "time,value\n0.5,10000000\n1,10000000.25\n");
+}
+
+BOOST_AUTO_TEST_CASE(ColumnarExporterTest) {
+  const size_t kRows = 1000;
+  {
+    ColumnarExporter exp(path, 300);
+    BOOST_REQUIRE(exp.Open(Exporter::GetRecordColumns()));
+    for (size_t i = 0; i < kRows; ++i) {
+      BOOST_REQUIRE(exp.WriteRecord({i * 0.1, i * 2.0}));
+    }
+    BOOST_CHECK(exp.Close());
+  }
+  ColumnarReader reader;
+  BOOST_REQUIRE(reader.Open(path));
+  BOOST_CHECK(reader.GetColumns() == Exporter::GetRecordColumns());
+  BOOST_CHECK(reader.GetRowsAmount() == kRows);
+  BOOST_REQUIRE(reader.GetChunks().size() == 4);
+  size_t row = 0;
+  bool   ok  = true;
+  for (const auto &chunk : reader.GetChunks()) {
+    for (size_t i = 0; i < chunk.rows; ++i, ++row) {
+      ok = ok && chunk.columns[0][i] == row * 0.1;
+      ok = ok && chunk.columns[1][i] == row * 2.0;
+    }
+  }
+  BOOST_CHECK(ok);
+  BOOST_CHECK(row == kRows);
+}
+
+BOOST_AUTO_TEST_CASE(ColumnarReaderInvalidTest) {
+  // offsets of fields of the file header
+  const uint64_t kColumnsField = 12;
+  const uint64_t kDataField    = 32;
+  ColumnarReader reader;
+  // names of columns do not fit before data
+  WriteColumnar(1000);
+  Patch<uint32_t>(kColumnsField, 1000000);
+  BOOST_CHECK(not reader.Open(path));
+  BOOST_CHECK(reader.GetMessage().find("Invalid format") == 0);
+  // empty chunk
+  WriteColumnar(1000);
+  const uint64_t kChunk = Peek<uint64_t>(kDataField);
+  Patch<uint64_t>(kChunk + sizeof(uint64_t), 0);
+  BOOST_CHECK(not reader.Open(path));
+  BOOST_CHECK(reader.GetMessage().find("Invalid format") == 0);
+  // rows of the chunk do not fit into its size
+  WriteColumnar(1000);
+  Patch<uint64_t>(kChunk, 1000000);
+  BOOST_CHECK(not reader.Open(path));
+  BOOST_CHECK(reader.GetMessage().find("Invalid format") == 0);
+  WriteColumnar(1000);
+  BOOST_CHECK(reader.Open(path));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
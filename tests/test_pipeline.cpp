@@ -0,0 +1,125 @@
+#include <boost/test/unit_test.hpp>
+#include <thread>
+#include "../src/collector/collector.hpp"
+#include "test_capture.hpp"
+
+struct PipelineTestFixture {
+  PipelineTestFixture()
+      : capture("pipeline") {
+    for (size_t i = 0; i < kRecords; ++i) {
+      capture.AddRecord(i * 0.01, 1e7 + i % 17);
+      if (i == 5000) {
+        capture.AddLine("broken line");
+      }
+    }
+    capture.Close();
+  }
+
+  /**
+   * Method for loading the capture into sample store.
+   */
+  SampleStore::ShrPtr Load(bool pipelined, double from, double to,
+                           Collector *cl) {
+    auto source = new FileDataSource(capture.path);
+    source->SetTimeWindow(from, to);
+    cl->UseDataSource(source);
+    cl->UseSampleStore(new SpillSampleStore(64 << 20));
+    cl->UseDetector(new Detector());
+    if (pipelined) {
+      cl->UsePipeline(new LoadingPipeline(1000, 4));
+    }
+    BOOST_REQUIRE(cl->Begin());
+    cl->FetchAllRecords();
+    cl->End();
+    return cl->GetSampleStore();
+  }
+
+  static void CheckSameRecords(SampleStore *a, SampleStore *b) {
+    BOOST_REQUIRE_EQUAL(a->GetSize(), b->GetSize());
+    VoidDataSource::Record rec_a;
+    VoidDataSource::Record rec_b;
+    for (uint64_t i = 0; i < a->GetSize(); ++i) {
+      BOOST_REQUIRE_EQUAL(a->ReadRecords(i, &rec_a, 1), 1);
+      BOOST_REQUIRE_EQUAL(b->ReadRecords(i, &rec_b, 1), 1);
+      BOOST_REQUIRE_EQUAL(rec_a.time,  rec_b.time);
+      BOOST_REQUIRE_EQUAL(rec_a.value, rec_b.value);
+    }
+  }
+
+  static const size_t kRecords = 30000;
+  TestCapture capture;
+};
+// -----------------------------------------------------------------------------
+// Инициализация набора тестов
+BOOST_FIXTURE_TEST_SUITE(PipelineTestSuite, PipelineTestFixture)
+
+BOOST_AUTO_TEST_CASE(SpscRingTest) {
+  const size_t kAmount = 200000;
+  SpscRing<size_t> ring(5);
+  BOOST_CHECK_EQUAL(ring.GetCapacity(), 8);
+  std::thread producer([&ring]() {
+    for (size_t i = 0; i < kAmount; ++i) {
+      while (not ring.TryPush(i)) {
+        std::this_thread::yield();
+      }
+    }
+  });
+  size_t expected = 0;
+  size_t item     = 0;
+  bool   ordered  = true;
+  while (expected < kAmount) {
+    if (ring.TryPop(&item)) {
+      ordered = ordered && item == expected;
+      ++expected;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  BOOST_CHECK(ordered);
+  BOOST_CHECK(not ring.TryPop(&item));
+}
+
+BOOST_AUTO_TEST_CASE(PipelineSameResultTest) {
+  const double kNan = std::nan("");
+  const double kWindows[][2] = {{kNan, kNan}, {12.345, 200.5}};
+  for (const auto &window : kWindows) {
+    Collector seq;
+    Collector pip;
+    seq.UseCompressor(new Compressor(100));
+    pip.UseCompressor(new Compressor(100));
+    auto seq_store = Load(false, window[0], window[1], &seq);
+    auto pip_store = Load(true,  window[0], window[1], &pip);
+    CheckSameRecords(seq_store.get(), pip_store.get());
+    // the broken line is reported after loading in both modes, 8 lines
+    // of header and 5001 records are before it, lines before the window
+    // are counted too
+    BOOST_CHECK(seq.GetMessages() == pip.GetMessages());
+    BOOST_REQUIRE_EQUAL(pip.GetMessages().size(), 1);
+    BOOST_CHECK_EQUAL(pip.GetMessages().front(),
+                      "Failed to parse line #5010");
+    const auto &seq_events = seq.GetDetector()->GetEvents();
+    const auto &pip_events = pip.GetDetector()->GetEvents();
+    BOOST_REQUIRE_EQUAL(seq_events.size(), pip_events.size());
+    for (size_t i = 0; i < seq_events.size(); ++i) {
+      BOOST_CHECK_EQUAL(seq_events[i].line, pip_events[i].line);
+    }
+    const auto &stat = pip.GetPipeline()->GetStatistics();
+    BOOST_CHECK(stat.parser.busy > 0);
+    BOOST_CHECK(stat.consumer.GetUtilization() <= 1);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(PipelineErrorTest) {
+  Collector cl;
+  cl.UseCompressor(new LimitedCompressor(12345));
+  auto store = Load(true, std::nan(""), std::nan(""), &cl);
+  BOOST_CHECK_EQUAL(store->GetSize(), 12345 + 1);
+  // the broken line is before the limit, so it is reported too
+  BOOST_REQUIRE_EQUAL(cl.GetMessages().size(), 2);
+  BOOST_CHECK_EQUAL(cl.GetMessages().front(), "Limit of records");
+  BOOST_CHECK_EQUAL(cl.GetMessages().back().find("Failed to parse line #"),
+                    0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,214 @@
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <random>
+#include <atomic>
+#include "../src/collector/psd.hpp"
+#include "../src/collector/parallel.hpp"
+
+struct PsdTestFixture {
+  static const uint32_t kChunkRecords = 4096;
+
+  /**
+   * Storage, which keeps only few chunks in memory, so spectrum is
+   * calculated from spilled records.
+   */
+  static SampleStore* CreateStore() {
+    return new SpillSampleStore(4 * kChunkRecords * 2 * sizeof(double),
+                                kChunkRecords);
+  }
+
+  static void FillSine(double freq, double amp, double rate, uint64_t amount,
+                       SampleStore *out) {
+    for (uint64_t i = 0; i < amount; ++i) {
+      const double kTime = i / rate;
+      BOOST_REQUIRE(out->PushRecord(VoidDataSource::Record(kTime,
+        amp * std::sin(2 * M_PI * freq * kTime)
+      )));
+    }
+  }
+
+  static void FillNoise(double sigma, double rate, uint64_t amount,
+                        SampleStore *out) {
+    std::mt19937 gen(3);
+    std::normal_distribution<double> dist(0, sigma);
+    for (uint64_t i = 0; i < amount; ++i) {
+      BOOST_REQUIRE(out->PushRecord(VoidDataSource::Record(i / rate,
+                                                           dist(gen))));
+    }
+  }
+};
+// -----------------------------------------------------------------------------
+// Инициализация набора тестов
+BOOST_FIXTURE_TEST_SUITE(PsdTestSuite, PsdTestFixture)
+
+BOOST_AUTO_TEST_CASE(FftTest) {
+  BOOST_CHECK_EQUAL(Fft(1000).GetSize(), 1024);
+  BOOST_CHECK_EQUAL(Fft(512).GetSize(),  512);
+  BOOST_CHECK(Fft::IsPowerOfTwo(64));
+  BOOST_CHECK(not Fft::IsPowerOfTwo(96));
+  // comparison with direct calculation of DFT
+  const size_t kSize = 256;
+  std::mt19937 gen(5);
+  std::uniform_real_distribution<double> dist(-1, 1);
+  std::vector<Fft::Complex> in(kSize);
+  for (auto &val : in) {
+    val = Fft::Complex(dist(gen), dist(gen));
+  }
+  std::vector<Fft::Complex> out(in);
+  Fft fft(kSize);
+  fft.Transform(out.data());
+  for (size_t k = 0; k < kSize; ++k) {
+    Fft::Complex sum(0, 0);
+    for (size_t n = 0; n < kSize; ++n) {
+      sum += in[n] * std::polar(1.0, -2 * M_PI * k * n / kSize);
+    }
+    BOOST_REQUIRE_SMALL(std::abs(out[k] - sum), 1e-9);
+  }
+  // inverse transform is not normalized
+  fft.Transform(out.data(), true);
+  for (size_t n = 0; n < kSize; ++n) {
+    BOOST_REQUIRE_SMALL(std::abs(out[n] / (double)kSize - in[n]), 1e-12);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ParallelForTest) {
+  const size_t kAmount = 1000;
+  const size_t kWorkers = 4;
+  std::vector<std::atomic<int>> visits(kAmount);
+  std::vector<size_t>           per_worker(kWorkers, 0);
+  ParallelFor(kAmount, [&](size_t index, size_t worker) {
+    ++visits[index];
+    ++per_worker[worker];
+  }, kWorkers);
+  for (const auto &visit : visits) {
+    BOOST_REQUIRE_EQUAL(visit.load(), 1);
+  }
+  size_t total = 0;
+  for (auto amount : per_worker) {
+    total += amount;
+  }
+  BOOST_CHECK_EQUAL(total, kAmount);
+  BOOST_CHECK_EQUAL(GetWorkersAmount(3), 3);
+  BOOST_CHECK(GetWorkersAmount() >= 1);
+}
+
+BOOST_AUTO_TEST_CASE(SinePeakTest) {
+  const double kRate = 1000;
+  const double kFreq = 125;
+  std::unique_ptr<SampleStore> store(CreateStore());
+  FillSine(kFreq, 2.0, kRate, 100000, store.get());
+  WelchPsd::Settings opts;
+  opts.segment_length = 1024;
+  WelchPsd psd(opts);
+  BOOST_REQUIRE(psd.Calculate(store.get()));
+  BOOST_CHECK_CLOSE(psd.GetSampleRate(), kRate, 1e-6);
+  BOOST_CHECK_EQUAL(psd.GetSegmentsAmount(), (100000 - 1024) / 512 + 1);
+  const auto &freqs   = psd.GetFrequencies();
+  const auto &density = psd.GetDensity();
+  BOOST_REQUIRE_EQUAL(freqs.size(), 513);
+  const auto kPeak = std::max_element(density.begin(), density.end())
+                   - density.begin();
+  BOOST_CHECK_CLOSE(freqs[kPeak], kFreq, 1e-6);
+  // integral of density is equal to power of the sine: amp^2 / 2
+  double power = 0;
+  for (auto val : density) {
+    power += val * kRate / 1024;
+  }
+  BOOST_CHECK_CLOSE(power, 2.0, 1.0);
+}
+
+BOOST_AUTO_TEST_CASE(WhiteNoiseTest) {
+  const double kRate  = 10;
+  const double kSigma = 0.5;
+  std::unique_ptr<SampleStore> store(CreateStore());
+  FillNoise(kSigma, kRate, 200000, store.get());
+  const WelchPsd::Window kWindows[] = {
+    WelchPsd::kRectangular, WelchPsd::kHann, WelchPsd::kHamming,
+    WelchPsd::kBlackman
+  };
+  for (auto window : kWindows) {
+    WelchPsd::Settings opts;
+    opts.segment_length = 256;
+    opts.window         = window;
+    WelchPsd psd(opts);
+    BOOST_REQUIRE(psd.Calculate(store.get()));
+    // one-sided density of white noise: 2 * sigma^2 / rate
+    const auto &density = psd.GetDensity();
+    double mean = 0;
+    for (size_t k = 1; k + 1 < density.size(); ++k) {
+      mean += density[k];
+    }
+    mean /= density.size() - 2;
+    BOOST_CHECK_CLOSE(mean, 2 * kSigma * kSigma / kRate, 3.0);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ThreadsTest) {
+  std::unique_ptr<SampleStore> store(CreateStore());
+  FillNoise(1.0, 1.0, 50000, store.get());
+  WelchPsd::Settings opts;
+  opts.segment_length = 512;
+  opts.overlap        = 0.75;
+  opts.batch_segments = 7;
+  opts.threads        = 1;
+  WelchPsd single(opts);
+  opts.threads = 4;
+  WelchPsd multi(opts);
+  BOOST_REQUIRE(single.Calculate(store.get()));
+  BOOST_REQUIRE(multi.Calculate(store.get()));
+  BOOST_REQUIRE_EQUAL(single.GetDensity().size(), multi.GetDensity().size());
+  for (size_t k = 0; k < single.GetDensity().size(); ++k) {
+    BOOST_REQUIRE_CLOSE(single.GetDensity()[k], multi.GetDensity()[k], 1e-9);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(PhaseNoiseTest) {
+  const double kNominal = 10e6;
+  std::unique_ptr<SampleStore> store(CreateStore());
+  FillNoise(1e-3, 1.0, 10000, store.get());
+  WelchPsd::Settings opts;
+  opts.segment_length = 128;
+  WelchPsd plain(opts);
+  BOOST_REQUIRE(plain.Calculate(store.get()));
+  BOOST_CHECK(plain.GetPhaseNoise().empty());
+  // values are deviations of frequency from nominal
+  std::unique_ptr<SampleStore> freqs(CreateStore());
+  SampleStore::Record rec;
+  for (uint64_t i = 0; i < store->GetSize(); ++i) {
+    BOOST_REQUIRE_EQUAL(store->ReadRecords(i, &rec, 1), 1);
+    rec.value = kNominal + rec.value;
+    BOOST_REQUIRE(freqs->PushRecord(rec));
+  }
+  opts.nominal = kNominal;
+  WelchPsd fractional(opts);
+  BOOST_REQUIRE(fractional.Calculate(freqs.get()));
+  const auto kNoise = fractional.GetPhaseNoise();
+  BOOST_REQUIRE_EQUAL(kNoise.size(), 65);
+  BOOST_CHECK(std::isnan(kNoise[0]));
+  for (size_t k = 1; k < kNoise.size(); ++k) {
+    const double kSy = plain.GetDensity()[k] / (kNominal * kNominal);
+    const double kF  = fractional.GetFrequencies()[k];
+    BOOST_REQUIRE_CLOSE(fractional.GetDensity()[k], kSy, 1e-3);
+    BOOST_REQUIRE_CLOSE(kNoise[k],
+      10 * std::log10(0.5 * kNominal * kNominal / (kF * kF) * kSy), 1e-3);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(InvalidTest) {
+  std::unique_ptr<SampleStore> store(CreateStore());
+  FillNoise(1.0, 1.0, 100, store.get());
+  WelchPsd::Settings opts;
+  WelchPsd psd(opts);
+  BOOST_CHECK(not psd.Calculate(store.get()));
+  BOOST_CHECK(not psd.GetMessage().empty());
+  opts.segment_length = 64;
+  opts.overlap        = 1.0;
+  WelchPsd overlapped(opts);
+  BOOST_CHECK(not overlapped.Calculate(store.get()));
+  WelchPsd::Window window;
+  BOOST_CHECK(WelchPsd::ParseWindow("blackman", &window));
+  BOOST_CHECK_EQUAL(window, WelchPsd::kBlackman);
+  BOOST_CHECK(not WelchPsd::ParseWindow("kaiser", &window));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,136 @@
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include "../src/collector/compressor.hpp"
+
+struct QuantileSketchTestFixture {
+  static double GetExact(std::vector<double> values, double q) {
+    std::sort(values.begin(), values.end());
+    return values[(size_t)std::llround(q * (values.size() - 1))];
+  }
+};
+// -----------------------------------------------------------------------------
+// Инициализация набора тестов
+BOOST_FIXTURE_TEST_SUITE(QuantileSketchTestSuite, QuantileSketchTestFixture)
+
+BOOST_AUTO_TEST_CASE(SmallSketchTest) {
+  QuantileSketch sketch;
+  BOOST_CHECK(sketch.IsEmpty());
+  BOOST_CHECK(std::isnan(sketch.GetQuantile(0.5, 0, 1)));
+  // values are kept exactly, until there are free centroids
+  for (int i = 1; i <= 5; ++i) {
+    sketch.Add(i);
+  }
+  BOOST_CHECK_EQUAL(sketch.GetWeight(), 5);
+  BOOST_CHECK_EQUAL(sketch.GetCentroidsAmount(), 5);
+  BOOST_CHECK_CLOSE(sketch.GetQuantile(0.5, 1, 5), 3.0, 1e-9);
+  BOOST_CHECK_CLOSE(sketch.GetQuantile(0.0, 1, 5), 1.0, 1e-9);
+  BOOST_CHECK_CLOSE(sketch.GetQuantile(1.0, 1, 5), 5.0, 1e-9);
+  // single value
+  QuantileSketch single;
+  single.Add(7);
+  BOOST_CHECK_EQUAL(single.GetQuantile(0.05, 7, std::nan("")), 7);
+  BOOST_CHECK_EQUAL(single.GetQuantile(0.95, 7, std::nan("")), 7);
+}
+
+BOOST_AUTO_TEST_CASE(AccuracyTest) {
+  // values with big nominal and small deviations
+  const double kNominal = 10e6;
+  std::mt19937 gen(11);
+  std::normal_distribution<double> dist(0, 0.1);
+  std::vector<double> values(20000);
+  QuantileSketch sketch;
+  for (auto &val : values) {
+    val = kNominal + dist(gen);
+    sketch.Add(val);
+  }
+  BOOST_CHECK_EQUAL(sketch.GetWeight(), values.size());
+  BOOST_CHECK(sketch.GetCentroidsAmount() <= QuantileSketch::kCentroids);
+  const double kMin = *std::min_element(values.begin(), values.end());
+  const double kMax = *std::max_element(values.begin(), values.end());
+  for (double q : {0.05, 0.25, 0.5, 0.75, 0.95}) {
+    const double kEstimated = sketch.GetQuantile(q, kMin, kMax);
+    // error is compared with sigma of distribution
+    BOOST_CHECK_SMALL(kEstimated - GetExact(values, q), 0.02);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(MergeTest) {
+  std::mt19937 gen(13);
+  std::exponential_distribution<double> dist(1.0);
+  std::vector<double> values;
+  // sketches are merged by pairs, like buckets of compressor
+  std::vector<QuantileSketch> sketches(64);
+  for (auto &sketch : sketches) {
+    for (int i = 0; i < 100; ++i) {
+      values.push_back(dist(gen));
+      sketch.Add(values.back());
+    }
+  }
+  while (sketches.size() > 1) {
+    std::vector<QuantileSketch> merged;
+    for (size_t i = 0; i < sketches.size(); i += 2) {
+      merged.push_back(sketches[i]);
+      merged.back().MergeWith(sketches[i + 1]);
+    }
+    sketches.swap(merged);
+  }
+  const double kMin = *std::min_element(values.begin(), values.end());
+  const double kMax = *std::max_element(values.begin(), values.end());
+  BOOST_CHECK_EQUAL(sketches[0].GetWeight(), values.size());
+  // error is compared with width of p5 - p95 band
+  const double kBand = GetExact(values, 0.95) - GetExact(values, 0.05);
+  for (double q : {0.05, 0.5, 0.95}) {
+    const double kExact = GetExact(values, q);
+    BOOST_CHECK_SMALL(sketches[0].GetQuantile(q, kMin, kMax) - kExact,
+                      0.03 * kBand);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(CompressorQuantilesTest) {
+  const uint32_t kSize   = 50;
+  const uint32_t kAmount = 100000;
+  Compressor plain(kSize);
+  Compressor comp(kSize);
+  comp.UseQuantiles(true);
+  BOOST_CHECK(comp.IsQuantilesUsed());
+  // every record of the buffer covers values [0, 99] uniformly
+  for (uint32_t i = 0; i < kAmount; ++i) {
+    BOOST_REQUIRE(plain.PushRecord(Compressor::Record(i, i % 100)));
+    BOOST_REQUIRE(comp.PushRecord(Compressor::Record(i, i % 100)));
+  }
+  // records without quantiles do not keep sketches at all
+  BOOST_CHECK(not plain.GetRecords().begin()->sketch);
+  BOOST_CHECK(sizeof(Compressor::Record) < sizeof(QuantileSketch));
+  BOOST_CHECK(std::isnan(plain.GetRecords().begin()->GetQuantile(0.5)));
+  // sketches survive merging of records
+  uint64_t weight = 0;
+  for (const auto &rec : comp.GetRecords()) {
+    BOOST_REQUIRE(rec.sketch);
+    BOOST_REQUIRE_EQUAL(rec.sketch->GetWeight(), rec.amount);
+    weight += rec.amount;
+    if (rec.amount < 1000) {
+      continue;
+    }
+    BOOST_CHECK_SMALL(rec.GetQuantile(0.05) - 5.0,  2.0);
+    BOOST_CHECK_SMALL(rec.GetQuantile(0.5)  - 50.0, 5.0);
+    BOOST_CHECK_SMALL(rec.GetQuantile(0.95) - 95.0, 2.0);
+  }
+  BOOST_CHECK_EQUAL(weight, kAmount);
+  // copy of the record has its own sketch
+  const Compressor::Record kCopy(*comp.GetRecords().begin());
+  BOOST_REQUIRE(kCopy.sketch);
+  BOOST_CHECK(kCopy.sketch != comp.GetRecords().begin()->sketch);
+  BOOST_CHECK_EQUAL(kCopy.GetQuantile(0.5),
+                    comp.GetRecords().begin()->GetQuantile(0.5));
+  Compressor::Range ratio;
+  BOOST_CHECK(comp.CastQuantileToScales(*comp.GetRecords().begin(), 0.5,
+                                        &ratio));
+  BOOST_CHECK(ratio.first >= 0 && ratio.first <= 1);
+  BOOST_CHECK(ratio.second >= 0 && ratio.second <= 1);
+  BOOST_CHECK(not plain.CastQuantileToScales(*plain.GetRecords().begin(),
+                                             0.5, &ratio));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
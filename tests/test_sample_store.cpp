@@ -0,0 +1,86 @@
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <random>
+#include "../src/collector/sample_store.hpp"
+
+struct SampleStoreTestFixture {
+  static const uint32_t kChunkRecords = 1000;
+  static const size_t   kChunkBytes   = kChunkRecords * 2 * sizeof(double);
+
+  static double GetTime(uint64_t index) {
+    return 0.01 * index;
+  }
+
+  static double GetValue(uint64_t index) {
+    return std::sin(0.001 * index) + index;
+  }
+
+  static void FillStore(uint64_t amount, SampleStore *out) {
+    for (uint64_t i = 0; i < amount; ++i) {
+      BOOST_REQUIRE(out->PushRecord(VoidDataSource::Record(GetTime(i),
+                                                           GetValue(i))));
+    }
+  }
+};
+// -----------------------------------------------------------------------------
+// Инициализация набора тестов
+BOOST_FIXTURE_TEST_SUITE(SampleStoreTestSuite, SampleStoreTestFixture)
+
+BOOST_AUTO_TEST_CASE(SpillTest) {
+  const uint64_t kAmount = 100500;
+  SpillSampleStore store(4 * kChunkBytes, kChunkRecords);
+  BOOST_CHECK_EQUAL(store.GetMaxResidentChunks(), 4);
+  FillStore(kAmount, &store);
+  BOOST_CHECK_EQUAL(store.GetSize(), kAmount);
+  BOOST_CHECK_EQUAL(store.GetResidentChunks(), 4);
+  BOOST_CHECK_EQUAL(store.GetSpilledBytes(), 97 * kChunkBytes);
+  // random access to spilled and resident chunks
+  std::mt19937 gen(17);
+  std::uniform_int_distribution<uint64_t> pos_dist(0, kAmount - 1);
+  std::vector<VoidDataSource::Record> recs(2500);
+  for (int i = 0; i < 200; ++i) {
+    const uint64_t kFirst = pos_dist(gen);
+    const size_t   kRead  = store.ReadRecords(kFirst, recs.data(), recs.size());
+    BOOST_REQUIRE_EQUAL(kRead, std::min<uint64_t>(recs.size(),
+                                                  kAmount - kFirst));
+    for (size_t r = 0; r < kRead; ++r) {
+      BOOST_REQUIRE_EQUAL(recs[r].time,  GetTime(kFirst + r));
+      BOOST_REQUIRE_EQUAL(recs[r].value, GetValue(kFirst + r));
+    }
+    BOOST_REQUIRE(store.GetResidentChunks() <= 4);
+  }
+  // full chunks are written only once
+  BOOST_CHECK_EQUAL(store.GetSpilledBytes(), 100 * kChunkBytes);
+  BOOST_CHECK_EQUAL(store.ReadRecords(kAmount, recs.data(), 1), 0);
+  // pushing after reading
+  FillStore(10, &store);
+  BOOST_CHECK_EQUAL(store.GetSize(), kAmount + 10);
+  BOOST_REQUIRE_EQUAL(store.ReadRecords(kAmount - 1, recs.data(), 3), 3);
+  BOOST_CHECK_EQUAL(recs[0].time, GetTime(kAmount - 1));
+  BOOST_CHECK_EQUAL(recs[2].time, GetTime(1));
+}
+
+BOOST_AUTO_TEST_CASE(FillCompressorTest) {
+  const uint64_t kAmount = 50000;
+  SpillSampleStore store(2 * kChunkBytes, kChunkRecords);
+  FillStore(kAmount, &store);
+  BOOST_CHECK_EQUAL(store.FindRecord(-1.0), 0);
+  BOOST_CHECK_EQUAL(store.FindRecord(GetTime(12345)), 12345);
+  BOOST_CHECK_EQUAL(store.FindRecord(GetTime(12345) - 0.005), 12345);
+  BOOST_CHECK_EQUAL(store.FindRecord(GetTime(kAmount)), kAmount);
+  Compressor comp(100);
+  BOOST_REQUIRE(store.FillCompressor(GetTime(20000), GetTime(29999), &comp));
+  const auto &recs = comp.GetRecords();
+  BOOST_REQUIRE(not recs.empty());
+  uint64_t pushed = 0;
+  for (const auto &rec : recs) {
+    pushed += rec.amount;
+  }
+  BOOST_CHECK_EQUAL(pushed, 10000);
+  BOOST_CHECK_EQUAL(recs.front().time.first, GetTime(20000));
+  const auto &kLast = recs.back().time;
+  BOOST_CHECK_EQUAL(std::isnan(kLast.second) ? kLast.first : kLast.second,
+                    GetTime(29999));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,227 @@
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include <mutex>
+#include "../src/collector/collector.hpp"
+#include "../src/collector/parallel.hpp"
+#include "test_capture.hpp"
+
+/**
+ * Compressor, which cancels loading like GUI thread after the limit of
+ * records.
+ */
+class CancellingCompressor : public Compressor {
+  public:
+    CancellingCompressor(const CancelToken::ShrPtr &token, size_t limit)
+        : Compressor(100),
+          _token(token),
+          _limit(limit) {
+    }
+    virtual bool PushRecord(Record &&new_rec) {
+      if (GetPushedRecords() + 1 >= _limit) {
+        _token->Cancel();
+      }
+      return Compressor::PushRecord(std::move(new_rec));
+    }
+  private:
+    CancelToken::ShrPtr _token;
+    const size_t        _limit;
+};
+
+struct SchedulerTestFixture {
+  SchedulerTestFixture()
+      : release(false),
+        started(false) {
+  }
+  /**
+   * Method for occupying the only worker of scheduler, so the following
+   * tasks are queued until "release".
+   */
+  void Occupy(TaskScheduler *scheduler, TaskScheduler::Group *group) {
+    scheduler->Run([this]() {
+      started = true;
+      while (not release) {
+        std::this_thread::yield();
+      }
+    }, TaskScheduler::kLowPriority, group);
+    while (not started) {
+      std::this_thread::yield();
+    }
+  }
+  /**
+   * Method for waiting without executing tasks by the test thread.
+   */
+  static void Poll(const TaskScheduler::Group &group) {
+    while (not group.IsFinished()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  std::atomic<bool> release;
+  std::atomic<bool> started;
+};
+// -----------------------------------------------------------------------------
+// Инициализация набора тестов
+BOOST_FIXTURE_TEST_SUITE(SchedulerTestSuite, SchedulerTestFixture)
+
+BOOST_AUTO_TEST_CASE(RunTest) {
+  const size_t kAmount = 16;
+  TaskScheduler scheduler(4);
+  BOOST_CHECK_EQUAL(scheduler.GetThreadsAmount(), 4);
+  std::vector<std::atomic<int>> visits(kAmount * kAmount);
+  TaskScheduler::Group group;
+  // every task adds its own tasks and waits them
+  for (size_t i = 0; i < kAmount; ++i) {
+    scheduler.Run([&scheduler, &visits, i, kAmount]() {
+      TaskScheduler::Group nested;
+      for (size_t k = 0; k < kAmount; ++k) {
+        scheduler.Run([&visits, i, k, kAmount]() {
+          ++visits[i * kAmount + k];
+        }, TaskScheduler::GetCurrentPriority(), &nested);
+      }
+      scheduler.Wait(&nested);
+      BOOST_CHECK(nested.IsFinished());
+    }, TaskScheduler::kLowPriority, &group);
+  }
+  scheduler.Wait(&group);
+  for (const auto &visit : visits) {
+    BOOST_REQUIRE_EQUAL(visit.load(), 1);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(PriorityTest) {
+  TaskScheduler        scheduler(1);
+  TaskScheduler::Group group;
+  std::mutex           mutex;
+  std::vector<int>     order;
+  Occupy(&scheduler, &group);
+  for (int i = 0; i < 10; ++i) {
+    const auto kPriority = i % 2 ? TaskScheduler::kHighPriority
+                                 : TaskScheduler::kLowPriority;
+    scheduler.Run([&mutex, &order, kPriority]() {
+      BOOST_CHECK_EQUAL(TaskScheduler::GetCurrentPriority(), kPriority);
+      std::lock_guard<std::mutex> lock(mutex);
+      order.push_back(kPriority);
+    }, kPriority, &group);
+  }
+  release = true;
+  Poll(group);
+  BOOST_REQUIRE_EQUAL(order.size(), 10);
+  for (size_t i = 0; i < order.size(); ++i) {
+    BOOST_CHECK_EQUAL(order[i], i < 5 ? TaskScheduler::kHighPriority
+                                      : TaskScheduler::kLowPriority);
+  }
+  BOOST_CHECK_EQUAL(TaskScheduler::GetCurrentPriority(),
+                    TaskScheduler::kHighPriority);
+}
+
+BOOST_AUTO_TEST_CASE(CancelTest) {
+  TaskScheduler        scheduler(1);
+  TaskScheduler::Group group;
+  auto                 token = std::make_shared<CancelToken>();
+  std::atomic<int>     executed(0);
+  Occupy(&scheduler, &group);
+  for (int i = 0; i < 10; ++i) {
+    scheduler.Run([&executed]() { ++executed; }, TaskScheduler::kLowPriority,
+                  &group, token);
+  }
+  token->Cancel();
+  release = true;
+  Poll(group);
+  BOOST_CHECK_EQUAL(executed.load(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(StolenTest) {
+  TaskScheduler        scheduler(1);
+  TaskScheduler::Group busy;
+  TaskScheduler::Group group;
+  Occupy(&scheduler, &busy);
+  std::atomic<int> executed(0);
+  scheduler.Run([&executed]() { ++executed; }, TaskScheduler::kHighPriority,
+                &group);
+  // the task is executed by the waiting thread, it is not stolen
+  scheduler.Wait(&group);
+  BOOST_CHECK_EQUAL(executed.load(), 1);
+  BOOST_CHECK_EQUAL(scheduler.GetStolenTasks(), 0);
+  release = true;
+  Poll(busy);
+}
+
+BOOST_AUTO_TEST_CASE(CheckpointWriterTest) {
+  // all workers of the shared scheduler are occupied by batch jobs
+  TaskScheduler       &shared = TaskScheduler::GetShared();
+  TaskScheduler::Group busy;
+  std::atomic<size_t>  occupied(0);
+  for (size_t i = 0; i < shared.GetThreadsAmount(); ++i) {
+    shared.Run([this, &occupied]() {
+      ++occupied;
+      while (not release) {
+        std::this_thread::yield();
+      }
+    }, TaskScheduler::kLowPriority, &busy);
+  }
+  while (occupied < shared.GetThreadsAmount()) {
+    std::this_thread::yield();
+  }
+  TestCapture capture("scheduler_checkpoint");
+  capture.Close();
+  const std::string kPath = capture.path + ".ckpt";
+  {
+    CheckpointWriter writer(kPath, 0);
+    writer.Save(Checkpoint());
+    BOOST_CHECK_EQUAL(writer.GetWritten(), 0);
+    // the task of writer is not started, so the loading thread writes
+    writer.Save(Checkpoint());
+    BOOST_CHECK_EQUAL(writer.GetWritten(), 1);
+    release = true;
+    BOOST_CHECK(writer.Flush());
+    BOOST_CHECK_EQUAL(writer.GetWritten(), 1);
+  }
+  Poll(busy);
+  std::remove(kPath.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(ParallelForTest) {
+  // nested loops are executed by workers of the shared scheduler
+  const size_t kAmount = 8;
+  std::vector<std::atomic<int>> visits(kAmount * kAmount);
+  ParallelFor(kAmount, [&visits, kAmount](size_t i, size_t) {
+    ParallelFor(kAmount, [&visits, i, kAmount](size_t k, size_t) {
+      ++visits[i * kAmount + k];
+    }, 4);
+  }, 4);
+  for (const auto &visit : visits) {
+    BOOST_REQUIRE_EQUAL(visit.load(), 1);
+  }
+  BOOST_CHECK(not TaskScheduler::SetSharedThreads(2));
+  BOOST_CHECK_EQUAL(GetWorkersAmount(),
+                    TaskScheduler::GetShared().GetThreadsAmount());
+}
+
+BOOST_AUTO_TEST_CASE(CollectorCancelTest) {
+  const size_t kLimit = 3000;
+  TestCapture capture("scheduler");
+  for (size_t i = 0; i < 10000; ++i) {
+    capture.AddRecord(i * 0.01, 1e7 + std::sin(0.01 * i));
+  }
+  capture.Close();
+  auto token = new CancelToken();
+  Collector cl;
+  cl.UseCancelToken(token);
+  cl.UseCompressor(new CancellingCompressor(cl.GetCancelToken(), kLimit));
+  cl.UseDataSource(new FileDataSource(capture.path));
+  BOOST_REQUIRE(cl.Begin());
+  // loading is a batch task, test thread waits it like GUI
+  bool loaded = true;
+  TaskScheduler::Group group;
+  TaskScheduler::GetShared().Run([&cl, &loaded]() {
+    loaded = cl.FetchAllRecords();
+  }, TaskScheduler::kLowPriority, &group);
+  TaskScheduler::GetShared().Wait(&group);
+  cl.End();
+  BOOST_CHECK(not loaded);
+  BOOST_CHECK_EQUAL(cl.GetCompressor()->GetPushedRecords(), kLimit);
+  BOOST_REQUIRE(not cl.GetMessages().empty());
+  BOOST_CHECK_EQUAL(cl.GetMessages().back(), "Loading is cancelled");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,144 @@
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <thread>
+#include <unistd.h>
+#include "../src/collector/collector.hpp"
+#include "../src/collector/shared_view.hpp"
+#include "test_capture.hpp"
+
+struct SharedViewTestFixture {
+  SharedViewTestFixture()
+      : name("/orolia_test_view_" + std::to_string(::getpid())) {
+  }
+
+  static void CheckSame(const Compressor &expected, const Compressor &comp) {
+    BOOST_CHECK_EQUAL(comp.GetPushedRecords(), expected.GetPushedRecords());
+    BOOST_CHECK(comp.GetTimeScale()  == expected.GetTimeScale());
+    BOOST_CHECK(comp.GetValueScale() == expected.GetValueScale());
+    BOOST_CHECK_EQUAL(comp.IsQuantilesUsed(), expected.IsQuantilesUsed());
+    const auto &kExpected = expected.GetRecords();
+    const auto &kRecords  = comp.GetRecords();
+    BOOST_REQUIRE_EQUAL(kRecords.size(), kExpected.size());
+    auto exp_it = kExpected.begin();
+    for (const auto &rec : kRecords) {
+      BOOST_REQUIRE_EQUAL(rec.time.first,   exp_it->time.first);
+      BOOST_REQUIRE_EQUAL(rec.value.first,  exp_it->value.first);
+      BOOST_REQUIRE_EQUAL(rec.amount,       exp_it->amount);
+      if (expected.IsQuantilesUsed()) {
+        BOOST_REQUIRE_EQUAL(rec.GetQuantile(0.5), exp_it->GetQuantile(0.5));
+      }
+      ++exp_it;
+    }
+  }
+
+  const std::string name;
+};
+// -----------------------------------------------------------------------------
+// Инициализация набора тестов
+BOOST_FIXTURE_TEST_SUITE(SharedViewTestSuite, SharedViewTestFixture)
+
+BOOST_AUTO_TEST_CASE(PublishTest) {
+  SharedViewReader reader;
+  BOOST_CHECK(not reader.Attach(name));
+  Compressor comp(100);
+  comp.UseQuantiles(true);
+  for (int i = 0; i < 10000; ++i) {
+    BOOST_REQUIRE(comp.PushRecord(Compressor::Record(0.01 * i, i % 7)));
+  }
+  SharedViewWriter writer(name, 100);
+  BOOST_CHECK(not writer.Publish(comp));
+  BOOST_REQUIRE(writer.Open());
+  BOOST_REQUIRE(reader.Attach(name));
+  BOOST_CHECK_EQUAL(reader.GetMaxRecords(), 100);
+  Compressor view(1);
+  BOOST_CHECK(not reader.HasNewVersion());
+  BOOST_CHECK(not reader.Read(&view));
+  BOOST_REQUIRE(writer.Publish(comp));
+  BOOST_CHECK(reader.HasNewVersion());
+  SharedViewReader::Statistics stat;
+  BOOST_REQUIRE(reader.Read(&view, &stat));
+  BOOST_CHECK(not reader.HasNewVersion());
+  BOOST_CHECK_EQUAL(stat.version, 1);
+  BOOST_CHECK_EQUAL(stat.pushed, 10000);
+  BOOST_CHECK(not stat.finished);
+  CheckSame(comp, view);
+  // the next publication goes into another slot
+  for (int i = 10000; i < 10500; ++i) {
+    BOOST_REQUIRE(comp.PushRecord(Compressor::Record(0.01 * i, -1)));
+  }
+  BOOST_REQUIRE(writer.Publish(comp, true));
+  BOOST_REQUIRE(reader.Read(&view, &stat));
+  BOOST_CHECK_EQUAL(stat.version, 2);
+  BOOST_CHECK(stat.finished);
+  CheckSame(comp, view);
+  // compressor with more buckets does not fit
+  Compressor big(200);
+  for (int i = 0; i < 200; ++i) {
+    BOOST_REQUIRE(big.PushRecord(Compressor::Record(i, i)));
+  }
+  BOOST_CHECK(not writer.Publish(big));
+}
+
+BOOST_AUTO_TEST_CASE(ConcurrentReadTest) {
+  // every publication has buckets with the same value, so mixing of two
+  // publications is visible
+  SharedViewWriter writer(name, 500);
+  BOOST_REQUIRE(writer.Open());
+  std::atomic<bool> stop(false);
+  std::thread publisher([&writer, &stop]() {
+    for (int pub = 0; not stop; ++pub) {
+      Compressor comp(500);
+      for (int i = 0; i < 100 + pub % 400; ++i) {
+        comp.PushRecord(Compressor::Record(i, pub));
+      }
+      writer.Publish(comp);
+    }
+  });
+  SharedViewReader reader;
+  BOOST_REQUIRE(reader.Attach(name));
+  Compressor view(1);
+  int read = 0;
+  for (int i = 0; i < 1000000 && read < 500; ++i) {
+    SharedViewReader::Statistics stat;
+    if (not reader.Read(&view, &stat)) {
+      std::this_thread::yield();
+      continue;
+    }
+    ++read;
+    const auto &records = view.GetRecords();
+    BOOST_REQUIRE_EQUAL(records.size(), stat.pushed);
+    for (const auto &rec : records) {
+      BOOST_REQUIRE_EQUAL(rec.value.first, records.front().value.first);
+    }
+  }
+  stop = true;
+  publisher.join();
+  BOOST_CHECK_EQUAL(read, 500);
+}
+
+BOOST_AUTO_TEST_CASE(CollectorTest) {
+  TestCapture capture("shared_view");
+  for (int i = 0; i < 50000; ++i) {
+    capture.AddRecord(0.01 * i, 1e7 + i % 100);
+  }
+  capture.Close();
+  Collector cl;
+  cl.UseCompressor(new Compressor(300));
+  cl.UseDataSource(new FileDataSource(capture.path));
+  cl.UsePublisher(new SharedViewWriter(name, 300, 0));
+  BOOST_REQUIRE(cl.Begin());
+  SharedViewReader reader;
+  BOOST_REQUIRE(reader.Attach(name));
+  BOOST_REQUIRE(cl.FetchAllRecords());
+  // state is published during loading too
+  BOOST_CHECK(cl.GetPublisher()->GetVersion() > 1);
+  cl.End();
+  Compressor view(1);
+  SharedViewReader::Statistics stat;
+  BOOST_REQUIRE(reader.Read(&view, &stat));
+  BOOST_CHECK(stat.finished);
+  BOOST_CHECK_EQUAL(stat.pushed, 50000);
+  CheckSame(*cl.GetCompressor(), view);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,91 @@
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include "../src/collector/data_source.hpp"
+#include "test_capture.hpp"
+
+struct TimeIndexTestFixture {
+  TimeIndexTestFixture()
+      : capture("time_index") {
+    for (size_t i = 0; i < kRecords; ++i) {
+      capture.AddRecord(i * 0.01, 1e7 + i % 13);
+    }
+    capture.Close();
+  }
+  ~TimeIndexTestFixture() {}
+
+  size_t ReadWindow(VoidDataSource *src, double *first, double *last) {
+    VoidDataSource::Record rec;
+    size_t amount = 0;
+    BOOST_REQUIRE(src->OccupySource());
+    while (not src->IsAtTheEnd()) {
+      if (src->GetRecord(&rec)) {
+        if (amount == 0) {
+          *first = rec.time;
+        }
+        *last = rec.time;
+        ++amount;
+      }
+    }
+    src->ReleaseSource();
+    return amount;
+  }
+
+  static const size_t kRecords = 100000;
+  TestCapture capture;
+};
+// -----------------------------------------------------------------------------
+// Инициализация набора тестов
+BOOST_FIXTURE_TEST_SUITE(TimeIndexTestSuite, TimeIndexTestFixture)
+
+BOOST_AUTO_TEST_CASE(TimeIndexFindBeforeTest) {
+  TimeIndex idx;
+  TimeIndex::Entry entry;
+  BOOST_CHECK(not idx.FindBefore(1.0, &entry));
+  BOOST_CHECK(idx.AddEntry({1.0, 100, 10}));
+  BOOST_CHECK(idx.AddEntry({2.0, 200, 20}));
+  BOOST_CHECK(idx.AddEntry({3.0, 300, 30}));
+  // offsets must grow
+  BOOST_CHECK(not idx.AddEntry({4.0, 300, 40}));
+  BOOST_CHECK(not idx.FindBefore(1.0, &entry));
+  BOOST_CHECK(idx.FindBefore(2.0, &entry));
+  BOOST_CHECK(entry.offset == 100);
+  BOOST_CHECK(idx.FindBefore(2.5, &entry));
+  BOOST_CHECK(entry.offset == 200);
+  BOOST_CHECK(idx.FindBefore(10.0, &entry));
+  BOOST_CHECK(entry.line == 30);
+}
+
+BOOST_AUTO_TEST_CASE(FileDataSourceWindowBySearchTest) {
+  FileDataSource src(capture.path);
+  src.SetTimeWindow(500.0, 510.0);
+  double first = 0;
+  double last  = 0;
+  BOOST_CHECK(ReadWindow(&src, &first, &last) == 1001);
+  BOOST_CHECK(std::fabs(first - 500.0) < 1e-9);
+  BOOST_CHECK(std::fabs(last  - 510.0) < 1e-9);
+  // records after binary search are not indexed
+  BOOST_CHECK(src.GetTimeIndex().IsEmpty());
+  // lines before the window are counted, 8 lines of header go first
+  VoidDataSource::Record rec;
+  VoidDataSource *base = &src;
+  BOOST_REQUIRE(base->OccupySource());
+  while (not base->GetRecord(&rec) && not base->IsAtTheEnd()) {
+  }
+  BOOST_CHECK_SMALL(rec.time - 500.0, 1e-9);
+  BOOST_CHECK_EQUAL(base->GetLineNumber(), 50009);
+  base->ReleaseSource();
+}
+
+BOOST_AUTO_TEST_CASE(FileDataSourceWindowByIndexTest) {
+  FileDataSource src(capture.path);
+  double first = 0;
+  double last  = 0;
+  BOOST_CHECK(ReadWindow(&src, &first, &last) == kRecords);
+  BOOST_CHECK(not src.GetTimeIndex().IsEmpty());
+  src.SetTimeWindow(123.45, std::nan(""));
+  BOOST_CHECK(ReadWindow(&src, &first, &last) == kRecords - 12345);
+  BOOST_CHECK(std::fabs(first - 123.45) < 1e-9);
+  BOOST_CHECK(std::fabs(last  - (kRecords - 1) * 0.01) < 1e-9);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
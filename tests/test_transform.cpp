@@ -0,0 +1,118 @@
+#include <boost/test/unit_test.hpp>
+#include <cmath>
+#include "../src/collector/collector.hpp"
+#include "test_capture.hpp"
+
+struct TransformTestFixture {
+  typedef VoidDataSource::Record Record;
+
+  template <class Pipe>
+  static std::vector<Record> Apply(Pipe &pipe, size_t amount) {
+    std::vector<Record> out;
+    for (size_t i = 0; i < amount; ++i) {
+      Record rec(i, 10 + i);
+      if (pipe(rec)) {
+        out.push_back(rec);
+      }
+    }
+    return out;
+  }
+};
+// -----------------------------------------------------------------------------
+// Инициализация набора тестов
+BOOST_FIXTURE_TEST_SUITE(TransformTestSuite, TransformTestFixture)
+
+BOOST_AUTO_TEST_CASE(TransformStagesTest) {
+  Record rec(1, 10000100);
+  BOOST_CHECK(transform::FractionalFrequency(1e7)(rec));
+  BOOST_CHECK_CLOSE(rec.value, 1e-5, 1e-9);
+  rec.value = 2;
+  BOOST_CHECK(transform::Scale(3, 1)(rec));
+  BOOST_CHECK_EQUAL(rec.value, 7);
+  // moving average of 10, 11, 12, ...
+  transform::MovingAverage ma(3);
+  const auto kAveraged = Apply(ma, 10);
+  BOOST_REQUIRE_EQUAL(kAveraged.size(), 10);
+  BOOST_CHECK_EQUAL(kAveraged[0].value, 10);
+  BOOST_CHECK_EQUAL(kAveraged[1].value, 10.5);
+  for (size_t i = 2; i < kAveraged.size(); ++i) {
+    BOOST_CHECK_CLOSE(kAveraged[i].value, 10 + i - 1, 1e-12);
+  }
+  transform::Decimate dec(4);
+  const auto kDecimated = Apply(dec, 10);
+  BOOST_REQUIRE_EQUAL(kDecimated.size(), 3);
+  BOOST_CHECK_EQUAL(kDecimated[2].time, 8);
+  transform::RemoveDrift drift(1);
+  const auto kFlat = Apply(drift, 5);
+  for (const auto &r : kFlat) {
+    BOOST_CHECK_EQUAL(r.value, 10);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TransformComposeTest) {
+  auto pipe = transform::Compose(transform::Decimate(2),
+                                 transform::Scale(2),
+                                 transform::MovingAverage(2));
+  const auto kOut = Apply(pipe, 6);
+  // decimated values: 10, 12, 14; scaled: 20, 24, 28; averaged
+  BOOST_REQUIRE_EQUAL(kOut.size(), 3);
+  BOOST_CHECK_EQUAL(kOut[0].value, 20);
+  BOOST_CHECK_EQUAL(kOut[1].value, 22);
+  BOOST_CHECK_EQUAL(kOut[2].value, 26);
+  // runtime chain gives the same result
+  TransformChain chain;
+  BOOST_REQUIRE(chain.AddStages("decimate:2,scale:2,ma:2"));
+  const auto kChainOut = Apply(chain, 6);
+  BOOST_REQUIRE_EQUAL(kChainOut.size(), 3);
+  for (size_t i = 0; i < kOut.size(); ++i) {
+    BOOST_CHECK_EQUAL(kChainOut[i].value, kOut[i].value);
+  }
+  TransformChain invalid;
+  BOOST_CHECK(not invalid.AddStages("scale:2,unknown:1"));
+  BOOST_CHECK(not invalid.AddStages("ma:x"));
+  BOOST_CHECK(not invalid.AddStages("decimate"));
+  // windows and factors are integer and limited
+  BOOST_CHECK(not invalid.AddStages("ma:1e12"));
+  BOOST_CHECK(not invalid.AddStages("ma:2.5"));
+  BOOST_CHECK(not invalid.AddStages("decimate:1e10"));
+  BOOST_CHECK(not invalid.AddStages("decimate:0.5"));
+  BOOST_CHECK(invalid.IsEmpty());
+}
+
+BOOST_AUTO_TEST_CASE(TransformCollectorTest) {
+  TestCapture capture("transform");
+  for (size_t i = 0; i < 1000; ++i) {
+    capture.AddRecord(i * 0.01, 1e7 + (i % 2 ? 1 : -1));
+  }
+  capture.Close();
+  Collector cl;
+  cl.UseCompressor(new Compressor(100));
+  cl.UseDataSource(new FileDataSource(capture.path));
+  cl.UseSampleStore(new SpillSampleStore(1 << 20));
+  auto pipe = transform::Compose(transform::FractionalFrequency(1e7),
+                                 transform::MovingAverage(2),
+                                 transform::Decimate(10));
+  BOOST_REQUIRE(cl.Begin());
+  BOOST_REQUIRE(cl.FetchAllRecords(pipe));
+  cl.End();
+  const auto kStore = cl.GetSampleStore();
+  BOOST_REQUIRE_EQUAL(kStore->GetSize(), 100);
+  Record rec;
+  BOOST_REQUIRE_EQUAL(kStore->ReadRecords(99, &rec, 1), 1);
+  BOOST_CHECK_CLOSE(rec.time, 9.9, 1e-9);
+  BOOST_CHECK_SMALL(rec.value, 1e-15);
+  // stages are applied only to one series of records
+  Collector channels;
+  std::unique_ptr<TransformChain> chain(new TransformChain());
+  BOOST_REQUIRE(chain->AddStages("ma:2"));
+  channels.UseCompressor(new Compressor(100));
+  channels.UseDataSource(new FileDataSource(capture.path));
+  channels.UseChannels(VoidDataSource::Channels({0, 1}));
+  channels.UseTransform(chain.release());
+  BOOST_CHECK(not channels.Begin());
+  BOOST_REQUIRE(not channels.GetMessages().empty());
+  BOOST_CHECK_EQUAL(channels.GetMessages().back(),
+                    "Transform of records does not support several channels");
+}
+
+BOOST_AUTO_TEST_SUITE_END()